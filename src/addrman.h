@@ -17,6 +17,10 @@
 #include <stdint.h>
 #include <vector>
 
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/unordered_map.hpp>
+
 /** 
  * Extended statistics about a CAddress 
  */
@@ -41,7 +45,7 @@ private:
     //! in tried set? (memory only)
     bool fInTried;
 
-    //! position in vRandom
+    //! position in vRandom (-1 for an unused slot in CAddrMan::vInfo)
     int nRandomPos;
 
     friend class CAddrMan;
@@ -101,6 +105,25 @@ public:
 
 };
 
+/** Salted hash of a network address, for the address index of CAddrMan */
+class CNetAddrHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CNetAddrHasher() : salt(GetRandHash()) {}
+
+    size_t operator()(const CNetAddr& addr) const
+    {
+        uint256 key;
+        unsigned char* pkey = key.begin();
+        for (int n = 0; n < 16; n++)
+            pkey[n] = addr.GetByte(n);
+        return key.GetHash(salt);
+    }
+};
+
 /** Stochastic address manager
  *
  * Design goals:
@@ -125,6 +148,10 @@ public:
  *      be observable by adversaries.
  *    * Several indexes are kept for high performance. Defining DEBUG_ADDRMAN will introduce frequent (and expensive)
  *      consistency checks for the entire data structure.
+ *  * Entries live in one contiguous vector indexed by nId (slots of deleted entries are reused), addresses are
+ *    found through a salted hash index.
+ *  * The tables are guarded by a reader/writer lock: Select and serialization only read them and run
+ *    concurrently with each other, everything that modifies an entry takes the lock exclusively.
  */
 
 //! total number of buckets for tried addresses
@@ -169,20 +196,20 @@ public:
 class CAddrMan
 {
 private:
-    //! critical section to protect the inner data structures
-    mutable CCriticalSection cs;
+    //! reader/writer lock to protect the inner data structures
+    mutable boost::shared_mutex cs;
 
     //! secret key to randomize bucket select with
     uint256 nKey;
 
-    //! last used nId
-    int nIdCount;
+    //! information about all nIds, indexed by nId; unused slots have nRandomPos == -1
+    std::vector<CAddrInfo> vInfo;
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    //! unused slots in vInfo, reused before vInfo grows
+    std::vector<int> vFreeIds;
 
     //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr;
+    boost::unordered_map<CNetAddr, int, CNetAddrHasher> mapAddr;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -204,8 +231,7 @@ protected:
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int *pnId = NULL);
 
-    //! find an entry, creating it if necessary.
-    //! nTime and nServices of the found node are updated, if necessary.
+    //! Create a new entry. This may move other entries, invalidating pointers to them.
     CAddrInfo* Create(const CAddress &addr, const CNetAddr &addrSource, int *pnId = NULL);
 
     //! Swap two elements in vRandom.
@@ -229,15 +255,17 @@ protected:
     //! Mark an entry as attempted to connect.
     void Attempt_(const CService &addr, int64_t nTime);
 
-    //! Select an address to connect to.
-    //! nUnkBias determines how much to favor new addresses over tried ones (min=0, max=100)
-    CAddress Select_();
+    //! Select an address to connect to. Only reads the tables.
+    CAddress Select_() const;
 
 #ifdef DEBUG_ADDRMAN
     //! Perform consistency check. Returns an error code or zero.
-    int Check_();
+    int Check_() const;
 #endif
 
+    //! Reset all tables and pick a new key.
+    void Clear_();
+
     //! Select several addresses at once.
     void GetAddr_(std::vector<CAddress> &vAddr);
 
@@ -262,7 +290,7 @@ public:
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
      *
-     * Notice that vvTried, mapAddr and vVector are never encoded explicitly;
+     * Notice that vvTried, mapAddr and vRandom are never encoded explicitly;
      * they are instead reconstructed from the other information.
      *
      * vvNew is serialized, but only used if ADDRMAN_UNKOWN_BUCKET_COUNT didn't change,
@@ -277,7 +305,7 @@ public:
     template<typename Stream>
     void Serialize(Stream &s, int nType, int nVersionDummy) const
     {
-        LOCK(cs);
+        boost::shared_lock<boost::shared_mutex> lock(cs);
 
         unsigned char nVersion = 1;
         s << nVersion;
@@ -288,20 +316,20 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::vector<int> vUnkIds(vInfo.size(), -1);
         int nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            mapUnkIds[(*it).first] = nIds;
-            const CAddrInfo &info = (*it).second;
+        for (size_t nId = 0; nId < vInfo.size(); nId++) {
+            const CAddrInfo &info = vInfo[nId];
             if (info.nRefCount) {
                 assert(nIds != nNew); // this means nNew was wrong, oh ow
+                vUnkIds[nId] = nIds;
                 s << info;
                 nIds++;
             }
         }
         nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            const CAddrInfo &info = (*it).second;
+        for (size_t nId = 0; nId < vInfo.size(); nId++) {
+            const CAddrInfo &info = vInfo[nId];
             if (info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
@@ -317,7 +345,7 @@ public:
             s << nSize;
             for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
                 if (vvNew[bucket][i] != -1) {
-                    int nIndex = mapUnkIds[vvNew[bucket][i]];
+                    int nIndex = vUnkIds[vvNew[bucket][i]];
                     s << nIndex;
                 }
             }
@@ -327,9 +355,9 @@ public:
     template<typename Stream>
     void Unserialize(Stream& s, int nType, int nVersionDummy)
     {
-        LOCK(cs);
+        boost::unique_lock<boost::shared_mutex> lock(cs);
 
-        Clear();
+        Clear_();
 
         unsigned char nVersion;
         s >> nVersion;
@@ -346,8 +374,13 @@ public:
         }
 
         // Deserialize entries from the new table.
+        if (nNew < 0 || nNew > ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE ||
+            nTried < 0 || nTried > ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE)
+            throw std::ios_base::failure("Corrupt table sizes in addrman deserialization");
+        vInfo.reserve(nNew + nTried);
+        vInfo.resize(nNew);
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = vInfo[n];
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
@@ -363,7 +396,6 @@ public:
                 }
             }
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -373,13 +405,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                int nId = vInfo.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                vInfo.push_back(info);
+                mapAddr[info] = nId;
+                vvTried[nKBucket][nKBucketPos] = nId;
             } else {
                 nLost++;
             }
@@ -394,7 +426,7 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo &info = mapInfo[nIndex];
+                    CAddrInfo &info = vInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
@@ -406,13 +438,11 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            const CAddrInfo &info = vInfo[n];
+            if (info.nRandomPos != -1 && info.fInTried == false && info.nRefCount == 0) {
+                Delete(n);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -429,27 +459,13 @@ public:
 
     void Clear()
     {
-        std::vector<int>().swap(vRandom);
-        nKey = GetRandHash();
-        for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-            for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-                vvNew[bucket][entry] = -1;
-            }
-        }
-        for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
-            for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-                vvTried[bucket][entry] = -1;
-            }
-        }
-
-        nIdCount = 0;
-        nTried = 0;
-        nNew = 0;
+        boost::unique_lock<boost::shared_mutex> lock(cs);
+        Clear_();
     }
 
     CAddrMan()
     {
-        Clear();
+        Clear_();
     }
 
     ~CAddrMan()
@@ -458,21 +474,19 @@ public:
     }
 
     //! Return the number of (unique) addresses in all tables.
-    int size()
+    int size() const
     {
+        boost::shared_lock<boost::shared_mutex> lock(cs);
         return vRandom.size();
     }
 
-    //! Consistency check
-    void Check()
+    //! Consistency check; the caller must hold cs.
+    void Check() const
     {
 #ifdef DEBUG_ADDRMAN
-        {
-            LOCK(cs);
-            int err;
-            if ((err=Check_()))
-                LogPrintf("ADDRMAN CONSISTENCY CHECK FAILED!!! err=%i\n", err);
-        }
+        int err;
+        if ((err=Check_()))
+            LogPrintf("ADDRMAN CONSISTENCY CHECK FAILED!!! err=%i\n", err);
 #endif
     }
 
@@ -481,7 +495,7 @@ public:
     {
         bool fRet = false;
         {
-            LOCK(cs);
+            boost::unique_lock<boost::shared_mutex> lock(cs);
             Check();
             fRet |= Add_(addr, source, nTimePenalty);
             Check();
@@ -491,12 +505,12 @@ public:
         return fRet;
     }
 
-    //! Add multiple addresses.
+    //! Add multiple addresses (e.g. an addr message) in one locked pass.
     bool Add(const std::vector<CAddress> &vAddr, const CNetAddr& source, int64_t nTimePenalty = 0)
     {
         int nAdd = 0;
         {
-            LOCK(cs);
+            boost::unique_lock<boost::shared_mutex> lock(cs);
             Check();
             for (std::vector<CAddress>::const_iterator it = vAddr.begin(); it != vAddr.end(); it++)
                 nAdd += Add_(*it, source, nTimePenalty) ? 1 : 0;
@@ -511,7 +525,7 @@ public:
     void Good(const CService &addr, int64_t nTime = GetAdjustedTime())
     {
         {
-            LOCK(cs);
+            boost::unique_lock<boost::shared_mutex> lock(cs);
             Check();
             Good_(addr, nTime);
             Check();
@@ -522,7 +536,7 @@ public:
     void Attempt(const CService &addr, int64_t nTime = GetAdjustedTime())
     {
         {
-            LOCK(cs);
+            boost::unique_lock<boost::shared_mutex> lock(cs);
             Check();
             Attempt_(addr, nTime);
             Check();
@@ -531,13 +545,13 @@ public:
 
     /**
      * Choose an address to connect to.
-     * nUnkBias determines how much "new" entries are favored over "tried" ones (0-100).
+     * Only takes the lock shared, so it does not wait for other readers.
      */
     CAddress Select()
     {
         CAddress addrRet;
         {
-            LOCK(cs);
+            boost::shared_lock<boost::shared_mutex> lock(cs);
             Check();
             addrRet = Select_();
             Check();
@@ -548,13 +562,14 @@ public:
     //! Return a bunch of addresses, selected at random.
     std::vector<CAddress> GetAddr()
     {
-        Check();
         std::vector<CAddress> vAddr;
         {
-            LOCK(cs);
+            // GetAddr_ reorders vRandom, so this is a writer
+            boost::unique_lock<boost::shared_mutex> lock(cs);
+            Check();
             GetAddr_(vAddr);
+            Check();
         }
-        Check();
         return vAddr;
     }
 
@@ -562,7 +577,7 @@ public:
     void Connected(const CService &addr, int64_t nTime = GetAdjustedTime())
     {
         {
-            LOCK(cs);
+            boost::unique_lock<boost::shared_mutex> lock(cs);
             Check();
             Connected_(addr, nTime);
             Check();
@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "auxpowminer.h"
+
+#include "chain.h"
+#include "main.h"
+#include "miner.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utiltime.h"
+
+CAuxpowMiner auxpowMiner;
+
+void CAuxBlockCache::Add(const CScript& client, const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+{
+    if (!mapBlocks.insert(std::make_pair(hash, pblock)).second)
+        return;
+
+    std::deque<uint256>& queueHashes = mapClients[client];
+    queueHashes.push_back(hash);
+    while (queueHashes.size() > nMaxPerClient) {
+        mapBlocks.erase(queueHashes.front());
+        queueHashes.pop_front();
+    }
+}
+
+std::shared_ptr<const CBlock> CAuxBlockCache::Get(const uint256& hash) const
+{
+    std::map<uint256, std::shared_ptr<const CBlock> >::const_iterator it = mapBlocks.find(hash);
+    if (it == mapBlocks.end())
+        return std::shared_ptr<const CBlock>();
+    return it->second;
+}
+
+void CAuxBlockCache::EraseClient(const CScript& client)
+{
+    std::map<CScript, std::deque<uint256> >::iterator it = mapClients.find(client);
+    if (it == mapClients.end())
+        return;
+    for (size_t i = 0; i < it->second.size(); i++)
+        mapBlocks.erase(it->second[i]);
+    mapClients.erase(it);
+}
+
+void CAuxBlockCache::Clear()
+{
+    mapBlocks.clear();
+    mapClients.clear();
+}
+
+CAuxpowMiner::CAuxpowMiner() : pindexPrev(NULL), nExtraNonce(0)
+{
+}
+
+CAuxpowMiner::~CAuxpowMiner()
+{
+}
+
+void CAuxpowMiner::DropLeastRecentClient()
+{
+    std::map<CScript, Template>::iterator itOldest = mapTemplates.begin();
+    for (std::map<CScript, Template>::iterator it = mapTemplates.begin(); it != mapTemplates.end(); ++it)
+        if (it->second.nLastRequest < itOldest->second.nLastRequest)
+            itOldest = it;
+    cache.EraseClient(itOldest->first);
+    mapTemplates.erase(itOldest);
+}
+
+std::shared_ptr<const CBlock> CAuxpowMiner::GetCurrentBlock(const CScript& scriptPubKey, int& nHeight, CAmount& nFees)
+{
+    LOCK2(cs_main, cs);
+
+    // Work on an old tip is stale, whoever asks next gets a new block
+    if (pindexPrev != chainActive.Tip()) {
+        mapTemplates.clear();
+        cache.Clear();
+        pindexPrev = chainActive.Tip();
+    }
+
+    if (!mapTemplates.count(scriptPubKey) && mapTemplates.size() >= AUXPOW_MAX_CLIENTS)
+        DropLeastRecentClient();
+
+    Template& t = mapTemplates[scriptPubKey];
+    int64_t nNow = GetTime();
+    t.nLastRequest = nNow;
+    if (!t.pblocktemplate) {
+        unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        t.pblocktemplate.reset(CreateNewBlock(scriptPubKey));
+        if (!t.pblocktemplate) {
+            mapTemplates.erase(scriptPubKey);
+            return std::shared_ptr<const CBlock>();
+        }
+        t.pblock.reset();
+        t.nTransactionsUpdated = nTransactionsUpdated;
+        t.nLastUpdate = nNow;
+    } else if (mempool.GetTransactionsUpdated() != t.nTransactionsUpdated && nNow - t.nLastUpdate >= AUXPOW_TEMPLATE_UPDATE_INTERVAL) {
+        t.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        t.nLastUpdate = nNow;
+        if (UpdateBlockTemplate(t.pblocktemplate.get()) > 0)
+            t.pblock.reset();
+    }
+
+    // Hand out a copy, the template itself keeps changing
+    if (!t.pblock) {
+        CBlock* pblock = &t.pblocktemplate->block;
+        IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
+        pblock->nVersion.SetAuxpow(true);
+        t.pblock = std::make_shared<const CBlock>(*pblock);
+        cache.Add(scriptPubKey, t.pblock->GetHash(), t.pblock);
+    }
+
+    nHeight = pindexPrev->nHeight + 1;
+    nFees = -t.pblocktemplate->vTxFees[0];
+    return t.pblock;
+}
+
+std::shared_ptr<const CBlock> CAuxpowMiner::LookupBlock(const uint256& hash)
+{
+    LOCK(cs);
+    return cache.Get(hash);
+}
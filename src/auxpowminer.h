@@ -0,0 +1,99 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_AUXPOWMINER_H
+#define BITCOIN_AUXPOWMINER_H
+
+#include "amount.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+
+class CBlockIndex;
+struct CBlockTemplate;
+
+/** Aux blocks remembered per payout script, older ones can no longer be submitted */
+static const size_t AUXPOW_MAX_BLOCKS_PER_CLIENT = 32;
+/** Payout scripts with a template at the same time, the one asked for least recently is dropped */
+static const size_t AUXPOW_MAX_CLIENTS = 64;
+/** Seconds between two updates of a template from the mempool */
+static const int64_t AUXPOW_TEMPLATE_UPDATE_INTERVAL = 5;
+
+/**
+ * Aux blocks handed out, by hash, with a bounded number per client so one
+ * busy pool cannot push out the work of the others. Not thread safe, the
+ * owner locks.
+ */
+class CAuxBlockCache
+{
+private:
+    size_t nMaxPerClient;
+    std::map<uint256, std::shared_ptr<const CBlock> > mapBlocks;
+    //! Hashes handed out to each client, oldest first
+    std::map<CScript, std::deque<uint256> > mapClients;
+
+public:
+    explicit CAuxBlockCache(size_t nMaxPerClientIn = AUXPOW_MAX_BLOCKS_PER_CLIENT) : nMaxPerClient(nMaxPerClientIn) {}
+
+    void Add(const CScript& client, const uint256& hash, const std::shared_ptr<const CBlock>& pblock);
+    /** The block handed out with hash, null if it is unknown or was dropped */
+    std::shared_ptr<const CBlock> Get(const uint256& hash) const;
+    void EraseClient(const CScript& client);
+    void Clear();
+
+    size_t size() const { return mapBlocks.size(); }
+};
+
+/**
+ * Merge mining templates, one per payout script. A template is created once
+ * per tip and then only extended with the transactions that reach the
+ * mempool, see UpdateBlockTemplate. Each change is handed out as a new aux
+ * block, the blocks handed out before stay valid until the tip moves.
+ */
+class CAuxpowMiner
+{
+private:
+    struct Template
+    {
+        std::unique_ptr<CBlockTemplate> pblocktemplate;
+        //! What was handed out last, null once the template changed
+        std::shared_ptr<const CBlock> pblock;
+        unsigned int nTransactionsUpdated;
+        int64_t nLastUpdate;
+        int64_t nLastRequest;
+    };
+
+    CCriticalSection cs;
+    const CBlockIndex* pindexPrev;
+    std::map<CScript, Template> mapTemplates;
+    CAuxBlockCache cache;
+    unsigned int nExtraNonce;
+
+    void DropLeastRecentClient();
+
+public:
+    CAuxpowMiner();
+    ~CAuxpowMiner();
+
+    /**
+     * The block to merge-mine for scriptPubKey at the current tip, with the
+     * height and fees it was built with. Null if the block could not be
+     * created.
+     */
+    std::shared_ptr<const CBlock> GetCurrentBlock(const CScript& scriptPubKey, int& nHeight, CAmount& nFees);
+
+    /** The block handed out with hash, null if it is unknown or stale */
+    std::shared_ptr<const CBlock> LookupBlock(const uint256& hash);
+};
+
+extern CAuxpowMiner auxpowMiner;
+
+#endif // BITCOIN_AUXPOWMINER_H
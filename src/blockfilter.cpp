@@ -0,0 +1,333 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+
+/** Writes bit fields most significant bit first into a byte vector */
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset; //!< Number of bits of nBuffer in use
+
+public:
+    CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    /** Write the nBits least significant bits of data (nBits <= 64) */
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0) {
+            int nCount = std::min(8 - nOffset, nBits);
+            nBuffer |= (data << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += nCount;
+            nBits -= nCount;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /** Write out a partially filled byte, padded with zero bits */
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/** Reads bit fields written by CBitWriter */
+class CBitReader
+{
+private:
+    std::vector<unsigned char>::const_iterator it;
+    std::vector<unsigned char>::const_iterator end;
+    uint8_t nBuffer;
+    int nOffset; //!< Number of bits of nBuffer already read
+
+public:
+    CBitReader(std::vector<unsigned char>::const_iterator itIn, std::vector<unsigned char>::const_iterator endIn) :
+        it(itIn), end(endIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (it == end)
+                    throw std::ios_base::failure("CBitReader::Read() : end of data");
+                nBuffer = *it++;
+                nOffset = 0;
+            }
+            int nCount = std::min(8 - nOffset, nBits);
+            data <<= nCount;
+            data |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - nCount);
+            nOffset += nCount;
+            nBits -= nCount;
+        }
+        return data;
+    }
+
+    bool AtEnd() const { return it == end; }
+};
+
+static void GolombRiceEncode(CBitWriter& writer, int nP, uint64_t x)
+{
+    // Quotient in unary: q ones followed by a zero
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? static_cast<int>(q) : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+
+    // Remainder in binary
+    writer.Write(x, nP);
+}
+
+static uint64_t GolombRiceDecode(CBitReader& reader, int nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        ++q;
+    uint64_t r = reader.Read(nP);
+    return (q << nP) + r;
+}
+
+/** Map x uniformly into [0, n): the high 64 bits of the 128 bit product x * n */
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64);
+#else
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+CGCSFilter::CGCSFilter(uint64_t nSipK0In, uint64_t nSipK1In, int nPIn, uint32_t nMIn) :
+    nSipK0(nSipK0In), nSipK1(nSipK1In), nP(nPIn), nM(nMIn), nN(0), nF(0)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, nN);
+    vEncoded.assign(ss.begin(), ss.end());
+}
+
+CGCSFilter::CGCSFilter(uint64_t nSipK0In, uint64_t nSipK1In, int nPIn, uint32_t nMIn, const std::vector<unsigned char>& vEncodedIn) :
+    nSipK0(nSipK0In), nSipK1(nSipK1In), nP(nPIn), nM(nMIn), vEncoded(vEncodedIn)
+{
+    CDataStream ss(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nCount = ReadCompactSize(ss);
+    if (nCount > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("CGCSFilter() : N must be < 2^32");
+    nN = static_cast<uint32_t>(nCount);
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    // Decode all elements so a malformed filter is rejected here and not on first use
+    CBitReader reader(vEncoded.begin() + GetSizeOfCompactSize(nN), vEncoded.end());
+    for (uint32_t i = 0; i < nN; ++i)
+        GolombRiceDecode(reader, nP);
+    if (!reader.AtEnd())
+        throw std::ios_base::failure("CGCSFilter() : encoded filter contains excess data");
+}
+
+CGCSFilter::CGCSFilter(uint64_t nSipK0In, uint64_t nSipK1In, int nPIn, uint32_t nMIn, const ElementSet& elements) :
+    nSipK0(nSipK0In), nSipK1(nSipK1In), nP(nPIn), nM(nMIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("CGCSFilter() : N must be < 2^32");
+    nN = static_cast<uint32_t>(elements.size());
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, nN);
+    vEncoded.assign(ss.begin(), ss.end());
+
+    if (elements.empty())
+        return;
+
+    CBitWriter writer(vEncoded);
+    uint64_t nLast = 0;
+    std::vector<uint64_t> vHashes = BuildHashedSet(elements);
+    for (size_t i = 0; i < vHashes.size(); ++i) {
+        GolombRiceEncode(writer, nP, vHashes[i] - nLast);
+        nLast = vHashes[i];
+    }
+    writer.Flush();
+}
+
+uint64_t CGCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(nSipK0, nSipK1).Write(element.data(), element.size()).Finalize();
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> CGCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (ElementSet::const_iterator it = elements.begin(); it != elements.end(); ++it)
+        vHashes.push_back(HashToRange(*it));
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool CGCSFilter::MatchInternal(const uint64_t* pHashes, size_t nHashes) const
+{
+    CBitReader reader(vEncoded.begin() + GetSizeOfCompactSize(nN), vEncoded.end());
+
+    uint64_t nValue = 0;
+    size_t nQuery = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        nValue += GolombRiceDecode(reader, nP);
+
+        // Both sequences are sorted, advance the query side up to the filter value
+        while (true) {
+            if (nQuery == nHashes)
+                return false;
+            if (pHashes[nQuery] == nValue)
+                return true;
+            if (pHashes[nQuery] > nValue)
+                break;
+            nQuery++;
+        }
+    }
+    return false;
+}
+
+bool CGCSFilter::Match(const Element& element) const
+{
+    if (nN == 0)
+        return false;
+    uint64_t nQuery = HashToRange(element);
+    return MatchInternal(&nQuery, 1);
+}
+
+bool CGCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (nN == 0 || elements.empty())
+        return false;
+    std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return MatchInternal(vQueries.data(), vQueries.size());
+}
+
+static CGCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockundo)
+{
+    CGCSFilter::ElementSet elements;
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    BOOST_FOREACH(const CTxUndo& txundo, blockundo.vtxundo) {
+        BOOST_FOREACH(const CTxInUndo& prevout, txundo.vprevout) {
+            const CScript& script = prevout.txout.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    return elements;
+}
+
+CBlockFilter::CBlockFilter() : nFilterType(BLOCK_FILTER_BASIC)
+{
+}
+
+CBlockFilter::CBlockFilter(uint8_t nFilterTypeIn, const CBlock& block, const CBlockUndo& blockundo) :
+    nFilterType(nFilterTypeIn), hashBlock(block.GetHash())
+{
+    uint64_t k0, k1;
+    int P;
+    uint32_t M;
+    if (!BuildParams(k0, k1, P, M))
+        throw std::invalid_argument("CBlockFilter() : unknown filter type");
+    filter = CGCSFilter(k0, k1, P, M, BasicFilterElements(block, blockundo));
+}
+
+CBlockFilter::CBlockFilter(uint8_t nFilterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vEncoded) :
+    nFilterType(nFilterTypeIn), hashBlock(hashBlockIn)
+{
+    uint64_t k0, k1;
+    int P;
+    uint32_t M;
+    if (!BuildParams(k0, k1, P, M))
+        throw std::invalid_argument("CBlockFilter() : unknown filter type");
+    filter = CGCSFilter(k0, k1, P, M, vEncoded);
+}
+
+bool CBlockFilter::BuildParams(uint64_t& k0, uint64_t& k1, int& P, uint32_t& M) const
+{
+    // The SipHash key is the first 16 bytes of the block hash
+    k0 = ReadLE64(hashBlock.begin());
+    k1 = ReadLE64(hashBlock.begin() + 8);
+
+    switch (nFilterType) {
+    case BLOCK_FILTER_BASIC:
+        P = BASIC_FILTER_P;
+        M = BASIC_FILTER_M;
+        return true;
+    }
+    return false;
+}
+
+uint256 CBlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vEncoded = GetEncodedFilter();
+    return Hash(vEncoded.begin(), vEncoded.end());
+}
+
+uint256 CBlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), prevHeader.begin(), prevHeader.end());
+}
+
+const char* BlockFilterTypeName(uint8_t nFilterType)
+{
+    switch (nFilterType) {
+    case BLOCK_FILTER_BASIC:
+        return "basic";
+    }
+    return "";
+}
+
+bool BlockFilterTypeByName(const std::string& strName, uint8_t& nFilterType)
+{
+    if (strName == "basic") {
+        nFilterType = BLOCK_FILTER_BASIC;
+        return true;
+    }
+    return false;
+}
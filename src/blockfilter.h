@@ -0,0 +1,117 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set filter (BIP 158). Elements are hashed with SipHash into
+ * the range [0, N * M), sorted, and the differences between successive values
+ * are Golomb-Rice coded with parameter P. A query for an element that is not
+ * in the set matches with a probability of about 1 / M.
+ */
+class CGCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+private:
+    uint64_t nSipK0;
+    uint64_t nSipK1;
+    int nP;
+    uint32_t nM;
+    uint32_t nN;
+    uint64_t nF; //!< Range of element hashes, N * M
+    std::vector<unsigned char> vEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+
+    /** Walk the sorted query hashes and the decoded filter in step */
+    bool MatchInternal(const uint64_t* pHashes, size_t nHashes) const;
+
+public:
+    /** Construct an empty filter */
+    CGCSFilter(uint64_t nSipK0In = 0, uint64_t nSipK1In = 0, int nPIn = 0, uint32_t nMIn = 0);
+
+    /** Reconstruct a filter from its encoding, throws std::ios_base::failure if it is malformed */
+    CGCSFilter(uint64_t nSipK0In, uint64_t nSipK1In, int nPIn, uint32_t nMIn, const std::vector<unsigned char>& vEncodedIn);
+
+    /** Build a new filter from a set of elements */
+    CGCSFilter(uint64_t nSipK0In, uint64_t nSipK1In, int nPIn, uint32_t nMIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /** Checks if the element may be in the set. False positives are possible. */
+    bool Match(const Element& element) const;
+
+    /** Checks if any of the given elements may be in the set; cheaper than calling Match on each */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+enum BlockFilterType
+{
+    BLOCK_FILTER_BASIC = 0,
+};
+
+/** Filter parameters of the basic filter type, see BIP 158 */
+static const int BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+/**
+ * Compact filter of one block: the output scripts it creates and the
+ * previous output scripts it spends, keyed by the block hash. Built once
+ * when the block is connected and served to light clients, who test their
+ * own scripts against it instead of loading a bloom filter into every peer.
+ */
+class CBlockFilter
+{
+private:
+    uint8_t nFilterType;
+    uint256 hashBlock;
+    CGCSFilter filter;
+
+    bool BuildParams(uint64_t& k0, uint64_t& k1, int& P, uint32_t& M) const;
+
+public:
+    CBlockFilter();
+
+    /** Build the filter of a block; blockundo holds the outputs it spends */
+    CBlockFilter(uint8_t nFilterTypeIn, const CBlock& block, const CBlockUndo& blockundo);
+
+    /** Reconstruct a filter from its encoding, throws std::ios_base::failure if it is malformed */
+    CBlockFilter(uint8_t nFilterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vEncoded);
+
+    uint8_t GetFilterType() const { return nFilterType; }
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const CGCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Double SHA256 of the encoded filter */
+    uint256 GetHash() const;
+
+    /** Filter header committing to this filter and all previous ones: Hash(filter hash || previous header) */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+};
+
+/** Name of a filter type as used in REST paths, empty if unknown */
+const char* BlockFilterTypeName(uint8_t nFilterType);
+
+/** Look up a filter type by name, returns false if unknown */
+bool BlockFilterTypeByName(const std::string& strName, uint8_t& nFilterType);
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,228 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilterindex.h"
+
+#include "main.h"
+#include "net.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+static const char DB_FILTER = 'f';
+static const char DB_BEST_BLOCK = 'B';
+
+CBlockFilterIndex* pblockfilterindex = NULL;
+
+CBlockFilterIndex::CBlockFilterIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CLevelDBWrapper(GetDataDir() / "blocks" / "filter", nCacheSize, fMemory, fWipe),
+    fSynced(false)
+{
+}
+
+bool CBlockFilterIndex::ReadEntry(const uint256& hashBlock, CBlockFilterIndexEntry& entry) const
+{
+    return Read(make_pair(DB_FILTER, hashBlock), entry);
+}
+
+bool CBlockFilterIndex::ReadFilter(const uint256& hashBlock, CBlockFilter& filter) const
+{
+    CBlockFilterIndexEntry entry;
+    if (!ReadEntry(hashBlock, entry))
+        return false;
+    try {
+        filter = CBlockFilter(BLOCK_FILTER_BASIC, hashBlock, entry.vFilter);
+    } catch (const std::exception& e) {
+        return error("%s: invalid filter of block %s: %s", __func__, hashBlock.ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::ReadFilterHeader(const uint256& hashBlock, uint256& header) const
+{
+    CBlockFilterIndexEntry entry;
+    if (!ReadEntry(hashBlock, entry))
+        return false;
+    header = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndex::ReadBestBlock(uint256& hashBlock) const
+{
+    return Read(DB_BEST_BLOCK, hashBlock);
+}
+
+bool CBlockFilterIndex::WriteFilters(const std::vector<CBlockFilter>& vFilters, const std::vector<uint256>& vHeaders)
+{
+    assert(vFilters.size() == vHeaders.size());
+    if (vFilters.empty())
+        return true;
+
+    CLevelDBBatch batch;
+    for (size_t i = 0; i < vFilters.size(); i++) {
+        CBlockFilterIndexEntry entry;
+        entry.vFilter = vFilters[i].GetEncodedFilter();
+        entry.hashFilter = vFilters[i].GetHash();
+        entry.header = vHeaders[i];
+        batch.Write(make_pair(DB_FILTER, vFilters[i].GetBlockHash()), entry);
+    }
+    batch.Write(DB_BEST_BLOCK, vFilters.back().GetBlockHash());
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterIndex::BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+
+    // Until the background build reaches the tip it picks up new blocks itself
+    if (!fSynced)
+        return true;
+
+    uint256 prevHeader;
+    if (pindex->pprev && !ReadFilterHeader(pindex->pprev->GetBlockHash(), prevHeader))
+        return error("%s: missing filter header of block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+
+    std::vector<CBlockFilter> vFilters(1, CBlockFilter(BLOCK_FILTER_BASIC, block, blockundo));
+    std::vector<uint256> vHeaders(1, vFilters[0].ComputeHeader(prevHeader));
+    return WriteFilters(vFilters, vHeaders);
+}
+
+bool CBlockFilterIndex::IsSynced() const
+{
+    AssertLockHeld(cs_main);
+    return fSynced;
+}
+
+void CBlockFilterIndex::SetSynced()
+{
+    AssertLockHeld(cs_main);
+    fSynced = true;
+}
+
+/** A block to be filtered by the background build, with its undo position read under cs_main */
+struct CBlockFilterBuildItem
+{
+    const CBlockIndex* pindex;
+    CDiskBlockPos posUndo;
+    uint256 hashPrev;
+};
+
+static void BuildBlockFilters(const std::vector<CBlockFilterBuildItem>* pvItems, std::vector<CBlockFilter>* pvFilters,
+                              std::vector<char>* pvBuilt, unsigned int nWorker, unsigned int nThreads)
+{
+    for (size_t i = nWorker; i < pvItems->size(); i += nThreads) {
+        boost::this_thread::interruption_point();
+
+        const CBlockFilterBuildItem& item = (*pvItems)[i];
+        CBlock block;
+        if (!ReadBlockFromDisk(block, item.pindex)) {
+            LogPrintf("%s: failed to read block %s\n", __func__, item.pindex->GetBlockHash().ToString());
+            continue;
+        }
+
+        // The genesis block spends nothing and has no undo data
+        CBlockUndo blockundo;
+        if (item.pindex->pprev && (item.posUndo.IsNull() || !blockundo.ReadFromDisk(item.posUndo, item.hashPrev))) {
+            LogPrintf("%s: failed to read undo data of block %s\n", __func__, item.pindex->GetBlockHash().ToString());
+            continue;
+        }
+
+        (*pvFilters)[i] = CBlockFilter(BLOCK_FILTER_BASIC, block, blockundo);
+        (*pvBuilt)[i] = 1;
+    }
+}
+
+void ThreadBuildBlockFilterIndex()
+{
+    RenameThread("crown-cfindex");
+
+    const CBlockIndex* pindexLast = NULL;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        if (pblockfilterindex->ReadBestBlock(hashBest)) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end())
+                pindexLast = chainActive.FindFork(mi->second);
+        }
+    }
+    LogPrintf("Block filter index: building from height %d\n", pindexLast ? pindexLast->nHeight + 1 : 0);
+
+    unsigned int nThreads = std::max(std::min(boost::thread::hardware_concurrency(), (unsigned int)BLOCK_FILTER_BUILD_MAX_THREADS), 1u);
+    int64_t nLastLog = GetTime();
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        std::vector<CBlockFilterBuildItem> vItems;
+        {
+            LOCK(cs_main);
+            // The chain may have been reorganized while the last batch was built
+            if (pindexLast && !chainActive.Contains(pindexLast))
+                pindexLast = chainActive.FindFork(pindexLast);
+
+            const CBlockIndex* pindex = pindexLast ? chainActive.Next(pindexLast) : chainActive.Genesis();
+            if (pindex == NULL) {
+                // Caught up, ConnectBlock adds the filters of new blocks from now on
+                pblockfilterindex->SetSynced();
+                nLocalServices |= NODE_COMPACT_FILTERS;
+                LogPrintf("Block filter index: synced up to height %d\n", pindexLast ? pindexLast->nHeight : -1);
+                return;
+            }
+
+            while (pindex && vItems.size() < (size_t)BLOCK_FILTER_BUILD_BATCH) {
+                CBlockFilterBuildItem item;
+                item.pindex = pindex;
+                item.posUndo = pindex->GetUndoPos();
+                item.hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+                vItems.push_back(item);
+                pindex = chainActive.Next(pindex);
+            }
+        }
+
+        // Reading and filtering blocks is independent per block, spread it over worker threads
+        std::vector<CBlockFilter> vFilters(vItems.size());
+        std::vector<char> vBuilt(vItems.size(), 0);
+        boost::thread_group workers;
+        for (unsigned int i = 0; i < nThreads; i++)
+            workers.create_thread(boost::bind(&BuildBlockFilters, &vItems, &vFilters, &vBuilt, i, nThreads));
+        try {
+            workers.join_all();
+        } catch (const boost::thread_interrupted&) {
+            workers.interrupt_all();
+            workers.join_all();
+            throw;
+        }
+
+        // Each header commits to the previous one, chain them in order
+        uint256 prevHeader;
+        if (pindexLast && !pblockfilterindex->ReadFilterHeader(pindexLast->GetBlockHash(), prevHeader)) {
+            LogPrintf("%s: missing filter header of block %s\n", __func__, pindexLast->GetBlockHash().ToString());
+            return;
+        }
+        std::vector<uint256> vHeaders(vItems.size());
+        for (size_t i = 0; i < vItems.size(); i++) {
+            if (!vBuilt[i]) {
+                LogPrintf("%s: stopped at height %d\n", __func__, vItems[i].pindex->nHeight);
+                return;
+            }
+            vHeaders[i] = vFilters[i].ComputeHeader(prevHeader);
+            prevHeader = vHeaders[i];
+        }
+
+        if (!pblockfilterindex->WriteFilters(vFilters, vHeaders)) {
+            LogPrintf("%s: failed to write filters\n", __func__);
+            return;
+        }
+        pindexLast = vItems.back().pindex;
+
+        if (GetTime() - nLastLog >= 30) {
+            LogPrintf("Block filter index: built up to height %d\n", pindexLast->nHeight);
+            nLastLog = GetTime();
+        }
+    }
+}
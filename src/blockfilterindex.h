@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTERINDEX_H
+#define BITCOIN_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "leveldbwrapper.h"
+#include "serialize.h"
+
+#include <vector>
+
+class CBlockIndex;
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+//! Max memory allocated to the block filter index cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 64;
+/** Number of blocks read and filtered per step of the background build */
+static const int BLOCK_FILTER_BUILD_BATCH = 1000;
+/** Maximum number of worker threads of the background build */
+static const int BLOCK_FILTER_BUILD_MAX_THREADS = 8;
+/** Maximum number of filters served for one getcfilters request */
+static const unsigned int MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of filter hashes served for one getcfheaders request */
+static const unsigned int MAX_GETCFHEADERS_SIZE = 2000;
+/** Spacing of the filter headers served by getcfcheckpt */
+static const int CFCHECKPT_INTERVAL = 1000;
+
+/** Stored value of one block: its encoded filter, the filter hash and the filter header */
+class CBlockFilterIndexEntry
+{
+public:
+    std::vector<unsigned char> vFilter;
+    uint256 hashFilter;
+    uint256 header;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(vFilter);
+        READWRITE(hashFilter);
+        READWRITE(header);
+    }
+};
+
+/**
+ * Index of the basic compact filter of every block in the active chain,
+ * keyed by block hash. Blocks of a chain that is later reorganized away keep
+ * their entries, they are valid for that block forever. Filters are added as
+ * blocks are connected once the background build of the existing chain has
+ * caught up with the tip.
+ */
+class CBlockFilterIndex : public CLevelDBWrapper
+{
+private:
+    //! Set once the background build reached the tip, guarded by cs_main
+    bool fSynced;
+
+    CBlockFilterIndex(const CBlockFilterIndex&);
+    void operator=(const CBlockFilterIndex&);
+
+public:
+    CBlockFilterIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool ReadEntry(const uint256& hashBlock, CBlockFilterIndexEntry& entry) const;
+    bool ReadFilter(const uint256& hashBlock, CBlockFilter& filter) const;
+    bool ReadFilterHeader(const uint256& hashBlock, uint256& header) const;
+
+    /** Last block up to which all filters of its chain are present */
+    bool ReadBestBlock(uint256& hashBlock) const;
+
+    /** Store consecutive filters with their headers and advance the best block */
+    bool WriteFilters(const std::vector<CBlockFilter>& vFilters, const std::vector<uint256>& vHeaders);
+
+    /** Add the filter of a newly connected block, cs_main must be held */
+    bool BlockConnected(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    bool IsSynced() const;
+    void SetSynced();
+};
+
+/** Global compact block filter index, NULL unless -blockfilterindex is set */
+extern CBlockFilterIndex* pblockfilterindex;
+
+/** Build the filters of the blocks that are not indexed yet */
+void ThreadBuildBlockFilterIndex();
+
+#endif // BITCOIN_BLOCKFILTERINDEX_H
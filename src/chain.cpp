@@ -84,3 +84,45 @@ const CBlockIndex *CChain::FindFork(const CBlockIndex *pindex) const {
         pindex = pindex->pprev;
     return pindex;
 }
+
+const size_t CBlockIndexArena::DEFAULT_CHUNK_SIZE;
+
+void CBlockIndexArena::AddChunk(size_t nSize)
+{
+    vChunks.push_back(std::make_pair(new CBlockIndex[nSize], nSize));
+    nChunkUsed = 0;
+}
+
+CBlockIndexArena::~CBlockIndexArena()
+{
+    for (size_t i = 0; i < vChunks.size(); i++)
+        delete[] vChunks[i].first;
+}
+
+void CBlockIndexArena::Reserve(size_t nCount)
+{
+    if (vChunks.empty() || vChunks.back().second - nChunkUsed < nCount)
+        AddChunk(std::max(nCount, DEFAULT_CHUNK_SIZE));
+}
+
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    Reserve(1);
+    nAllocated++;
+    return &vChunks.back().first[nChunkUsed++];
+}
+
+void CBlockIndexArena::Splice(CBlockIndexArena& other)
+{
+    if (vChunks.empty()) {
+        vChunks.swap(other.vChunks);
+        nChunkUsed = other.nChunkUsed;
+    } else {
+        // Keep allocating from our own last chunk
+        vChunks.insert(vChunks.end() - 1, other.vChunks.begin(), other.vChunks.end());
+        other.vChunks.clear();
+    }
+    nAllocated += other.nAllocated;
+    other.nChunkUsed = 0;
+    other.nAllocated = 0;
+}
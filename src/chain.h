@@ -359,6 +359,43 @@ public:
     }
 };
 
+/**
+ * Allocates block index entries in contiguous chunks instead of one heap
+ * object each. Entries live until the arena is destroyed, like those of
+ * mapBlockIndex. Not thread safe, the global arena is guarded by cs_main.
+ */
+class CBlockIndexArena
+{
+private:
+    //! Chunks with their sizes, entries are allocated from the last one
+    std::vector<std::pair<CBlockIndex*, size_t> > vChunks;
+    size_t nChunkUsed;
+    size_t nAllocated;
+
+    CBlockIndexArena(const CBlockIndexArena&);
+    void operator=(const CBlockIndexArena&);
+
+    void AddChunk(size_t nSize);
+
+public:
+    //! Entries per chunk unless more are reserved
+    static const size_t DEFAULT_CHUNK_SIZE = 4096;
+
+    CBlockIndexArena() : nChunkUsed(0), nAllocated(0) {}
+    ~CBlockIndexArena();
+
+    /** Make the next nCount allocations contiguous */
+    void Reserve(size_t nCount);
+
+    /** A new entry, as constructed by CBlockIndex() */
+    CBlockIndex* Allocate();
+
+    /** Take over the entries of another arena, which is left empty */
+    void Splice(CBlockIndexArena& other);
+
+    size_t Size() const { return nAllocated; }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -11,6 +11,7 @@
 #include <string>
 #include <vector>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
 #include <openssl/aes.h>
 #include <openssl/evp.h>
 
@@ -212,6 +213,36 @@ bool CCryptoKeyStore::Lock()
     return true;
 }
 
+/** Decrypt one crypted key and check that it matches its public key. */
+static bool CheckCryptedKey(const CKeyingMaterial& vMasterKeyIn, const CPubKey& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret)
+{
+    CKeyingMaterial vchSecret;
+    if(!DecryptSecret(vMasterKeyIn, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
+        return false;
+    if (vchSecret.size() != 32)
+        return false;
+    CKey key;
+    key.Set(vchSecret.begin(), vchSecret.end(), vchPubKey.IsCompressed());
+    return key.GetPubKey() == vchPubKey;
+}
+
+/** Check a slice of crypted keys, stopping at the first one that fails. */
+static void CheckCryptedKeyRange(const CKeyingMaterial* pMasterKey,
+                                 std::vector<CryptedKeyMap::const_iterator>::const_iterator itBegin,
+                                 std::vector<CryptedKeyMap::const_iterator>::const_iterator itEnd,
+                                 bool* pfPass, bool* pfFail)
+{
+    for (; itBegin != itEnd; ++itBegin)
+    {
+        if (!CheckCryptedKey(*pMasterKey, (*itBegin)->second.first, (*itBegin)->second.second))
+        {
+            *pfFail = true;
+            return;
+        }
+        *pfPass = true;
+    }
+}
+
 bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 {
     {
@@ -221,32 +252,53 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 
         bool keyPass = false;
         bool keyFail = false;
-        CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        unsigned int nThreads = 1;
+        if (!fDecryptionThoroughlyChecked)
+            nThreads = std::min<unsigned int>(std::max(boost::thread::hardware_concurrency(), 1u),
+                                              mapCryptedKeys.size() / UNLOCK_KEYS_PER_THREAD_MIN);
+        if (nThreads <= 1)
         {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            CKeyingMaterial vchSecret;
-            if(!DecryptSecret(vMasterKeyIn, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
+            CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
+            for (; mi != mapCryptedKeys.end(); ++mi)
             {
-                keyFail = true;
-                break;
+                if (!CheckCryptedKey(vMasterKeyIn, (*mi).second.first, (*mi).second.second))
+                {
+                    keyFail = true;
+                    break;
+                }
+                keyPass = true;
+                if (fDecryptionThoroughlyChecked)
+                    break;
             }
-            if (vchSecret.size() != 32)
+        }
+        else
+        {
+            // First unlock of a large wallet: split the thorough check over
+            // worker threads, each one checking a contiguous slice of keys.
+            std::vector<CryptedKeyMap::const_iterator> vKeys;
+            vKeys.reserve(mapCryptedKeys.size());
+            for (CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin(); mi != mapCryptedKeys.end(); ++mi)
+                vKeys.push_back(mi);
+
+            // (pass, fail) per worker, so no result is shared between threads
+            std::vector<std::pair<bool, bool> > vResults(nThreads, std::make_pair(false, false));
+            boost::thread_group threadGroup;
+            size_t nSlice = (vKeys.size() + nThreads - 1) / nThreads;
+            for (unsigned int i = 0; i < nThreads; i++)
             {
-                keyFail = true;
-                break;
+                size_t nBegin = std::min(vKeys.size(), i * nSlice);
+                size_t nEnd = std::min(vKeys.size(), nBegin + nSlice);
+                threadGroup.create_thread(boost::bind(&CheckCryptedKeyRange, &vMasterKeyIn,
+                                                      vKeys.begin() + nBegin, vKeys.begin() + nEnd,
+                                                      &vResults[i].first, &vResults[i].second));
             }
-            CKey key;
-            key.Set(vchSecret.begin(), vchSecret.end(), vchPubKey.IsCompressed());
-            if (key.GetPubKey() != vchPubKey)
+            threadGroup.join_all();
+
+            for (unsigned int i = 0; i < nThreads; i++)
             {
-                keyFail = true;
-                break;
+                keyPass |= vResults[i].first;
+                keyFail |= vResults[i].second;
             }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
         }
         if (keyPass && keyFail)
         {
@@ -13,6 +13,8 @@ class uint256;
 
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32;
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8;
+//! minimum number of crypted keys per thread before the first Unlock check goes parallel
+const unsigned int UNLOCK_KEYS_PER_THREAD_MIN = 1000;
 
 /**
  * Private key encryption is done based on a CMasterKey,
@@ -127,6 +127,47 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/**
+ * SHA-256 transformation of N independent chunks, given as big endian
+ * words with one lane per chunk. Every step loops over the lanes, so the
+ * lanes end up in vector registers.
+ */
+template <int N>
+void TransformLanes(uint32_t s[8][N], uint32_t w[64][N])
+{
+    for (int i = 16; i < 64; i++)
+        for (int l = 0; l < N; l++)
+            w[i][l] = sigma1(w[i - 2][l]) + w[i - 7][l] + sigma0(w[i - 15][l]) + w[i - 16][l];
+
+    uint32_t a[N], b[N], c[N], d[N], e[N], f[N], g[N], h[N];
+    for (int l = 0; l < N; l++) {
+        a[l] = s[0][l]; b[l] = s[1][l]; c[l] = s[2][l]; d[l] = s[3][l];
+        e[l] = s[4][l]; f[l] = s[5][l]; g[l] = s[6][l]; h[l] = s[7][l];
+    }
+    for (int i = 0; i < 64; i++) {
+        for (int l = 0; l < N; l++) {
+            uint32_t t1 = h[l] + Sigma1(e[l]) + Ch(e[l], f[l], g[l]) + K[i] + w[i][l];
+            uint32_t t2 = Sigma0(a[l]) + Maj(a[l], b[l], c[l]);
+            h[l] = g[l]; g[l] = f[l]; f[l] = e[l]; e[l] = d[l] + t1;
+            d[l] = c[l]; c[l] = b[l]; b[l] = a[l]; a[l] = t1 + t2;
+        }
+    }
+    for (int l = 0; l < N; l++) {
+        s[0][l] += a[l]; s[1][l] += b[l]; s[2][l] += c[l]; s[3][l] += d[l];
+        s[4][l] += e[l]; s[5][l] += f[l]; s[6][l] += g[l]; s[7][l] += h[l];
+    }
+}
+
 } // namespace sha256
 } // namespace
 
@@ -187,3 +228,56 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+////// Double SHA-256 of block headers
+
+CSHA256DNonceScanner::CSHA256DNonceScanner(const unsigned char* header)
+{
+    sha256::Initialize(midstate);
+    sha256::Transform(midstate, header);
+    for (int i = 0; i < 3; i++)
+        tail[i] = ReadBE32(header + 64 + 4 * i);
+}
+
+void CSHA256DNonceScanner::Hash(uint32_t nNonce, unsigned char hashes[LANES][CSHA256::OUTPUT_SIZE]) const
+{
+    uint32_t s[8][LANES];
+    uint32_t w[64][LANES];
+
+    // Second chunk of the header: the tail, the nonce and the padding of 80 bytes
+    for (int l = 0; l < LANES; l++) {
+        for (int i = 0; i < 8; i++)
+            s[i][l] = midstate[i];
+        w[0][l] = tail[0];
+        w[1][l] = tail[1];
+        w[2][l] = tail[2];
+        // The nonce is serialized little endian
+        unsigned char vchNonce[4];
+        WriteLE32(vchNonce, nNonce + l);
+        w[3][l] = ReadBE32(vchNonce);
+        w[4][l] = 0x80000000ul;
+        for (int i = 5; i < 15; i++)
+            w[i][l] = 0;
+        w[15][l] = 640;
+    }
+    sha256::TransformLanes<LANES>(s, w);
+
+    // The second hash is of the 32 byte result, in a single chunk
+    uint32_t init[8];
+    sha256::Initialize(init);
+    for (int l = 0; l < LANES; l++) {
+        for (int i = 0; i < 8; i++) {
+            w[i][l] = s[i][l];
+            s[i][l] = init[i];
+        }
+        w[8][l] = 0x80000000ul;
+        for (int i = 9; i < 15; i++)
+            w[i][l] = 0;
+        w[15][l] = 256;
+    }
+    sha256::TransformLanes<LANES>(s, w);
+
+    for (int l = 0; l < LANES; l++)
+        for (int i = 0; i < 8; i++)
+            WriteBE32(hashes[l] + 4 * i, s[i][l]);
+}
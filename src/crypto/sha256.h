@@ -25,4 +25,26 @@ public:
     CSHA256& Reset();
 };
 
+/**
+ * Double SHA-256 of an 80 byte block header for many nonces. The first 64
+ * bytes are hashed once into a midstate, each call then hashes LANES
+ * consecutive nonces side by side, laid out so the compiler can use vector
+ * instructions for the lanes.
+ */
+class CSHA256DNonceScanner
+{
+private:
+    uint32_t midstate[8];
+    //! Bytes 64 to 75 of the header as big endian words
+    uint32_t tail[3];
+
+public:
+    static const int LANES = 8;
+
+    //! The first 76 bytes of the header, everything but the nonce
+    explicit CSHA256DNonceScanner(const unsigned char* header);
+    //! Hashes of the header with nonces nNonce to nNonce + LANES - 1
+    void Hash(uint32_t nNonce, unsigned char hashes[LANES][CSHA256::OUTPUT_SIZE]) const;
+};
+
 #endif // BITCOIN_CRYPTO_SHA256_H
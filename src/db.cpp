@@ -51,6 +51,10 @@ CDBEnv::CDBEnv() : dbenv(DB_CXX_NO_EXCEPTIONS)
 {
     fDbEnvInit = false;
     fMockDb = false;
+    nCommits = 0;
+    nFlushes = 0;
+    nGroupCommitWindow = 0;
+    fCheckpointPending = false;
 }
 
 CDBEnv::~CDBEnv()
@@ -280,11 +284,15 @@ void CDB::Flush()
         return;
 
     // Flush database activity from memory pool to disk log
-    unsigned int nMinutes = 0;
-    if (fReadOnly)
-        nMinutes = 1;
+    if (fReadOnly) {
+        bitdb.dbenv.txn_checkpoint(GetArg("-dblogsize", 100) * 1024, 1, 0);
+        return;
+    }
 
-    bitdb.dbenv.txn_checkpoint(nMinutes ? GetArg("-dblogsize", 100) * 1024 : 0, nMinutes, 0);
+    if (bitdb.nGroupCommitWindow > 0)
+        bitdb.RequestCheckpoint();
+    else
+        bitdb.Checkpoint();
 }
 
 void CDB::Close()
@@ -304,6 +312,47 @@ void CDB::Close()
     }
 }
 
+void CDBEnv::IncrementCommits()
+{
+    LOCK(cs_db);
+    ++nCommits;
+}
+
+void CDBEnv::Checkpoint()
+{
+    dbenv.txn_checkpoint(0, 0, 0);
+    LOCK(cs_db);
+    ++nFlushes;
+}
+
+void CDBEnv::RequestCheckpoint()
+{
+    LOCK(cs_db);
+    fCheckpointPending = true;
+}
+
+void CDBEnv::GroupCommit()
+{
+    {
+        LOCK(cs_db);
+        if (!fCheckpointPending || !fDbEnvInit)
+            return;
+        fCheckpointPending = false;
+    }
+    Checkpoint();
+}
+
+void ThreadGroupCommitDB()
+{
+    RenameThread("crown-dbcommit");
+
+    while (bitdb.nGroupCommitWindow > 0)
+    {
+        MilliSleep(bitdb.nGroupCommitWindow);
+        bitdb.GroupCommit();
+    }
+}
+
 void CDBEnv::CloseDb(const string& strFile)
 {
     {
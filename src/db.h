@@ -28,6 +28,7 @@ struct CBlockLocator;
 extern unsigned int nWalletDBUpdated;
 
 void ThreadFlushWalletDB(const std::string& strWalletFile);
+void ThreadGroupCommitDB();
 
 
 class CDBEnv
@@ -47,6 +48,16 @@ public:
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
 
+    //! Commits (explicit or auto-committed writes) and log checkpoints so far, guarded by cs_db
+    uint64_t nCommits;
+    uint64_t nFlushes;
+    /**
+     * Group commit window in milliseconds. When non-zero, closing a write
+     * handle does not checkpoint; ThreadGroupCommitDB issues one checkpoint
+     * per window for all handles closed in it.
+     */
+    int64_t nGroupCommitWindow;
+
     CDBEnv();
     ~CDBEnv();
     void MakeMock();
@@ -80,6 +91,13 @@ public:
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
 
+    void IncrementCommits();
+    void Checkpoint();
+    //! Ask ThreadGroupCommitDB to checkpoint at the end of the current window
+    void RequestCheckpoint();
+    //! Checkpoint if anything was requested since the last call
+    void GroupCommit();
+
     DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC)
     {
         DbTxn* ptxn = NULL;
@@ -88,6 +106,9 @@ public:
             return NULL;
         return ptxn;
     }
+
+private:
+    bool fCheckpointPending;
 };
 
 extern CDBEnv bitdb;
@@ -170,6 +191,8 @@ protected:
 
         // Write
         int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        if (ret == 0 && !activeTxn)
+            bitdb.IncrementCommits();
 
         // Clear memory in case it was a private key
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -193,6 +216,8 @@ protected:
 
         // Erase
         int ret = pdb->del(activeTxn, &datKey, 0);
+        if (ret == 0 && !activeTxn)
+            bitdb.IncrementCommits();
 
         // Clear memory
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -224,7 +249,7 @@ protected:
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
+        int ret = pdb->cursor(activeTxn, &pcursor, 0);
         if (ret != 0)
             return NULL;
         return pcursor;
@@ -285,6 +310,8 @@ public:
             return false;
         int ret = activeTxn->commit(0);
         activeTxn = NULL;
+        if (ret == 0)
+            bitdb.IncrementCommits();
         return (ret == 0);
     }
 
@@ -214,6 +214,52 @@ public:
     }
 };
 
+/** Writes data through to another stream while hashing it, so a file can be checksummed as it is written. */
+template<typename Sink>
+class CHashingWriter : public CHashWriter
+{
+private:
+    Sink* sink;
+
+public:
+    CHashingWriter(Sink* sinkIn) : CHashWriter(sinkIn->GetType(), sinkIn->GetVersion()), sink(sinkIn) {}
+
+    CHashingWriter<Sink>& write(const char *pch, size_t size) {
+        sink->write(pch, size);
+        CHashWriter::write(pch, size);
+        return (*this);
+    }
+
+    template<typename T>
+    CHashingWriter<Sink>& operator<<(const T& obj) {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Reads data from another stream while hashing it, so a file can be verified without buffering it. */
+template<typename Source>
+class CHashVerifier : public CHashWriter
+{
+private:
+    Source* source;
+
+public:
+    CHashVerifier(Source* sourceIn) : CHashWriter(sourceIn->GetType(), sourceIn->GetVersion()), source(sourceIn) {}
+
+    CHashVerifier<Source>& read(char *pch, size_t size) {
+        source->read(pch, size);
+        CHashWriter::write(pch, size);
+        return (*this);
+    }
+
+    template<typename T>
+    CHashVerifier<Source>& operator>>(T& obj) {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 /** Compute the 256-bit hash of an object's serialization. */
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
@@ -225,6 +271,23 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/** SipHash-2-4, a fast keyed 64-bit hash. */
+class CSipHasher
+{
+private:
+    uint64_t v[4];
+    uint64_t tmp;
+    int count;
+
+public:
+    /** Construct a SipHash calculator initialized with 128-bit key (k0, k1) */
+    CSipHasher(uint64_t k0, uint64_t k1);
+    /** Hash arbitrary bytes. */
+    CSipHasher& Write(const unsigned char* data, size_t size);
+    /** Compute the 64-bit SipHash-2-4 of the data written so far. The object remains untouched. */
+    uint64_t Finalize() const;
+};
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
 //int HMAC_SHA512_Init(HMAC_SHA512_CTX *pctx, const void *pkey, size_t len);
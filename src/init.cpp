@@ -14,15 +14,18 @@
 #include "addrman.h"
 #include "amount.h"
 #include "auxpow.h"
+#include "blockfilterindex.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "key.h"
 #include "main.h"
 #include "miner.h"
 #include "net.h"
+#include "nodestatedb.h"
 #include "rpcserver.h"
 #include "script/standard.h"
 #include "script/sigcache.h"
+#include "startuptasks.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -37,9 +40,10 @@
 #include "systemnodeconfig.h"
 #include "spork.h"
 #include "utilmoneystr.h"
-#include "dbmanager.h"
 #include "instantx.h"
 #include "platform/platform-db.h"
+#include "platform/nf-token/nf-tokens-manager.h"
+#include "platform/nf-token/nft-protocols-manager.h"
 #ifdef ENABLE_WALLET
 #include "db.h"
 #include "wallet.h"
@@ -217,6 +221,8 @@ void PrepareShutdown()
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete pblockfilterindex;
+        pblockfilterindex = NULL;
         Platform::PlatformDb::DestroyInstance();
     }
 #ifdef ENABLE_WALLET
@@ -303,6 +309,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -?                     " + _("This help message") + "\n";
     strUsage += "  -alertnotify=<cmd>     " + _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)") + "\n";
     strUsage += "  -alerts                " + strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS);
+    strUsage += "  -backgroundverify      " + strprintf(_("Verify all but the last %u of -checkblocks in the background after startup (default: %u)"), DEFAULT_CHECKBLOCKS_BLOCKING, DEFAULT_BACKGROUND_VERIFY) + "\n";
+    strUsage += "  -blockfilterindex      " + strprintf(_("Maintain an index of compact block filters (BIP 157/158) and serve them to light clients (default: %u)"), DEFAULT_BLOCKFILTERINDEX) + "\n";
     strUsage += "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n";
     strUsage += "  -checkblocks=<n>       " + strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288) + "\n";
     strUsage += "  -checklevel=<n>        " + strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3) + "\n";
@@ -346,6 +354,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -maxsendbuffer=<n>     " + strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000) + "\n";
     strUsage += "  -onion=<ip:port>       " + strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy") + "\n";
     strUsage += "  -onlynet=<net>         " + _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)") + "\n";
+    strUsage += "  -peerbloomfilters      " + strprintf(_("Support filtering of blocks and transactions with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS) + "\n";
     strUsage += "  -permitbaremultisig    " + strprintf(_("Relay non-P2SH multisig (default: %u)"), 1) + "\n";
     strUsage += "  -port=<port>           " + strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 9340, 19340) + "\n";
     strUsage += "  -proxy=<ip:port>       " + _("Connect through SOCKS5 proxy") + "\n";
@@ -379,6 +388,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -maxtxfee=<amt>          " + strprintf(_("Maximum total fees to use in a single wallet transaction, setting too low may abort large transactions (default: %s)"), FormatMoney(maxTxFee)) + "\n";
     strUsage += "  -upgradewallet           " + _("Upgrade wallet to latest format") + " " + _("on startup") + "\n";
     strUsage += "  -wallet=<file>           " + _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), "wallet.dat") + "\n";
+    strUsage += "  -walletgroupcommit=<n>   " + strprintf(_("Coalesce wallet database flushes into one per <n> milliseconds; a crash may lose writes from the last window (0 = flush on every write, default: %u)"), 0) + "\n";
     strUsage += "  -walletnotify=<cmd>      " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n";
     if (mode == HMM_BITCOIN_QT)
         strUsage += "  -windowtitle=<name>  " + _("Wallet window title") + "\n";
@@ -599,62 +609,288 @@ bool InitSanityCheck(void)
 
 bool LoadData()
 {
-    std::string strDBName;
-    boost::filesystem::path pathDB = GetDataDir();
-
-    uiInterface.InitMessage(_("Loading masternode cache..."));
-    
-    if (!Load(mnodeman, "mncache.dat", "MasternodeCache"))
+    uiInterface.InitMessage(_("Loading masternode, budget and instant send cache..."));
+    if (!LoadNodeState())
     {
-        return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
+        return InitError(_("Failed to load masternode, budget and instant send cache from") + "\n" + (GetDataDir() / "nodestate").string());
     }
 
-    uiInterface.InitMessage(_("Loading systemnode cache..."));
-    if (!Load(snodeman, "sncache.dat", "SystemnodeCache"))
-    {
-        return InitError(_("Failed to load systemnode cache from") + "\n" + (pathDB / strDBName).string());
+    return true;
+}
+
+void DumpData()
+{
+    CloseNodeState();
+}
+
+/** Open the block tree, coins and platform databases and load the block index, offering a reindex if that fails */
+static bool LoadBlockChain(int64_t nBlockTreeDBCache, int64_t nCoinDBCache, int64_t nPlatformDbCache, Platform::PlatformOpt opt)
+{
+    int64_t nStart;
+    bool fLoaded = false;
+    while (!fLoaded) {
+        bool fReset = fReindex;
+        std::string strLoadError;
+
+        uiInterface.InitMessage(_("Loading block index..."));
+
+        nStart = GetTimeMillis();
+        do {
+            try {
+                UnloadBlockIndex();
+                delete pcoinsTip;
+                delete pcoinsdbview;
+                delete pcoinscatcher;
+                delete pblocktree;
+                Platform::PlatformDb::DestroyInstance();
+
+                Platform::PlatformDb::CreateInstance(nPlatformDbCache, opt, false, fReindex || fPlatformReindex);
+                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+
+                if (fReindex)
+                    pblocktree->WriteReindexing(true);
+
+                if (!LoadBlockIndex()) {
+                    strLoadError = _("Error loading block database");
+                    break;
+                }
+
+                // If the loaded chain has a wrong genesis, bail out immediately
+                // (we're likely using a testnet datadir, or the other way around).
+                if (!mapBlockIndex.empty() && mapBlockIndex.count(Params().HashGenesisBlock()) == 0)
+                    return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
+
+                if (!Params().HashDevnetGenesisBlock().IsNull() && !mapBlockIndex.empty() && mapBlockIndex.count(Params().HashDevnetGenesisBlock()) == 0)
+                    return InitError(_("Incorrect or no devnet genesis block found. Wrong datadir for devnet specified?"));
+
+                // Initialize the block index (no-op if non-empty database was already loaded)
+                if (!InitBlockIndex()) {
+                    strLoadError = _("Error initializing block database");
+                    break;
+                }
+
+                // Check for changed -txindex state
+                if (fTxIndex != GetBoolArg("-txindex", true)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
+                    break;
+                }
+
+                if (fPlatformReindex) {
+                    Platform::PlatformDb::Instance().Reindex();
+                }
+
+                uiInterface.InitMessage(_("Verifying blocks..."));
+                fVerifying = true;
+                // With -backgroundverify only the blocks nearest the tip are checked before going on
+                int nCheckBlocks = GetArg("-checkblocks", 288);
+                if (GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY) && (nCheckBlocks <= 0 || nCheckBlocks > DEFAULT_CHECKBLOCKS_BLOCKING))
+                    nCheckBlocks = DEFAULT_CHECKBLOCKS_BLOCKING;
+                if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 4), nCheckBlocks)) {
+                    strLoadError = _("Corrupted block database detected");
+                    fVerifying = false;
+                    break;
+                }
+                fVerifying = false;
+            } catch(std::exception &e) {
+                if (fDebug) LogPrintf("%s\n", e.what());
+                strLoadError = _("Error opening block database");
+                break;
+            }
+
+            Platform::PlatformDb::Instance().CleanupDb();
+            fLoaded = true;
+        } while(false);
+
+        if (!fLoaded) {
+            // first suggest a reindex
+            if (!fReset) {
+                bool fRet = uiInterface.ThreadSafeMessageBox(
+                    strLoadError + ".\n\n" + _("Do you want to rebuild the block database now?"),
+                    "", CClientUIInterface::MSG_ERROR | CClientUIInterface::BTN_ABORT);
+                if (fRet) {
+                    fReindex = true;
+                    fRequestShutdown = false;
+                } else {
+                    LogPrintf("Aborted block database rebuild. Exiting.\n");
+                    return false;
+                }
+            } else {
+                return InitError(strLoadError);
+            }
+        }
     }
 
-    uiInterface.InitMessage(_("Loading instant send cache..."));
-    if (!Load(GetInstantSend(), "ixcache.dat", "InstantSend"))
+    // As LoadBlockIndex can take several minutes, it's possible the user
+    // requested to kill the GUI during the last operation. If so, exit.
+    // As the program has not fully started yet, Shutdown() is possibly overkill.
+    if (fRequestShutdown)
     {
-        return InitError(_("Failed to load systemnode cache from") + "\n" + (pathDB / strDBName).string());
+        LogPrintf("Shutdown requested. Exiting.\n");
+        return false;
     }
+    LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
-    uiInterface.InitMessage(_("Loading budget cache..."));
-    if (!Load(budget, "budget-v2.dat", "MasternodeBudget"))
-    {
-        return InitError(_("Failed to load systemnode cache from") + "\n" + (pathDB / strDBName).string());
+    return true;
+}
+
+static bool LoadFeeEstimates()
+{
+    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    // Allowed to fail as this file IS missing on first startup.
+    if (!est_filein.IsNull())
+        mempool.ReadFeeEstimates(est_filein);
+    fFeeEstimatesInitialized = true;
+    return true;
+}
+
+/** Build the nf-token indexes from the platform database, they start at the loaded tip */
+static bool LoadPlatformIndexes()
+{
+    Platform::NftProtocolsManager::Instance();
+    Platform::NfTokensManager::Instance();
+    return true;
+}
+
+#ifdef ENABLE_WALLET
+/** Read wallet.dat, this does not need the block chain */
+static bool LoadWalletFile(const std::string& strWalletFile, std::vector<CWalletTx>& vWtx, bool& fFirstRun, std::ostringstream& strErrors)
+{
+    if (GetBoolArg("-zapwallettxes", false)) {
+        uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
+
+        pwalletMain = new CWallet(strWalletFile);
+        DBErrors nZapWalletRet = pwalletMain->ZapWalletTx(vWtx);
+        if (nZapWalletRet != DB_LOAD_OK) {
+            uiInterface.InitMessage(_("Error loading wallet.dat: Wallet corrupted"));
+            return false;
+        }
+
+        delete pwalletMain;
+        pwalletMain = NULL;
     }
 
-    //flag our cached items so we send them to our peers
-    budget.ResetSync();
-    budget.ClearSeen();
+    uiInterface.InitMessage(_("Loading wallet..."));
 
-    uiInterface.InitMessage(_("Loading masternode payment cache..."));
-    if (!Load(masternodePayments, "mnpayments.dat", "MasternodePayments"))
+    int64_t nStart = GetTimeMillis();
+    fFirstRun = true;
+    pwalletMain = new CWallet(strWalletFile);
+    DBErrors nLoadWalletRet = pwalletMain->LoadWallet(fFirstRun);
+    if (nLoadWalletRet != DB_LOAD_OK)
     {
-        return InitError(_("Failed to load systemnode cache from") + "\n" + (pathDB / strDBName).string());
+        if (nLoadWalletRet == DB_CORRUPT)
+            strErrors << _("Error loading wallet.dat: Wallet corrupted") << "\n";
+        else if (nLoadWalletRet == DB_NONCRITICAL_ERROR)
+        {
+            string msg(_("Warning: error reading wallet.dat! All keys read correctly, but transaction data"
+                         " or address book entries might be missing or incorrect."));
+            InitWarning(msg);
+        }
+        else if (nLoadWalletRet == DB_TOO_NEW)
+            strErrors << _("Error loading wallet.dat: Wallet requires newer version of Crown Core") << "\n";
+        else if (nLoadWalletRet == DB_NEED_REWRITE)
+        {
+            strErrors << _("Wallet needed to be rewritten: restart Crown Core to complete") << "\n";
+            LogPrintf("%s", strErrors.str());
+            return InitError(strErrors.str());
+        }
+        else
+            strErrors << _("Error loading wallet.dat") << "\n";
     }
 
-    uiInterface.InitMessage(_("Loading systemnode payment cache..."));
-    if (!Load(systemnodePayments, "snpayments.dat", "SystemnodePayments"))
+    if (GetBoolArg("-upgradewallet", fFirstRun))
     {
-        return InitError(_("Failed to load systemnode cache from") + "\n" + (pathDB / strDBName).string());
+        int nMaxVersion = GetArg("-upgradewallet", 0);
+        if (nMaxVersion == 0) // the -upgradewallet without argument case
+        {
+            LogPrintf("Performing wallet upgrade to %i\n", FEATURE_LATEST);
+            nMaxVersion = CLIENT_VERSION;
+            pwalletMain->SetMinVersion(FEATURE_LATEST); // permanently upgrade the wallet immediately
+        }
+        else
+            LogPrintf("Allowing wallet upgrade up to %i\n", nMaxVersion);
+        if (nMaxVersion < pwalletMain->GetVersion())
+            strErrors << _("Cannot downgrade wallet") << "\n";
+        pwalletMain->SetMaxVersion(nMaxVersion);
     }
 
+    if (fFirstRun)
+    {
+        // Create new keyUser and set as default key
+        RandAddSeedPerfmon();
+
+        CPubKey newDefaultKey;
+        if (pwalletMain->GetKeyFromPool(newDefaultKey)) {
+            pwalletMain->SetDefaultKey(newDefaultKey);
+            if (!pwalletMain->SetAddressBook(pwalletMain->vchDefaultKey.GetID(), "", "receive"))
+                strErrors << _("Cannot write default address") << "\n";
+        }
+    }
+
+    LogPrintf("%s", strErrors.str());
+    LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
     return true;
 }
 
-void DumpData()
+/** Bring the loaded wallet up to the loaded block chain */
+static bool SyncWalletWithChain(const std::string& strWalletFile, const std::vector<CWalletTx>& vWtx, const bool& fFirstRun)
 {
-    Dump(mnodeman, "mncache.dat", "MasternodeCache");
-    Dump(budget, "budget-v2.dat", "MasternodeBudget");
-    Dump(masternodePayments, "mnpayments.dat", "MasternodePayments");
-    Dump(snodeman, "sncache.dat", "SystemnodeCache");
-    Dump(systemnodePayments, "snpayments.dat", "SystemnodePayments");
-    Dump(GetInstantSend(), "ixcache.dat", "InstantSend");
+    if (fFirstRun)
+        pwalletMain->SetBestChain(chainActive.GetLocator());
+
+    RegisterValidationInterface(pwalletMain);
+
+    CBlockIndex *pindexRescan = chainActive.Tip();
+    if (GetBoolArg("-rescan", false))
+        pindexRescan = chainActive.Genesis();
+    else
+    {
+        CWalletDB walletdb(strWalletFile);
+        CBlockLocator locator;
+        if (walletdb.ReadBestBlock(locator))
+            pindexRescan = FindForkInGlobalIndex(chainActive, locator);
+        else
+            pindexRescan = chainActive.Genesis();
+    }
+    if (chainActive.Tip() && chainActive.Tip() != pindexRescan)
+    {
+        uiInterface.InitMessage(_("Rescanning..."));
+        LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
+        int64_t nStart = GetTimeMillis();
+        pwalletMain->ScanForWalletTransactions(pindexRescan, true);
+        LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
+        pwalletMain->SetBestChain(chainActive.GetLocator());
+        nWalletDBUpdated++;
+
+        // Restore wallet transaction metadata after -zapwallettxes=1
+        if (GetBoolArg("-zapwallettxes", false) && GetArg("-zapwallettxes", "1") != "2")
+        {
+            BOOST_FOREACH(const CWalletTx& wtxOld, vWtx)
+            {
+                uint256 hash = wtxOld.GetHash();
+                std::map<uint256, CWalletTx>::iterator mi = pwalletMain->mapWallet.find(hash);
+                if (mi != pwalletMain->mapWallet.end())
+                {
+                    const CWalletTx* copyFrom = &wtxOld;
+                    CWalletTx* copyTo = &mi->second;
+                    copyTo->mapValue = copyFrom->mapValue;
+                    copyTo->vOrderForm = copyFrom->vOrderForm;
+                    copyTo->nTimeReceived = copyFrom->nTimeReceived;
+                    copyTo->nTimeSmart = copyFrom->nTimeSmart;
+                    copyTo->fFromMe = copyFrom->fFromMe;
+                    copyTo->strFromAccount = copyFrom->strFromAccount;
+                    copyTo->nOrderPos = copyFrom->nOrderPos;
+                    copyTo->WriteToDisk();
+                }
+            }
+        }
+    }
+    return true;
 }
+#endif // ENABLE_WALLET
 
 /** Initialize crown.
  *  @pre Parameters should be parsed and config file should be read.
@@ -928,6 +1164,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     nMaxDatacarrierBytes = GetArg("-datacarriersize", nMaxDatacarrierBytes);
 
     fAlerts = GetBoolArg("-alerts", DEFAULT_ALERTS);
+    fPeerBloomFilters = GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS);
 
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
 
@@ -1269,6 +1506,10 @@ bool AppInit2(boost::thread_group& threadGroup)
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (GetBoolArg("-txindex", true) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nBlockFilterIndexCache = 0;
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+        nBlockFilterIndexCache = std::min(nTotalCache / 8, nMaxBlockFilterIndexCache << 20);
+    nTotalCache -= nBlockFilterIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1277,265 +1518,53 @@ bool AppInit2(boost::thread_group& threadGroup)
     int64_t nPlatformDbCache = 1024 * 1024 * 10; //TODO: set appropriate platform db cache size
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nBlockFilterIndexCache > 0)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
-    bool fLoaded = false;
-    while (!fLoaded) {
-        bool fReset = fReindex;
-        std::string strLoadError;
-
-        uiInterface.InitMessage(_("Loading block index..."));
-
-        nStart = GetTimeMillis();
-        do {
-            try {
-                UnloadBlockIndex();
-                delete pcoinsTip;
-                delete pcoinsdbview;
-                delete pcoinscatcher;
-                delete pblocktree;
-                Platform::PlatformDb::DestroyInstance();
-
-                Platform::PlatformDb::CreateInstance(nPlatformDbCache, opt, false, fReindex || fPlatformReindex);
-                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
-                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
-
-                if (fReindex)
-                    pblocktree->WriteReindexing(true);
-
-                if (!LoadBlockIndex()) {
-                    strLoadError = _("Error loading block database");
-                    break;
-                }
-
-                // If the loaded chain has a wrong genesis, bail out immediately
-                // (we're likely using a testnet datadir, or the other way around).
-                if (!mapBlockIndex.empty() && mapBlockIndex.count(Params().HashGenesisBlock()) == 0)
-                    return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
-
-                if (!Params().HashDevnetGenesisBlock().IsNull() && !mapBlockIndex.empty() && mapBlockIndex.count(Params().HashDevnetGenesisBlock()) == 0)
-                    return InitError(_("Incorrect or no devnet genesis block found. Wrong datadir for devnet specified?"));
-
-                // Initialize the block index (no-op if non-empty database was already loaded)
-                if (!InitBlockIndex()) {
-                    strLoadError = _("Error initializing block database");
-                    break;
-                }
-
-                // Check for changed -txindex state
-                if (fTxIndex != GetBoolArg("-txindex", true)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
-                    break;
-                }
-
-                if (fPlatformReindex) {
-                    Platform::PlatformDb::Instance().Reindex();
-                }
-
-                uiInterface.InitMessage(_("Verifying blocks..."));
-                fVerifying = true;
-                if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 4),
-                              GetArg("-checkblocks", 288))) {
-                    strLoadError = _("Corrupted block database detected");
-                    fVerifying = false;
-                    break;
-                }
-                fVerifying = false;
-            } catch(std::exception &e) {
-                if (fDebug) LogPrintf("%s\n", e.what());
-                strLoadError = _("Error opening block database");
-                break;
-            }
-
-            Platform::PlatformDb::Instance().CleanupDb();
-            fLoaded = true;
-        } while(false);
-
-        if (!fLoaded) {
-            // first suggest a reindex
-            if (!fReset) {
-                bool fRet = uiInterface.ThreadSafeMessageBox(
-                    strLoadError + ".\n\n" + _("Do you want to rebuild the block database now?"),
-                    "", CClientUIInterface::MSG_ERROR | CClientUIInterface::BTN_ABORT);
-                if (fRet) {
-                    fReindex = true;
-                    fRequestShutdown = false;
-                } else {
-                    LogPrintf("Aborted block database rebuild. Exiting.\n");
-                    return false;
-                }
-            } else {
-                return InitError(strLoadError);
-            }
-        }
-    }
-
-    // As LoadBlockIndex can take several minutes, it's possible the user
-    // requested to kill the GUI during the last operation. If so, exit.
-    // As the program has not fully started yet, Shutdown() is possibly overkill.
-    if (fRequestShutdown)
-    {
-        LogPrintf("Shutdown requested. Exiting.\n");
-        return false;
-    }
-    LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
-
-    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
-    // Allowed to fail as this file IS missing on first startup.
-    if (!est_filein.IsNull())
-        mempool.ReadFeeEstimates(est_filein);
-    fFeeEstimatesInitialized = true;
+    // Independent loads run in parallel, the wallet and the node state are
+    // brought up to the block chain once it is loaded
+    CStartupTaskGraph startup;
+    std::vector<std::string> vAfterBlockIndex(1, "blockindex");
+    startup.Add("blockindex", boost::bind(&LoadBlockChain, nBlockTreeDBCache, nCoinDBCache, nPlatformDbCache, opt));
+    startup.Add("feeestimates", &LoadFeeEstimates);
+    startup.Add("nodestate", &LoadData, vAfterBlockIndex);
+    startup.Add("platform", &LoadPlatformIndexes, vAfterBlockIndex);
 
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
+    // needed to restore wallet transaction meta data after -zapwallettxes
+    std::vector<CWalletTx> vWtx;
+    bool fFirstRun = true;
+
     if (fDisableWallet) {
         pwalletMain = NULL;
         LogPrintf("Wallet disabled!\n");
     } else {
-
-        // needed to restore wallet transaction meta data after -zapwallettxes
-        std::vector<CWalletTx> vWtx;
-
-        if (GetBoolArg("-zapwallettxes", false)) {
-            uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
-
-            pwalletMain = new CWallet(strWalletFile);
-            DBErrors nZapWalletRet = pwalletMain->ZapWalletTx(vWtx);
-            if (nZapWalletRet != DB_LOAD_OK) {
-                uiInterface.InitMessage(_("Error loading wallet.dat: Wallet corrupted"));
-                return false;
-            }
-
-            delete pwalletMain;
-            pwalletMain = NULL;
-        }
-
-        uiInterface.InitMessage(_("Loading wallet..."));
-
-        nStart = GetTimeMillis();
-        bool fFirstRun = true;
-        pwalletMain = new CWallet(strWalletFile);
-        DBErrors nLoadWalletRet = pwalletMain->LoadWallet(fFirstRun);
-        if (nLoadWalletRet != DB_LOAD_OK)
-        {
-            if (nLoadWalletRet == DB_CORRUPT)
-                strErrors << _("Error loading wallet.dat: Wallet corrupted") << "\n";
-            else if (nLoadWalletRet == DB_NONCRITICAL_ERROR)
-            {
-                string msg(_("Warning: error reading wallet.dat! All keys read correctly, but transaction data"
-                             " or address book entries might be missing or incorrect."));
-                InitWarning(msg);
-            }
-            else if (nLoadWalletRet == DB_TOO_NEW)
-                strErrors << _("Error loading wallet.dat: Wallet requires newer version of Crown Core") << "\n";
-            else if (nLoadWalletRet == DB_NEED_REWRITE)
-            {
-                strErrors << _("Wallet needed to be rewritten: restart Crown Core to complete") << "\n";
-                LogPrintf("%s", strErrors.str());
-                return InitError(strErrors.str());
-            }
-            else
-                strErrors << _("Error loading wallet.dat") << "\n";
-        }
-
-        if (GetBoolArg("-upgradewallet", fFirstRun))
-        {
-            int nMaxVersion = GetArg("-upgradewallet", 0);
-            if (nMaxVersion == 0) // the -upgradewallet without argument case
-            {
-                LogPrintf("Performing wallet upgrade to %i\n", FEATURE_LATEST);
-                nMaxVersion = CLIENT_VERSION;
-                pwalletMain->SetMinVersion(FEATURE_LATEST); // permanently upgrade the wallet immediately
-            }
-            else
-                LogPrintf("Allowing wallet upgrade up to %i\n", nMaxVersion);
-            if (nMaxVersion < pwalletMain->GetVersion())
-                strErrors << _("Cannot downgrade wallet") << "\n";
-            pwalletMain->SetMaxVersion(nMaxVersion);
-        }
-
-        if (fFirstRun)
-        {
-            // Create new keyUser and set as default key
-            RandAddSeedPerfmon();
-
-            CPubKey newDefaultKey;
-            if (pwalletMain->GetKeyFromPool(newDefaultKey)) {
-                pwalletMain->SetDefaultKey(newDefaultKey);
-                if (!pwalletMain->SetAddressBook(pwalletMain->vchDefaultKey.GetID(), "", "receive"))
-                    strErrors << _("Cannot write default address") << "\n";
-            }
-
-            pwalletMain->SetBestChain(chainActive.GetLocator());
-        }
-
-        LogPrintf("%s", strErrors.str());
-        LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
-
-        RegisterValidationInterface(pwalletMain);
-
-        CBlockIndex *pindexRescan = chainActive.Tip();
-        if (GetBoolArg("-rescan", false))
-            pindexRescan = chainActive.Genesis();
-        else
-        {
-            CWalletDB walletdb(strWalletFile);
-            CBlockLocator locator;
-            if (walletdb.ReadBestBlock(locator))
-                pindexRescan = FindForkInGlobalIndex(chainActive, locator);
-            else
-                pindexRescan = chainActive.Genesis();
-        }
-        if (chainActive.Tip() && chainActive.Tip() != pindexRescan)
-        {
-            uiInterface.InitMessage(_("Rescanning..."));
-            LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
-            nStart = GetTimeMillis();
-            pwalletMain->ScanForWalletTransactions(pindexRescan, true);
-            LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
-            pwalletMain->SetBestChain(chainActive.GetLocator());
-            nWalletDBUpdated++;
-
-            // Restore wallet transaction metadata after -zapwallettxes=1
-            if (GetBoolArg("-zapwallettxes", false) && GetArg("-zapwallettxes", "1") != "2")
-            {
-                BOOST_FOREACH(const CWalletTx& wtxOld, vWtx)
-                {
-                    uint256 hash = wtxOld.GetHash();
-                    std::map<uint256, CWalletTx>::iterator mi = pwalletMain->mapWallet.find(hash);
-                    if (mi != pwalletMain->mapWallet.end())
-                    {
-                        const CWalletTx* copyFrom = &wtxOld;
-                        CWalletTx* copyTo = &mi->second;
-                        copyTo->mapValue = copyFrom->mapValue;
-                        copyTo->vOrderForm = copyFrom->vOrderForm;
-                        copyTo->nTimeReceived = copyFrom->nTimeReceived;
-                        copyTo->nTimeSmart = copyFrom->nTimeSmart;
-                        copyTo->fFromMe = copyFrom->fFromMe;
-                        copyTo->strFromAccount = copyFrom->strFromAccount;
-                        copyTo->nOrderPos = copyFrom->nOrderPos;
-                        copyTo->WriteToDisk();
-                    }
-                }
-            }
-        }
-    } // (!fDisableWallet)
+        std::vector<std::string> vAfterWallet(vAfterBlockIndex);
+        vAfterWallet.push_back("wallet");
+        startup.Add("wallet", boost::bind(&LoadWalletFile, strWalletFile, boost::ref(vWtx), boost::ref(fFirstRun), boost::ref(strErrors)));
+        startup.Add("walletsync", boost::bind(&SyncWalletWithChain, strWalletFile, boost::cref(vWtx), boost::cref(fFirstRun)), vAfterWallet);
+    }
 #else // ENABLE_WALLET
     LogPrintf("No wallet compiled in!\n");
 #endif // !ENABLE_WALLET
+
+    if (!startup.Run(boost::thread::hardware_concurrency()))
+        return false;
+
     // ********************************************************* Step 9: import blocks
 
     if (mapArgs.count("-blocknotify"))
         uiInterface.NotifyBlockTip.connect(BlockNotifyCallback);
 
     // scan for better chains in the block chain database, that are not yet connected in the active best chain
+    nStart = GetTimeMillis();
     CValidationState state;
     if (!ActivateBestChain(state))
         strErrors << "Failed to connect best block";
+    RecordStartupStage("activatechain", nStart, GetTimeMillis(), state.IsValid());
 
     std::vector<boost::filesystem::path> vImportFiles;
     if (mapArgs.count("-loadblock"))
@@ -1550,10 +1579,28 @@ bool AppInit2(boost::thread_group& threadGroup)
             MilliSleep(10);
     }
 
+    // Filters of blocks already in the chain are built in the background, new
+    // blocks get theirs in ConnectBlock once the build has caught up
+    if (nBlockFilterIndexCache > 0) {
+        pblockfilterindex = new CBlockFilterIndex(nBlockFilterIndexCache, false, fReindex);
+        threadGroup.create_thread(&ThreadBuildBlockFilterIndex);
+    }
+
+    // The rest of -checkblocks is verified on low priority threads, a
+    // corrupted block raises a warning instead of stopping the startup
+    int nCheckBlocks = GetArg("-checkblocks", 288);
+    if (GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY) && (nCheckBlocks <= 0 || nCheckBlocks > DEFAULT_CHECKBLOCKS_BLOCKING))
+        threadGroup.create_thread(boost::bind(&ThreadVerifyDB, GetArg("-checklevel", 4), nCheckBlocks, DEFAULT_CHECKBLOCKS_BLOCKING));
+
     // ********************************************************* Step 10: setup Budgets
 
-    if (!LoadData())
-        return false;
+    nStart = GetTimeMillis();
+    CheckNodeState();
+
+    //flag our cached items so we send them to our peers
+    budget.ResetSync();
+    budget.ClearSeen();
+    RecordStartupStage("nodestatecheck", nStart, GetTimeMillis());
 
     fMasterNode = GetBoolArg("-masternode", false);
     fSystemNode = GetBoolArg("-systemnode", false);
@@ -1712,6 +1759,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     // ********************************************************* Step 12: finished
 
     SetRPCWarmupFinished();
+    SetStartupFinished();
     uiInterface.InitMessage(_("Done loading"));
 
 #ifdef ENABLE_WALLET
@@ -1721,6 +1769,11 @@ bool AppInit2(boost::thread_group& threadGroup)
 
         // Run a thread to flush wallet periodically
         threadGroup.create_thread(boost::bind(&ThreadFlushWalletDB, boost::ref(pwalletMain->strWalletFile)));
+
+        // Run a thread to coalesce wallet database flushes
+        bitdb.nGroupCommitWindow = std::max(GetArg("-walletgroupcommit", 0), (int64_t)0);
+        if (bitdb.nGroupCommitWindow > 0)
+            threadGroup.create_thread(&ThreadGroupCommitDB);
     }
 #endif
 
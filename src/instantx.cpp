@@ -36,8 +36,9 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
     {
         //LogPrintf("ProcessMessageInstantX::ix\n");
         CDataStream vMsg(vRecv);
-        CTransaction tx;
-        vRecv >> tx;
+        CTransactionRef ptx;
+        vRecv >> ptx;
+        const CTransaction& tx = *ptx;
 
         CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
@@ -52,7 +53,7 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
         if (GetTransactionAge(tx.GetHash()) > m_acceptedBlockCount)
             return;
 
-        int64_t nBlockHeight = CreateNewLock(tx);
+        int64_t nBlockHeight = CreateNewLock(ptx);
         if (nBlockHeight == 0)
             return;
 
@@ -62,7 +63,7 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
         bool fAccepted = false;
         {
             LOCK(cs_main);
-            fAccepted = AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs);
+            fAccepted = AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs);
         }
         if (fAccepted)
         {
@@ -70,7 +71,7 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
 
             DoConsensusVote(tx, nBlockHeight);
 
-            m_txLockReq.insert(make_pair(tx.GetHash(), tx));
+            m_txLockReq.insert(make_pair(tx.GetHash(), ptx));
 
             IXLogPrintf("ProcessMessageInstantX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -80,7 +81,7 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
             return;
 
         } else {
-            m_txLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            m_txLockReqRejected.insert(make_pair(tx.GetHash(), ptx));
 
             // can we get the conflicting transaction as proof?
 
@@ -105,7 +106,7 @@ void InstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, CD
 
                         //reprocess the last 15 blocks
                         ReprocessBlocks(15);
-                        m_txLockReq.insert(make_pair(tx.GetHash(), tx));
+                        m_txLockReq.insert(make_pair(tx.GetHash(), ptx));
                     }
                 }
             }
@@ -218,6 +219,12 @@ bool InstantSend::IsIxTxValid(const CTransaction& txCollateral) const
 
 int64_t InstantSend::CreateNewLock(const CTransaction& tx)
 {
+    return CreateNewLock(MakeTransactionRef(tx));
+}
+
+int64_t InstantSend::CreateNewLock(const CTransactionRef& ptx)
+{
+    const CTransaction& tx = *ptx;
     LOCK(cs);
     int64_t nTxAge = 0;
     BOOST_REVERSE_FOREACH(CTxIn i, tx.vin){
@@ -248,7 +255,7 @@ int64_t InstantSend::CreateNewLock(const CTransaction& tx)
         LogPrint("instantx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
     }
 
-    m_txLockReq.insert(make_pair(tx.GetHash(), tx));
+    m_txLockReq.insert(make_pair(tx.GetHash(), ptx));
     return nBlockHeight;
 }
 
@@ -258,24 +265,16 @@ void InstantSend::DoConsensusVote(const CTransaction& tx, int64_t nBlockHeight)
     LOCK(cs);
     if(!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
-
-    if(n == -1)
-    {
-        LogPrint("instantx", "InstantX::DoConsensusVote - Unknown Masternode\n");
-        return;
-    }
-
-    if(n > INSTANTX_SIGNATURES_TOTAL)
+    if(!IsInQuorum(activeMasternode.vin, nBlockHeight))
     {
-        LogPrint("instantx", "InstantX::DoConsensusVote - Masternode not in the top %d (%d)\n", INSTANTX_SIGNATURES_TOTAL, n);
+        LogPrint("instantx", "InstantX::DoConsensusVote - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
         return;
     }
     /*
         nBlockHeight calculated from the transaction is the authoritive source
     */
 
-    LogPrint("instantx", "InstantX::DoConsensusVote - In the top %d (%d)\n", INSTANTX_SIGNATURES_TOTAL, n);
+    LogPrint("instantx", "InstantX::DoConsensusVote - In the top %d\n", INSTANTX_SIGNATURES_TOTAL);
 
     CConsensusVote ctx;
     ctx.vinMasternode = activeMasternode.vin;
@@ -300,13 +299,13 @@ void InstantSend::DoConsensusVote(const CTransaction& tx, int64_t nBlockHeight)
 bool InstantSend::ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx)
 {
     LOCK(cs);
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    bool fInQuorum = IsInQuorum(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if(pmn != NULL)
-        IXLogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode ADDR %s %d\n", pmn->addr.ToString().c_str(), n);
+        IXLogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode ADDR %s %d\n", pmn->addr.ToString().c_str(), fInQuorum);
 
-    if(n == -1)
+    if(!fInQuorum && (pmn == NULL || !pmn->IsEnabled() || pmn->protocolVersion < MIN_INSTANTX_PROTO_VERSION))
     {
         //can be caused by past versions trying to vote with an invalid protocol
         LogPrint("instantx", "InstantX::ProcessConsensusVote - Unknown Masternode\n");
@@ -314,9 +313,9 @@ bool InstantSend::ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx)
         return false;
     }
 
-    if(n > INSTANTX_SIGNATURES_TOTAL)
+    if(!fInQuorum)
     {
-        LogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode not in the top %d (%d) - %s\n", INSTANTX_SIGNATURES_TOTAL, n, ctx.GetHash().ToString().c_str());
+        LogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode not in the top %d - %s\n", INSTANTX_SIGNATURES_TOTAL, ctx.GetHash().ToString().c_str());
         return false;
     }
 
@@ -356,7 +355,10 @@ bool InstantSend::ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx)
             IXLogPrintf("InstantX::ProcessConsensusVote - Transaction Lock Is Complete \n");
             LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
 
-            CTransaction& tx = m_txLockReq[ctx.txHash];
+            CTransactionRef& ptx = m_txLockReq[ctx.txHash];
+            if (!ptx)
+                ptx = MakeTransactionRef();
+            const CTransaction& tx = *ptx;
             if(!CheckForConflictingLocks(tx)){
 
 #ifdef ENABLE_WALLET
@@ -434,11 +436,46 @@ int64_t InstantSend::GetAverageVoteTime() const
     return total / count;
 }
 
+const CInstantSendQuorum* InstantSend::GetQuorum(int nBlockHeight)
+{
+    LOCK(cs);
+
+    // An added or removed masternode can change any ranking
+    int nMasternodes = mnodeman.size();
+    if(nMasternodes != m_quorumsMasternodeCount) {
+        m_quorums.clear();
+        m_quorumsMasternodeCount = nMasternodes;
+    }
+
+    std::map<int, CInstantSendQuorum>::const_iterator it = m_quorums.find(nBlockHeight);
+    if(it != m_quorums.end())
+        return &it->second;
+
+    std::vector<CTxIn> vecTop = mnodeman.GetTopMasternodes(INSTANTX_SIGNATURES_TOTAL, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    if(vecTop.empty())
+        return NULL; // unknown block, try again later
+
+    CInstantSendQuorum& quorum = m_quorums[nBlockHeight];
+    BOOST_FOREACH(const CTxIn& vin, vecTop)
+        quorum.insert(vin.prevout);
+    return &quorum;
+}
+
+bool InstantSend::IsInQuorum(const CTxIn& vinMasternode, int nBlockHeight)
+{
+    LOCK(cs);
+    const CInstantSendQuorum* pquorum = GetQuorum(nBlockHeight);
+    return pquorum != NULL && pquorum->count(vinMasternode.prevout);
+}
+
 void InstantSend::CheckAndRemove()
 {
     LOCK(cs);
     if(chainActive.Tip() == NULL) return;
 
+    // The masternode list was just checked, rank again with the new states
+    m_quorums.clear();
+
     std::map<uint256, CTransactionLock>::iterator it = m_txLocks.begin();
 
     while (it != m_txLocks.end())
@@ -450,10 +487,10 @@ void InstantSend::CheckAndRemove()
             // Remove rejected transaction if expired
             m_txLockReqRejected.erase(it->second.txHash);
 
-            std::map<uint256, CTransaction>::iterator itLock = m_txLockReq.find(it->second.txHash);
+            std::map<uint256, CTransactionRef>::iterator itLock = m_txLockReq.find(it->second.txHash);
             if (itLock != m_txLockReq.end())
             {
-                CTransaction& tx = itLock->second;
+                const CTransaction& tx = *itLock->second;
 
                 BOOST_FOREACH(const CTxIn& in, tx.vin)
                     m_lockedInputs.erase(in.prevout);
@@ -526,12 +563,12 @@ boost::optional<CConsensusVote> InstantSend::GetLockVote(uint256 txHash) const
     return boost::optional<CConsensusVote>();
 }
 
-boost::optional<CTransaction> InstantSend::GetLockReq(uint256 txHash) const
+CTransactionRef InstantSend::GetLockReq(uint256 txHash) const
 {
-    std::map<uint256, CTransaction>::const_iterator it = m_txLockReq.find(txHash);
+    std::map<uint256, CTransactionRef>::const_iterator it = m_txLockReq.find(txHash);
     if (it != m_txLockReq.end())
-        return boost::optional<CTransaction>(it->second);
-    return boost::optional<CTransaction>();
+        return it->second;
+    return CTransactionRef();
 }
 
 bool InstantSend::AlreadyHave(uint256 txHash) const
@@ -560,6 +597,7 @@ void InstantSend::Clear()
     m_txLocks.clear();
     m_unknownVotes.clear();
     m_txLockReqRejected.clear();
+    m_quorums.clear();
 }
 
 int InstantSend::GetCompleteLocksCount() const
@@ -626,23 +664,19 @@ bool CConsensusVote::Sign()
 
 bool CTransactionLock::SignaturesValid() const
 {
-
-    BOOST_FOREACH(CConsensusVote vote, vecConsensusVotes)
+    // Check quorum membership of all votes first, it is cheap and rejects
+    // most bad locks before any signature is verified
+    BOOST_FOREACH(const CConsensusVote& vote, vecConsensusVotes)
     {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
-
-        if(n == -1)
+        if(!GetInstantSend().IsInQuorum(vote.vinMasternode, vote.nBlockHeight))
         {
-            IXLogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
-            return false;
-        }
-
-        if(n > INSTANTX_SIGNATURES_TOTAL)
-        {
-            IXLogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %s\n", INSTANTX_SIGNATURES_TOTAL);
+            IXLogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
             return false;
         }
+    }
 
+    BOOST_FOREACH(const CConsensusVote& vote, vecConsensusVotes)
+    {
         if(!vote.SignatureValid()){
             IXLogPrintf("CTransactionLock::SignaturesValid() - Signature not valid\n");
             return false;
@@ -667,7 +701,7 @@ int CTransactionLock::CountSignatures() const
     if(nBlockHeight == 0) return -1;
 
     int n = 0;
-    BOOST_FOREACH(CConsensusVote v, vecConsensusVotes){
+    BOOST_FOREACH(const CConsensusVote& v, vecConsensusVotes){
         if(v.nBlockHeight == nBlockHeight){
             n++;
         }
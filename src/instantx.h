@@ -13,6 +13,8 @@
 #include "main.h"
 #include "spork.h"
 
+#include <boost/unordered_set.hpp>
+
 /*
     At 15 signatures, 1/2 of the masternode network can be owned by
     one party without comprimising the security of InstantX
@@ -31,6 +33,14 @@ class InstantSend;
 
 static const int MIN_INSTANTX_PROTO_VERSION = 70040;
 
+struct COutPointCheapHasher
+{
+    size_t operator()(const COutPoint& out) const { return out.hash.GetCheapHash() ^ out.n; }
+};
+
+/** Collateral outpoints of the top INSTANTX_SIGNATURES_TOTAL masternodes for one block height */
+typedef boost::unordered_set<COutPoint, COutPointCheapHasher> CInstantSendQuorum;
+
 extern std::auto_ptr<InstantSend> g_instantSend;
 
 InstantSend& GetInstantSend();
@@ -38,10 +48,12 @@ InstantSend& GetInstantSend();
 class InstantSend
 {
 public:
+    InstantSend() : m_completeTxLocks(0), m_quorumsMasternodeCount(0) {}
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
     void CheckAndRemove();
     void Clear();
     int64_t CreateNewLock(const CTransaction& tx);
+    int64_t CreateNewLock(const CTransactionRef& ptx);
     int GetSignaturesCount(uint256 txHash) const;
     int GetCompleteLocksCount() const;
     bool IsLockTimedOut(uint256 txHash) const;
@@ -50,7 +62,9 @@ public:
     std::string ToString() const;
     boost::optional<uint256> GetLockedTx(const COutPoint& out) const;
     boost::optional<CConsensusVote> GetLockVote(uint256 txHash) const;
-    boost::optional<CTransaction> GetLockReq(uint256 txHash) const;
+    //! The lock request of txHash, null if there is none
+    CTransactionRef GetLockReq(uint256 txHash) const;
+    bool IsInQuorum(const CTxIn& vinMasternode, int nBlockHeight);
 
     ADD_SERIALIZE_METHODS;
 
@@ -64,6 +78,19 @@ public:
         READWRITE(m_txLockReqRejected);
         READWRITE(m_completeTxLocks);
     }
+
+    /// Lock requests, votes and completed locks with the inputs they lock
+    template <typename Records>
+    void RecordsOp(Records& r) {
+        LOCK(cs);
+        r.Map('i', m_lockedInputs);
+        r.Map('v', m_txLockVote);
+        r.Map('r', m_txLockReq);
+        r.Map('l', m_txLocks);
+        r.Map('u', m_unknownVotes);
+        r.Map('x', m_txLockReqRejected);
+        r.Value('c', m_completeTxLocks);
+    }
 public:
     static const int m_acceptedBlockCount = 24;
     static const int m_numberOfSeconds = 60;
@@ -74,6 +101,7 @@ private:
     bool ProcessConsensusVote(CNode* pnode, const CConsensusVote& ctx);
     bool CheckForConflictingLocks(const CTransaction& tx);
     int64_t GetAverageVoteTime() const;
+    const CInstantSendQuorum* GetQuorum(int nBlockHeight);
 
 private:
     // critical section to protect the inner data structures
@@ -81,11 +109,17 @@ private:
 
     std::map<COutPoint, uint256> m_lockedInputs;
     std::map<uint256, CConsensusVote> m_txLockVote;
-    std::map<uint256, CTransaction> m_txLockReq;
+    std::map<uint256, CTransactionRef> m_txLockReq;
     std::map<uint256, CTransactionLock> m_txLocks;
     std::map<uint256, int64_t> m_unknownVotes; //track votes with no tx for DOS
-    std::map<uint256, CTransaction> m_txLockReqRejected;
+    std::map<uint256, CTransactionRef> m_txLockReqRejected;
     int m_completeTxLocks;
+
+    // Quorums by block height, computed on first use. They are dropped in
+    // CheckAndRemove, after the masternode list was checked, and whenever
+    // the number of masternodes changes.
+    std::map<int, CInstantSendQuorum> m_quorums;
+    int m_quorumsMasternodeCount;
 };
 
 class CConsensusVote
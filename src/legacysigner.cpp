@@ -8,6 +8,7 @@
 #include "init.h"
 #include "util.h"
 #include "masternodeman.h"
+#include "nodestatedb.h"
 #include "script/sign.h"
 #include "instantx.h"
 #include "ui_interface.h"
@@ -118,12 +119,16 @@ void ThreadCheckLegacySigner()
 
     unsigned int c1 = 0;
     unsigned int c2 = 0;
+    unsigned int c3 = 0;
 
     while (true)
     {
         MilliSleep(1000);
         //LogPrintf("ThreadCheckLegacySigner::check timeout\n");
 
+        // write out what changed, so shutdown has little left to do and a crash loses little
+        if(++c3 % NODE_STATE_FLUSH_INTERVAL == 0) FlushNodeState();
+
         // try to sync from all available nodes, one step at a time
         masternodeSync.Process();
         systemnodeSync.Process();
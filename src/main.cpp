@@ -11,6 +11,7 @@
 #include "addrman.h"
 #include "alert.h"
 #include "auxpow.h"
+#include "blockfilterindex.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -29,6 +30,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "spork.h"
+#include "startuptasks.h"
 #include "utilmoneystr.h"
 #include "platform/specialtx.h"
 #include "platform/platform-db.h"
@@ -36,6 +38,7 @@
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
@@ -59,6 +62,7 @@ using namespace std;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
 CChain chainActive;
 std::map<PointerHash, uint256> mapUsedStakePointers;
 ProofTracker* g_proofTracker = new ProofTracker();
@@ -76,6 +80,7 @@ bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
+bool fPeerBloomFilters = DEFAULT_PEERBLOOMFILTERS;
 int nLastStakeAttempt = 0;
 
 /** Fees smaller than this (in cSats) are considered zero fee (for relaying and mining)
@@ -89,7 +94,7 @@ Platform::NfTokenTxMemPoolHandler g_nfTokenTxMemPoolHandler;
 Platform::NftProtoTxMemPoolHandler g_nftProtoTxMemPoolHandler;
 
 struct COrphanTx {
-    CTransaction tx;
+    CTransactionRef tx;
     NodeId fromPeer;
 };
 map<uint256, COrphanTx> mapOrphanTransactions;
@@ -594,8 +599,9 @@ CBlockTreeDB *pblocktree = NULL;
 // mapOrphanTransactions
 //
 
-bool AddOrphanTx(const CTransaction& tx, NodeId peer)
+bool AddOrphanTx(const CTransactionRef& ptx, NodeId peer)
 {
+    const CTransaction& tx = *ptx;
     uint256 hash = tx.GetHash();
     if (mapOrphanTransactions.count(hash))
         return false;
@@ -614,8 +620,9 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = ptx;
+    orphan.fromPeer = peer;
     BOOST_FOREACH(const CTxIn& txin, tx.vin)
         mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
 
@@ -629,7 +636,7 @@ void static EraseOrphanTx(uint256 hash)
     map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
-    BOOST_FOREACH(const CTxIn& txin, it->second.tx.vin)
+    BOOST_FOREACH(const CTxIn& txin, it->second.tx->vin)
     {
         map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
         if (itPrev == mapOrphanTransactionsByPrev.end())
@@ -650,7 +657,7 @@ void EraseOrphansFor(NodeId peer)
         map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
         if (maybeErase->second.fromPeer == peer)
         {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
+            EraseOrphanTx(maybeErase->second.tx->GetHash());
             ++nErased;
         }
     }
@@ -1088,8 +1095,9 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                        bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+// ptx is the shared copy of tx the mempool entry takes over, without it the entry copies tx
+static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, const CTransactionRef& ptx,
+                        bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
 {
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
@@ -1213,7 +1221,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
         CAmount nFees = nValueIn-nValueOut;
         double dPriority = view.GetPriority(tx, chainActive.Height());
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height());
+        CTxMemPoolEntry entry = ptx ? CTxMemPoolEntry(ptx, nFees, GetTime(), dPriority, chainActive.Height())
+                                    : CTxMemPoolEntry(tx, nFees, GetTime(), dPriority, chainActive.Height());
         unsigned int nSize = entry.GetTxSize();
 
         // Don't accept it if it can't get into a block
@@ -1290,6 +1299,18 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+    return AcceptToMemoryPoolWorker(pool, state, tx, CTransactionRef(), fLimitFree, pfMissingInputs, fRejectInsaneFee, ignoreFees);
+}
+
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &ptx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+    return AcceptToMemoryPoolWorker(pool, state, *ptx, ptx, fLimitFree, pfMissingInputs, fRejectInsaneFee, ignoreFees);
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
@@ -2508,6 +2529,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    // The compact filter is built once here, the spent outputs are at hand in blockundo
+    if (pblockfilterindex && !pblockfilterindex->BlockConnected(block, blockundo, pindex))
+        LogPrintf("ConnectBlock() : failed to add block filter of %s\n", pindex->GetBlockHash().ToString());
+
     if (block.IsProofOfStake()) {
         COutPoint stakeSource(block.stakePointer.txid, block.stakePointer.nPos);
         mapUsedStakePointers.emplace(stakeSource.GetHash(), block.GetHash());
@@ -3144,8 +3169,8 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, bool fProofOfStake)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block, fProofOfStake);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
+    *pindexNew = CBlockIndex(block, fProofOfStake);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3319,13 +3344,12 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot)
+/**
+ * The checks of CheckBlock that need nothing but the block: header,
+ * merkle root, size and the place of the coinbase and coinstake
+ */
+static bool CheckBlockStructure(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot)
 {
-    // These are checks that are independent of context.
-
-    if (block.fChecked)
-        return true;
-
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
     bool fCheck = block.IsProofOfWork() && fCheckPOW;
@@ -3371,6 +3395,19 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
                              REJECT_INVALID, "bad-cs-multiple");
     }
 
+    return true;
+}
+
+bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot)
+{
+    // These are checks that are independent of context.
+
+    if (block.fChecked)
+        return true;
+
+    if (!CheckBlockStructure(block, state, fCheckPOW, fCheckMerkleRoot))
+        return false;
+
 
     // ----------- instantX transaction scanning -----------
 
@@ -3886,9 +3923,7 @@ CBlockIndex * InsertBlockIndex(uint256 hash, bool fProofOfStake)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
     pindexNew->fProofOfStake = fProofOfStake;
@@ -3903,18 +3938,22 @@ bool static LoadBlockIndexDB()
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    vector<pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    // Calculate nChainWork, skip pointers and candidates in one pass by height.
+    // Heights are dense, so the entries are bucketed by height instead of sorted.
+    int nMaxHeight = 0;
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    vector<size_t> vHeightOffset(nMaxHeight + 2, 0);
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        vHeightOffset[item.second->nHeight + 1]++;
+    for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+        vHeightOffset[nHeight] += vHeightOffset[nHeight - 1];
+    vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        vSortedByHeight[vHeightOffset[item.second->nHeight]++] = item.second;
+
+    BOOST_FOREACH(CBlockIndex* pindex, vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
-    {
-        CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
         if (pindex->nStatus & BLOCK_HAVE_DATA) {
             if (pindex->pprev) {
@@ -4089,6 +4128,156 @@ bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth
     return true;
 }
 
+namespace {
+
+/** A block of the background verification, copied from the index so the workers do not need cs_main to find it */
+struct CVerifyItem
+{
+    int nHeight;
+    uint256 hash;
+    uint256 hashPrev;
+    CDiskBlockPos pos;
+    CDiskBlockPos posUndo;
+    bool fProofOfStake;
+};
+
+CCriticalSection cs_backgroundVerify;
+CBackgroundVerifyStatus backgroundVerifyStatus;
+
+bool VerifyItem(const CVerifyItem& item, int nCheckLevel, std::string& strError)
+{
+    // check level 0: read from disk
+    CBlock block;
+    if (!ReadBlockOrHeader(block, item.pos, item.fProofOfStake) || block.GetHash() != item.hash) {
+        strError = "ReadBlockFromDisk failed";
+        return false;
+    }
+    // check level 1: verify block validity, without what depends on the
+    // tip, sporks or masternode state, that would need cs_main and judge
+    // old blocks by today's rules
+    if (nCheckLevel >= 1) {
+        CValidationState state;
+        if (!CheckBlockStructure(block, state, true, true)) {
+            strError = "bad block: " + state.GetRejectReason();
+            return false;
+        }
+    }
+    // check level 2: verify undo validity
+    if (nCheckLevel >= 2 && !item.posUndo.IsNull()) {
+        CBlockUndo undo;
+        if (!undo.ReadFromDisk(item.posUndo, item.hashPrev)) {
+            strError = "bad undo data";
+            return false;
+        }
+    }
+    return true;
+}
+
+void VerifyWorker(const std::vector<CVerifyItem>& vItems, size_t nOffset, size_t nStride, int nCheckLevel)
+{
+    RenameThread("crown-verify");
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    SetThreadIOPriorityIdle();
+
+    for (size_t i = nOffset; i < vItems.size(); i += nStride) {
+        boost::this_thread::interruption_point();
+        {
+            LOCK(cs_backgroundVerify);
+            if (backgroundVerifyStatus.nFailedHeight >= 0)
+                return;
+        }
+        if (ShutdownRequested())
+            return;
+
+        const CVerifyItem& item = vItems[i];
+        std::string strError;
+        bool fValid = VerifyItem(item, nCheckLevel, strError);
+
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus.nChecked++;
+        if (!fValid) {
+            LogPrintf("ThreadVerifyDB : *** %s at %d, hash=%s\n", strError, item.nHeight, item.hash.ToString());
+            if (backgroundVerifyStatus.nFailedHeight < item.nHeight)
+                backgroundVerifyStatus.nFailedHeight = item.nHeight;
+        }
+    }
+}
+
+} // anon namespace
+
+void ThreadVerifyDB(int nCheckLevel, int nCheckDepth, int nSkipDepth)
+{
+    RenameThread("crown-verifydb");
+    int64_t nStart = GetTimeMillis();
+
+    // Blocks are verified from the tip down, the blocking VerifyDB already did the first nSkipDepth
+    std::vector<CVerifyItem> vItems;
+    nCheckLevel = std::max(0, std::min(2, nCheckLevel));
+    {
+        LOCK(cs_main);
+        if (nCheckDepth <= 0 || nCheckDepth > chainActive.Height())
+            nCheckDepth = chainActive.Height();
+        for (CBlockIndex* pindex = chainActive[chainActive.Height() - nSkipDepth]; pindex && pindex->pprev; pindex = pindex->pprev) {
+            if (pindex->nHeight < chainActive.Height() - nCheckDepth)
+                break;
+            CVerifyItem item;
+            item.nHeight = pindex->nHeight;
+            item.hash = pindex->GetBlockHash();
+            item.hashPrev = pindex->pprev->GetBlockHash();
+            item.pos = pindex->GetBlockPos();
+            item.posUndo = pindex->GetUndoPos();
+            item.fProofOfStake = pindex->IsProofOfStake();
+            vItems.push_back(item);
+        }
+    }
+    if (vItems.empty())
+        return;
+
+    {
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus = CBackgroundVerifyStatus();
+        backgroundVerifyStatus.fRunning = true;
+        backgroundVerifyStatus.nCheckLevel = nCheckLevel;
+        backgroundVerifyStatus.nTotal = vItems.size();
+    }
+    LogPrintf("Verifying %u more blocks at level %i in the background\n", vItems.size(), nCheckLevel);
+
+    unsigned int nThreads = std::max(std::min(boost::thread::hardware_concurrency(), BACKGROUND_VERIFY_MAX_THREADS), 1u);
+    boost::thread_group workers;
+    for (unsigned int i = 0; i < nThreads; i++)
+        workers.create_thread(boost::bind(&VerifyWorker, boost::cref(vItems), i, nThreads, nCheckLevel));
+    try {
+        workers.join_all();
+    } catch (const boost::thread_interrupted&) {
+        workers.interrupt_all();
+        workers.join_all();
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus.fRunning = false;
+        throw;
+    }
+
+    CBackgroundVerifyStatus status;
+    {
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus.fRunning = false;
+        status = backgroundVerifyStatus;
+    }
+    RecordStartupStage("backgroundverify", nStart, GetTimeMillis(), status.nFailedHeight < 0);
+
+    if (status.nFailedHeight >= 0) {
+        strMiscWarning = strprintf(_("Warning: The block database is corrupted at height %d. Restart with -reindex to rebuild it."), status.nFailedHeight);
+        CAlert::Notify(strMiscWarning, true);
+    } else {
+        LogPrintf("No errors in %i blocks verified in the background  %dms\n", status.nChecked, GetTimeMillis() - nStart);
+    }
+}
+
+CBackgroundVerifyStatus GetBackgroundVerifyStatus()
+{
+    LOCK(cs_backgroundVerify);
+    return backgroundVerifyStatus;
+}
+
 void UnloadBlockIndex()
 {
     mapBlockIndex.clear();
@@ -4633,22 +4822,19 @@ void static ProcessGetData(CNode* pfrom)
             {
                 // Send stream from relay memory
                 bool pushed = false;
-                {
-                    LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                    if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
-                        pushed = true;
-                    }
+                CRelayCache::Entry relayed = relayCache.Find(inv);
+                if (relayed) {
+                    pfrom->PushMessage(inv.GetCommand(), *relayed);
+                    pushed = true;
                 }
 
                 if (!pushed && inv.type == MSG_TX) {
 
-                    CTransaction tx;
-                    if (mempool.lookup(inv.hash, tx)) {
+                    CTransactionRef ptx = mempool.get(inv.hash);
+                    if (ptx) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << tx;
+                        ss.reserve(ss.GetSerializeSize(*ptx));
+                        ss << *ptx;
                         pfrom->PushMessage("tx", ss);
                         pushed = true;
                     }
@@ -4665,12 +4851,12 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    boost::optional<CTransaction> lockedTx = GetInstantSend().GetLockReq(inv.hash);
+                    CTransactionRef lockedTx = GetInstantSend().GetLockReq(inv.hash);
                     if (lockedTx)
                     {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << lockedTx.get();
+                        ss << *lockedTx;
                         pfrom->PushMessage("ix", ss);
                         pushed = true;
                     }
@@ -4829,6 +5015,37 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/**
+ * Resolve a BIP 157 filter request to its stop block. Peers asking for a
+ * filter type we do not serve or for a malformed range are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop,
+                                      uint32_t nMaxCount, const CBlockIndex*& pindexStop)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pblockfilterindex || !pblockfilterindex->IsSynced() || nFilterType != BLOCK_FILTER_BASIC) {
+        LogPrint("net", "peer=%d requested unsupported block filter type %d, disconnecting\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+    if (mi == mapBlockIndex.end()) {
+        LogPrint("net", "peer=%d requested block filters up to unknown block %s, disconnecting\n", pfrom->id, hashStop.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    pindexStop = mi->second;
+
+    if (nStartHeight > (uint32_t)pindexStop->nHeight || (uint32_t)pindexStop->nHeight - nStartHeight >= nMaxCount) {
+        LogPrint("net", "peer=%d requested invalid block filter range %u-%d, disconnecting\n", pfrom->id, nStartHeight, pindexStop->nHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     static std::pair<unsigned int, uint256> pairHighBlock;
@@ -5219,18 +5436,121 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == "getcfilters")
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        vector<uint256> vHashes;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop))
+                return true;
+            vHashes.resize(pindexStop->nHeight - nStartHeight + 1);
+            for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vHashes[pindex->nHeight - nStartHeight] = pindex->GetBlockHash();
+        }
+
+        // Filters are read as they were stored, nothing is computed per peer
+        BOOST_FOREACH(const uint256& hash, vHashes) {
+            CBlockFilterIndexEntry entry;
+            if (!pblockfilterindex->ReadEntry(hash, entry)) {
+                LogPrint("net", "getcfilters: no filter for block %s, peer=%d\n", hash.ToString(), pfrom->id);
+                break;
+            }
+            pfrom->PushMessage("cfilter", nFilterType, hash, entry.vFilter);
+        }
+    }
+
+
+    else if (strCommand == "getcfheaders")
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        vector<uint256> vHashes;
+        uint256 hashPrevBlock;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop))
+                return true;
+            vHashes.resize(pindexStop->nHeight - nStartHeight + 1);
+            const CBlockIndex* pindex = pindexStop;
+            for (; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vHashes[pindex->nHeight - nStartHeight] = pindex->GetBlockHash();
+            if (pindex)
+                hashPrevBlock = pindex->GetBlockHash();
+        }
+
+        uint256 prevHeader;
+        if (!hashPrevBlock.IsNull() && !pblockfilterindex->ReadFilterHeader(hashPrevBlock, prevHeader)) {
+            LogPrint("net", "getcfheaders: no filter header for block %s, peer=%d\n", hashPrevBlock.ToString(), pfrom->id);
+            return true;
+        }
+        vector<uint256> vFilterHashes;
+        vFilterHashes.reserve(vHashes.size());
+        BOOST_FOREACH(const uint256& hash, vHashes) {
+            CBlockFilterIndexEntry entry;
+            if (!pblockfilterindex->ReadEntry(hash, entry)) {
+                LogPrint("net", "getcfheaders: no filter for block %s, peer=%d\n", hash.ToString(), pfrom->id);
+                return true;
+            }
+            vFilterHashes.push_back(entry.hashFilter);
+        }
+        pfrom->PushMessage("cfheaders", nFilterType, hashStop, prevHeader, vFilterHashes);
+    }
+
+
+    else if (strCommand == "getcfcheckpt")
+    {
+        uint8_t nFilterType;
+        uint256 hashStop;
+        vRecv >> nFilterType >> hashStop;
+
+        vector<uint256> vHashes;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pindexStop))
+                return true;
+            for (int nHeight = CFCHECKPT_INTERVAL; nHeight <= pindexStop->nHeight; nHeight += CFCHECKPT_INTERVAL)
+                vHashes.push_back(pindexStop->GetAncestor(nHeight)->GetBlockHash());
+        }
+
+        vector<uint256> vHeaders;
+        vHeaders.reserve(vHashes.size());
+        BOOST_FOREACH(const uint256& hash, vHashes) {
+            uint256 header;
+            if (!pblockfilterindex->ReadFilterHeader(hash, header)) {
+                LogPrint("net", "getcfcheckpt: no filter header for block %s, peer=%d\n", hash.ToString(), pfrom->id);
+                return true;
+            }
+            vHeaders.push_back(header);
+        }
+        pfrom->PushMessage("cfcheckpt", nFilterType, hashStop, vHeaders);
+    }
+
+
     else if (strCommand == "tx")
     {
         vector<uint256> vWorkQueue;
         vector<uint256> vEraseQueue;
-        CTransaction tx;
+        // Deserialized once, the mempool, relay queue and orphans share it
+        CTransactionRef ptx;
 
         //masternode signed transaction
         bool ignoreFees = false;
         CTxIn vin;
         vector<unsigned char> vchSig;
 
-        vRecv >> tx;
+        vRecv >> ptx;
+        const CTransaction& tx = *ptx;
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
@@ -5242,10 +5562,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
         mapAlreadyAskedFor.erase(inv);
 
-        if (AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees))
+        if (AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs, false, ignoreFees))
         {
             mempool.check(pcoinsTip);
-            RelayTransaction(tx);
+            RelayTransaction(ptx);
             vWorkQueue.push_back(inv.hash);
 
             LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
@@ -5265,7 +5585,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                      ++mi)
                 {
                     const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
+                    CTransactionRef orphanTx = mapOrphanTransactions[orphanHash].tx;
                     NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
                     bool fMissingInputs2 = false;
                     // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
@@ -5307,7 +5627,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
         else if (fMissingInputs)
         {
-            AddOrphanTx(tx, pfrom->GetId());
+            AddOrphanTx(ptx, pfrom->GetId());
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -5319,7 +5639,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             // if they are already in the mempool (allowing the node to function
             // as a gateway for nodes hidden behind it).
 
-            RelayTransaction(tx);
+            RelayTransaction(ptx);
         }
 
         if(strCommand == "dstx"){
@@ -5473,10 +5793,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         vector<CInv> vInv;
         BOOST_FOREACH(uint256& hash, vtxid) {
             CInv inv(MSG_TX, hash);
-            CTransaction tx;
-            bool fInMemPool = mempool.lookup(hash, tx);
-            if (!fInMemPool) continue; // another thread removed since queryHashes, maybe...
-            if ((pfrom->pfilter && pfrom->pfilter->IsRelevantAndUpdate(tx)) ||
+            CTransactionRef ptx = mempool.get(hash);
+            if (!ptx) continue; // another thread removed since queryHashes, maybe...
+            if ((pfrom->pfilter && pfrom->pfilter->IsRelevantAndUpdate(*ptx)) ||
                (!pfrom->pfilter))
                 vInv.push_back(inv);
             if (vInv.size() == MAX_INV_SZ) {
@@ -5599,6 +5918,14 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (!fPeerBloomFilters && (strCommand == "filterload" || strCommand == "filteradd" || strCommand == "filterclear"))
+    {
+        // BIP 37 is switched off, light clients are expected to use compact block filters
+        LogPrint("net", "%s from peer=%d while bloom filters are disabled, disconnecting\n", strCommand, pfrom->id);
+        pfrom->fDisconnect = true;
+    }
+
+
     else if (strCommand == "filterload")
     {
         CBloomFilter filter;
@@ -5810,6 +6137,7 @@ bool ProcessMessages(CNode* pfrom)
 
         // Process message
         bool fRet = false;
+        int64_t nTimeStart = GetTimeMicros();
         try
         {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
@@ -5843,6 +6171,8 @@ bool ProcessMessages(CNode* pfrom)
             PrintExceptionContinue(NULL, "ProcessMessages()");
         }
 
+        pfrom->RecordMessageRecv(strCommand, nMessageSize + CMessageHeader::HEADER_SIZE, GetTimeMicros() - nTimeStart);
+
         if (!fRet)
             LogPrintf("ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
 
@@ -5850,8 +6180,11 @@ bool ProcessMessages(CNode* pfrom)
     }
 
     // In case the connection got shut down, its receive buffer was wiped
-    if (!pfrom->fDisconnect)
+    if (!pfrom->fDisconnect) {
+        for (std::deque<CNetMessage>::iterator mi = pfrom->vRecvMsg.begin(); mi != it; ++mi)
+            mi->ReleaseBuffer();
         pfrom->vRecvMsg.erase(pfrom->vRecvMsg.begin(), it);
+    }
 
     return fOk;
 }
@@ -5988,6 +6321,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         // Message: inventory
         //
+        pto->PushRelayedInventory();
         vector<CInv> vInv;
         vector<CInv> vInvWait;
         {
@@ -6183,10 +6517,7 @@ class CMainCleanup
 public:
     CMainCleanup() {}
     ~CMainCleanup() {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        // block headers, the entries are freed with blockIndexArena
         mapBlockIndex.clear();
 
         // orphan transactions
@@ -61,6 +61,8 @@ static const unsigned int DEFAULT_BLOCK_MIN_SIZE = 0;
 static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000;
 /** Default for accepting alerts from the P2P network. */
 static const bool DEFAULT_ALERTS = true;
+/** Default for -peerbloomfilters, serving BIP 37 bloom filtered connections */
+static const bool DEFAULT_PEERBLOOMFILTERS = true;
 /** The maximum size for transactions we're willing to relay/mine */
 static const unsigned int MAX_STANDARD_TX_SIZE = 250000;
 /** The maximum allowed number of signature check operations in a block (network rule) */
@@ -134,6 +136,8 @@ extern Platform::NfTokenTxMemPoolHandler g_nfTokenTxMemPoolHandler;
 extern Platform::NftProtoTxMemPoolHandler g_nftProtoTxMemPoolHandler;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
+//! Storage of the entries of mapBlockIndex, guarded by cs_main
+extern CBlockIndexArena blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
@@ -151,6 +155,7 @@ extern bool fCheckBlockIndex;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
+extern bool fPeerBloomFilters;
 extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
 extern int nLastStakeAttempt;
@@ -266,6 +271,9 @@ void FlushStateToDisk();
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectInsaneFee=false, bool ignoreFees=false);
+/** The same, the mempool entry shares ptx instead of copying the transaction */
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &ptx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fRejectInsaneFee=false, bool ignoreFees=false);
 
 bool AcceptableInputs(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectInsaneFee=false, bool isDSTX=false);
@@ -599,6 +607,33 @@ public:
     bool VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/** Blocks below the tip that VerifyDB checks before startup goes on when the rest is checked in the background */
+static const int DEFAULT_CHECKBLOCKS_BLOCKING = 6;
+/** Default for -backgroundverify */
+static const bool DEFAULT_BACKGROUND_VERIFY = true;
+/** Maximum number of threads of the background block verification */
+static const unsigned int BACKGROUND_VERIFY_MAX_THREADS = 4;
+
+/** Progress of the background block verification */
+struct CBackgroundVerifyStatus
+{
+    bool fRunning;
+    int nCheckLevel;
+    int nTotal;
+    int nChecked;
+    //! Height of the corrupted block found, -1 if none
+    int nFailedHeight;
+
+    CBackgroundVerifyStatus() : fRunning(false), nCheckLevel(0), nTotal(0), nChecked(0), nFailedHeight(-1) {}
+};
+
+/**
+ * Check the blocks from nSkipDepth to nCheckDepth below the tip at levels
+ * 0 to 2 on a pool of low priority threads, warn if one is corrupted.
+ */
+void ThreadVerifyDB(int nCheckLevel, int nCheckDepth, int nSkipDepth);
+CBackgroundVerifyStatus GetBackgroundVerifyStatus();
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
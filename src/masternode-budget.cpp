@@ -168,28 +168,85 @@ bool IsBudgetCollateralValid(uint256 nTxCollateralHash, uint256 nExpectedHash, s
     }
 }
 
-void CBudgetManager::CheckOrphanVotes()
+// Only the votes waiting for nParentHash are looked at. Those that are accepted are dropped, the others
+// stay for a later try until they expire in CheckAndRemove
+void CBudgetManager::CheckOrphanVotes(const uint256& nParentHash)
 {
     LOCK(cs);
 
-
     std::string strError = "";
-    std::map<uint256, CBudgetVote>::iterator it1 = mapOrphanMasternodeBudgetVotes.begin();
-    while(it1 != mapOrphanMasternodeBudgetVotes.end()){
-        if(ReceiveProposalVote(((*it1).second), NULL, strError)){
+    typedef std::multimap<uint256, uint256>::iterator OrphanIndexIterator;
+    std::pair<OrphanIndexIterator, OrphanIndexIterator> range1 = mapOrphanProposalVoteIndex.equal_range(nParentHash);
+    for (OrphanIndexIterator it = range1.first; it != range1.second; ) {
+        std::map<uint256, CBudgetVote>::iterator it1 = mapOrphanMasternodeBudgetVotes.find(it->second);
+        if (it1 != mapOrphanMasternodeBudgetVotes.end()) {
+            if (!ReceiveProposalVote(((*it1).second), NULL, strError)) {
+                ++it;
+                continue;
+            }
             LogPrintf("CBudgetManager::CheckOrphanVotes - Proposal/Budget is known, activating and removing orphan vote\n");
-            mapOrphanMasternodeBudgetVotes.erase(it1++);
-        } else {
-            ++it1;
+            mapOrphanMasternodeBudgetVotes.erase(it1);
         }
+        mapOrphanProposalVoteIndex.erase(it++);
     }
-    std::map<uint256, BudgetDraftVote>::iterator it2 = mapOrphanBudgetDraftVotes.begin();
-    while(it2 != mapOrphanBudgetDraftVotes.end()){
-        if(UpdateBudgetDraft(((*it2).second),NULL, strError)){
+
+    std::pair<OrphanIndexIterator, OrphanIndexIterator> range2 = mapOrphanBudgetDraftVoteIndex.equal_range(nParentHash);
+    for (OrphanIndexIterator it = range2.first; it != range2.second; ) {
+        std::map<uint256, BudgetDraftVote>::iterator it2 = mapOrphanBudgetDraftVotes.find(it->second);
+        if (it2 != mapOrphanBudgetDraftVotes.end()) {
+            if (!UpdateBudgetDraft(((*it2).second), NULL, strError)) {
+                ++it;
+                continue;
+            }
             LogPrintf("CBudgetManager::CheckOrphanVotes - Proposal/Budget is known, activating and removing orphan vote\n");
-            mapOrphanBudgetDraftVotes.erase(it2++);
-        } else {
-            ++it2;
+            mapOrphanBudgetDraftVotes.erase(it2);
+        }
+        mapOrphanBudgetDraftVoteIndex.erase(it++);
+    }
+}
+
+void CBudgetManager::AddOrphanVote(const CBudgetVote& vote)
+{
+    uint256 hash = vote.GetHash();
+    if (mapOrphanMasternodeBudgetVotes.insert(make_pair(hash, vote)).second)
+        mapOrphanProposalVoteIndex.insert(make_pair(vote.nProposalHash, hash));
+}
+
+void CBudgetManager::AddOrphanVote(const BudgetDraftVote& vote)
+{
+    uint256 hash = vote.GetHash();
+    if (mapOrphanBudgetDraftVotes.insert(make_pair(hash, vote)).second)
+        mapOrphanBudgetDraftVoteIndex.insert(make_pair(vote.nBudgetHash, hash));
+}
+
+void CBudgetManager::RebuildIndexes()
+{
+    LOCK(cs);
+
+    // Earlier versions kept one orphan per parent keyed by the parent hash, key them by vote hash
+    std::map<uint256, CBudgetVote> mapProposalVotes;
+    mapProposalVotes.swap(mapOrphanMasternodeBudgetVotes);
+    mapOrphanProposalVoteIndex.clear();
+    for (std::map<uint256, CBudgetVote>::const_iterator it = mapProposalVotes.begin(); it != mapProposalVotes.end(); ++it)
+        AddOrphanVote(it->second);
+
+    std::map<uint256, BudgetDraftVote> mapDraftVotes;
+    mapDraftVotes.swap(mapOrphanBudgetDraftVotes);
+    mapOrphanBudgetDraftVoteIndex.clear();
+    for (std::map<uint256, BudgetDraftVote>::const_iterator it = mapDraftVotes.begin(); it != mapDraftVotes.end(); ++it)
+        AddOrphanVote(it->second);
+
+    // The newest current vote of each masternode, DiscontinueOlderVotes keeps the others obsolete
+    mapBudgetDraftVoteByVoter.clear();
+    std::map<uint256, int64_t> mapVoteTimes;
+    for (std::map<uint256, BudgetDraft>::const_iterator i = mapBudgetDrafts.begin(); i != mapBudgetDrafts.end(); ++i) {
+        const std::map<uint256, BudgetDraftVote>& votes = i->second.GetVotes();
+        for (std::map<uint256, BudgetDraftVote>::const_iterator vote = votes.begin(); vote != votes.end(); ++vote) {
+            std::map<uint256, int64_t>::iterator found = mapVoteTimes.find(vote->first);
+            if (found != mapVoteTimes.end() && found->second >= vote->second.nTime)
+                continue;
+            mapVoteTimes[vote->first] = vote->second.nTime;
+            mapBudgetDraftVoteByVoter[vote->first] = i->first;
         }
     }
 }
@@ -418,6 +475,42 @@ void CBudgetManager::CheckAndRemove()
         ++it2;
     }
 
+    // Orphan votes that were not accepted when their parent arrived get another try
+    typedef std::multimap<uint256, uint256>::iterator OrphanIndexIterator;
+    std::set<uint256> setOrphanParents;
+    for (OrphanIndexIterator it = mapOrphanProposalVoteIndex.begin(); it != mapOrphanProposalVoteIndex.end(); ++it)
+        if (mapProposals.count(it->first))
+            setOrphanParents.insert(it->first);
+    for (OrphanIndexIterator it = mapOrphanBudgetDraftVoteIndex.begin(); it != mapOrphanBudgetDraftVoteIndex.end(); ++it)
+        if (mapBudgetDrafts.count(it->first))
+            setOrphanParents.insert(it->first);
+    BOOST_FOREACH(const uint256& nParentHash, setOrphanParents)
+        CheckOrphanVotes(nParentHash);
+
+    // Orphan votes that were not accepted within a day
+    LogPrintf("CBudgetManager::CheckAndRemove - orphan votes cleanup - size: %d\n", mapOrphanMasternodeBudgetVotes.size() + mapOrphanBudgetDraftVotes.size());
+    const int64_t nOrphanExpiry = GetTime() - (60*60*24);
+    for (OrphanIndexIterator it3 = mapOrphanProposalVoteIndex.begin(); it3 != mapOrphanProposalVoteIndex.end(); ) {
+        std::map<uint256, CBudgetVote>::iterator vote = mapOrphanMasternodeBudgetVotes.find(it3->second);
+        if (vote == mapOrphanMasternodeBudgetVotes.end() || vote->second.nTime < nOrphanExpiry) {
+            if (vote != mapOrphanMasternodeBudgetVotes.end())
+                mapOrphanMasternodeBudgetVotes.erase(vote);
+            mapOrphanProposalVoteIndex.erase(it3++);
+        } else {
+            ++it3;
+        }
+    }
+    for (OrphanIndexIterator it4 = mapOrphanBudgetDraftVoteIndex.begin(); it4 != mapOrphanBudgetDraftVoteIndex.end(); ) {
+        std::map<uint256, BudgetDraftVote>::iterator vote = mapOrphanBudgetDraftVotes.find(it4->second);
+        if (vote == mapOrphanBudgetDraftVotes.end() || vote->second.nTime < nOrphanExpiry) {
+            if (vote != mapOrphanBudgetDraftVotes.end())
+                mapOrphanBudgetDraftVotes.erase(vote);
+            mapOrphanBudgetDraftVoteIndex.erase(it4++);
+        } else {
+            ++it4;
+        }
+    }
+
     LogPrintf("CBudgetManager::CheckAndRemove - PASSED\n");
 }
 
@@ -856,18 +949,38 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         uint256 nProp;
         vRecv >> nProp;
 
+        // newer peers ask for one shard and send a filter of the items they have
+        int nShard = -1;
+        int nShards = 0;
+        CBloomFilter filter;
+        bool fFilter = false;
+        if(!vRecv.empty()) {
+            vRecv >> nShard >> nShards >> filter;
+            if(!filter.IsWithinSizeConstraints()) {
+                LogPrintf("mnvs - filter too large\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+            filter.UpdateEmptyFull();
+            fFilter = true;
+            // a peer with a different shard count gets everything it does not have
+            if(nShards != BUDGET_SYNC_SHARDS || nShard < 0 || nShard >= BUDGET_SYNC_SHARDS)
+                nShard = -1;
+        }
+
         if(Params().NetworkID() == CBaseChainParams::MAIN){
             if(nProp.IsNull()) {
-                if(pfrom->HasFulfilledRequest("mnvs")) {
+                std::string strRequest = nShard < 0 ? "mnvs" : strprintf("mnvs%d", nShard);
+                if(pfrom->HasFulfilledRequest(strRequest)) {
                     LogPrintf("mnvs - peer already asked me for the list\n");
                     Misbehaving(pfrom->GetId(), 20);
                     return;
                 }
-                pfrom->FulfilledRequest("mnvs");
+                pfrom->FulfilledRequest(strRequest);
             }
         }
 
-        Sync(pfrom, nProp);
+        Sync(pfrom, nProp, false, nShard, fFilter ? &filter : NULL);
         LogPrintf("mnvs - Sent Masternode votes to %s\n", pfrom->addr.ToString());
     }
 
@@ -905,7 +1018,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         LogPrintf("mprop - new budget - %s\n", budgetProposalBroadcast.GetHash().ToString());
 
         //We might have active votes for this proposal that are valid now
-        CheckOrphanVotes();
+        CheckOrphanVotes(budgetProposalBroadcast.GetHash());
     }
 
     if (strCommand == "mvote") { //Masternode Vote
@@ -1006,7 +1119,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         }
 
         //we might have active votes for this budget that are now valid
-        CheckOrphanVotes();
+        CheckOrphanVotes(budgetDraftBroadcast.GetHash());
     }
 
     if (strCommand == "fbvote") { //Finalized Budget Vote
@@ -1114,7 +1227,7 @@ void CBudgetManager::MarkSynced()
 }
 
 
-void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial) const
+void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial, int nShard, const CBloomFilter* pfilter) const
 {
     LOCK(cs);
 
@@ -1126,6 +1239,9 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial) const
         This code checks each of the hash maps for all known budget proposals and finalized budget proposals, then checks them against the
         budget object to see if they're OK. If all checks pass, we'll send it to the peer.
 
+        A request for one shard only gets the items of that shard, items the peer has according to
+        its filter are skipped, the peer learns the shard is done from a MASTERNODE_SYNC_BUDGET_SHARD count.
+
     */
 
     int nInvCount = 0;
@@ -1134,17 +1250,24 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial) const
     while(it1 != mapSeenMasternodeBudgetProposals.end())
     {
         std::map<uint256, CBudgetProposal>::const_iterator pbudgetProposal = mapProposals.find((*it1).first);
-        if(pbudgetProposal != mapProposals.end() && pbudgetProposal->second.fValid && (nProp.IsNull() || (*it1).first == nProp)){
-            pfrom->PushInventory(CInv(MSG_BUDGET_PROPOSAL, (*it1).second.GetHash()));
-            nInvCount++;
+        if(pbudgetProposal != mapProposals.end() && pbudgetProposal->second.fValid && (nProp.IsNull() || (*it1).first == nProp) &&
+                (nShard < 0 || GetBudgetSyncShard((*it1).first) == nShard)){
+            uint256 hash = (*it1).second.GetHash();
+            if(!pfilter || !pfilter->contains(hash)) {
+                pfrom->PushInventory(CInv(MSG_BUDGET_PROPOSAL, hash));
+                nInvCount++;
+            }
         
             //send votes
             std::map<uint256, CBudgetVote>::const_iterator it2 = pbudgetProposal->second.mapVotes.begin();
             while(it2 != pbudgetProposal->second.mapVotes.end()){
                 if((*it2).second.fValid){
                     if((fPartial && !(*it2).second.fSynced) || !fPartial) {
-                        pfrom->PushInventory(CInv(MSG_BUDGET_VOTE, (*it2).second.GetHash()));
-                        nInvCount++;
+                        uint256 hashVote = (*it2).second.GetHash();
+                        if(!pfilter || !pfilter->contains(hashVote)) {
+                            pfrom->PushInventory(CInv(MSG_BUDGET_VOTE, hashVote));
+                            nInvCount++;
+                        }
                     }
                 }
                 ++it2;
@@ -1162,14 +1285,43 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial) const
     std::map<uint256, BudgetDraftBroadcast>::const_iterator it3 = mapSeenBudgetDrafts.begin();
     while(it3 != mapSeenBudgetDrafts.end()){
         std::map<uint256, BudgetDraft>::const_iterator pbudgetDraft = mapBudgetDrafts.find((*it3).first);
-        if(pbudgetDraft != mapBudgetDrafts.end() && (nProp.IsNull() || (*it3).first == nProp))
-            pbudgetDraft->second.Sync(pfrom, fPartial);
+        if(pbudgetDraft != mapBudgetDrafts.end() && (nProp.IsNull() || (*it3).first == nProp) &&
+                (nShard < 0 || GetBudgetSyncShard((*it3).first) == nShard))
+            nInvCount += pbudgetDraft->second.Sync(pfrom, fPartial, pfilter);
         ++it3;
     }
 
     pfrom->PushMessage("ssc", MASTERNODE_SYNC_BUDGET_FIN, nInvCount);
     LogPrintf("CBudgetManager::Sync - sent %d items\n", nInvCount);
 
+    if(nShard >= 0)
+        pfrom->PushMessage("ssc", MASTERNODE_SYNC_BUDGET_SHARD, nShard);
+}
+
+CBloomFilter CBudgetManager::GetKnownItemsFilter(int nShard) const
+{
+    LOCK(cs);
+
+    std::vector<uint256> vHashes;
+    for (std::map<uint256, CBudgetProposalBroadcast>::const_iterator it = mapSeenMasternodeBudgetProposals.begin(); it != mapSeenMasternodeBudgetProposals.end(); ++it)
+        if (GetBudgetSyncShard(it->first) == nShard)
+            vHashes.push_back(it->first);
+    for (std::map<uint256, CBudgetVote>::const_iterator it = mapSeenMasternodeBudgetVotes.begin(); it != mapSeenMasternodeBudgetVotes.end(); ++it)
+        if (GetBudgetSyncShard(it->second.nProposalHash) == nShard)
+            vHashes.push_back(it->first);
+    for (std::map<uint256, BudgetDraftBroadcast>::const_iterator it = mapSeenBudgetDrafts.begin(); it != mapSeenBudgetDrafts.end(); ++it)
+        if (GetBudgetSyncShard(it->first) == nShard)
+            vHashes.push_back(it->first);
+    for (std::map<uint256, BudgetDraftVote>::const_iterator it = mapSeenBudgetDraftVotes.begin(); it != mapSeenBudgetDraftVotes.end(); ++it)
+        if (GetBudgetSyncShard(it->second.nBudgetHash) == nShard)
+            vHashes.push_back(it->first);
+
+    // a new tweak per request, so an item one peer skips as a false positive is sent by the next one
+    CBloomFilter filter(std::max(vHashes.size(), (size_t)1), BUDGET_SYNC_FILTER_FP_RATE, GetRand(std::numeric_limits<unsigned int>::max()), BLOOM_UPDATE_NONE);
+    BOOST_FOREACH(const uint256& hash, vHashes)
+        filter.insert(hash);
+    return filter;
+
 }
 
 const BudgetDraftBroadcast* CBudgetManager::GetSeenBudgetDraft(uint256 hash) const
@@ -1266,7 +1418,7 @@ bool CBudgetManager::ReceiveProposalVote(const CBudgetVote &vote, CNode *pfrom,
             if(!masternodeSync.IsSynced()) return false;
 
             LogPrintf("CBudgetManager::ReceiveProposalVote - Unknown proposal %d, asking for source proposal\n", vote.nProposalHash.ToString());
-            mapOrphanMasternodeBudgetVotes[vote.nProposalHash] = vote;
+            AddOrphanVote(vote);
 
             if(!askedForSourceProposalOrBudget.count(vote.nProposalHash)){
                 pfrom->PushMessage("mnvs", vote.nProposalHash);
@@ -1321,7 +1473,7 @@ bool CBudgetManager::UpdateBudgetDraft(const BudgetDraftVote& vote, CNode* pfrom
             if(!masternodeSync.IsSynced()) return false;
 
             LogPrintf("CBudgetManager::UpdateBudgetDraft - Unknown Finalized Proposal %s, asking for source budget\n", vote.nBudgetHash.ToString());
-            mapOrphanBudgetDraftVotes[vote.nBudgetHash] = vote;
+            AddOrphanVote(vote);
 
             if(!askedForSourceProposalOrBudget.count(vote.nBudgetHash)){
                 pfrom->PushMessage("mnvs", vote.nBudgetHash);
@@ -1334,12 +1486,22 @@ bool CBudgetManager::UpdateBudgetDraft(const BudgetDraftVote& vote, CNode* pfrom
         return false;
     }
 
+    // Only the draft holding the current vote of this masternode can have a newer or an older one
     bool isOldVote = false;
+    const uint256 voterHash = vote.vin.prevout.GetHash();
+    BudgetDraft* previousDraft = NULL;
 
-    for (std::map<uint256, BudgetDraft>::iterator i = mapBudgetDrafts.begin(); i != mapBudgetDrafts.end(); ++i)
+    std::map<uint256, uint256>::const_iterator current = mapBudgetDraftVoteByVoter.find(voterHash);
+    if (current != mapBudgetDraftVoteByVoter.end())
     {
-        const std::map<uint256, BudgetDraftVote>& votes = i->second.GetVotes();
-        const std::map<uint256, BudgetDraftVote>::const_iterator found = votes.find(vote.vin.prevout.GetHash());
+        std::map<uint256, BudgetDraft>::iterator draft = mapBudgetDrafts.find(current->second);
+        if (draft != mapBudgetDrafts.end())
+            previousDraft = &draft->second;
+    }
+    if (previousDraft != NULL)
+    {
+        const std::map<uint256, BudgetDraftVote>& votes = previousDraft->GetVotes();
+        const std::map<uint256, BudgetDraftVote>::const_iterator found = votes.find(voterHash);
         if (found != votes.end() && found->second.nTime > vote.nTime)
             isOldVote = true;
     }
@@ -1347,9 +1509,11 @@ bool CBudgetManager::UpdateBudgetDraft(const BudgetDraftVote& vote, CNode* pfrom
     if (!mapBudgetDrafts[vote.nBudgetHash].AddOrUpdateVote(isOldVote, vote, strError))
         return false;
 
-    for (std::map<uint256, BudgetDraft>::iterator i = mapBudgetDrafts.begin(); i != mapBudgetDrafts.end(); ++i)
+    if (!isOldVote)
     {
-        i->second.DiscontinueOlderVotes(vote);
+        if (previousDraft != NULL && current->second != vote.nBudgetHash)
+            previousDraft->DiscontinueOlderVotes(vote);
+        mapBudgetDraftVoteByVoter[voterHash] = vote.nBudgetHash;
     }
 
     mapSeenBudgetDraftVotes.insert(make_pair(vote.GetHash(), vote));
@@ -1650,6 +1814,7 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     std::string errorMessage;
     std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
 
+    pubKeyVerified = CPubKey();
     if(!legacySigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrintf("CBudgetVote::Sign - Error upon calling SignMessage");
         return false;
@@ -1660,14 +1825,12 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
         return false;
     }
 
+    pubKeyVerified = pubKeyMasternode;
     return true;
 }
 
 bool CBudgetVote::SignatureValid(bool fSignatureCheck) const
 {
-    std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
-
     CMasternode* pmn = mnodeman.Find(vin);
 
     if(pmn == NULL)
@@ -1676,13 +1839,18 @@ bool CBudgetVote::SignatureValid(bool fSignatureCheck) const
         return false;
     }
 
-    if(!fSignatureCheck) return true;
+    // Verified before against the same key
+    if(!fSignatureCheck || (pubKeyVerified.IsValid() && pubKeyVerified == pmn->pubkey2)) return true;
+
+    std::string errorMessage;
+    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
 
     if(!legacySigner.VerifyMessage(pmn->pubkey2, vchSig, strMessage, errorMessage)) {
         LogPrintf("CBudgetVote::SignatureValid() - Verify message failed\n");
         return false;
     }
 
+    pubKeyVerified = pmn->pubkey2;
     return true;
 }
 
@@ -2157,7 +2325,7 @@ void BudgetDraft::MarkSynced()
     }
 }
 
-int BudgetDraft::Sync(CNode* pfrom, bool fPartial) const
+int BudgetDraft::Sync(CNode* pfrom, bool fPartial, const CBloomFilter* pfilter) const
 {
     LOCK(m_cs);
 
@@ -2165,8 +2333,12 @@ int BudgetDraft::Sync(CNode* pfrom, bool fPartial) const
         return 0;
 
     int invCount = 0;
-    pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED, GetHash()));
-    ++invCount;
+    const uint256 hash = GetHash();
+    if (!pfilter || !pfilter->contains(hash))
+    {
+        pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED, hash));
+        ++invCount;
+    }
 
     //send votes
     for(std::map<uint256,BudgetDraftVote>::const_iterator vote = m_votes.begin(); vote != m_votes.end(); ++vote)
@@ -2176,7 +2348,10 @@ int BudgetDraft::Sync(CNode* pfrom, bool fPartial) const
 
         if((fPartial && !vote->second.fSynced) || !fPartial)
         {
-            pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED_VOTE, vote->second.GetHash()));
+            const uint256 voteHash = vote->second.GetHash();
+            if (pfilter && pfilter->contains(voteHash))
+                continue;
+            pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED_VOTE, voteHash));
             ++invCount;
         }
     }
@@ -2324,6 +2499,7 @@ bool BudgetDraftVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     std::string errorMessage;
     std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
 
+    pubKeyVerified = CPubKey();
     if(!legacySigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrintf("BudgetDraftVote::Sign - Error upon calling SignMessage");
         return false;
@@ -2334,15 +2510,12 @@ bool BudgetDraftVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
         return false;
     }
 
+    pubKeyVerified = pubKeyMasternode;
     return true;
 }
 
 bool BudgetDraftVote::SignatureValid(bool fSignatureCheck)
 {
-    std::string errorMessage;
-
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
-
     CMasternode* pmn = mnodeman.Find(vin);
 
     if(pmn == NULL)
@@ -2351,13 +2524,18 @@ bool BudgetDraftVote::SignatureValid(bool fSignatureCheck)
         return false;
     }
 
-    if(!fSignatureCheck) return true;
+    // Verified before against the same key
+    if(!fSignatureCheck || (pubKeyVerified.IsValid() && pubKeyVerified == pmn->pubkey2)) return true;
+
+    std::string errorMessage;
+    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
 
     if(!legacySigner.VerifyMessage(pmn->pubkey2, vchSig, strMessage, errorMessage)) {
         LogPrintf("BudgetDraftVote::SignatureValid() - Verify message failed\n");
         return false;
     }
 
+    pubKeyVerified = pmn->pubkey2;
     return true;
 }
 
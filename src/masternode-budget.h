@@ -7,6 +7,7 @@
 #define MASTERNODE_BUDGET_H
 
 #include "main.h"
+#include "bloom.h"
 #include "sync.h"
 #include "net.h"
 #include "key.h"
@@ -35,6 +36,10 @@ static const CAmount BUDGET_FEE_TX = (25*COIN);
 static const int64_t BUDGET_FEE_CONFIRMATIONS = 6;
 static const int64_t BUDGET_VOTE_UPDATE_MIN = 60*60;
 static const int64_t FINAL_BUDGET_VOTE_UPDATE_MIN = 30*60;
+//! Budget sync is split in shards by the first byte of the proposal or budget draft hash, votes go with their parent
+static const int BUDGET_SYNC_SHARDS = 4;
+//! False positive rate of the filter of known items sent with a budget sync request
+static const double BUDGET_SYNC_FILTER_FP_RATE = 0.001;
 
 extern std::vector<CBudgetProposalBroadcast> vecImmatureBudgetProposals;
 extern std::vector<BudgetDraftBroadcast> vecImmatureBudgetDrafts;
@@ -46,6 +51,8 @@ int GetBudgetPaymentCycleBlocks();
 
 int GetNextSuperblock(int height);
 
+inline int GetBudgetSyncShard(const uint256& hash) { return *hash.begin() % BUDGET_SYNC_SHARDS; }
+
 CAmount GetVotingThreshold();
 
 //Check the collateral transaction for the budget proposal/finalized budget
@@ -65,6 +72,8 @@ public:
     int nVote;
     int64_t nTime;
     std::vector<unsigned char> vchSig;
+    //! Masternode key vchSig was last verified against, not serialized
+    mutable CPubKey pubKeyVerified;
 
     CBudgetVote();
     CBudgetVote(CTxIn vin, uint256 nProposalHash, int nVoteIn);
@@ -128,6 +137,13 @@ private:
     std::map<uint256, BudgetDraftVote> mapSeenBudgetDraftVotes;
     std::map<uint256, BudgetDraftVote> mapOrphanBudgetDraftVotes;
 
+    // derived from the maps above and rebuilt after loading, see RebuildIndexes
+    //! Hashes of the orphan votes by the proposal or budget draft they wait for
+    std::multimap<uint256, uint256> mapOrphanProposalVoteIndex;
+    std::multimap<uint256, uint256> mapOrphanBudgetDraftVoteIndex;
+    //! Budget draft holding the current vote of a masternode, by outpoint hash
+    std::map<uint256, uint256> mapBudgetDraftVoteByVoter;
+
 public:
     CBudgetManager()
     {
@@ -146,7 +162,13 @@ public:
 
     void ResetSync();
     void MarkSynced();
-    void Sync(CNode *node, uint256 nProp, bool fPartial = false) const;
+    /**
+     * Send the inventory of the proposal nProp, or of all proposals and budget drafts,
+     * or of those in nShard only. Items in pfilter are known to the peer and skipped.
+     */
+    void Sync(CNode *node, uint256 nProp, bool fPartial = false, int nShard = -1, const CBloomFilter* pfilter = NULL) const;
+    /** Filter of the proposals, budget drafts and votes of a sync shard we have, sent with a sync request */
+    CBloomFilter GetKnownItemsFilter(int nShard) const;
 
     void ProcessMessage(CNode *pfrom, const std::string &strCommand, CDataStream &vRecv);
 
@@ -197,7 +219,7 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight) const;
     std::string ToString() const;
 
-    void CheckOrphanVotes();
+    void CheckOrphanVotes(const uint256& nParentHash);
     void CheckAndRemove();
 
     void Clear()
@@ -213,6 +235,9 @@ public:
         mapSeenBudgetDraftVotes.clear();
         mapOrphanMasternodeBudgetVotes.clear();
         mapOrphanBudgetDraftVotes.clear();
+        mapOrphanProposalVoteIndex.clear();
+        mapOrphanBudgetDraftVoteIndex.clear();
+        mapBudgetDraftVoteByVoter.clear();
     }
 
     ADD_SERIALIZE_METHODS;
@@ -229,10 +254,36 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapBudgetDrafts);
+
+        if (ser_action.ForRead())
+            RebuildIndexes();
+    }
+
+    /// Proposals, drafts, seen and orphan votes, the vote indexes are rebuilt after a read
+    template <typename Records>
+    void RecordsOp(Records& r)
+    {
+        LOCK(cs);
+        r.Map('P', mapSeenMasternodeBudgetProposals);
+        r.Map('V', mapSeenMasternodeBudgetVotes);
+        r.Map('D', mapSeenBudgetDrafts);
+        r.Map('W', mapSeenBudgetDraftVotes);
+        r.Map('v', mapOrphanMasternodeBudgetVotes);
+        r.Map('w', mapOrphanBudgetDraftVotes);
+
+        r.Map('p', mapProposals);
+        r.Map('d', mapBudgetDrafts);
+
+        if (r.ForRead())
+            RebuildIndexes();
     }
 
 private:
     const BudgetDraft *GetMostVotedBudget(int height) const;
+
+    void AddOrphanVote(const CBudgetVote& vote);
+    void AddOrphanVote(const BudgetDraftVote& vote);
+    void RebuildIndexes();
 };
 
 class CTxBudgetPayment
@@ -327,7 +378,7 @@ public:
     CAmount GetTotalPayout() const;
 
     void MarkSynced();
-    int Sync(CNode* pfrom, bool fPartial) const;
+    int Sync(CNode* pfrom, bool fPartial, const CBloomFilter* pfilter = NULL) const;
     void ResetSync();
 
     //checks the hashes to make sure we know about them
@@ -446,6 +497,8 @@ public:
     uint256 nBudgetHash;
     int64_t nTime;
     std::vector<unsigned char> vchSig;
+    //! Masternode key vchSig was last verified against, not serialized
+    CPubKey pubKeyVerified;
 
     BudgetDraftVote();
     BudgetDraftVote(CTxIn vinIn, uint256 nBudgetHashIn);
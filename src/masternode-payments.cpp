@@ -210,17 +210,22 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
 
         int nCountNeeded;
         vRecv >> nCountNeeded;
+        // newer peers ask for the votes in mnwa aggregates, older ones send only the count
+        bool fAggregate = false;
+        if(!vRecv.empty()) vRecv >> fAggregate;
 
+        // an aggregated sync may be followed by one request for the votes as inventory, see "mnwa"
+        std::string strRequest = fAggregate ? "mnwaget" : "mnget";
         if(Params().NetworkID() == CBaseChainParams::MAIN){
-            if(pfrom->HasFulfilledRequest("mnget")) {
+            if(pfrom->HasFulfilledRequest(strRequest)) {
                 LogPrintf("mnget - peer already asked me for the list\n");
                 Misbehaving(pfrom->GetId(), 20);
                 return;
             }
         }
 
-        pfrom->FulfilledRequest("mnget");
-        masternodePayments.Sync(pfrom, nCountNeeded);
+        pfrom->FulfilledRequest(strRequest);
+        masternodePayments.Sync(pfrom, nCountNeeded, fAggregate);
         LogPrintf("mnget - Sent Masternode winners to %s\n", pfrom->addr.ToString().c_str());
     }
     else if (strCommand == "mnw") { //Masternode Payments Declare Winner
@@ -249,36 +254,127 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
             return;
         }
 
-        std::string strError = "";
-        if(!winner.IsValid(pfrom, strError)){
-            if(strError != "") LogPrintf("mnw - invalid message - %s\n", strError);
+        masternodePayments.AcceptWinner(pfrom, winner, nHeight, false);
+    }
+    else if (strCommand == "mnwa") { //Masternode Payments Winner Aggregate, sent during sync
+        CMasternodePaymentWinnerAggregate aggregate;
+        vRecv >> aggregate;
+
+        if(pfrom->nVersion < MIN_MNW_PEER_PROTO_VERSION) return;
+
+        // only sent in answer to our mnget, each one costs a rank list and signature checks
+        if(!pfrom->HasFulfilledRequest("mnwsync")){
+            LogPrint("mnpayments", "mnwa - unrequested aggregate from %s\n", pfrom->addr.ToString());
             return;
         }
 
-        if(!masternodePayments.CanVote(winner.vinMasternode.prevout, winner.nBlockHeight)){
-            LogPrintf("mnw - masternode already voted - %s\n", winner.vinMasternode.prevout.ToStringShort());
+        if(!aggregate.IsWellFormed()){
+            LogPrintf("mnwa - malformed aggregate from %s\n", pfrom->addr.ToString());
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
 
+        int nHeight;
+        {
+            TRY_LOCK(cs_main, locked);
+            if(!locked || chainActive.Tip() == NULL) return;
+            nHeight = chainActive.Tip()->nHeight;
+        }
+
+        int nFirstBlock = nHeight - (mnodeman.CountEnabled()*1.25);
+        if(aggregate.nBlockHeight < nFirstBlock || aggregate.nBlockHeight > nHeight+20){
+            LogPrint("mnpayments", "mnwa - winners out of range - FirstBlock %d Height %d bestHeight %d\n", nFirstBlock, aggregate.nBlockHeight, nHeight);
+            return;
+        }
+
+        // the ranks are computed once for all voters of the aggregate
+        std::vector<pair<int, CMasternode> > vecRanks = mnodeman.GetMasternodeRanks(aggregate.nBlockHeight-100, MIN_MNW_PEER_PROTO_VERSION);
+
+        size_t nSig = 0;
+        int nValid = 0;
+        for(int nRank = 1; nRank <= MNPAYMENTS_SIGNATURES_TOTAL; nRank++){
+            if(!aggregate.HasVoter(nRank)) continue;
+            const std::vector<unsigned char>& vchSig = aggregate.vSigs[nSig++];
+            if(nRank > (int)vecRanks.size()) break;
+
+            CMasternodePaymentWinner winner(vecRanks[nRank-1].second.vin);
+            winner.nBlockHeight = aggregate.nBlockHeight;
+            winner.payee = aggregate.payee;
+            winner.vchSig = vchSig;
+            winner.nRank = nRank;
+
+            if(masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash())){
+                masternodeSync.AddedMasternodeWinner(winner.GetHash());
+                nValid++;
+                continue;
+            }
+
+            // a different masternode list at the sender only shows as a signature that does not match
+            if(!winner.SignatureValid()){
+                LogPrint("mnpayments", "mnwa - signature does not match rank %d\n", winner.nRank);
+                continue;
+            }
+            nValid++;
+
+            masternodePayments.AcceptWinner(pfrom, winner, nHeight, true);
+        }
+
+        // a masternode list that differs from the sender's shifts the ranks and fails every
+        // signature, that is no fault of the peer, so ask it once for its votes as inventory
+        if(nValid == 0 && pfrom->nVersion >= MIN_PAYMENT_VOTES_INV_PROTO_VERSION && !pfrom->HasFulfilledRequest("mnwsyncinv")){
+            LogPrint("mnpayments", "mnwa - no valid signature in aggregate from %s, asking for the votes as inventory\n", pfrom->addr.ToString());
+            pfrom->FulfilledRequest("mnwsyncinv");
+            pfrom->PushMessage("mnget", mnodeman.CountEnabled(), false);
+        }
+    }
+}
+
+/**
+ * Check and store a vote that is in range and not known yet. Votes of an
+ * aggregate already have their rank from our masternode list and their
+ * signature checked by the caller.
+ */
+bool CMasternodePayments::AcceptWinner(CNode* pfrom, CMasternodePaymentWinner& winner, int nHeight, bool fAggregated)
+{
+    const char* strCommand = fAggregated ? "mnwa" : "mnw";
+
+    if(fAggregated){
+        if(!CanVote(winner.vinMasternode.prevout, winner.nBlockHeight)){
+            LogPrintf("%s - masternode already voted - %s\n", strCommand, winner.vinMasternode.prevout.ToStringShort());
+            return false;
+        }
+    } else {
+        std::string strError = "";
+        if(!winner.IsValid(pfrom, strError)){
+            if(strError != "") LogPrintf("%s - invalid message - %s\n", strCommand, strError);
+            return false;
+        }
+
+        if(!CanVote(winner.vinMasternode.prevout, winner.nBlockHeight)){
+            LogPrintf("%s - masternode already voted - %s\n", strCommand, winner.vinMasternode.prevout.ToStringShort());
+            return false;
+        }
+
         if(!winner.SignatureValid()){
-            LogPrintf("mnw - invalid signature\n");
+            LogPrintf("%s - invalid signature\n", strCommand);
             if(masternodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
             // it could just be a non-synced masternode
             mnodeman.AskForMN(pfrom, winner.vinMasternode);
-            return;
+            return false;
         }
+    }
 
-        CTxDestination address1;
-        ExtractDestination(winner.payee, address1);
-        CBitcoinAddress address2(address1);
+    CTxDestination address1;
+    ExtractDestination(winner.payee, address1);
+    CBitcoinAddress address2(address1);
 
-        LogPrint("mnpayments", "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinMasternode.prevout.ToStringShort());
+    LogPrint("mnpayments", "%s - winning vote - Addr %s Height %d bestHeight %d - %s\n", strCommand, address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinMasternode.prevout.ToStringShort());
 
-        if(masternodePayments.AddWinningMasternode(winner)){
-            winner.Relay();
-            masternodeSync.AddedMasternodeWinner(winner.GetHash());
-        }
-    }
+    if(!AddWinningMasternode(winner)) return false;
+
+    winner.Relay();
+    masternodeSync.AddedMasternodeWinner(winner.GetHash());
+    return true;
 }
 
 bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
@@ -305,11 +401,18 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
 
 bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 {
-    if(mapMasternodeBlocks.count(nBlockHeight)){
-        return mapMasternodeBlocks[nBlockHeight].GetPayee(payee);
-    }
+    LOCK(cs_mapMasternodeBlocks);
 
-    return false;
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Get(nBlockHeight);
+    return pblockPayees && pblockPayees->GetPayee(payee);
+}
+
+bool CMasternodePayments::HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq)
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Get(nBlockHeight);
+    return pblockPayees && pblockPayees->HasPayeeWithVotes(payee, nVotesReq);
 }
 
 // Is this masternode scheduled to get paid soon? 
@@ -325,22 +428,36 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    CScript mnpayee;
-    mnpayee = GetScriptForDestination(mn.pubkey.GetID());
+    CScript mnpayee = GetScriptForDestination(mn.pubkey.GetID());
+    return masternodeBlocks.IsLeading(mnpayee, nHeight, nHeight+8, nNotBlockHeight);
+}
 
-    CScript payee;
-    for(int64_t h = nHeight; h <= nHeight+8; h++){
-        if(h == nNotBlockHeight) continue;
-        if(mapMasternodeBlocks.count(h)){
-            if(mapMasternodeBlocks[h].GetPayee(payee)){
-                if(mnpayee == payee) {
-                    return true;
-                }
-            }
-        }
+bool CMasternodePayments::AddVoteToBlocks(const uint256& hash, CMasternodePaymentWinner& winner, std::vector<uint256>& vExpired)
+{
+    int n = 1;
+    if(IsReferenceNode(winner.vinMasternode)) n = 100;
+    return masternodeBlocks.AddVote(winner.nBlockHeight, hash, winner.payee, n, vExpired);
+}
+
+void CMasternodePayments::RemoveVotes(const std::vector<uint256>& vHashes)
+{
+    BOOST_FOREACH(const uint256& hash, vHashes) {
+        masternodeSync.mapSeenSyncMNW.erase(hash);
+        mapMasternodePayeeVotes.erase(hash);
     }
+}
 
-    return false;
+void CMasternodePayments::RebuildBlocks()
+{
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+
+    masternodeBlocks.Clear();
+    std::vector<uint256> vRemove;
+    for (std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin(); it != mapMasternodePayeeVotes.end(); ++it) {
+        if(!AddVoteToBlocks(it->first, it->second, vRemove))
+            vRemove.push_back(it->first);
+    }
+    RemoveVotes(vRemove);
 }
 
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
@@ -350,24 +467,20 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         return false;
     }
 
-    {
-        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
-    
-        if(mapMasternodePayeeVotes.count(winnerIn.GetHash())){
-           return false;
-        }
-
-        mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
 
-        if(!mapMasternodeBlocks.count(winnerIn.nBlockHeight)){
-           CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-           mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
-        }
+    uint256 hash = winnerIn.GetHash();
+    if(mapMasternodePayeeVotes.count(hash)){
+       return false;
     }
 
-    int n = 1;
-    if(IsReferenceNode(winnerIn.vinMasternode)) n = 100;
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, n);
+    // votes of a height that drops out of the window go with it
+    std::vector<uint256> vExpired;
+    if(!AddVoteToBlocks(hash, winnerIn, vExpired)){
+        return false;
+    }
+    RemoveVotes(vExpired);
+    mapMasternodePayeeVotes[hash] = winnerIn;
 
     return true;
 }
@@ -455,8 +568,9 @@ std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if(mapMasternodeBlocks.count(nBlockHeight)){
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Get(nBlockHeight);
+    if(pblockPayees){
+        return pblockPayees->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -466,8 +580,9 @@ bool CMasternodePayments::IsTransactionValid(const CAmount& nValueCreated, const
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if(mapMasternodeBlocks.count(nBlockHeight)){
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew, nValueCreated);
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Get(nBlockHeight);
+    if(pblockPayees){
+        return pblockPayees->IsTransactionValid(txNew, nValueCreated);
     }
 
     return true;
@@ -484,22 +599,15 @@ void CMasternodePayments::CheckAndRemove()
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    //keep up to five cycles for historical sake
-    int nLimit = std::max(int(mnodeman.size()*1.25), 1000);
-
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while(it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
+    //keep up to five cycles for historical sake, leave room in the window for votes ahead of the tip
+    int nLimit = std::min(std::max(int(mnodeman.size()*1.25), 1000), PAYMENT_VOTE_WINDOW - 100);
 
-        if(nHeight - winner.nBlockHeight > nLimit){
-            LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
-            mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+    std::vector<uint256> vExpired;
+    masternodeBlocks.ExpireBelow(nHeight - nLimit, vExpired);
+    if(!vExpired.empty()){
+        LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing %d old Masternode payments below block %d\n", vExpired.size(), nHeight - nLimit);
     }
+    RemoveVotes(vExpired);
 }
 
 bool IsReferenceNode(CTxIn& vin)
@@ -548,6 +656,7 @@ bool CMasternodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
         return false;
     }
 
+    nRank = n;
     return true;
 }
 
@@ -557,8 +666,9 @@ bool CMasternodePayments::ProcessBlock(int nBlockHeight)
 
     //reference node - hybrid mode
 
+    int n = 0;
     if(!IsReferenceNode(activeMasternode.vin)){
-        int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight-100, MIN_MNW_PEER_PROTO_VERSION);
+        n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight-100, MIN_MNW_PEER_PROTO_VERSION);
 
         if(n == -1)
         {
@@ -576,6 +686,7 @@ bool CMasternodePayments::ProcessBlock(int nBlockHeight)
     if(nBlockHeight <= nLastBlockHeight) return false;
 
     CMasternodePaymentWinner newWinner(activeMasternode.vin);
+    newWinner.nRank = n;
 
     if(budget.IsBudgetPaymentBlock(nBlockHeight)){
         //is budget payment block -- handled by the budgeting software
@@ -660,9 +771,9 @@ bool CMasternodePaymentWinner::SignatureValid()
     return false;
 }
 
-void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
+void CMasternodePayments::Sync(CNode* node, int nCountNeeded, bool fAggregate)
 {
-    LOCK(cs_mapMasternodePayeeVotes);
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
 
     int nHeight;
     {
@@ -675,15 +786,33 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
     if(nCountNeeded > nCount) nCountNeeded = nCount;
 
     int nInvCount = 0;
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while(it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
-        if(winner.nBlockHeight >= nHeight-nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
-            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, winner.GetHash()));
+    int nAggregates = 0;
+    for(int h = nHeight-nCountNeeded; h <= nHeight + 20; h++) {
+        const std::vector<uint256>* pvVotes = masternodeBlocks.GetVotes(h);
+        if(!pvVotes) continue;
+
+        // votes with a known rank go in one aggregate per payee, the others as inventory
+        std::map<CScript, std::map<int, const CMasternodePaymentWinner*> > mapByPayee;
+        BOOST_FOREACH(const uint256& hash, *pvVotes) {
+            const CMasternodePaymentWinner& winner = mapMasternodePayeeVotes[hash];
+            if(fAggregate && winner.nRank >= 1 && winner.nRank <= MNPAYMENTS_SIGNATURES_TOTAL && !mapByPayee[winner.payee].count(winner.nRank)) {
+                mapByPayee[winner.payee][winner.nRank] = &winner;
+            } else {
+                // an aggregate has one vote per rank, others of the same rank go as inventory
+                node->PushInventory(CInv(MSG_MASTERNODE_WINNER, hash));
+            }
             nInvCount++;
         }
-        ++it;
+
+        for(std::map<CScript, std::map<int, const CMasternodePaymentWinner*> >::iterator it = mapByPayee.begin(); it != mapByPayee.end(); ++it) {
+            CMasternodePaymentWinnerAggregate aggregate(h, it->first);
+            for(std::map<int, const CMasternodePaymentWinner*>::iterator itRank = it->second.begin(); itRank != it->second.end(); ++itRank)
+                aggregate.AddVoter(itRank->first, itRank->second->vchSig);
+            node->PushMessage("mnwa", aggregate);
+            nAggregates++;
+        }
     }
+    LogPrint("mnpayments", "CMasternodePayments::Sync - %d votes, %d aggregates to %s\n", nInvCount, nAggregates, node->addr.ToString());
     node->PushMessage("ssc", MASTERNODE_SYNC_MNW, nInvCount);
 }
 
@@ -692,7 +821,7 @@ std::string CMasternodePayments::ToString() const
     std::ostringstream info;
 
     info << "Votes: " << (int)mapMasternodePayeeVotes.size() <<
-            ", Blocks: " << (int)mapMasternodeBlocks.size();
+            ", Blocks: " << (int)masternodeBlocks.size();
 
     return info.str();
 }
@@ -703,17 +832,7 @@ int CMasternodePayments::GetOldestBlock()
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    int nOldestBlock = std::numeric_limits<int>::max();
-
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while(it != mapMasternodeBlocks.end()) {
-        if((*it).first < nOldestBlock) {
-            nOldestBlock = (*it).first;
-        }
-        it++;
-    }
-
-    return nOldestBlock;
+    return masternodeBlocks.GetOldest();
 }
 
 
@@ -722,15 +841,5 @@ int CMasternodePayments::GetNewestBlock()
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    int nNewestBlock = 0;
-
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while(it != mapMasternodeBlocks.end()) {
-        if((*it).first > nNewestBlock) {
-            nNewestBlock = (*it).first;
-        }
-        it++;
-    }
-
-    return nNewestBlock;
+    return masternodeBlocks.GetNewest();
 }
@@ -9,6 +9,7 @@
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "paymentvotes.h"
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
@@ -136,17 +137,21 @@ public:
     int nBlockHeight;
     CScript payee;
     std::vector<unsigned char> vchSig;
+    //! Rank of the voter at nBlockHeight-100 when the vote was checked, 0 if unknown, not serialized
+    int nRank;
 
     CMasternodePaymentWinner() {
         nBlockHeight = 0;
         vinMasternode = CTxIn();
         payee = CScript();
+        nRank = 0;
     }
 
     CMasternodePaymentWinner(CTxIn vinIn) {
         nBlockHeight = 0;
         vinMasternode = vinIn;
         payee = CScript();
+        nRank = 0;
     }
 
     uint256 GetHash(){
@@ -189,6 +194,56 @@ public:
     }
 };
 
+// All votes of one height for one payee, sent as a single mnwa message
+// during sync: a bitmap of the voters over the masternode ranks of the
+// height, followed by their signatures in rank order
+class CMasternodePaymentWinnerAggregate
+{
+public:
+    int nBlockHeight;
+    CScript payee;
+    std::vector<unsigned char> vchVoters;
+    std::vector<std::vector<unsigned char> > vSigs;
+
+    CMasternodePaymentWinnerAggregate() {
+        nBlockHeight = 0;
+    }
+
+    CMasternodePaymentWinnerAggregate(int nBlockHeightIn, const CScript& payeeIn) {
+        nBlockHeight = nBlockHeightIn;
+        payee = payeeIn;
+        vchVoters.resize((MNPAYMENTS_SIGNATURES_TOTAL + 7) / 8);
+    }
+
+    bool HasVoter(int nRank) const {
+        return nRank >= 1 && nRank <= MNPAYMENTS_SIGNATURES_TOTAL && (vchVoters[(nRank-1) / 8] >> ((nRank-1) % 8)) & 1;
+    }
+
+    // voters must be added in rank order
+    void AddVoter(int nRank, const std::vector<unsigned char>& vchSig) {
+        vchVoters[(nRank-1) / 8] |= 1 << ((nRank-1) % 8);
+        vSigs.push_back(vchSig);
+    }
+
+    bool IsWellFormed() const {
+        if(vchVoters.size() != (MNPAYMENTS_SIGNATURES_TOTAL + 7) / 8) return false;
+        size_t nVoters = 0;
+        for(int nRank = 1; nRank <= MNPAYMENTS_SIGNATURES_TOTAL; nRank++)
+            if(HasVoter(nRank)) nVoters++;
+        return nVoters > 0 && nVoters == vSigs.size();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nBlockHeight);
+        READWRITE(*(CScriptBase*)(&payee));
+        READWRITE(vchVoters);
+        READWRITE(vSigs);
+    }
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -199,10 +254,16 @@ class CMasternodePayments
 private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
+    //! Tallies of the votes by height, guarded by cs_mapMasternodeBlocks
+    CPaymentVoteWindow<CMasternodeBlockPayees> masternodeBlocks;
+
+    bool AcceptWinner(CNode* pfrom, CMasternodePaymentWinner& winner, int nHeight, bool fAggregated);
+    bool AddVoteToBlocks(const uint256& hash, CMasternodePaymentWinner& winner, std::vector<uint256>& vExpired);
+    void RemoveVotes(const std::vector<uint256>& vHashes);
+    void RebuildBlocks();
 
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
-    std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<COutPoint, int> mapMasternodesLastVote;
 
     CMasternodePayments() {
@@ -212,18 +273,19 @@ public:
 
     void Clear() {
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
-        mapMasternodeBlocks.clear();
+        masternodeBlocks.Clear();
         mapMasternodePayeeVotes.clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
     bool ProcessBlock(int nBlockHeight);
 
-    void Sync(CNode* node, int nCountNeeded);
+    void Sync(CNode* node, int nCountNeeded, bool fAggregate = false);
     void CheckAndRemove();
     int LastPayment(CMasternode& mn);
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
+    bool HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq);
     bool IsTransactionValid(const CAmount& nValueCreated, const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
 
@@ -242,7 +304,20 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
         READWRITE(mapMasternodePayeeVotes);
+        // The tallies are rebuilt from the votes
+        std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead())
+            RebuildBlocks();
+    }
+
+    /// Masternode payee votes by hash, the tallies per height are rebuilt from them after a read
+    template <typename Records>
+    void RecordsOp(Records& r) {
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
+        r.Map('v', mapMasternodePayeeVotes);
+        if (r.ForRead())
+            RebuildBlocks();
     }
 };
 
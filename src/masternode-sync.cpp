@@ -81,6 +81,9 @@ void CMasternodeSync::Reset()
     countMasternodeWinner = 0;
     countBudgetItemProp = 0;
     countBudgetItemFin = 0;
+    vBudgetShardRequested.assign(BUDGET_SYNC_SHARDS, 0);
+    vBudgetShardDone.assign(BUDGET_SYNC_SHARDS, 0);
+    vBudgetShardLastRequest.assign(BUDGET_SYNC_SHARDS, 0);
     RequestedMasternodeAssets = MASTERNODE_SYNC_INITIAL;
     RequestedMasternodeAttempt = 0;
     nAssetSyncStarted = GetTime();
@@ -135,6 +138,32 @@ bool CMasternodeSync::IsBudgetFinEmpty()
     return sumBudgetItemFin==0 && countBudgetItemFin>0;
 }
 
+// A shard counts as synced once a peer answered it, or after enough requests to peers that don't answer per shard
+bool CMasternodeSync::IsBudgetShardSynced(int nShard) const
+{
+    return vBudgetShardDone[nShard] > 0 || vBudgetShardRequested[nShard] >= MASTERNODE_SYNC_THRESHOLD*3;
+}
+
+int CMasternodeSync::CountBudgetShardsSynced() const
+{
+    int nCount = 0;
+    for(int nShard = 0; nShard < BUDGET_SYNC_SHARDS; nShard++)
+        if(IsBudgetShardSynced(nShard)) nCount++;
+    return nCount;
+}
+
+// The shard still to sync that was asked for the least, one request per shard and round, -1 if there is none
+int CMasternodeSync::GetNextBudgetShard() const
+{
+    int nNext = -1;
+    for(int nShard = 0; nShard < BUDGET_SYNC_SHARDS; nShard++) {
+        if(IsBudgetShardSynced(nShard)) continue;
+        if(vBudgetShardLastRequest[nShard] > GetTime() - MASTERNODE_SYNC_TIMEOUT) continue;
+        if(nNext < 0 || vBudgetShardRequested[nShard] < vBudgetShardRequested[nNext]) nNext = nShard;
+    }
+    return nNext;
+}
+
 void CMasternodeSync::GetNextAsset()
 {
     switch(RequestedMasternodeAssets)
@@ -207,6 +236,16 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                 if(RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
                 sumBudgetItemFin += nCount;
                 countBudgetItemFin++;
+                // older peers answer with the full set, which covers every shard
+                if(pfrom->nVersion < MIN_BUDGET_SHARD_PEER_PROTO_VERSION)
+                    for(int nShard = 0; nShard < BUDGET_SYNC_SHARDS; nShard++)
+                        vBudgetShardDone[nShard]++;
+                break;
+            case(MASTERNODE_SYNC_BUDGET_SHARD):
+                // nCount is the shard that was sent
+                if(RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
+                if(nCount < 0 || nCount >= BUDGET_SYNC_SHARDS) return;
+                vBudgetShardDone[nCount]++;
                 break;
         }
         
@@ -224,7 +263,10 @@ void CMasternodeSync::ClearFulfilledRequest()
         pnode->ClearFulfilledRequest("getspork");
         pnode->ClearFulfilledRequest("mnsync");
         pnode->ClearFulfilledRequest("mnwsync");
+        pnode->ClearFulfilledRequest("mnwsyncinv");
         pnode->ClearFulfilledRequest("busync");
+        for(int nShard = 0; nShard < BUDGET_SYNC_SHARDS; nShard++)
+            pnode->ClearFulfilledRequest(strprintf("busync%d", nShard));
     }
 }
 
@@ -271,7 +313,8 @@ void CMasternodeSync::Process()
                 mnodeman.DsegUpdate(pnode); 
             } else if(RequestedMasternodeAttempt < 6) {
                 int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage("mnget", nMnCount); //sync payees
+                pnode->FulfilledRequest("mnwsync");
+                pnode->PushMessage("mnget", nMnCount, true); //sync payees, aggregated
                 uint256 n = uint256();
                 pnode->PushMessage("mnvs", n); //sync masternode votes
             } else {
@@ -357,7 +400,7 @@ void CMasternodeSync::Process()
                 if(pindexPrev == NULL) return;
 
                 int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage("mnget", nMnCount); //sync payees
+                pnode->PushMessage("mnget", nMnCount, true); //sync payees, aggregated
                 RequestedMasternodeAttempt++;
 
                 return;
@@ -368,7 +411,8 @@ void CMasternodeSync::Process()
 
             if(RequestedMasternodeAssets == MASTERNODE_SYNC_BUDGET){
                 //we'll start rejecting votes if we accidentally get set as synced too soon
-                if(lastBudgetItem > 0 && lastBudgetItem < GetTime() - MASTERNODE_SYNC_TIMEOUT*2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD){ //hasn't received a new item in the last five seconds, so we'll move to the
+                if(lastBudgetItem > 0 && lastBudgetItem < GetTime() - MASTERNODE_SYNC_TIMEOUT*2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD &&
+                        CountBudgetShardsSynced() == BUDGET_SYNC_SHARDS){ //hasn't received a new item in the last five seconds, so we'll move to the
                     //LogPrintf("CMasternodeSync::Process - HasNextFinalizedBudget %d nCountFailures %d IsBudgetPropEmpty %d\n", budget.HasNextFinalizedBudget(), nCountFailures, IsBudgetPropEmpty());
                     //if(budget.HasNextFinalizedBudget() || nCountFailures >= 2 || IsBudgetPropEmpty()) {
                         GetNextAsset();
@@ -387,23 +431,41 @@ void CMasternodeSync::Process()
 
                 // timeout
                 if(lastBudgetItem == 0 &&
-                (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD*3 || GetTime() - nAssetSyncStarted > MASTERNODE_SYNC_TIMEOUT*5)) {
-                    // maybe there is no budgets at all, so just finish syncing
+                ((CountBudgetShardsSynced() == BUDGET_SYNC_SHARDS && sumBudgetItemProp == 0 && sumBudgetItemFin == 0) ||
+                 GetTime() - nAssetSyncStarted > MASTERNODE_SYNC_TIMEOUT*5)) {
+                    // maybe there is no budgets at all, or the peers had nothing we don't have, so just finish syncing
                     GetNextAsset();
                     activeMasternode.ManageStatus();
                     return;
                 }
 
-                if(pnode->HasFulfilledRequest("busync")) continue;
-                pnode->FulfilledRequest("busync");
+                // older peers don't know shards and take a second "mnvs" as misbehaving, ask them once for everything
+                if(pnode->nVersion < MIN_BUDGET_SHARD_PEER_PROTO_VERSION) {
+                    if(pnode->HasFulfilledRequest("busync")) continue;
+                    pnode->FulfilledRequest("busync");
 
-                if(RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD*3) return;
+                    uint256 n = uint256();
+                    pnode->PushMessage("mnvs", n); //sync masternode votes
+                    RequestedMasternodeAttempt++;
+
+                    continue;
+                }
+
+                // each shard goes to another peer in the same round, so the shards are fetched in parallel
+                int nShard = GetNextBudgetShard();
+                if(nShard < 0) return;
+
+                std::string strRequest = strprintf("busync%d", nShard);
+                if(pnode->HasFulfilledRequest(strRequest)) continue;
+                pnode->FulfilledRequest(strRequest);
 
                 uint256 n = uint256();
-                pnode->PushMessage("mnvs", n); //sync masternode votes
+                pnode->PushMessage("mnvs", n, nShard, BUDGET_SYNC_SHARDS, budget.GetKnownItemsFilter(nShard)); //sync masternode votes
+                vBudgetShardRequested[nShard]++;
+                vBudgetShardLastRequest[nShard] = GetTime();
                 RequestedMasternodeAttempt++;
-                
-                return;
+
+                continue;
             }
 
         }
@@ -13,6 +13,7 @@
 #define MASTERNODE_SYNC_BUDGET            4
 #define MASTERNODE_SYNC_BUDGET_PROP       10
 #define MASTERNODE_SYNC_BUDGET_FIN        11
+#define MASTERNODE_SYNC_BUDGET_SHARD      12
 #define MASTERNODE_SYNC_FAILED            998
 #define MASTERNODE_SYNC_FINISHED          999
 
@@ -49,6 +50,10 @@ public:
     int countMasternodeWinner;
     int countBudgetItemProp;
     int countBudgetItemFin;
+    // budget sync requests and answers per shard, see BUDGET_SYNC_SHARDS
+    std::vector<int> vBudgetShardRequested;
+    std::vector<int> vBudgetShardDone;
+    std::vector<int64_t> vBudgetShardLastRequest;
 
     // Count peers we've requested the list from
     int RequestedMasternodeAssets;
@@ -67,6 +72,9 @@ public:
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     bool IsBudgetFinEmpty();
     bool IsBudgetPropEmpty();
+    bool IsBudgetShardSynced(int nShard) const;
+    int CountBudgetShardsSynced() const;
+    int GetNextBudgetShard() const;
 
     void Reset();
     void Process();
@@ -6,6 +6,7 @@
 #include "masternode.h"
 #include "masternodeman.h"
 #include "legacysigner.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "sync.h"
 #include "addrman.h"
@@ -143,6 +144,7 @@ bool CMasternode::UpdateFromNewBroadcast(const CMasternodeBroadcast& mnb)
             lastPing = mnb.lastPing;
             mnodeman.mapSeenMasternodePing.insert(make_pair(lastPing.GetHash(), lastPing));
         }
+        uiInterface.NotifyMasternodeChanged(vin, CT_UPDATED);
         return true;
     }
     return false;
@@ -177,6 +179,14 @@ arith_uint256 CMasternode::CalculateScore(int64_t nBlockHeight) const
 }
 
 void CMasternode::Check(bool forceCheck)
+{
+    int nActiveStatePrev = activeState;
+    CheckActiveState(forceCheck);
+    if(activeState != nActiveStatePrev)
+        uiInterface.NotifyMasternodeChanged(vin, CT_UPDATED);
+}
+
+void CMasternode::CheckActiveState(bool forceCheck)
 {
     if(ShutdownRequested()) return;
 
@@ -275,14 +285,12 @@ int64_t CMasternode::GetLastPaid() const
         }
         n++;
 
-        if(masternodePayments.mapMasternodeBlocks.count(BlockReading->nHeight)){
-            /*
-                Search for this payee, with at least 2 votes. This will aid in consensus allowing the network 
-                to converge on the same payees quickly, then keep the same schedule.
-            */
-            if(masternodePayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)){
-                return BlockReading->nTime + nOffset;
-            }
+        /*
+            Search for this payee, with at least 2 votes. This will aid in consensus allowing the network 
+            to converge on the same payees quickly, then keep the same schedule.
+        */
+        if(masternodePayments.HasPayeeWithVotes(BlockReading->nHeight, mnpayee, 2)){
+            return BlockReading->nTime + nOffset;
         }
 
         if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
@@ -901,6 +909,7 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             }
 
             pmn->lastPing = *this;
+            uiInterface.NotifyMasternodeChanged(vin, CT_UPDATED);
 
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
@@ -226,7 +226,9 @@ public:
 
     int64_t SecondsSincePayment() const;
     bool UpdateFromNewBroadcast(const CMasternodeBroadcast& mnb);
+    /// Re-evaluate activeState, notifying the UI when it changes
     void Check(bool forceCheck = false);
+    void CheckActiveState(bool forceCheck);
 
     bool IsBroadcastedWithin(int seconds) const
     {
@@ -8,6 +8,7 @@
 #include "systemnodeman.h"
 #include "activemasternode.h"
 #include "legacysigner.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "addrman.h"
 #include "spork.h"
@@ -60,6 +61,7 @@ bool CMasternodeMan::Add(const CMasternode &mn)
     {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.addr.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        uiInterface.NotifyMasternodeChanged(mn.vin, CT_NEW);
         return true;
     }
 
@@ -130,6 +132,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            uiInterface.NotifyMasternodeChanged((*it).vin, CT_DELETED);
             it = vMasternodes.erase(it);
         } else {
             ++it;
@@ -193,6 +196,8 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
+    BOOST_FOREACH(const CMasternode& mn, vMasternodes)
+        uiInterface.NotifyMasternodeChanged(mn.vin, CT_DELETED);
     vMasternodes.clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
@@ -264,6 +269,28 @@ CMasternode *CMasternodeMan::Find(const CTxIn &vin)
     return NULL;
 }
 
+bool CMasternodeMan::Get(const CTxIn& vin, CMasternode& mnRet)
+{
+    LOCK(cs);
+
+    CMasternode* pmn = Find(vin);
+    if(pmn == NULL)
+        return false;
+    mnRet = *pmn;
+    return true;
+}
+
+std::vector<CTxIn> CMasternodeMan::GetMasternodeVins()
+{
+    LOCK(cs);
+
+    std::vector<CTxIn> vVins;
+    vVins.reserve(vMasternodes.size());
+    BOOST_FOREACH(const CMasternode& mn, vMasternodes)
+        vVins.push_back(mn.vin);
+    return vVins;
+}
+
 
 CMasternode *CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
@@ -445,6 +472,40 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     return -1;
 }
 
+std::vector<CTxIn> CMasternodeMan::GetTopMasternodes(int nCount, int64_t nBlockHeight, int minProtocol)
+{
+    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
+    std::vector<CTxIn> vecTop;
+
+    //make sure we know about this block
+    uint256 hash = uint256();
+    if(!GetBlockHash(hash, nBlockHeight)) return vecTop;
+
+    LOCK(cs);
+
+    // same selection as GetMasternodeRank with fOnlyActive
+    vecMasternodeScores.reserve(vMasternodes.size());
+    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        if(mn.protocolVersion < minProtocol) continue;
+        mn.Check();
+        if(!mn.IsEnabled()) continue;
+
+        arith_uint256 n = mn.CalculateScore(nBlockHeight);
+        vecMasternodeScores.push_back(make_pair(n.GetCompact(false), mn.vin));
+    }
+
+    // only the head of the ranking is needed
+    size_t nTop = std::min(vecMasternodeScores.size(), (size_t)std::max(nCount, 0));
+    std::partial_sort(vecMasternodeScores.begin(), vecMasternodeScores.begin() + nTop, vecMasternodeScores.end(),
+                      [](const pair<int64_t, CTxIn>& t1, const pair<int64_t, CTxIn>& t2) { return t1.first > t2.first; });
+
+    vecTop.reserve(nTop);
+    for(size_t i = 0; i < nTop; i++)
+        vecTop.push_back(vecMasternodeScores[i].second);
+
+    return vecTop;
+}
+
 std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
     std::vector<pair<int64_t, CMasternode> > vecMasternodeScores;
@@ -654,6 +715,7 @@ void CMasternodeMan::Remove(CTxIn vin)
     while(it != vMasternodes.end()){
         if((*it).vin == vin){
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).addr.ToString(), size() - 1);
+            uiInterface.NotifyMasternodeChanged(vin, CT_DELETED);
             vMasternodes.erase(it);
             break;
         }
@@ -66,6 +66,19 @@ public:
         READWRITE(mapSeenMasternodePing);
     }
 
+    /// Masternode list, list requests both ways, dsq count and the broadcasts and pings already seen
+    template <typename Records>
+    void RecordsOp(Records& r) {
+        LOCK(cs);
+        r.Vector('m', vMasternodes);
+        r.Map('a', mAskedUsForMasternodeList);
+        r.Map('w', mWeAskedForMasternodeList);
+        r.Map('e', mWeAskedForMasternodeListEntry);
+        r.Value('d', nDsqCount);
+        r.Map('b', mapSeenMasternodeBroadcast);
+        r.Map('p', mapSeenMasternodePing);
+    }
+
     CMasternodeMan();
     CMasternodeMan(CMasternodeMan& other);
 
@@ -104,9 +117,15 @@ public:
     CMasternode* GetCurrentMasterNode(int mod=1, int64_t nBlockHeight=0, int minProtocol=0);
 
     std::vector<CMasternode> GetFullMasternodeVector() { Check(); return vMasternodes; }
+    /// Copy a single entry, for callers that must not keep pointers into the list
+    bool Get(const CTxIn& vin, CMasternode& mnRet);
+    /// Collateral inputs of all entries
+    std::vector<CTxIn> GetMasternodeVins();
 
     std::vector<pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int64_t nBlockHeight, int minProtocol=0, bool fOnlyActive=true);
+    /// Collateral inputs of the nCount enabled Masternodes ranked best for a block, best first
+    std::vector<CTxIn> GetTopMasternodes(int nCount, int64_t nBlockHeight, int minProtocol=0);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol=0, bool fOnlyActive=true);
 
     void ProcessMasternodeConnections();
@@ -8,6 +8,8 @@
 #include "miner.h"
 
 #include "amount.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "hash.h"
@@ -30,6 +32,9 @@
 #include "mn-pos/stakeminer.h"
 #include "spork.h"
 
+#include <atomic>
+#include <limits>
+
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <mn-pos/stakevalidation.h>
@@ -91,6 +96,13 @@ public:
     }
 };
 
+// Transactions added to an existing block go by fee rate only, highest first
+typedef std::pair<CFeeRate, const CTransaction*> TxFeeRate;
+static bool TxFeeRateCompare(const TxFeeRate& a, const TxFeeRate& b)
+{
+    return b.first < a.first;
+}
+
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
     pblock->nTime = std::max(pindexPrev->GetMedianTimePast()+1, GetAdjustedTime());
@@ -100,6 +112,45 @@ void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
         pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
 }
 
+static unsigned int GetBlockMaxSize()
+{
+    // Largest block you're willing to create:
+    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
+    // Limit to betweeen 1K and MAX_BLOCK_SIZE-1K for sanity:
+    return std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SIZE-1000), nBlockMaxSize));
+}
+
+// Masternode, systemnode and general budget payments of a block with nFees
+static void FillCoinbaseValue(CMutableTransaction& txCoinbase, const CBlockIndex* pindexPrev, CAmount nFees)
+{
+    if (IsSporkActive(SPORK_4_ENABLE_MASTERNODE_PAYMENTS))
+    {
+        FillBlockPayee(txCoinbase, nFees);
+        SNFillBlockPayee(txCoinbase, nFees);
+    }
+    else
+    {
+        txCoinbase.vout[0].nValue = GetBlockValue(pindexPrev->nHeight, nFees);
+    }
+}
+
+static void SetBlockPayees(CBlock* pblock, const CMutableTransaction& txCoinbase, const CBlockIndex* pindexPrev)
+{
+    if (!(IsSporkActive(SPORK_13_ENABLE_SUPERBLOCKS) && budget.IsBudgetPaymentBlock(pindexPrev->nHeight + 1)))
+    {
+        // Make payee
+        if(txCoinbase.vout.size() > 1)
+        {
+            pblock->payee = txCoinbase.vout[MN_PMT_SLOT].scriptPubKey;
+        }
+        // Make SNpayee
+        if(txCoinbase.vout.size() > 2)
+        {
+            pblock->payeeSN = txCoinbase.vout[SN_PMT_SLOT].scriptPubKey;
+        }
+    }
+}
+
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
 {
     // Create new block
@@ -159,10 +210,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     if (Params().MineBlocksOnDemand())
         pblock->nVersion.SetBaseVersion(GetArg("-blockversion", pblock->nVersion.GetBaseVersion()), nChainId);
 
-    // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
-    // Limit to betweeen 1K and MAX_BLOCK_SIZE-1K for sanity:
-    nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SIZE-1000), nBlockMaxSize));
+    unsigned int nBlockMaxSize = GetBlockMaxSize();
 
     // How much of the block should be dedicated to high-priority transactions,
     // included regardless of the fees they pay
@@ -369,15 +417,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         }
 
         // Masternode and general budget payments
-        if (IsSporkActive(SPORK_4_ENABLE_MASTERNODE_PAYMENTS))
-        {
-            FillBlockPayee(txCoinbase, nFees);
-            SNFillBlockPayee(txCoinbase, nFees);
-        }
-        else
-        {
-            txCoinbase.vout[0].nValue = GetBlockValue(pindexPrev->nHeight, nFees);
-        }
+        FillCoinbaseValue(txCoinbase, pindexPrev, nFees);
 
         // Proof of stake blocks pay the mining reward in the coinstake transaction
         if (fProofOfStake) {
@@ -404,20 +444,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             txCoinbase.vout[0].scriptPubKey = CScript();
         }
 
-        if (!(IsSporkActive(SPORK_13_ENABLE_SUPERBLOCKS) && budget.IsBudgetPaymentBlock(pindexPrev->nHeight + 1)))
-        {
-            // Make payee
-	    if(txCoinbase.vout.size() > 1)
-            {
-                pblock->payee = txCoinbase.vout[MN_PMT_SLOT].scriptPubKey;
-            }
-            // Make SNpayee
-	    if(txCoinbase.vout.size() > 2)
-            {
-                pblock->payeeSN = txCoinbase.vout[SN_PMT_SLOT].scriptPubKey;
-            }
-        }
-
+        SetBlockPayees(pblock, txCoinbase, pindexPrev);
 
         nLastBlockTx = nBlockTx;
         nLastBlockSize = nBlockSize;
@@ -457,6 +484,158 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     return pblocktemplate.release();
 }
 
+unsigned int UpdateBlockTemplate(CBlockTemplate* pblocktemplate)
+{
+    CBlock *pblock = &pblocktemplate->block;
+    if (pblock->IsProofOfStake())
+        return 0;
+
+    unsigned int nBlockMaxSize = GetBlockMaxSize();
+    unsigned int nBlockMinSize = std::min(nBlockMaxSize, (unsigned int)GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE));
+
+    LOCK2(cs_main, mempool.cs);
+
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (pblock->hashPrevBlock != pindexPrev->GetBlockHash())
+        return 0;
+    const int nHeight = pindexPrev->nHeight + 1;
+
+    // Spend what the block already spends, its transactions were checked when they were added
+    CCoinsViewCache view(pcoinsTip);
+    set<uint256> setInBlock;
+    uint64_t nBlockSize = 1000;
+    int nBlockSigOps = 100;
+    for (unsigned int i = 1; i < pblock->vtx.size(); i++)
+    {
+        const CTransaction& tx = pblock->vtx[i];
+        CValidationState state;
+        CTxUndo txundo;
+        UpdateCoins(tx, state, view, txundo, nHeight);
+        setInBlock.insert(tx.GetHash());
+        nBlockSize += ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        nBlockSigOps += pblocktemplate->vTxSigOps[i];
+    }
+    CAmount nFees = -pblocktemplate->vTxFees[0];
+
+    // What to go back to if the updated block does not validate
+    const unsigned int nTxPrev = pblock->vtx.size();
+    const CBlockHeader headerPrev = *pblock;
+    const CTransaction txCoinbasePrev = pblock->vtx[0];
+    const CScript payeePrev = pblock->payee;
+    const CScript payeeSNPrev = pblock->payeeSN;
+    const CAmount nFeesPrev = nFees;
+    const int64_t nSigOpsPrev = pblocktemplate->vTxSigOps[0];
+
+    // Transactions that arrived since, by fee rate
+    vector<TxFeeRate> vecCandidates;
+    for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+    {
+        const CTransaction& tx = mi->second.GetTx();
+        if (setInBlock.count(mi->first) || tx.IsCoinBase() || !IsFinalTx(tx, nHeight))
+            continue;
+        double dPriorityDelta = 0;
+        CAmount nFeeDelta = 0;
+        mempool.ApplyDeltas(mi->first, dPriorityDelta, nFeeDelta);
+        vecCandidates.push_back(make_pair(CFeeRate(mi->second.GetFee() + nFeeDelta, mi->second.GetTxSize()), &tx));
+    }
+    std::stable_sort(vecCandidates.begin(), vecCandidates.end(), TxFeeRateCompare);
+
+    // A transaction whose inputs are not there yet is tried again after the next pass added its parents
+    unsigned int nAdded = 0;
+    bool fProgress = true;
+    while (fProgress && !vecCandidates.empty())
+    {
+        fProgress = false;
+        vector<TxFeeRate> vecWaiting;
+        for (unsigned int i = 0; i < vecCandidates.size(); i++)
+        {
+            const CFeeRate& feeRate = vecCandidates[i].first;
+            const CTransaction& tx = *vecCandidates[i].second;
+
+            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+            if (nBlockSize + nTxSize >= nBlockMaxSize)
+                continue;
+
+            unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+                continue;
+
+            // The priority space was filled when the block was created, free transactions only go into the minimum size
+            double dPriorityDelta = 0;
+            CAmount nFeeDelta = 0;
+            mempool.ApplyDeltas(tx.GetHash(), dPriorityDelta, nFeeDelta);
+            if ((dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+                continue;
+
+            if (!view.HaveInputs(tx))
+            {
+                vecWaiting.push_back(vecCandidates[i]);
+                continue;
+            }
+
+            CAmount nTxFees = view.GetValueIn(tx)-tx.GetValueOut();
+
+            nTxSigOps += GetP2SHSigOpCount(tx, view);
+            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+                continue;
+
+            CValidationState state;
+            if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+                continue;
+
+            CTxUndo txundo;
+            UpdateCoins(tx, state, view, txundo, nHeight);
+
+            pblock->vtx.push_back(tx);
+            pblocktemplate->vTxFees.push_back(nTxFees);
+            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
+            nBlockSize += nTxSize;
+            nBlockSigOps += nTxSigOps;
+            nFees += nTxFees;
+            nAdded++;
+            fProgress = true;
+        }
+        vecCandidates.swap(vecWaiting);
+    }
+
+    if (nAdded == 0)
+        return 0;
+
+    // Pay the new fees out of the coinbase, with the same payees as a new block would have
+    CMutableTransaction txCoinbase(pblock->vtx[0]);
+    txCoinbase.vout.resize(1);
+    FillCoinbaseValue(txCoinbase, pindexPrev, nFees);
+    SetBlockPayees(pblock, txCoinbase, pindexPrev);
+    pblock->vtx[0] = txCoinbase;
+    pblocktemplate->vTxFees[0] = -nFees;
+    pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
+
+    UpdateTime(pblock, pindexPrev);
+    pblock->hashMerkleRoot = pblock->BuildMerkleTree();
+
+    pblock->fChecked = false;
+    CValidationState state;
+    if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
+        LogPrintf("UpdateBlockTemplate() : TestBlockValidity failed, keeping the previous block\n  %s\n", pblock->ToString());
+        pblock->vtx.erase(pblock->vtx.begin() + nTxPrev, pblock->vtx.end());
+        pblocktemplate->vTxFees.resize(nTxPrev);
+        pblocktemplate->vTxSigOps.resize(nTxPrev);
+        *((CBlockHeader*)pblock) = headerPrev;
+        pblock->vtx[0] = txCoinbasePrev;
+        pblock->payee = payeePrev;
+        pblock->payeeSN = payeeSNPrev;
+        pblocktemplate->vTxFees[0] = -nFeesPrev;
+        pblocktemplate->vTxSigOps[0] = nSigOpsPrev;
+        pblock->BuildMerkleTree();
+        return 0;
+    }
+
+    nLastBlockTx = pblock->vtx.size() - 1;
+    nLastBlockSize = nBlockSize;
+    LogPrint("miner", "UpdateBlockTemplate(): %u transactions added, total size %u\n", nAdded, nBlockSize);
+    return nAdded;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -484,38 +663,83 @@ double dHashesPerSec = 0.0;
 int64_t nHPSTimerStart = 0;
 
 //
-// ScanHash scans nonces looking for a hash with at least some zero bits.
-// The nonce is usually preserved between calls, but periodically or if the
-// nonce is 0xffff0000 or above, the block is rebuilt and nNonce starts over at
-// zero.
+// ScanHash scans the nonces from nNonce up to nNonceEnd for a hash at or
+// below hashTarget, CSHA256DNonceScanner::LANES nonces at a time from the
+// midstate of the header. It returns after at most 0x10000 nonces so the
+// caller can check whether the block needs to be rebuilt, nNonce is then
+// where to go on, or the nonce that was found.
 //
-bool static ScanHash(const CBlockHeader *pblock, uint32_t& nNonce, uint256 *phash)
+bool static ScanHash(const CBlockHeader *pblock, uint64_t& nNonce, uint64_t nNonceEnd, const arith_uint256& hashTarget, uint256 *phash)
 {
-    // Write the first 76 bytes of the block header to a double-SHA256 state.
-    CHash256 hasher;
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << *pblock;
+    ss << *(const CPureBlockHeader*)pblock;
     assert(ss.size() == 80);
-    hasher.Write((unsigned char*)&ss[0], 76);
+    CSHA256DNonceScanner scanner((const unsigned char*)&ss[0]);
+
+    // Most significant word of the target, only hashes up to it need the full comparison
+    const uint32_t nTargetTop = (hashTarget >> 224).GetLow64();
+    const uint64_t nStop = std::min(nNonceEnd, nNonce + 0x10000);
+    unsigned char hashes[CSHA256DNonceScanner::LANES][CSHA256::OUTPUT_SIZE];
+    for (; nNonce < nStop; nNonce += CSHA256DNonceScanner::LANES) {
+        scanner.Hash((uint32_t)nNonce, hashes);
+        uint64_t nLanes = std::min((uint64_t)CSHA256DNonceScanner::LANES, nStop - nNonce);
+        for (uint64_t l = 0; l < nLanes; l++) {
+            if (ReadLE32(hashes[l] + 28) > nTargetTop)
+                continue;
+            memcpy(phash->begin(), hashes[l], CSHA256::OUTPUT_SIZE);
+            if (UintToArith256(*phash) <= hashTarget) {
+                nNonce += l;
+                return true;
+            }
+        }
+    }
+    nNonce = nStop;
+    return false;
+}
 
-    while (true) {
-        nNonce++;
+// Meter hashes/sec over all miner threads
+static std::atomic<uint64_t> nHashCounter(0);
 
-        // Write the last 4 bytes of the block header (the nonce) to a copy of
-        // the double-SHA256 state, and compute the result.
-        CHash256(hasher).Write((unsigned char*)&nNonce, 4).Finalize((unsigned char*)phash);
+static void MeterHashes(uint64_t nHashesDone)
+{
+    nHashCounter += nHashesDone;
+    int64_t nNow = GetTimeMillis();
+    if (nNow - nHPSTimerStart <= 4000)
+        return;
 
-        // Return the nonce if the hash has at least some zero bits,
-        // caller will check if it has enough to reach the target
-        if (((uint16_t*)phash)[15] == 0)
-            return true;
+    static CCriticalSection cs;
+    LOCK(cs);
+    if (nNow - nHPSTimerStart > 4000)
+    {
+        uint64_t nHashes = nHashCounter.exchange(0);
+        if (nHPSTimerStart != 0)
+            dHashesPerSec = 1000.0 * nHashes / (nNow - nHPSTimerStart);
+        nHPSTimerStart = nNow;
+        static int64_t nLogTime;
+        if (GetTime() - nLogTime > 30 * 60)
+        {
+            nLogTime = GetTime();
+            LogPrintf("hashmeter %6.0f khash/s\n", dHashesPerSec/1000.0);
+        }
+    }
+}
 
-        // If nothing found after trying for a while, return -1
-        if ((nNonce & 0xffff) == 0)
-            return false;
-        if ((nNonce & 0xfff) == 0)
-            boost::this_thread::interruption_point();
+bool SolveBlock(CBlockHeader* pblock)
+{
+    arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+    uint256 hash;
+    uint64_t nNonce = pblock->nNonce;
+    while (nNonce <= std::numeric_limits<uint32_t>::max()) {
+        uint64_t nNonceStart = nNonce;
+        bool fFound = ScanHash(pblock, nNonce, (uint64_t)std::numeric_limits<uint32_t>::max() + 1, hashTarget, &hash);
+        MeterHashes(nNonce - nNonceStart + fFound);
+        if (fFound) {
+            pblock->nNonce = nNonce;
+            return true;
+        }
+        boost::this_thread::interruption_point();
     }
+    return false;
 }
 
 CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake)
@@ -560,15 +784,18 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
     return true;
 }
 
-void BitcoinMiner(CWallet *pwallet, bool fProofOfStake)
+void BitcoinMiner(CWallet *pwallet, bool fProofOfStake, int nThread, int nThreads)
 {
     LogPrintf("CrownMiner started\n");
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("crown-miner");
 
-    // Each thread has its own key and counter
+    // Each thread has its own key and counter, and its own range of nonces
     CReserveKey reservekey(pwallet);
     unsigned int nExtraNonce = 0;
+    const uint64_t nNonceRange = ((uint64_t)std::numeric_limits<uint32_t>::max() + 1) / std::max(nThreads, 1);
+    const uint64_t nNonceBegin = nThread * nNonceRange;
+    const uint64_t nNonceEnd = nNonceBegin + nNonceRange;
 
     try {
         while (true) {
@@ -635,68 +862,36 @@ void BitcoinMiner(CWallet *pwallet, bool fProofOfStake)
                 ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
 
             //
-            // Search
+            // Search this thread's share of the nonces, bumping the extra nonce
+            // when they are used up rather than creating the block again
             //
             int64_t nStart = GetTime();
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
             uint256 hash;
-            uint32_t nNonce = 0;
-            uint32_t nOldNonce = 0;
+            uint64_t nNonce = nNonceBegin;
             while (true) {
-                bool fFound = ScanHash(pblock, nNonce, &hash);
-                uint32_t nHashesDone = nNonce - nOldNonce;
-                nOldNonce = nNonce;
+                uint64_t nNonceStart = nNonce;
+                bool fFound = ScanHash(pblock, nNonce, nNonceEnd, hashTarget, &hash);
+                MeterHashes(nNonce - nNonceStart + fFound);
 
                 // Check if something found
                 if (fFound)
                 {
-                    if (UintToArith256(hash) <= hashTarget)
-                    {
-                        // Found a solution
-                        pblock->nNonce = nNonce;
-                        assert(hash == pblock->GetHash());
+                    // Found a solution
+                    pblock->nNonce = nNonce;
+                    assert(hash == pblock->GetHash());
 
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("CrownMiner:\n");
-                        LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", hash.GetHex(), hashTarget.GetHex());
-                        ProcessBlockFound(pblock, *pwallet, reservekey);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                    LogPrintf("CrownMiner:\n");
+                    LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", hash.GetHex(), hashTarget.GetHex());
+                    ProcessBlockFound(pblock, *pwallet, reservekey);
+                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
 
-                        // In regression test mode, stop mining after a block is found.
-                        if (Params().MineBlocksOnDemand())
-                            throw boost::thread_interrupted();
+                    // In regression test mode, stop mining after a block is found.
+                    if (Params().MineBlocksOnDemand())
+                        throw boost::thread_interrupted();
 
-                        break;
-                    }
-                }
-
-                // Meter hashes/sec
-                static int64_t nHashCounter;
-                if (nHPSTimerStart == 0)
-                {
-                    nHPSTimerStart = GetTimeMillis();
-                    nHashCounter = 0;
-                }
-                else
-                    nHashCounter += nHashesDone;
-                if (GetTimeMillis() - nHPSTimerStart > 4000)
-                {
-                    static CCriticalSection cs;
-                    {
-                        LOCK(cs);
-                        if (GetTimeMillis() - nHPSTimerStart > 4000)
-                        {
-                            dHashesPerSec = 1000.0 * nHashCounter / (GetTimeMillis() - nHPSTimerStart);
-                            nHPSTimerStart = GetTimeMillis();
-                            nHashCounter = 0;
-                            static int64_t nLogTime;
-                            if (GetTime() - nLogTime > 30 * 60)
-                            {
-                                nLogTime = GetTime();
-                                LogPrintf("hashmeter %6.0f khash/s\n", dHashesPerSec/1000.0);
-                            }
-                        }
-                    }
+                    break;
                 }
 
                 // Check for stop or if block needs to be rebuilt
@@ -704,13 +899,17 @@ void BitcoinMiner(CWallet *pwallet, bool fProofOfStake)
                 // Regtest mode doesn't require peers
                 if (vNodes.empty() && Params().MiningRequiresPeers())
                     break;
-                if (nNonce >= 0xffff0000)
-                    break;
                 if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
                     break;
                 if (pindexPrev != chainActive.Tip())
                     break;
 
+                if (nNonce >= nNonceEnd)
+                {
+                    IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
+                    nNonce = nNonceBegin;
+                }
+
                 // Update nTime every few seconds
                 UpdateTime(pblock, pindexPrev);
                 if (Params().AllowMinDifficultyBlocks())
@@ -757,5 +956,5 @@ void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads)
 
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, pwallet, false));
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, pwallet, false, i, nThreads));
 }
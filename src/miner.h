@@ -19,13 +19,22 @@ struct CBlockTemplate;
 
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
-void BitcoinMiner(CWallet *pwallet, bool fProofOfStake);
+void BitcoinMiner(CWallet *pwallet, bool fProofOfStake, int nThread = 0, int nThreads = 1);
 
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet = nullptr, bool fProofOfStake = false);
 CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet = nullptr, bool fProofOfStake = false);
+/**
+ * Add the mempool transactions that arrived since a proof of work block was
+ * created and pay their fees out of its coinbase, without checking the
+ * transactions that are already in it again. Returns the number added, 0 if
+ * the block is no longer on the tip and must be created anew.
+ */
+unsigned int UpdateBlockTemplate(CBlockTemplate* pblocktemplate);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/** Find a nonce from the current one on that meets the target of the block, false if there is none */
+bool SolveBlock(CBlockHeader* pblock);
 /** Check mined block */
 void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey);
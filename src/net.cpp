@@ -25,6 +25,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -74,7 +75,7 @@ namespace {
 //
 bool fDiscover = true;
 bool fListen = true;
-uint64_t nLocalServices = NODE_NETWORK;
+std::atomic<uint64_t> nLocalServices(NODE_NETWORK);
 CCriticalSection cs_mapLocalHost;
 map<CNetAddr, LocalServiceInfo> mapLocalHost;
 static bool vfReachable[NET_MAX] = {};
@@ -90,9 +91,11 @@ bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
-deque<pair<int64_t, CInv> > vRelayExpiration;
-CCriticalSection cs_mapRelay;
+CRelayCache relayCache;
+CNetBufferPool netBufferPool;
+static deque<CRelayQueueEntry> vRelayQueue;
+static uint64_t nRelayQueueSequence = 0;
+static CCriticalSection cs_vRelayQueue;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
 static deque<string> vOneShots;
@@ -358,6 +361,9 @@ uint64_t CNode::nTotalBytesRecv = 0;
 uint64_t CNode::nTotalBytesSent = 0;
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
+CCriticalSection CNode::cs_totalMsgStats;
+mapMsgCmdStats CNode::mapTotalSendMsgStats;
+mapMsgCmdStats CNode::mapTotalRecvMsgStats;
 
 CNode* FindNode(const CNetAddr& ip)
 {
@@ -489,7 +495,7 @@ void CNode::PushVersion()
     else
         LogPrint("net", "send version message: version %d, blocks=%d, us=%s, peer=%d\n", PROTOCOL_VERSION, nBestHeight, addrMe.ToString(), id);
 
-    PushMessage("version", PROTOCOL_VERSION, nLocalServices, nTime, addrYou, addrMe,
+    PushMessage("version", PROTOCOL_VERSION, nLocalServices.load(), nTime, addrYou, addrMe,
                 nLocalHostNonce, strSubVersion, nBestHeight, true);
 }
 
@@ -584,6 +590,12 @@ void CNode::copyStats(CNodeStats &stats)
 
     // Leave string empty if addrLocal invalid (not filled in yet)
     stats.addrLocal = addrLocal.IsValid() ? addrLocal.ToString() : "";
+
+    {
+        LOCK(cs_msgStats);
+        X(mapSendMsgStats);
+        X(mapRecvMsgStats);
+    }
 }
 #undef X
 
@@ -595,7 +607,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, nRecvVersion));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, nRecvVersion);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -654,6 +666,13 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     // switch state to reading message data
     in_data = true;
 
+    // receive the payload into recycled storage
+    if (hdr.nMessageSize > 0) {
+        CSerializeData data;
+        netBufferPool.Acquire(data);
+        vRecv.SwapData(data);
+    }
+
     return nCopy;
 }
 
@@ -662,17 +681,60 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
-    if (vRecv.size() < nDataPos + nCopy) {
-        // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+    if (vRecv.capacity() < nDataPos + nCopy) {
+        // Allocate up to 256 KiB ahead (or double for large messages), but
+        // never more than the total message size.
+        vRecv.reserve(std::min((size_t)hdr.nMessageSize, std::max((size_t)nDataPos + nCopy + 256 * 1024, 2 * vRecv.capacity())));
     }
 
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    // Append without zero-filling the buffer first
+    vRecv.write(pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+void CNetMessage::ReleaseBuffer()
+{
+    CSerializeData data;
+    vRecv.SwapData(data);
+    netBufferPool.Release(data);
+}
+
+CNetBufferPool::CNetBufferPool() : nBytes(0)
+{
+}
+
+void CNetBufferPool::Acquire(CSerializeData& data)
+{
+    assert(data.empty());
+    LOCK(cs);
+    if (vFree.empty())
+        return;
+    data.swap(vFree.back());
+    vFree.pop_back();
+    nBytes -= data.capacity();
+}
+
+void CNetBufferPool::Release(CSerializeData& data)
+{
+    data.clear();
+    size_t nCapacity = data.capacity();
+    if (nCapacity == 0)
+        return;
+    {
+        LOCK(cs);
+        if (nCapacity <= MAX_POOLED_BUFFER_SIZE && nBytes + nCapacity <= MAX_BUFFER_POOL_BYTES) {
+            vFree.push_back(CSerializeData());
+            vFree.back().swap(data);
+            nBytes += nCapacity;
+            return;
+        }
+    }
+    // No room, free it (this is where the storage gets wiped)
+    CSerializeData().swap(data);
+}
+
 
 
 
@@ -686,6 +748,64 @@ void SocketSendData(CNode *pnode)
 {
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
 
+#ifndef WIN32
+    // Write as many queued messages as the socket takes in one call, each
+    // straight from its own buffer
+    while (it != pnode->vSendMsg.end()) {
+        struct iovec iov[MAX_SEND_IOVECS];
+        int nIov = 0;
+        size_t nQueued = 0;
+        for (std::deque<CSerializeData>::iterator itMsg = it; itMsg != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itMsg, ++nIov) {
+            size_t nOffset = (nIov == 0) ? pnode->nSendOffset : 0;
+            assert(itMsg->size() > nOffset);
+            iov[nIov].iov_base = (void*)&(*itMsg)[nOffset];
+            iov[nIov].iov_len = itMsg->size() - nOffset;
+            nQueued += iov[nIov].iov_len;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIov;
+        ssize_t nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (nBytes > 0) {
+            pnode->nLastSend = GetTime();
+            pnode->nSendBytes += nBytes;
+            pnode->RecordBytesSent(nBytes);
+
+            // Advance over the messages that were sent completely
+            size_t nSent = nBytes;
+            while (nSent > 0) {
+                size_t nRemaining = it->size() - pnode->nSendOffset;
+                if (nSent < nRemaining) {
+                    pnode->nSendOffset += nSent;
+                    break;
+                }
+                nSent -= nRemaining;
+                pnode->nSendOffset = 0;
+                pnode->nSendSize -= it->size();
+                netBufferPool.Release(*it);
+                it++;
+            }
+            if ((size_t)nBytes < nQueued) {
+                // could not send everything; stop sending more
+                break;
+            }
+        } else {
+            if (nBytes < 0) {
+                // error
+                int nErr = WSAGetLastError();
+                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+                {
+                    LogPrintf("socket send error %s\n", NetworkErrorString(nErr));
+                    pnode->CloseSocketDisconnect();
+                }
+            }
+            // couldn't send anything at all
+            break;
+        }
+    }
+#else
     while (it != pnode->vSendMsg.end()) {
         const CSerializeData &data = *it;
         assert(data.size() > pnode->nSendOffset);
@@ -698,6 +818,7 @@ void SocketSendData(CNode *pnode)
             if (pnode->nSendOffset == data.size()) {
                 pnode->nSendOffset = 0;
                 pnode->nSendSize -= data.size();
+                netBufferPool.Release(*it);
                 it++;
             } else {
                 // could not send full message; stop sending more
@@ -717,11 +838,14 @@ void SocketSendData(CNode *pnode)
             break;
         }
     }
+#endif
 
     if (it == pnode->vSendMsg.end()) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
+    size_t nErased = it - pnode->vSendMsg.begin();
+    pnode->nSendPriorityEnd -= std::min(pnode->nSendPriorityEnd, nErased);
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 }
 
@@ -1715,8 +1839,11 @@ void StartNode(boost::thread_group& threadGroup)
     int64_t nStart = GetTimeMillis();
     {
         CAddrDB adb;
-        if (!adb.Read(addrman))
+        if (!adb.Read(addrman)) {
+            // peers.dat is checked only after it was loaded, drop what was read
+            addrman.Clear();
             LogPrintf("Invalid or missing peers.dat; recreating\n");
+        }
     }
     LogPrintf("Loaded %i addresses from peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
@@ -1830,41 +1957,133 @@ void CExplicitNetCleanup::callCleanup()
 
 void RelayTransaction(const CTransaction& tx)
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss.reserve(10000);
-    ss << tx;
-    RelayTransaction(tx, ss);
+    RelayTransaction(MakeTransactionRef(tx));
 }
 
 void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
 {
-    CInv inv(MSG_TX, tx.GetHash());
+    RelayTransaction(MakeTransactionRef(tx), ss);
+}
+
+void RelayTransaction(const CTransactionRef& ptx)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(ss.GetSerializeSize(*ptx));
+    ss << *ptx;
+    RelayTransaction(ptx, ss);
+}
+
+void RelayTransaction(const CTransactionRef& ptx, const CDataStream& ss)
+{
+    CInv inv(MSG_TX, ptx->GetHash());
+
+    // Save original serialized message so newer versions are preserved
+    relayCache.Insert(inv, std::make_shared<const CDataStream>(ss));
+
+    // The peers pick the transaction up from the queue in SendMessages, so
+    // relaying does not touch every node here
+    CRelayQueueEntry entry;
+    entry.nTime = GetTime();
+    entry.inv = inv;
+    entry.tx = ptx;
+
+    LOCK(cs_vRelayQueue);
+    while (!vRelayQueue.empty() && vRelayQueue.front().nTime < entry.nTime - RELAY_QUEUE_EXPIRY)
+        vRelayQueue.pop_front();
+    entry.nSequence = nRelayQueueSequence++;
+    vRelayQueue.push_back(entry);
+}
+
+uint64_t GetRelayQueueSequence()
+{
+    LOCK(cs_vRelayQueue);
+    return nRelayQueueSequence;
+}
+
+void GetRelayQueueSince(uint64_t& nSequence, std::vector<CRelayQueueEntry>& vEntries)
+{
+    LOCK(cs_vRelayQueue);
+    if (!vRelayQueue.empty() && nSequence < nRelayQueueSequence) {
+        // Sequence numbers in the queue are consecutive; entries that
+        // expired before the peer got to them are skipped
+        uint64_t nFirst = vRelayQueue.front().nSequence;
+        size_t nStart = nSequence > nFirst ? nSequence - nFirst : 0;
+        vEntries.insert(vEntries.end(), vRelayQueue.begin() + nStart, vRelayQueue.end());
+    }
+    nSequence = nRelayQueueSequence;
+}
+
+void CNode::PushRelayedInventory()
+{
+    std::vector<CRelayQueueEntry> vEntries;
+    GetRelayQueueSince(nNextRelaySequence, vEntries);
+    if (vEntries.empty() || !fRelayTxes)
+        return;
+
+    std::vector<CInv> vInv;
+    vInv.reserve(vEntries.size());
     {
-        LOCK(cs_mapRelay);
-        // Expire old relay messages
-        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
-        {
-            mapRelay.erase(vRelayExpiration.front().second);
-            vRelayExpiration.pop_front();
+        LOCK(cs_filter);
+        BOOST_FOREACH(const CRelayQueueEntry& entry, vEntries) {
+            if (!pfilter || pfilter->IsRelevantAndUpdate(*entry.tx))
+                vInv.push_back(entry.inv);
         }
+    }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
-        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
+    LOCK(cs_inventory);
+    BOOST_FOREACH(const CInv& inv, vInv) {
+        if (!setInventoryKnown.count(inv))
+            vInventoryToSend.push_back(inv);
     }
-    LOCK(cs_vNodes);
-    BOOST_FOREACH(CNode* pnode, vNodes)
-    {
-        if(!pnode->fRelayTxes)
-            continue;
-        LOCK(pnode->cs_filter);
-        if (pnode->pfilter)
-        {
-            if (pnode->pfilter->IsRelevantAndUpdate(tx))
-                pnode->PushInventory(inv);
-        } else
-            pnode->PushInventory(inv);
+}
+
+CRelayCache::CRelayCache(size_t nMaxBytesIn) : nBytes(0), nMaxBytes(nMaxBytesIn)
+{
+}
+
+void CRelayCache::Expire(int64_t nNow)
+{
+    // Entries are in insertion order, so the oldest go first when over the size limit
+    while (!vExpiration.empty() && (vExpiration.front().first < nNow || nBytes > nMaxBytes)) {
+        std::map<CInv, Entry>::iterator it = mapEntries.find(vExpiration.front().second);
+        if (it != mapEntries.end()) {
+            nBytes -= it->second->size();
+            mapEntries.erase(it);
+        }
+        vExpiration.pop_front();
+    }
+}
+
+void CRelayCache::Insert(const CInv& inv, const Entry& entry)
+{
+    int64_t nNow = GetTime();
+    LOCK(cs);
+    if (mapEntries.insert(std::make_pair(inv, entry)).second) {
+        nBytes += entry->size();
+        vExpiration.push_back(std::make_pair(nNow + RELAY_CACHE_EXPIRY, inv));
     }
+    Expire(nNow);
+}
+
+CRelayCache::Entry CRelayCache::Find(const CInv& inv) const
+{
+    LOCK(cs);
+    std::map<CInv, Entry>::const_iterator it = mapEntries.find(inv);
+    if (it == mapEntries.end())
+        return Entry();
+    return it->second;
+}
+
+size_t CRelayCache::Size() const
+{
+    LOCK(cs);
+    return mapEntries.size();
+}
+
+size_t CRelayCache::Bytes() const
+{
+    LOCK(cs);
+    return nBytes;
 }
 
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
@@ -1913,6 +2132,44 @@ uint64_t CNode::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+static void AddMsgStats(mapMsgCmdStats& mapStats, const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros)
+{
+    // Commands of received messages are chosen by the peer, bound the number of entries
+    mapMsgCmdStats::iterator it = mapStats.find(strCommand);
+    if (it == mapStats.end()) {
+        const std::string strKey = mapStats.size() < MAX_MSG_STATS_COMMANDS ? strCommand : "*other*";
+        it = mapStats.insert(std::make_pair(strKey, CNetMsgStats())).first;
+    }
+    it->second.Add(nBytes, nTimeMicros);
+}
+
+void CNode::RecordMessageSent(const std::string& strCommand, uint64_t nBytes)
+{
+    {
+        LOCK(cs_msgStats);
+        AddMsgStats(mapSendMsgStats, strCommand, nBytes, 0);
+    }
+    LOCK(cs_totalMsgStats);
+    AddMsgStats(mapTotalSendMsgStats, strCommand, nBytes, 0);
+}
+
+void CNode::RecordMessageRecv(const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros)
+{
+    {
+        LOCK(cs_msgStats);
+        AddMsgStats(mapRecvMsgStats, strCommand, nBytes, nTimeMicros);
+    }
+    LOCK(cs_totalMsgStats);
+    AddMsgStats(mapTotalRecvMsgStats, strCommand, nBytes, nTimeMicros);
+}
+
+void CNode::GetTotalMsgStats(mapMsgCmdStats& mapSent, mapMsgCmdStats& mapRecv)
+{
+    LOCK(cs_totalMsgStats);
+    mapSent = mapTotalSendMsgStats;
+    mapRecv = mapTotalRecvMsgStats;
+}
+
 void CNode::Fuzz(int nChance)
 {
     if (!fSuccessfullyConnected) return; // Don't fuzz initial handshake
@@ -1964,30 +2221,33 @@ bool CAddrDB::Write(const CAddrMan& addr)
     GetRandBytes((unsigned char*)&randv, sizeof(randv));
     std::string tmpfn = strprintf("peers.dat.%04x", randv);
 
-    // serialize addresses, checksum data up to that point, then append csum
-    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
-    ssPeers << FLATDATA(Params().MessageStart());
-    ssPeers << addr;
-    uint256 hash = Hash(ssPeers.begin(), ssPeers.end());
-    ssPeers << hash;
-
-    // open output file, and associate with CAutoFile
-    boost::filesystem::path pathAddr = GetDataDir() / "peers.dat";
-    FILE *file = fopen(pathAddr.string().c_str(), "wb");
+    // open temporary output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathAddr.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
-    // Write and commit header, data
+    // serialize addresses straight to the file, checksumming the data on the
+    // way, then append csum
     try {
-        fileout << ssPeers;
+        CHashingWriter<CAutoFile> hashout(&fileout);
+        hashout << FLATDATA(Params().MessageStart());
+        hashout << addr;
+        fileout << hashout.GetHash();
     }
     catch (std::exception &e) {
+        fileout.fclose();
+        boost::filesystem::remove(pathTmp);
         return error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
     FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing peers.dat, if any, with new peers.dat.XXXX
+    if (!RenameOver(pathTmp, pathAddr))
+        return error("%s : Rename-into-place failed", __func__);
+
     return true;
 }
 
@@ -1999,49 +2259,33 @@ bool CAddrDB::Read(CAddrMan& addr)
     if (filein.IsNull())
         return error("%s : Failed to open file %s", __func__, pathAddr.string());
 
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathAddr);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char *)&vchData[0], dataSize);
-        filein >> hashIn;
-    }
-    catch (std::exception &e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-    }
-    filein.fclose();
-
-    CDataStream ssPeers(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssPeers.begin(), ssPeers.end());
-    if (hashIn != hashTmp)
-        return error("%s : Checksum mismatch, data corrupted", __func__);
-
+    // de-serialize straight from the file, hashing the data on the way, so
+    // peers.dat is never held in memory as a whole
+    CHashVerifier<CAutoFile> verifier(&filein);
     unsigned char pchMsgTmp[4];
+    uint256 hashIn;
     try {
         // de-serialize file header (network specific magic number) and ..
-        ssPeers >> FLATDATA(pchMsgTmp);
+        verifier >> FLATDATA(pchMsgTmp);
 
         // ... verify the network matches ours
         if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
             return error("%s : Invalid network magic number", __func__);
 
         // de-serialize address data into one CAddrMan object
-        ssPeers >> addr;
+        verifier >> addr;
+
+        // the checksum follows the data it covers
+        filein >> hashIn;
     }
     catch (std::exception &e) {
         return error("%s : Deserialize or I/O error - %s", __func__, e.what());
     }
 
+    // verify stored checksum matches input data
+    if (hashIn != verifier.GetHash())
+        return error("%s : Checksum mismatch, data corrupted", __func__);
+
     return true;
 }
 
@@ -2072,10 +2316,12 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    nSendPriorityEnd = 0;
     hashContinue = uint256();
     nStartingHeight = -1;
     fGetAddr = false;
     fRelayTxes = false;
+    nNextRelaySequence = GetRelayQueueSequence();
     setInventoryKnown.max_size(SendBufferSize() / 1000);
     pfilter = new CBloomFilter();
     nPingNonceSent = 0;
@@ -2158,6 +2404,7 @@ void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSen
     ENTER_CRITICAL_SECTION(cs_vSend);
     assert(ssSend.size() == 0);
     ssSend << CMessageHeader(Params().MessageStart(), pszCommand, 0);
+    strSendCommand = pszCommand;
     LogPrint("net", "sending: %s ", SanitizeString(pszCommand));
 }
 
@@ -2199,10 +2446,26 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
+    RecordMessageSent(strSendCommand, ssSend.size());
+
+    // When the send buffer backs up, blocks and headers go out ahead of the
+    // queued gossip, behind the message at the front that may be partly sent
+    // and behind earlier blocks and headers to keep their order
+    std::deque<CSerializeData>::iterator itInsert = vSendMsg.end();
+    if (nSendSize >= SendBufferSize() / 2 && (strSendCommand == "block" || strSendCommand == "headers")) {
+        nSendPriorityEnd = std::min(std::max(nSendPriorityEnd, (size_t)1), vSendMsg.size());
+        itInsert = vSendMsg.begin() + nSendPriorityEnd;
+        nSendPriorityEnd++;
+    }
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
+    // Hand the serialized message over to the send queue without copying it,
+    // and continue with a recycled buffer
+    std::deque<CSerializeData>::iterator it = vSendMsg.insert(itInsert, CSerializeData());
+    ssSend.SwapData(*it);
     nSendSize += (*it).size();
+    CSerializeData data;
+    netBufferPool.Acquire(data);
+    ssSend.SwapData(data);
 
     // If write queue empty, attempt "optimistic write"
     if (it == vSendMsg.begin())
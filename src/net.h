@@ -11,6 +11,7 @@
 #include "hash.h"
 #include "limitedmap.h"
 #include "mruset.h"
+#include "primitives/transaction.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
@@ -19,7 +20,10 @@
 #include "uint256.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -60,6 +64,20 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** Largest buffer kept in the network buffer pool */
+static const size_t MAX_POOLED_BUFFER_SIZE = 2 * 1000 * 1000;
+/** Total size of the buffers kept in the network buffer pool */
+static const size_t MAX_BUFFER_POOL_BYTES = 64 * 1000 * 1000;
+/** Maximum number of queued messages written with one sendmsg call */
+static const int MAX_SEND_IOVECS = 64;
+/** Seconds a relayed transaction stays available for getdata */
+static const int64_t RELAY_CACHE_EXPIRY = 15 * 60;
+/** Maximum size of the serialized transactions kept for getdata */
+static const size_t MAX_RELAY_CACHE_BYTES = 50 * 1000 * 1000;
+/** Seconds a relayed transaction waits in the relay queue for the peers to pick it up */
+static const int64_t RELAY_QUEUE_EXPIRY = 60;
+/** Maximum number of distinct commands counted per peer, further ones are counted as "*other*" */
+static const size_t MAX_MSG_STATS_COMMANDS = 64;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
@@ -124,16 +142,14 @@ CAddress GetLocalAddress(const CNetAddr *paddrPeer = NULL);
 
 extern bool fDiscover;
 extern bool fListen;
-extern uint64_t nLocalServices;
+//! Services we offer, may gain bits while running (see NODE_COMPACT_FILTERS)
+extern std::atomic<uint64_t> nLocalServices;
 extern uint64_t nLocalHostNonce;
 extern CAddrMan addrman;
 extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
-extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
-extern CCriticalSection cs_mapRelay;
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
 
 /** Subversion as sent to the P2P network in `version` messages */
@@ -153,6 +169,26 @@ struct LocalServiceInfo {
 extern CCriticalSection cs_mapLocalHost;
 extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost;
 
+/** Traffic and handler time of one message command */
+class CNetMsgStats
+{
+public:
+    uint64_t nMsgs;
+    uint64_t nBytes;
+    int64_t nTimeMicros; //!< Time spent in the handler, received messages only
+
+    CNetMsgStats() : nMsgs(0), nBytes(0), nTimeMicros(0) {}
+
+    void Add(uint64_t nBytesIn, int64_t nTimeMicrosIn)
+    {
+        nMsgs++;
+        nBytes += nBytesIn;
+        nTimeMicros += nTimeMicrosIn;
+    }
+};
+
+typedef std::map<std::string, CNetMsgStats> mapMsgCmdStats;
+
 class CNodeStats
 {
 public:
@@ -172,6 +208,8 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    mapMsgCmdStats mapSendMsgStats;
+    mapMsgCmdStats mapRecvMsgStats;
 };
 
 
@@ -213,8 +251,35 @@ public:
 
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
+
+    /** Give the payload storage back to the buffer pool once the message is processed */
+    void ReleaseBuffer();
+};
+
+/**
+ * Free list of message buffers. Received payloads and sent messages take
+ * their storage from here and return it when done, so the buffers of busy
+ * connections are reused instead of being allocated, zero-filled and wiped
+ * for every message. Only buffers that fall out of the pool are freed.
+ */
+class CNetBufferPool
+{
+private:
+    CCriticalSection cs;
+    std::vector<CSerializeData> vFree;
+    size_t nBytes;
+
+public:
+    CNetBufferPool();
+
+    /** Replace the storage of the empty buffer data by a pooled one, if there is any */
+    void Acquire(CSerializeData& data);
+    /** Keep the storage of data for reuse if the pool has room; data is left empty */
+    void Release(CSerializeData& data);
 };
 
+extern CNetBufferPool netBufferPool;
+
 
 
 
@@ -229,9 +294,11 @@ public:
     CDataStream ssSend;
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
+    size_t nSendPriorityEnd; // vSendMsg entries before this one were moved ahead of bulk gossip
     uint64_t nSendBytes;
     std::deque<CSerializeData> vSendMsg;
     CCriticalSection cs_vSend;
+    std::string strSendCommand; // command of the message being built in ssSend
 
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
@@ -292,6 +359,18 @@ protected:
     // Basic fuzz-testing
     void Fuzz(int nChance); // modifies ssSend
 
+    // Grow ssSend once for the payload instead of doubling it while a block serializes
+    template<typename T>
+    void ReserveMessage(const T& obj)
+    {
+        ssSend.reserve(ssSend.size() + ssSend.GetSerializeSize(obj));
+    }
+
+    void ReserveMessage(const CDataStream& ss)
+    {
+        ssSend.reserve(ssSend.size() + ss.size());
+    }
+
 public:
     uint256 hashContinue;
     int nStartingHeight;
@@ -304,6 +383,8 @@ public:
     bool fSyncingWith;
 
     // inventory based relay
+    //! Next relay queue entry to announce, only used by the message handler thread
+    uint64_t nNextRelaySequence;
     mruset<CInv> setInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     CCriticalSection cs_inventory;
@@ -321,6 +402,11 @@ public:
     // Whether a ping is requested.
     bool fPingQueued;
 
+    // Per command traffic of this peer
+    CCriticalSection cs_msgStats;
+    mapMsgCmdStats mapSendMsgStats;
+    mapMsgCmdStats mapRecvMsgStats;
+
     CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn = "", bool fInboundIn=false);
     ~CNode();
 
@@ -330,6 +416,9 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+    static CCriticalSection cs_totalMsgStats;
+    static mapMsgCmdStats mapTotalSendMsgStats;
+    static mapMsgCmdStats mapTotalRecvMsgStats;
 
     CNode(const CNode&);
     void operator=(const CNode&);
@@ -416,6 +505,9 @@ public:
         }
     }
 
+    /** Queue the transactions relayed since the last call for announcement, in one batch */
+    void PushRelayedInventory();
+
     void AskFor(const CInv& inv);
     void AskForBlock(const CInv& inv);
 
@@ -452,6 +544,7 @@ public:
         try
         {
             BeginMessage(pszCommand);
+            ReserveMessage(a1);
             ssSend << a1;
             EndMessage();
         }
@@ -698,6 +791,12 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    /** Count a message in the per command stats of this peer and of all peers */
+    void RecordMessageSent(const std::string& strCommand, uint64_t nBytes);
+    void RecordMessageRecv(const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros);
+
+    static void GetTotalMsgStats(mapMsgCmdStats& mapSent, mapMsgCmdStats& mapRecv);
 };
 
 class CExplicitNetCleanup
@@ -706,9 +805,60 @@ public:
     static void callCleanup();
 };
 
-class CTransaction;
+/**
+ * Serialized transactions this node announced, kept so that getdata requests
+ * are answered without serializing again. Entries are shared: a reader keeps
+ * its entry alive while pushing it, without holding the cache lock. Entries
+ * expire after RELAY_CACHE_EXPIRY or earlier once the cache exceeds its size.
+ */
+class CRelayCache
+{
+public:
+    typedef std::shared_ptr<const CDataStream> Entry;
+
+private:
+    mutable CCriticalSection cs;
+    std::map<CInv, Entry> mapEntries;
+    std::deque<std::pair<int64_t, CInv> > vExpiration;
+    size_t nBytes;
+    size_t nMaxBytes;
+
+    void Expire(int64_t nNow);
+
+public:
+    CRelayCache(size_t nMaxBytesIn = MAX_RELAY_CACHE_BYTES);
+
+    /** Add an entry, an existing one for the same inventory is kept */
+    void Insert(const CInv& inv, const Entry& entry);
+    /** Returns the entry of inv, or an empty pointer */
+    Entry Find(const CInv& inv) const;
+
+    size_t Size() const;
+    size_t Bytes() const;
+};
+
+extern CRelayCache relayCache;
+
+/** A relayed transaction waiting in the relay queue */
+struct CRelayQueueEntry
+{
+    uint64_t nSequence;
+    int64_t nTime;
+    CInv inv;
+    //! Needed for peers that set a bloom filter
+    CTransactionRef tx;
+};
+
+/** Sequence number the next relayed transaction will get */
+uint64_t GetRelayQueueSequence();
+/** Get the queued transactions from nSequence on, and advance nSequence past them */
+void GetRelayQueueSince(uint64_t& nSequence, std::vector<CRelayQueueEntry>& vEntries);
+
 void RelayTransaction(const CTransaction& tx);
 void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
+/** The same without copying the transaction, the relay queue shares ptx */
+void RelayTransaction(const CTransactionRef& ptx);
+void RelayTransaction(const CTransactionRef& ptx, const CDataStream& ss);
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll=false);    
 void RelayInv(CInv &inv, const int minProtoVersion = MinPeerProtoVersion());
 
@@ -0,0 +1,152 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nodestatedb.h"
+
+#include "dbmanager.h"
+#include "instantx.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "random.h"
+#include "systemnode-payments.h"
+#include "systemnodeman.h"
+
+#include <limits>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+CNodeStateDB* pnodestatedb = NULL;
+
+//! Guards pnodestatedb against a flush racing with shutdown
+static CCriticalSection cs_nodestatedb;
+
+CNodeStateDB::CNodeStateDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CLevelDBWrapper(GetDataDir() / "nodestate", nCacheSize, fMemory, fWipe)
+{
+    nSipK0 = GetRand(std::numeric_limits<uint64_t>::max());
+    nSipK1 = GetRand(std::numeric_limits<uint64_t>::max());
+}
+
+bool CNodeStateDB::EraseObject(const std::string& strName)
+{
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << strName;
+    const std::string strPrefix = ssPrefix.str();
+
+    CLevelDBBatch batch;
+    try {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+        for (pcursor->Seek(strPrefix); pcursor->Valid() && pcursor->key().starts_with(strPrefix); pcursor->Next()) {
+            leveldb::Slice slKey = pcursor->key();
+            batch.Erase(CFlatData((void*)slKey.data(), (void*)(slKey.data() + slKey.size())));
+        }
+        if (!WriteBatch(batch))
+            return error("%s: failed to erase %s", __func__, strName);
+    } catch (const std::exception& e) {
+        return error("%s: failed to erase %s - %s", __func__, strName, e.what());
+    }
+
+    LOCK(cs);
+    mapStored.erase(strName);
+    return true;
+}
+
+/**
+ * Read one object from the database, or from the flat file of earlier
+ * versions if the database has no records of it yet. Objects are read in
+ * parallel, so CheckAndRemove, which looks at the other objects, runs later
+ * in CheckNodeState.
+ */
+template <typename T>
+static void ReadNodeStateObject(T* pobj, const std::string strName, const std::string strFile, bool* pfResult)
+{
+    int64_t nStart = GetTimeMillis();
+
+    bool fFound = false;
+    if (!pnodestatedb->ReadObject(strName, *pobj, fFound)) {
+        // Unreadable records are dropped like a damaged cache file, the state is synced again
+        LogPrintf("Node state of %s is damaged, will try to recreate\n", strName);
+        *pfResult = true;
+        return;
+    }
+
+    if (fFound) {
+        LogPrintf("Loaded %s from node state database  %dms\n", strName, GetTimeMillis() - nStart);
+        *pfResult = true;
+        return;
+    }
+
+    *pfResult = Load(*pobj, strFile, strName, true);
+}
+
+template <typename T>
+static void CheckNodeStateObject(T& obj)
+{
+    obj.CheckAndRemove();
+    LogPrintf("     %s\n", obj.ToString());
+}
+
+bool LoadNodeState()
+{
+    {
+        LOCK(cs_nodestatedb);
+        pnodestatedb = new CNodeStateDB(nNodeStateDBCache << 20);
+    }
+
+    bool fResult[6];
+    boost::thread_group readers;
+    readers.create_thread(boost::bind(&ReadNodeStateObject<CMasternodeMan>, &mnodeman, "MasternodeCache", "mncache.dat", &fResult[0]));
+    readers.create_thread(boost::bind(&ReadNodeStateObject<CSystemnodeMan>, &snodeman, "SystemnodeCache", "sncache.dat", &fResult[1]));
+    readers.create_thread(boost::bind(&ReadNodeStateObject<InstantSend>, &GetInstantSend(), "InstantSend", "ixcache.dat", &fResult[2]));
+    readers.create_thread(boost::bind(&ReadNodeStateObject<CBudgetManager>, &budget, "MasternodeBudget", "budget-v2.dat", &fResult[3]));
+    readers.create_thread(boost::bind(&ReadNodeStateObject<CMasternodePayments>, &masternodePayments, "MasternodePayments", "mnpayments.dat", &fResult[4]));
+    readers.create_thread(boost::bind(&ReadNodeStateObject<CSystemnodePayments>, &systemnodePayments, "SystemnodePayments", "snpayments.dat", &fResult[5]));
+    readers.join_all();
+
+    for (int i = 0; i < 6; i++)
+        if (!fResult[i])
+            return false;
+
+    return true;
+}
+
+void CheckNodeState()
+{
+    // Same order as the sequential load of earlier versions
+    CheckNodeStateObject(mnodeman);
+    CheckNodeStateObject(snodeman);
+    CheckNodeStateObject(GetInstantSend());
+    CheckNodeStateObject(budget);
+    CheckNodeStateObject(masternodePayments);
+    CheckNodeStateObject(systemnodePayments);
+}
+
+void FlushNodeState()
+{
+    LOCK(cs_nodestatedb);
+    if (pnodestatedb == NULL)
+        return;
+
+    try {
+        pnodestatedb->WriteObject("MasternodeCache", mnodeman);
+        pnodestatedb->WriteObject("SystemnodeCache", snodeman);
+        pnodestatedb->WriteObject("InstantSend", GetInstantSend());
+        pnodestatedb->WriteObject("MasternodeBudget", budget);
+        pnodestatedb->WriteObject("MasternodePayments", masternodePayments);
+        pnodestatedb->WriteObject("SystemnodePayments", systemnodePayments);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+}
+
+void CloseNodeState()
+{
+    FlushNodeState();
+
+    LOCK(cs_nodestatedb);
+    delete pnodestatedb;
+    pnodestatedb = NULL;
+}
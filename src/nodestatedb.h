@@ -0,0 +1,289 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NODE_STATE_DB_H
+#define NODE_STATE_DB_H
+
+#include "hash.h"
+#include "leveldbwrapper.h"
+#include "streams.h"
+#include "sync.h"
+#include "util.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+/** Seconds between two flushes of the masternode, systemnode, budget, payment and InstantSend state */
+static const int NODE_STATE_FLUSH_INTERVAL = 60;
+//! Cache of the node state database (MiB)
+static const int64_t nNodeStateDBCache = 8;
+
+/** Field id followed by the serialized key of the map entry or index of the vector element */
+typedef std::vector<unsigned char> NodeStateRecordKey;
+/** Hash of each stored record of one object, by key */
+typedef std::map<NodeStateRecordKey, uint64_t> NodeStateRecordHashes;
+
+/**
+ * Collects the records of an object for CNodeStateDB. Objects list their
+ * fields in RecordsOp(), the same way for reading and writing:
+ *
+ *   template <typename Records>
+ *   void RecordsOp(Records& r) { LOCK(cs); r.Map('s', mapSeen); r.Value('n', nCount); }
+ *
+ * Only records whose serialization changed since the last write are added
+ * to the batch, records that are gone are erased. ForRead() tells objects
+ * that rebuild derived state after a read which side they are on.
+ */
+class CNodeStateWriter
+{
+private:
+    const std::string strName;
+    const NodeStateRecordHashes& mapStored;
+    NodeStateRecordHashes mapHashes;
+    CLevelDBBatch& batch;
+    uint64_t nSipK0;
+    uint64_t nSipK1;
+    unsigned int nWritten;
+
+    template <typename V>
+    void Record(const CDataStream& ssKey, const V& value)
+    {
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << value;
+        uint64_t nHash = CSipHasher(nSipK0, nSipK1).Write((const unsigned char*)&ssValue[0], ssValue.size()).Finalize();
+
+        NodeStateRecordKey key(ssKey.begin(), ssKey.end());
+        NodeStateRecordHashes::const_iterator it = mapStored.find(key);
+        if (it == mapStored.end() || it->second != nHash) {
+            batch.Write(std::make_pair(strName, key), value);
+            nWritten++;
+        }
+        mapHashes.insert(std::make_pair(key, nHash));
+    }
+
+public:
+    CNodeStateWriter(const std::string& strNameIn, const NodeStateRecordHashes& mapStoredIn, CLevelDBBatch& batchIn, uint64_t nSipK0In, uint64_t nSipK1In) :
+        strName(strNameIn), mapStored(mapStoredIn), batch(batchIn), nSipK0(nSipK0In), nSipK1(nSipK1In), nWritten(0) {}
+
+    template <typename K, typename V>
+    void Map(char chField, const std::map<K, V>& m)
+    {
+        for (typename std::map<K, V>::const_iterator it = m.begin(); it != m.end(); ++it) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey << chField << it->first;
+            Record(ssKey, it->second);
+        }
+    }
+
+    template <typename V>
+    void Vector(char chField, const std::vector<V>& v)
+    {
+        for (uint32_t i = 0; i < v.size(); i++) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey << chField << i;
+            Record(ssKey, v[i]);
+        }
+    }
+
+    template <typename T>
+    void Value(char chField, const T& obj)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << chField;
+        Record(ssKey, obj);
+    }
+
+    /** Erase the stored records that were not listed, returns the hashes of all listed records */
+    const NodeStateRecordHashes& Finish(unsigned int& nErased)
+    {
+        nErased = 0;
+        for (NodeStateRecordHashes::const_iterator it = mapStored.begin(); it != mapStored.end(); ++it) {
+            if (!mapHashes.count(it->first)) {
+                batch.Erase(std::make_pair(strName, it->first));
+                nErased++;
+            }
+        }
+        return mapHashes;
+    }
+
+    unsigned int GetWritten() const { return nWritten; }
+
+    static bool ForRead() { return false; }
+};
+
+/** Rebuilds an object from its records, see CNodeStateWriter */
+class CNodeStateReader
+{
+public:
+    typedef std::pair<NodeStateRecordKey, std::vector<char> > Record;
+
+    static bool ForRead() { return true; }
+
+private:
+    std::map<char, std::vector<Record> > mapFields;
+
+public:
+    void Add(const NodeStateRecordKey& key, const char* pValue, size_t nValueSize)
+    {
+        if (key.empty())
+            return;
+        mapFields[(char)key[0]].push_back(std::make_pair(key, std::vector<char>(pValue, pValue + nValueSize)));
+    }
+
+    template <typename K, typename V>
+    void Map(char chField, std::map<K, V>& m)
+    {
+        const std::vector<Record>& vRecords = mapFields[chField];
+        for (size_t i = 0; i < vRecords.size(); i++) {
+            CDataStream ssKey(vRecords[i].first, SER_DISK, CLIENT_VERSION);
+            char chFieldRecord;
+            ssKey >> chFieldRecord;
+            CDataStream ssValue(vRecords[i].second, SER_DISK, CLIENT_VERSION);
+            K key;
+            ssKey >> key;
+            ssValue >> m[key];
+        }
+    }
+
+    template <typename V>
+    void Vector(char chField, std::vector<V>& v)
+    {
+        const std::vector<Record>& vRecords = mapFields[chField];
+        std::vector<std::pair<uint32_t, size_t> > vIndex;
+        for (size_t i = 0; i < vRecords.size(); i++) {
+            CDataStream ssKey(vRecords[i].first, SER_DISK, CLIENT_VERSION);
+            char chFieldRecord;
+            ssKey >> chFieldRecord;
+            uint32_t nIndex;
+            ssKey >> nIndex;
+            vIndex.push_back(std::make_pair(nIndex, i));
+        }
+        std::sort(vIndex.begin(), vIndex.end());
+
+        v.clear();
+        v.resize(vIndex.size());
+        for (size_t i = 0; i < vIndex.size(); i++) {
+            const Record& record = vRecords[vIndex[i].second];
+            CDataStream ssValue(record.second, SER_DISK, CLIENT_VERSION);
+            ssValue >> v[i];
+        }
+    }
+
+    template <typename T>
+    void Value(char chField, T& obj)
+    {
+        const std::vector<Record>& vRecords = mapFields[chField];
+        if (vRecords.empty())
+            return;
+        CDataStream ssValue(vRecords[0].second, SER_DISK, CLIENT_VERSION);
+        ssValue >> obj;
+    }
+};
+
+/**
+ * Masternode, systemnode, budget, payment and InstantSend state, one record
+ * per map entry or vector element, keyed by object name and field. Replaces
+ * the flat files that were read and written whole on startup and shutdown:
+ * the state is flushed every NODE_STATE_FLUSH_INTERVAL seconds, each flush
+ * only writes what changed, and the objects are loaded in parallel.
+ */
+class CNodeStateDB : public CLevelDBWrapper
+{
+private:
+    CCriticalSection cs;
+    //! Hashes of the stored records, by object name
+    std::map<std::string, NodeStateRecordHashes> mapStored;
+    uint64_t nSipK0;
+    uint64_t nSipK1;
+
+    CNodeStateDB(const CNodeStateDB&);
+    void operator=(const CNodeStateDB&);
+
+public:
+    CNodeStateDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Erase all records of an object, also those that cannot be decoded */
+    bool EraseObject(const std::string& strName);
+
+    /** Load an object from its records, fFound is false if there are none */
+    template <typename T>
+    bool ReadObject(const std::string& strName, T& obj, bool& fFound)
+    {
+        CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+        ssPrefix << strName;
+        const std::string strPrefix = ssPrefix.str();
+
+        CNodeStateReader reader;
+        NodeStateRecordHashes mapHashes;
+        fFound = false;
+        try {
+            boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+            for (pcursor->Seek(strPrefix); pcursor->Valid() && pcursor->key().starts_with(strPrefix); pcursor->Next()) {
+                leveldb::Slice slKey = pcursor->key();
+                leveldb::Slice slValue = pcursor->value();
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                std::pair<std::string, NodeStateRecordKey> key;
+                ssKey >> key;
+
+                reader.Add(key.second, slValue.data(), slValue.size());
+                mapHashes[key.second] = CSipHasher(nSipK0, nSipK1).Write((const unsigned char*)slValue.data(), slValue.size()).Finalize();
+                fFound = true;
+            }
+            obj.RecordsOp(reader);
+        } catch (const std::exception& e) {
+            obj.Clear();
+            // Writes only erase records they know of, left behind these would be read again on every start
+            EraseObject(strName);
+            return error("%s: failed to load %s - %s", __func__, strName, e.what());
+        }
+
+        LOCK(cs);
+        mapStored[strName].swap(mapHashes);
+        return true;
+    }
+
+    /** Write the records of an object that changed since the last write */
+    template <typename T>
+    bool WriteObject(const std::string& strName, T& obj)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        LOCK(cs);
+        NodeStateRecordHashes& mapHashes = mapStored[strName];
+        CLevelDBBatch batch;
+        CNodeStateWriter writer(strName, mapHashes, batch, nSipK0, nSipK1);
+        obj.RecordsOp(writer);
+        unsigned int nErased;
+        NodeStateRecordHashes mapHashesNew = writer.Finish(nErased);
+        if (!WriteBatch(batch))
+            return error("%s: failed to write %s", __func__, strName);
+        mapHashes.swap(mapHashesNew);
+
+        LogPrint("masternode", "%s: %s, %u records written, %u erased, %u total  %dms\n", __func__,
+            strName, writer.GetWritten(), nErased, mapHashes.size(), GetTimeMillis() - nStart);
+        return true;
+    }
+};
+
+/** Global node state database, opened by LoadNodeState */
+extern CNodeStateDB* pnodestatedb;
+
+/** Open the node state database and load all objects, migrating the flat files of earlier versions */
+bool LoadNodeState();
+
+/** Drop what became invalid in the loaded objects, needs the block chain */
+void CheckNodeState();
+
+/** Write the state that changed since the last flush */
+void FlushNodeState();
+
+/** Flush and close the node state database */
+void CloseNodeState();
+
+#endif
@@ -0,0 +1,180 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PAYMENTVOTES_H
+#define PAYMENTVOTES_H
+
+#include "script/script.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
+
+/** Heights of payment votes kept by the masternode and systemnode payments, must exceed the expiry limit */
+static const int PAYMENT_VOTE_WINDOW = 8192;
+
+/**
+ * Payee tallies of a window of heights in a ring buffer indexed by height,
+ * for the masternode and systemnode payment votes. Each slot holds the tally
+ * of one height and the hashes of the votes counted in it, so a height
+ * expires in one step. A reverse index gives the heights each payee leads,
+ * which is what IsScheduled asks for. Not thread safe, the owner locks.
+ */
+template <typename BlockPayees>
+class CPaymentVoteWindow
+{
+private:
+    struct Slot
+    {
+        //! nBlockHeight is 0 while the slot is empty
+        BlockPayees payees;
+        CScript leader;
+        std::vector<uint256> vVotes;
+    };
+
+    std::vector<Slot> vSlots;
+    std::map<CScript, std::set<int> > mapLeaderHeights;
+    //! No height below this one has a slot
+    int nOldest;
+    int nNewest;
+    size_t nHeights;
+
+    Slot& At(int nHeight) { return vSlots[nHeight % vSlots.size()]; }
+
+    void SetLeader(Slot& slot, int nHeight, bool fHadLeader)
+    {
+        CScript leader;
+        slot.payees.GetPayee(leader);
+        if (fHadLeader && leader == slot.leader)
+            return;
+        if (fHadLeader) {
+            std::map<CScript, std::set<int> >::iterator it = mapLeaderHeights.find(slot.leader);
+            it->second.erase(nHeight);
+            if (it->second.empty())
+                mapLeaderHeights.erase(it);
+        }
+        mapLeaderHeights[leader].insert(nHeight);
+        slot.leader = leader;
+    }
+
+    void Release(Slot& slot, std::vector<uint256>& vExpired)
+    {
+        int nHeight = slot.payees.nBlockHeight;
+        if (nHeight == 0)
+            return;
+        std::map<CScript, std::set<int> >::iterator it = mapLeaderHeights.find(slot.leader);
+        if (it != mapLeaderHeights.end()) {
+            it->second.erase(nHeight);
+            if (it->second.empty())
+                mapLeaderHeights.erase(it);
+        }
+        vExpired.insert(vExpired.end(), slot.vVotes.begin(), slot.vVotes.end());
+        slot = Slot();
+        nHeights--;
+    }
+
+public:
+    explicit CPaymentVoteWindow(int nSize = PAYMENT_VOTE_WINDOW) : vSlots(nSize)
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        std::fill(vSlots.begin(), vSlots.end(), Slot());
+        mapLeaderHeights.clear();
+        nOldest = std::numeric_limits<int>::max();
+        nNewest = 0;
+        nHeights = 0;
+    }
+
+    /**
+     * Count a vote for payee at nHeight. A height that held the slot
+     * before is dropped and its votes are added to vExpired, a vote for a
+     * height older than the one in its slot is refused.
+     */
+    bool AddVote(int nHeight, const uint256& hash, const CScript& payee, int nVotes, std::vector<uint256>& vExpired)
+    {
+        if (nHeight <= 0)
+            return false;
+        Slot& slot = At(nHeight);
+        if (slot.payees.nBlockHeight > nHeight)
+            return false;
+        if (slot.payees.nBlockHeight != nHeight) {
+            Release(slot, vExpired);
+            slot.payees = BlockPayees(nHeight);
+            nHeights++;
+            nOldest = std::min(nOldest, nHeight);
+            nNewest = std::max(nNewest, nHeight);
+        }
+
+        bool fHadLeader = !slot.vVotes.empty();
+        slot.vVotes.push_back(hash);
+        slot.payees.AddPayee(payee, nVotes);
+        SetLeader(slot, nHeight, fHadLeader);
+        return true;
+    }
+
+    /** Drop all heights below nHeight, the hashes of their votes are added to vExpired */
+    void ExpireBelow(int nHeight, std::vector<uint256>& vExpired)
+    {
+        int64_t nSteps = std::min((int64_t)nHeight - nOldest, (int64_t)vSlots.size());
+        for (int64_t i = 0; i < nSteps; i++) {
+            Slot& slot = At(nOldest + i);
+            if (slot.payees.nBlockHeight < nHeight)
+                Release(slot, vExpired);
+        }
+        if (nSteps > 0)
+            nOldest = nHeight;
+    }
+
+    /** Tally of nHeight, NULL if there are no votes for it */
+    BlockPayees* Get(int nHeight)
+    {
+        if (nHeight <= 0)
+            return NULL;
+        Slot& slot = At(nHeight);
+        return slot.payees.nBlockHeight == nHeight ? &slot.payees : NULL;
+    }
+
+    /** Hashes of the votes counted for nHeight, NULL if there are none */
+    const std::vector<uint256>* GetVotes(int nHeight)
+    {
+        if (nHeight <= 0)
+            return NULL;
+        Slot& slot = At(nHeight);
+        return slot.payees.nBlockHeight == nHeight ? &slot.vVotes : NULL;
+    }
+
+    /** Whether payee has the most votes at a height from nFrom to nTo other than nNotHeight */
+    bool IsLeading(const CScript& payee, int nFrom, int nTo, int nNotHeight) const
+    {
+        std::map<CScript, std::set<int> >::const_iterator it = mapLeaderHeights.find(payee);
+        if (it == mapLeaderHeights.end())
+            return false;
+        for (std::set<int>::const_iterator h = it->second.lower_bound(nFrom); h != it->second.end() && *h <= nTo; ++h)
+            if (*h != nNotHeight)
+                return true;
+        return false;
+    }
+
+    int GetOldest()
+    {
+        for (int64_t nHeight = std::max(nOldest, nNewest - (int)vSlots.size() + 1); nHeight <= nNewest; nHeight++)
+            if (Get(nHeight))
+                return nHeight;
+        return std::numeric_limits<int>::max();
+    }
+
+    int GetNewest() const { return nHeights ? nNewest : 0; }
+
+    size_t size() const { return nHeights; }
+};
+
+#endif // PAYMENTVOTES_H
@@ -84,6 +84,9 @@ class CBlock : public CBlockHeader
 {
 public:
     // network and disk
+    // ***TODO*** hold CTransactionRef like the mempool does, so that block
+    // deserialization, CreateNewBlock/UpdateBlockTemplate and the wallet's
+    // SyncTransaction share transactions instead of copying them
     std::vector<CTransaction> vtx;
     std::vector<unsigned char> vchBlockSig;
     StakePointer stakePointer;
@@ -98,11 +98,22 @@ std::string CMutableTransaction::ToString() const
 void CTransaction::UpdateHash() const
 {
     *const_cast<uint256*>(&hash) = SerializeHash(*this);
+    *const_cast<unsigned int*>(&nSerializeSize) = ComputeSerializeSize();
 }
 
-CTransaction::CTransaction() : nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), vin(), vout(), nLockTime(0) { }
+unsigned int CTransaction::ComputeSerializeSize() const
+{
+    // The serialization does not depend on the stream type or version
+    CSizeComputer s(SER_NETWORK, PROTOCOL_VERSION);
+    NCONST_PTR(this)->SerializationOp(s, CSerActionSerialize(), SER_NETWORK, PROTOCOL_VERSION);
+    return s.size();
+}
+
+CTransaction::CTransaction() : nSerializeSize(0), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), vin(), vout(), nLockTime(0) {
+    *const_cast<unsigned int*>(&nSerializeSize) = ComputeSerializeSize();
+}
 
-CTransaction::CTransaction(const CMutableTransaction &tx) : nVersion(tx.nVersion), nType(tx.nType), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload) {
+CTransaction::CTransaction(const CMutableTransaction &tx) : nSerializeSize(0), nVersion(tx.nVersion), nType(tx.nType), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime), extraPayload(tx.extraPayload) {
     UpdateHash();
 }
 
@@ -113,6 +124,7 @@ CTransaction& CTransaction::operator=(const CTransaction &tx) {
     *const_cast<std::vector<CTxOut>*>(&vout) = tx.vout;
     *const_cast<unsigned int*>(&nLockTime) = tx.nLockTime;
     *const_cast<uint256*>(&hash) = tx.hash;
+    *const_cast<unsigned int*>(&nSerializeSize) = tx.nSerializeSize;
     *const_cast<std::vector<uint8_t>*>(&extraPayload) = tx.extraPayload;
     return *this;
 }
@@ -11,6 +11,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <memory>
+
 /** Transaction types */
 enum TxType : int16_t
 {
@@ -207,7 +209,10 @@ class CTransaction
 private:
     /** Memory only. */
     const uint256 hash;
+    //! Serialized size, kept with the hash so sizing a block does not walk every script
+    const unsigned int nSerializeSize;
     void UpdateHash() const;
+    unsigned int ComputeSerializeSize() const;
 
 public:
     static const int32_t CURRENT_VERSION=1;
@@ -233,7 +238,21 @@ public:
 
     CTransaction& operator=(const CTransaction& tx);
 
-    ADD_SERIALIZE_METHODS;
+    // ADD_SERIALIZE_METHODS, with the size served from the cache
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return nSerializeSize;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        NCONST_PTR(this)->SerializationOp(s, CSerActionSerialize(), nType, nVersion);
+    }
+    void Serialize(CSizeComputer& s, int nType, int nVersion) const {
+        s.seek(nSerializeSize);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        SerializationOp(s, CSerActionUnserialize(), nType, nVersion);
+    }
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
@@ -339,4 +358,13 @@ struct CMutableTransaction
 
 };
 
+/**
+ * A transaction shared between the mempool, relay, orphan and InstantSend
+ * maps. It is immutable, so passing it on costs a reference count instead of
+ * copying inputs, outputs and scripts.
+ */
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
+template <typename Tx> static inline CTransactionRef MakeTransactionRef(const Tx& tx) { return std::make_shared<const CTransaction>(tx); }
+
 #endif // BITCOIN_PRIMITIVES_TRANSACTION_H
@@ -68,6 +68,9 @@ public:
 /** nServices flags */
 enum {
     NODE_NETWORK = (1 << 0),
+    // NODE_COMPACT_FILTERS means the node serves BIP 157 compact block filters
+    // (getcfilters, getcfheaders, getcfcheckpt) of the basic type.
+    NODE_COMPACT_FILTERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
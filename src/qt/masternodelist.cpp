@@ -19,11 +19,11 @@
 #include "transactiontablemodel.h"
 #include "optionsmodel.h"
 #include "startmissingdialog.h"
+#include "nodetablemodel.h"
 
 #include <QTimer>
 #include <QMessageBox>
-
-CCriticalSection cs_masternodes;
+#include <QSortFilterProxyModel>
 
 MasternodeList::MasternodeList(QWidget *parent) :
     QWidget(parent),
@@ -51,11 +51,19 @@ MasternodeList::MasternodeList(QWidget *parent) :
     ui->tableWidgetMyMasternodes->setColumnWidth(4, columnActiveWidth);
     ui->tableWidgetMyMasternodes->setColumnWidth(5, columnLastSeenWidth);
 
-    ui->tableWidgetMasternodes->setColumnWidth(0, columnAddressWidth);
-    ui->tableWidgetMasternodes->setColumnWidth(1, columnProtocolWidth);
-    ui->tableWidgetMasternodes->setColumnWidth(2, columnStatusWidth);
-    ui->tableWidgetMasternodes->setColumnWidth(3, columnActiveWidth);
-    ui->tableWidgetMasternodes->setColumnWidth(4, columnLastSeenWidth);
+    nodeModel = new NodeTableModel(NodeTableModel::MASTERNODE, this);
+    nodeProxyModel = new QSortFilterProxyModel(this);
+    nodeProxyModel->setSourceModel(nodeModel);
+    nodeProxyModel->setSortRole(NodeTableModel::SortRole);
+    nodeProxyModel->setFilterKeyColumn(-1);
+    nodeProxyModel->setDynamicSortFilter(true);
+    ui->tableViewMasternodes->setModel(nodeProxyModel);
+
+    ui->tableViewMasternodes->setColumnWidth(0, columnAddressWidth);
+    ui->tableViewMasternodes->setColumnWidth(1, columnProtocolWidth);
+    ui->tableViewMasternodes->setColumnWidth(2, columnStatusWidth);
+    ui->tableViewMasternodes->setColumnWidth(3, columnActiveWidth);
+    ui->tableViewMasternodes->setColumnWidth(4, columnLastSeenWidth);
 
     ui->tableWidgetMyMasternodes->setContextMenuPolicy(Qt::CustomContextMenu);
 
@@ -250,7 +258,6 @@ void MasternodeList::updateMyNodeList(bool reset) {
     if(timeTillUpdate > 0 && !reset) return;
     lastMyListUpdate = GetTime();
 
-    ui->tableWidgetMasternodes->setSortingEnabled(false);
     BOOST_FOREACH(CNodeEntry mne, masternodeConfig.getEntries()) {
         CTxIn vin = CTxIn(uint256S(mne.getTxHash()), uint32_t(atoi(mne.getOutputIndex().c_str())));
         CMasternode *pmn = mnodeman.Find(vin);
@@ -258,7 +265,6 @@ void MasternodeList::updateMyNodeList(bool reset) {
         updateMyMasternodeInfo(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), QString::fromStdString(mne.getPrivKey()), QString::fromStdString(mne.getTxHash()),
             QString::fromStdString(mne.getOutputIndex()), pmn);
     }
-    ui->tableWidgetMasternodes->setSortingEnabled(true);
 
     // reset "timer"
     ui->secondsLabel->setText("0");
@@ -266,65 +272,19 @@ void MasternodeList::updateMyNodeList(bool reset) {
 
 void MasternodeList::updateNodeList()
 {
-    static int64_t nTimeListUpdate = 0;
-
-      // to prevent high cpu usage update only once in MASTERNODELIST_UPDATE_SECONDS secondsLabel
-      // or MASTERNODELIST_FILTER_COOLDOWN_SECONDS seconds after filter was last changed
-      int64_t nTimeToWait =   fFilterUpdated
-                              ? nTimeFilterUpdate - GetTime() + MASTERNODELIST_FILTER_COOLDOWN_SECONDS
-                              : nTimeListUpdate - GetTime() + MASTERNODELIST_UPDATE_SECONDS;
-
-    if(fFilterUpdated) ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nTimeToWait)));
-    if(nTimeToWait > 0) return;
-
-    nTimeListUpdate = GetTime();
-    fFilterUpdated = false;
-
-    TRY_LOCK(cs_masternodes, lockMasternodes);
-    if(!lockMasternodes)
-        return;
-
-    QString strToFilter;
-    ui->countLabel->setText("Updating...");
-    ui->tableWidgetMasternodes->setSortingEnabled(false);
-    ui->tableWidgetMasternodes->clearContents();
-    ui->tableWidgetMasternodes->setRowCount(0);
-    std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
-
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
+    // The list itself is kept up to date by nodeModel; only apply a changed
+    // filter MASTERNODELIST_FILTER_COOLDOWN_SECONDS seconds after it was last edited
+    if(fFilterUpdated)
     {
-        // populate list
-        // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.protocolVersion));
-        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(mn.Status()));
-        DateTableWidgetItem *activeSecondsItem = new DateTableWidgetItem(mn.lastPing.sigTime - mn.sigTime);
-        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime)));
-        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubkey.GetID()).ToString()));
-
-        if (strCurrentFilter != "")
-        {
-            strToFilter =   addressItem->text() + " " +
-                            protocolItem->text() + " " +
-                            statusItem->text() + " " +
-                            activeSecondsItem->text() + " " +
-                            lastSeenItem->text() + " " +
-                            pubkeyItem->text();
-            if (!strToFilter.contains(strCurrentFilter)) continue;
-        }
+        int64_t nTimeToWait = nTimeFilterUpdate - GetTime() + MASTERNODELIST_FILTER_COOLDOWN_SECONDS;
+        ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nTimeToWait)));
+        if(nTimeToWait > 0) return;
 
-        ui->tableWidgetMasternodes->insertRow(0);
-        ui->tableWidgetMasternodes->setItem(0, 0, addressItem);
-        ui->tableWidgetMasternodes->setItem(0, 1, protocolItem);
-        ui->tableWidgetMasternodes->setItem(0, 2, statusItem);
-        ui->tableWidgetMasternodes->setItem(0, 3, activeSecondsItem);
-        ui->tableWidgetMasternodes->setItem(0, 4, lastSeenItem);
-        ui->tableWidgetMasternodes->setItem(0, 5, pubkeyItem);
+        fFilterUpdated = false;
+        nodeProxyModel->setFilterFixedString(strCurrentFilter);
     }
 
-    ui->countLabel->setText(QString::number(ui->tableWidgetMasternodes->rowCount()));
-    ui->tableWidgetMasternodes->setSortingEnabled(true);
-
+    ui->countLabel->setText(QString::number(nodeProxyModel->rowCount()));
 }
 
 void MasternodeList::updateNextSuperblock()
@@ -595,7 +555,7 @@ void MasternodeList::updateVoteList(bool reset)
             ui->tableWidgetVoting->setItem(0, 12, monthlyPaymentItem);
 
             std::string projected;
-            if ((int64_t)pbudgetProposal->GetYeas() - (int64_t)pbudgetProposal->GetNays() > (ui->tableWidgetMasternodes->rowCount()/10)){
+            if ((int64_t)pbudgetProposal->GetYeas() - (int64_t)pbudgetProposal->GetNays() > (nodeModel->rowCount(QModelIndex())/10)){
                 nTotalAllotted += pbudgetProposal->GetAmount()/100000000;
                 projected = "Yes";
             } else {
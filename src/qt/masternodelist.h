@@ -10,7 +10,6 @@
 #include <QTimer>
 #include <QWidget>
 
-#define MASTERNODELIST_UPDATE_SECONDS            60
 #define MY_MASTERNODELIST_UPDATE_SECONDS         15
 #define MASTERNODELIST_FILTER_COOLDOWN_SECONDS   3
 
@@ -19,10 +18,12 @@ namespace Ui {
 }
 
 class ClientModel;
+class NodeTableModel;
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
 class QModelIndex;
+class QSortFilterProxyModel;
 QT_END_NAMESPACE
 
 /** Masternode Manager page widget */
@@ -64,6 +65,8 @@ private:
     ClientModel *clientModel;
     WalletModel *walletModel;
     SendCollateralDialog *sendDialog;
+    NodeTableModel *nodeModel;
+    QSortFilterProxyModel *nodeProxyModel;
     CCriticalSection cs_mnlistupdate;
     QString strCurrentFilter;
 
@@ -0,0 +1,271 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nodetablemodel.h"
+
+#include "base58.h"
+#include "masternodeman.h"
+#include "sync.h"
+#include "systemnodeman.h"
+#include "ui_interface.h"
+#include "utiltime.h"
+
+#include <set>
+
+#include <QDebug>
+#include <QList>
+
+#include <boost/bind.hpp>
+
+struct NodeTableEntry
+{
+    COutPoint outpoint;
+    QString address;
+    int protocol;
+    QString status;
+    int64_t activeSeconds;
+    int64_t lastSeen;
+    QString pubkey;
+};
+
+// Comparison operator for binary search of the (outpoint sorted) row list
+struct NodeTableEntryLessThan
+{
+    bool operator()(const NodeTableEntry &a, const COutPoint &b) const
+    {
+        return a.outpoint < b;
+    }
+    bool operator()(const COutPoint &a, const NodeTableEntry &b) const
+    {
+        return a < b.outpoint;
+    }
+};
+
+// CMasternode and CSystemnode share the fields shown in the list
+template <typename T>
+static void FillEntry(NodeTableEntry &entry, const T &node)
+{
+    entry.outpoint = node.vin.prevout;
+    entry.address = QString::fromStdString(node.addr.ToString());
+    entry.protocol = node.protocolVersion;
+    entry.status = QString::fromStdString(node.Status());
+    entry.activeSeconds = node.lastPing.sigTime - node.sigTime;
+    entry.lastSeen = node.lastPing.sigTime;
+    entry.pubkey = QString::fromStdString(CBitcoinAddress(node.pubkey.GetID()).ToString());
+}
+
+// Private implementation
+class NodeTablePriv
+{
+public:
+    NodeTablePriv(NodeTableModel *parent) :
+        parent(parent),
+        fPosted(false)
+    {
+    }
+
+    NodeTableModel *parent;
+
+    /** Rows, sorted by collateral outpoint */
+    QList<NodeTableEntry> cachedNodes;
+
+    /** Nodes changed since they were last read, filled from core threads */
+    CCriticalSection cs_pending;
+    std::set<COutPoint> setPending;
+    bool fPosted;
+
+    void queueChange(const COutPoint &outpoint)
+    {
+        {
+            LOCK(cs_pending);
+            setPending.insert(outpoint);
+            if (fPosted)
+                return;
+            fPosted = true;
+        }
+        QMetaObject::invokeMethod(parent, "processPendingChanges", Qt::QueuedConnection);
+    }
+
+    /** Read the current state of one node from its manager */
+    bool readNode(const COutPoint &outpoint, NodeTableEntry &entry)
+    {
+        if (parent->type == NodeTableModel::MASTERNODE) {
+            CMasternode mn;
+            if (!mnodeman.Get(CTxIn(outpoint), mn))
+                return false;
+            FillEntry(entry, mn);
+        } else {
+            CSystemnode sn;
+            if (!snodeman.Get(CTxIn(outpoint), sn))
+                return false;
+            FillEntry(entry, sn);
+        }
+        return true;
+    }
+
+    /** Bring the row of one node in line with its manager: insert, update or remove it */
+    void updateNode(const COutPoint &outpoint)
+    {
+        QList<NodeTableEntry>::iterator lower = qLowerBound(
+            cachedNodes.begin(), cachedNodes.end(), outpoint, NodeTableEntryLessThan());
+        int idx = (lower - cachedNodes.begin());
+        bool inModel = (lower != cachedNodes.end() && lower->outpoint == outpoint);
+
+        NodeTableEntry entry;
+        if (!readNode(outpoint, entry)) {
+            if (inModel) {
+                parent->beginRemoveRows(QModelIndex(), idx, idx);
+                cachedNodes.erase(lower);
+                parent->endRemoveRows();
+            }
+            return;
+        }
+
+        if (inModel) {
+            *lower = entry;
+            Q_EMIT parent->dataChanged(parent->index(idx, 0), parent->index(idx, parent->columns.size() - 1));
+        } else {
+            parent->beginInsertRows(QModelIndex(), idx, idx);
+            cachedNodes.insert(idx, entry);
+            parent->endInsertRows();
+        }
+    }
+
+    /** Apply up to NODE_TABLE_UPDATE_BATCH queued changes, returns false if more remain */
+    bool processPending()
+    {
+        std::vector<COutPoint> vBatch;
+        bool fDone;
+        {
+            LOCK(cs_pending);
+            while (!setPending.empty() && vBatch.size() < (size_t)NODE_TABLE_UPDATE_BATCH) {
+                vBatch.push_back(*setPending.begin());
+                setPending.erase(setPending.begin());
+            }
+            fDone = setPending.empty();
+            if (fDone)
+                fPosted = false;
+        }
+        for (size_t i = 0; i < vBatch.size(); ++i)
+            updateNode(vBatch[i]);
+        return fDone;
+    }
+};
+
+NodeTableModel::NodeTableModel(NodeType type, QObject *parent) :
+    QAbstractTableModel(parent),
+    type(type),
+    priv(new NodeTablePriv(this))
+{
+    columns << tr("Address") << tr("Protocol") << tr("Status") << tr("Active") << tr("Last Seen (UTC)") << tr("Pubkey");
+
+    // Subscribe before reading the initial set so that no change is missed;
+    // a node queued twice is simply read twice.
+    subscribeToCoreSignals();
+
+    std::vector<CTxIn> vVins = (type == MASTERNODE) ? mnodeman.GetMasternodeVins() : snodeman.GetSystemnodeVins();
+    for (size_t i = 0; i < vVins.size(); ++i)
+        priv->queueChange(vVins[i].prevout);
+}
+
+NodeTableModel::~NodeTableModel()
+{
+    unsubscribeFromCoreSignals();
+    delete priv;
+}
+
+void NodeTableModel::queueChange(const COutPoint &outpoint)
+{
+    priv->queueChange(outpoint);
+}
+
+void NodeTableModel::processPendingChanges()
+{
+    // Large bursts (initial load, list sync) are spread over several event
+    // loop iterations so the GUI stays responsive
+    if (!priv->processPending())
+        QMetaObject::invokeMethod(this, "processPendingChanges", Qt::QueuedConnection);
+}
+
+int NodeTableModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return priv->cachedNodes.size();
+}
+
+int NodeTableModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return columns.length();
+}
+
+QVariant NodeTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= priv->cachedNodes.size())
+        return QVariant();
+
+    const NodeTableEntry &entry = priv->cachedNodes[index.row()];
+
+    if (role == Qt::DisplayRole || role == SortRole) {
+        switch (index.column()) {
+        case Address:
+            return entry.address;
+        case Protocol:
+            if (role == SortRole)
+                return entry.protocol;
+            return QString::number(entry.protocol);
+        case Status:
+            return entry.status;
+        case Active:
+            if (role == SortRole)
+                return (qint64)entry.activeSeconds;
+            return QString::fromStdString(DurationToDHMS(entry.activeSeconds));
+        case LastSeen:
+            if (role == SortRole)
+                return (qint64)entry.lastSeen;
+            return QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", entry.lastSeen));
+        case Pubkey:
+            return entry.pubkey;
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant NodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < columns.size())
+        return columns[section];
+    return QVariant();
+}
+
+Qt::ItemFlags NodeTableModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+static void NotifyNodeChanged(NodeTableModel *model, const CTxIn &vin, ChangeType status)
+{
+    Q_UNUSED(status);
+    // The row is re-read from the manager, so the change type itself is not needed
+    model->queueChange(vin.prevout);
+}
+
+void NodeTableModel::subscribeToCoreSignals()
+{
+    if (type == MASTERNODE)
+        uiInterface.NotifyMasternodeChanged.connect(boost::bind(NotifyNodeChanged, this, _1, _2));
+    else
+        uiInterface.NotifySystemnodeChanged.connect(boost::bind(NotifyNodeChanged, this, _1, _2));
+}
+
+void NodeTableModel::unsubscribeFromCoreSignals()
+{
+    if (type == MASTERNODE)
+        uiInterface.NotifyMasternodeChanged.disconnect(boost::bind(NotifyNodeChanged, this, _1, _2));
+    else
+        uiInterface.NotifySystemnodeChanged.disconnect(boost::bind(NotifyNodeChanged, this, _1, _2));
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_QT_NODETABLEMODEL_H
+#define BITCOIN_QT_NODETABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStringList>
+
+class COutPoint;
+class NodeTablePriv;
+
+/** Number of queued node changes applied per GUI event loop iteration */
+static const int NODE_TABLE_UPDATE_BATCH = 250;
+
+/**
+   Qt model of the masternode or systemnode list. It is kept up to date from
+   the node manager's change notifications: only the nodes that were added,
+   removed or changed are re-read, the full list is never copied.
+ */
+class NodeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum NodeType {
+        MASTERNODE,
+        SYSTEMNODE
+    };
+
+    enum ColumnIndex {
+        Address = 0,
+        Protocol = 1,
+        Status = 2,
+        Active = 3,
+        LastSeen = 4,
+        Pubkey = 5
+    };
+
+    /** Roles to get specific information from a node row */
+    enum RoleIndex {
+        /** Raw value to sort by (numbers for the numeric columns) */
+        SortRole = Qt::UserRole
+    };
+
+    explicit NodeTableModel(NodeType type, QObject *parent = 0);
+    ~NodeTableModel();
+
+    /** Queue a node for re-reading; thread safe, called from core signals */
+    void queueChange(const COutPoint &outpoint);
+
+    /** @name Methods overridden from QAbstractTableModel
+        @{*/
+    int rowCount(const QModelIndex &parent) const;
+    int columnCount(const QModelIndex &parent) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+    /*@}*/
+
+public slots:
+    /** Apply queued node changes to the model */
+    void processPendingChanges();
+
+private:
+    NodeType type;
+    QStringList columns;
+    NodeTablePriv *priv;
+
+    void subscribeToCoreSignals();
+    void unsubscribeFromCoreSignals();
+
+    friend class NodeTablePriv;
+};
+
+#endif // BITCOIN_QT_NODETABLEMODEL_H
@@ -18,13 +18,13 @@
 #include "transactiontablemodel.h"
 #include "optionsmodel.h"
 #include "startmissingdialog.h"
+#include "nodetablemodel.h"
 
 #include <QTimer>
 #include <QMessageBox>
+#include <QSortFilterProxyModel>
 #include <QCheckBox>
 
-CCriticalSection cs_systemnodes;
-
 SystemnodeList::SystemnodeList(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::SystemnodeList),
@@ -49,11 +49,19 @@ SystemnodeList::SystemnodeList(QWidget *parent) :
     ui->tableWidgetMySystemnodes->setColumnWidth(4, columnActiveWidth);
     ui->tableWidgetMySystemnodes->setColumnWidth(5, columnLastSeenWidth);
 
-    ui->tableWidgetSystemnodes->setColumnWidth(0, columnAddressWidth);
-    ui->tableWidgetSystemnodes->setColumnWidth(1, columnProtocolWidth);
-    ui->tableWidgetSystemnodes->setColumnWidth(2, columnStatusWidth);
-    ui->tableWidgetSystemnodes->setColumnWidth(3, columnActiveWidth);
-    ui->tableWidgetSystemnodes->setColumnWidth(4, columnLastSeenWidth);
+    nodeModel = new NodeTableModel(NodeTableModel::SYSTEMNODE, this);
+    nodeProxyModel = new QSortFilterProxyModel(this);
+    nodeProxyModel->setSourceModel(nodeModel);
+    nodeProxyModel->setSortRole(NodeTableModel::SortRole);
+    nodeProxyModel->setFilterKeyColumn(-1);
+    nodeProxyModel->setDynamicSortFilter(true);
+    ui->tableViewSystemnodes->setModel(nodeProxyModel);
+
+    ui->tableViewSystemnodes->setColumnWidth(0, columnAddressWidth);
+    ui->tableViewSystemnodes->setColumnWidth(1, columnProtocolWidth);
+    ui->tableViewSystemnodes->setColumnWidth(2, columnStatusWidth);
+    ui->tableViewSystemnodes->setColumnWidth(3, columnActiveWidth);
+    ui->tableViewSystemnodes->setColumnWidth(4, columnLastSeenWidth);
 
     ui->tableWidgetMySystemnodes->setContextMenuPolicy(Qt::CustomContextMenu);
 
@@ -244,7 +252,6 @@ void SystemnodeList::updateMyNodeList(bool reset) {
     if(timeTillUpdate > 0 && !reset) return;
     lastMyListUpdate = GetTime();
 
-    ui->tableWidgetSystemnodes->setSortingEnabled(false);
     BOOST_FOREACH(CNodeEntry mne, systemnodeConfig.getEntries()) {
         CTxIn vin = CTxIn(uint256S(mne.getTxHash()), uint32_t(atoi(mne.getOutputIndex().c_str())));
         CSystemnode *pmn = snodeman.Find(vin);
@@ -252,7 +259,6 @@ void SystemnodeList::updateMyNodeList(bool reset) {
         updateMySystemnodeInfo(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), QString::fromStdString(mne.getPrivKey()), QString::fromStdString(mne.getTxHash()),
             QString::fromStdString(mne.getOutputIndex()), pmn);
     }
-    ui->tableWidgetSystemnodes->setSortingEnabled(true);
 
     // reset "timer"
     ui->secondsLabel->setText("0");
@@ -260,65 +266,19 @@ void SystemnodeList::updateMyNodeList(bool reset) {
 
 void SystemnodeList::updateNodeList()
 {
-    static int64_t nTimeListUpdate = 0;
-
-      // to prevent high cpu usage update only once in SYSTEMNODELIST_UPDATE_SECONDS secondsLabel
-      // or SYSTEMNODELIST_FILTER_COOLDOWN_SECONDS seconds after filter was last changed
-      int64_t nTimeToWait =   fFilterUpdated
-                              ? nTimeFilterUpdate - GetTime() + SYSTEMNODELIST_FILTER_COOLDOWN_SECONDS
-                              : nTimeListUpdate - GetTime() + SYSTEMNODELIST_UPDATE_SECONDS;
-
-    if(fFilterUpdated) ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nTimeToWait)));
-    if(nTimeToWait > 0) return;
-
-    nTimeListUpdate = GetTime();
-    fFilterUpdated = false;
-
-    TRY_LOCK(cs_systemnodes, lockSystemnodes);
-    if(!lockSystemnodes)
-        return;
-
-    QString strToFilter;
-    ui->countLabel->setText("Updating...");
-    ui->tableWidgetSystemnodes->setSortingEnabled(false);
-    ui->tableWidgetSystemnodes->clearContents();
-    ui->tableWidgetSystemnodes->setRowCount(0);
-    std::vector<CSystemnode> vSystemnodes = snodeman.GetFullSystemnodeVector();
-
-    BOOST_FOREACH(CSystemnode& mn, vSystemnodes)
+    // The list itself is kept up to date by nodeModel; only apply a changed
+    // filter SYSTEMNODELIST_FILTER_COOLDOWN_SECONDS seconds after it was last edited
+    if(fFilterUpdated)
     {
-        // populate list
-        // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.protocolVersion));
-        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(mn.Status()));
-        DateTableWidgetItem *activeSecondsItem = new DateTableWidgetItem(mn.lastPing.sigTime - mn.sigTime);
-        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime)));
-        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubkey.GetID()).ToString()));
-
-        if (strCurrentFilter != "")
-        {
-            strToFilter =   addressItem->text() + " " +
-                            protocolItem->text() + " " +
-                            statusItem->text() + " " +
-                            activeSecondsItem->text() + " " +
-                            lastSeenItem->text() + " " +
-                            pubkeyItem->text();
-            if (!strToFilter.contains(strCurrentFilter)) continue;
-        }
+        int64_t nTimeToWait = nTimeFilterUpdate - GetTime() + SYSTEMNODELIST_FILTER_COOLDOWN_SECONDS;
+        ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nTimeToWait)));
+        if(nTimeToWait > 0) return;
 
-        ui->tableWidgetSystemnodes->insertRow(0);
-        ui->tableWidgetSystemnodes->setItem(0, 0, addressItem);
-        ui->tableWidgetSystemnodes->setItem(0, 1, protocolItem);
-        ui->tableWidgetSystemnodes->setItem(0, 2, statusItem);
-        ui->tableWidgetSystemnodes->setItem(0, 3, activeSecondsItem);
-        ui->tableWidgetSystemnodes->setItem(0, 4, lastSeenItem);
-        ui->tableWidgetSystemnodes->setItem(0, 5, pubkeyItem);
+        fFilterUpdated = false;
+        nodeProxyModel->setFilterFixedString(strCurrentFilter);
     }
 
-    ui->countLabel->setText(QString::number(ui->tableWidgetSystemnodes->rowCount()));
-    ui->tableWidgetSystemnodes->setSortingEnabled(true);
-
+    ui->countLabel->setText(QString::number(nodeProxyModel->rowCount()));
 }
 
 void SystemnodeList::on_filterLineEdit_textChanged(const QString &filterString) {
@@ -10,7 +10,6 @@
 #include <QTimer>
 #include <QWidget>
 
-#define SYSTEMNODELIST_UPDATE_SECONDS            60
 #define MY_SYSTEMNODELIST_UPDATE_SECONDS         15
 #define SYSTEMNODELIST_FILTER_COOLDOWN_SECONDS   3
 
@@ -19,10 +18,12 @@ namespace Ui {
 }
 
 class ClientModel;
+class NodeTableModel;
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
 class QModelIndex;
+class QSortFilterProxyModel;
 QT_END_NAMESPACE
 
 /** Systemnode Manager page widget */
@@ -61,6 +62,8 @@ private:
     ClientModel *clientModel;
     WalletModel *walletModel;
     SendCollateralDialog *sendDialog;
+    NodeTableModel *nodeModel;
+    QSortFilterProxyModel *nodeProxyModel;
     CCriticalSection cs_mnlistupdate;
     QString strCurrentFilter;
 
@@ -12,6 +12,7 @@
 #include "transactionrecord.h"
 #include "walletmodel.h"
 
+#include "instantx.h"
 #include "main.h"
 #include "sync.h"
 #include "uint256.h"
@@ -24,6 +25,13 @@
 #include <QIcon>
 #include <QList>
 
+#include <set>
+
+#include <boost/thread.hpp>
+
+// Number of wallet transactions decomposed per lock acquisition during the initial load
+static const size_t TRANSACTION_TABLE_LOAD_CHUNK = 1000;
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter, /* status */
@@ -57,8 +65,19 @@ class TransactionTablePriv
 public:
     TransactionTablePriv(CWallet *wallet, TransactionTableModel *parent) :
         wallet(wallet),
-        parent(parent)
+        parent(parent),
+        fTipKnown(false),
+        cachedNumBlocks(0),
+        cachedNumISLocks(0),
+        fLoadDone(false),
+        fLoading(false)
+    {
+    }
+
+    ~TransactionTablePriv()
     {
+        loaderThread.interrupt();
+        loaderThread.join();
     }
 
     CWallet *wallet;
@@ -70,19 +89,148 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Chain height and InstantSend lock count as of the last confirmations
+     * update; rows whose status was computed at these values are current
+     * and can be returned without touching core locks.
+     */
+    bool fTipKnown;
+    int cachedNumBlocks;
+    int cachedNumISLocks;
+
+    /* Initial load: records decomposed by loaderThread, waiting to be
+     * inserted into the model on the GUI thread.
+     */
+    boost::thread loaderThread;
+    CCriticalSection cs_loaded;
+    QList<TransactionRecord> loadedRecords;
+    bool fLoadDone; // loader delivered everything, guarded by cs_loaded
+
+    /* Transactions deleted or hidden by a notification while the load is
+     * running. The loader may have decomposed them before, so their records
+     * are dropped when they arrive. Only used on the GUI thread.
+     */
+    bool fLoading;
+    std::set<uint256> setHiddenWhileLoading;
+
+    /* Query entire wallet anew from core, on a background thread. The
+     * wallet is walked in chunks so neither the GUI nor the core locks are
+     * held for the whole wallet at once; each chunk is handed to the GUI
+     * thread and inserted as one range (see insertLoadedRecords).
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        fLoading = true;
+        setHiddenWhileLoading.clear();
+        {
+            LOCK(cs_loaded);
+            fLoadDone = false;
+        }
+        loaderThread = boost::thread(boost::bind(&TransactionTablePriv::loadWallet, this));
+    }
+
+    void loadWallet()
+    {
+        std::vector<uint256> vHashes;
         {
             LOCK2(cs_main, wallet->cs_wallet);
+            vHashes.reserve(wallet->mapWallet.size());
             for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+                vHashes.push_back(it->first);
+        }
+
+        for(size_t nStart = 0; nStart < vHashes.size(); nStart += TRANSACTION_TABLE_LOAD_CHUNK)
+        {
+            boost::this_thread::interruption_point();
+
+            QList<TransactionRecord> records;
+            {
+                LOCK2(cs_main, wallet->cs_wallet);
+                size_t nEnd = std::min(vHashes.size(), nStart + TRANSACTION_TABLE_LOAD_CHUNK);
+                for(size_t i = nStart; i < nEnd; ++i)
+                {
+                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(vHashes[i]);
+                    if(mi != wallet->mapWallet.end() && TransactionRecord::showTransaction(mi->second))
+                        records.append(TransactionRecord::decomposeTransaction(wallet, mi->second));
+                }
+            }
+            if(records.isEmpty())
+                continue;
+
+            {
+                LOCK(cs_loaded);
+                loadedRecords.append(records);
+            }
+            QMetaObject::invokeMethod(parent, "insertLoadedRecords", Qt::QueuedConnection);
+        }
+
+        {
+            LOCK(cs_loaded);
+            fLoadDone = true;
+        }
+        QMetaObject::invokeMethod(parent, "insertLoadedRecords", Qt::QueuedConnection);
+    }
+
+    /* Insert the records delivered by the loader so far. They arrive sorted
+     * by hash; transactions already added, deleted or hidden through a
+     * notification are skipped and every contiguous run is inserted with a
+     * single beginInsertRows.
+     */
+    void insertLoadedRecords()
+    {
+        QList<TransactionRecord> records;
+        bool fDone;
+        {
+            LOCK(cs_loaded);
+            records.swap(loadedRecords);
+            fDone = fLoadDone;
+        }
+
+        if(!setHiddenWhileLoading.empty())
+        {
+            QList<TransactionRecord> shown;
+            foreach(const TransactionRecord &rec, records)
+                if(!setHiddenWhileLoading.count(rec.hash))
+                    shown.append(rec);
+            records.swap(shown);
+        }
+
+        int i = 0;
+        while(i < records.size())
+        {
+            QList<TransactionRecord>::iterator lower = qLowerBound(
+                cachedWallet.begin(), cachedWallet.end(), records[i].hash, TxLessThan());
+            int insertIndex = (lower - cachedWallet.begin());
+            bool inModel = (lower != cachedWallet.end() && lower->hash == records[i].hash);
+
+            // Collect the run of records that all land at insertIndex
+            int j = i;
+            while(j < records.size() &&
+                  (records[j].hash == records[i].hash ||
+                   insertIndex == cachedWallet.size() ||
+                   records[j].hash < cachedWallet[insertIndex].hash))
+                ++j;
+
+            if(inModel)
             {
-                if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                // Only skip the already known transaction, not the rest of the run
+                while(i < records.size() && records[i].hash == lower->hash)
+                    ++i;
+                continue;
             }
+
+            parent->beginInsertRows(QModelIndex(), insertIndex, insertIndex + (j - i) - 1);
+            for(int k = i; k < j; ++k)
+                cachedWallet.insert(insertIndex + (k - i), records[k]);
+            parent->endInsertRows();
+            i = j;
+        }
+
+        if(fDone)
+        {
+            fLoading = false;
+            setHiddenWhileLoading.clear();
         }
     }
 
@@ -112,6 +260,15 @@ public:
                 status = CT_DELETED; /* In model, but want to hide, treat as deleted */
         }
 
+        // A record the loader already decomposed must not bring the transaction back
+        if(fLoading)
+        {
+            if(status == CT_DELETED || !showTransaction)
+                setHiddenWhileLoading.insert(hash);
+            else
+                setHiddenWhileLoading.erase(hash);
+        }
+
         qDebug() << "    inModel=" + QString::number(inModel) +
                     " Index=" + QString::number(lowerIndex) + "-" + QString::number(upperIndex) +
                     " showTransaction=" + QString::number(showTransaction) + " derivedStatus=" + QString::number(status);
@@ -179,6 +336,13 @@ public:
         {
             TransactionRecord *rec = &cachedWallet[idx];
 
+            // Rows whose status was computed at the current tip are returned
+            // as they are, without taking any lock.
+            if(fTipKnown &&
+               rec->status.cur_num_blocks == cachedNumBlocks &&
+               rec->status.cur_num_ix_locks == cachedNumISLocks)
+                return rec;
+
             // Get required locks upfront. This avoids the GUI from getting
             // stuck if the core is holding the locks for a longer time - for
             // example, during a wallet rescan.
@@ -255,8 +419,24 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     priv->updateWallet(updated, status, showTransaction);
 }
 
+void TransactionTableModel::insertLoadedRecords()
+{
+    priv->insertLoadedRecords();
+}
+
 void TransactionTableModel::updateConfirmations()
 {
+    {
+        // Remember the tip the row statuses are now checked against
+        TRY_LOCK(cs_main, lockMain);
+        priv->fTipKnown = lockMain;
+        if(lockMain)
+        {
+            priv->cachedNumBlocks = chainActive.Height();
+            priv->cachedNumISLocks = GetInstantSend().GetCompleteLocksCount();
+        }
+    }
+
     // Blocks came in since last poll.
     // Invalidate status (number of confirmations) and (possibly) description
     //  for all rows. Qt is smart enough to only actually request the data for the
@@ -660,7 +840,11 @@ public:
     TransactionNotification(uint256 hash, ChangeType status, bool showTransaction):
         hash(hash), status(status), showTransaction(showTransaction) {}
 
-    void invoke(QObject *ttm)
+    void invoke(QObject *ttm);
+
+    // Deliver this notification on its own, keeping its position relative to
+    // setProcessingQueuedTransactions when replaying a rescan queue
+    void invokeImmediate(QObject *ttm)
     {
         QString strHash = QString::fromStdString(hash.GetHex());
         qDebug() << "NotifyTransactionChanged : " + strHash + " status= " + QString::number(status);
@@ -669,7 +853,7 @@ public:
                                   Q_ARG(int, status),
                                   Q_ARG(bool, showTransaction));
     }
-private:
+
     uint256 hash;
     ChangeType status;
     bool showTransaction;
@@ -678,6 +862,38 @@ private:
 static bool fQueueNotifications = false;
 static std::vector< TransactionNotification > vQueueNotifications;
 
+// Notifications not yet handled by the GUI thread, latest per transaction.
+// A burst of changes (e.g. a block touching many wallet transactions) is
+// delivered to the model as one processPendingNotifications call.
+static CCriticalSection cs_pendingNotifications;
+static std::map<uint256, TransactionNotification> mapPendingNotifications;
+
+void TransactionNotification::invoke(QObject *ttm)
+{
+    qDebug() << "NotifyTransactionChanged : " + QString::fromStdString(hash.GetHex()) + " status= " + QString::number(status);
+    bool fPost;
+    {
+        LOCK(cs_pendingNotifications);
+        fPost = mapPendingNotifications.empty();
+        // Later notifications win; updateWallet derives the effective change
+        // from showTransaction and whether the row is already in the model.
+        mapPendingNotifications[hash] = *this;
+    }
+    if (fPost)
+        QMetaObject::invokeMethod(ttm, "processPendingNotifications", Qt::QueuedConnection);
+}
+
+void TransactionTableModel::processPendingNotifications()
+{
+    std::map<uint256, TransactionNotification> mapNotifications;
+    {
+        LOCK(cs_pendingNotifications);
+        mapNotifications.swap(mapPendingNotifications);
+    }
+    for (std::map<uint256, TransactionNotification>::const_iterator it = mapNotifications.begin(); it != mapNotifications.end(); ++it)
+        priv->updateWallet(it->second.hash, it->second.status, it->second.showTransaction);
+}
+
 static void NotifyTransactionChanged(TransactionTableModel *ttm, CWallet *wallet, const uint256 &hash, ChangeType status)
 {
     // Find transaction in wallet
@@ -711,7 +927,7 @@ static void ShowProgress(TransactionTableModel *ttm, const std::string &title, i
             if (vQueueNotifications.size() - i <= 10)
                 QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
 
-            vQueueNotifications[i].invoke(ttm);
+            vQueueNotifications[i].invokeImmediate(ttm);
         }
         std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
     }
@@ -111,6 +111,10 @@ public slots:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Insert records delivered by the background initial load */
+    void insertLoadedRecords();
+    /* Apply all transaction notifications queued since the last call */
+    void processPendingNotifications();
 
     friend class TransactionTablePriv;
 };
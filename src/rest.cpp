@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilterindex.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
@@ -214,6 +215,154 @@ static bool rest_tx(AcceptedConnection* conn,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Parse the filter type name that starts the request path, "basic/..." */
+static uint8_t ParseFilterType(vector<string>& path, const string& strReq)
+{
+    boost::split(path, strReq, boost::is_any_of("/"));
+    uint8_t nFilterType;
+    if (path.size() < 2 || !BlockFilterTypeByName(path[0], nFilterType))
+        throw RESTERR(HTTP_BAD_REQUEST, "Unknown filter type: " + path[0]);
+    if (!pblockfilterindex)
+        throw RESTERR(HTTP_BAD_REQUEST, "Block filter index is not enabled (use -blockfilterindex)");
+    return nFilterType;
+}
+
+static bool rest_blockfilter(AcceptedConnection* conn,
+                             string& strReq,
+                             map<string, string>& mapHeaders,
+                             bool fRun)
+{
+    // basic/<hash>.<ext>
+    vector<string> path;
+    ParseFilterType(path, strReq);
+    string strTail = path[1];
+
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strTail);
+
+    string hashStr = params[0];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    CBlockFilterIndexEntry entry;
+    if (!pblockfilterindex->ReadEntry(hash, entry))
+        throw RESTERR(HTTP_NOT_FOUND, "Filter of " + hashStr + " not found");
+
+    CDataStream ssFilter(SER_NETWORK, PROTOCOL_VERSION);
+    ssFilter << entry.vFilter;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryFilter = ssFilter.str();
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryFilter.size(), "application/octet-stream") << binaryFilter << std::flush;
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssFilter.begin(), ssFilter.end()) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        return true;
+    }
+
+    case RF_JSON: {
+        Object objFilter;
+        objFilter.push_back(Pair("filter", HexStr(entry.vFilter)));
+        objFilter.push_back(Pair("header", entry.header.GetHex()));
+        string strJSON = write_string(Value(objFilter), false) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_blockfilterheaders(AcceptedConnection* conn,
+                                    string& strReq,
+                                    map<string, string>& mapHeaders,
+                                    bool fRun)
+{
+    // basic/<count>/<hash>.<ext>: headers of <count> blocks of the active chain starting at <hash>
+    vector<string> path;
+    ParseFilterType(path, strReq);
+    if (path.size() != 3)
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilterheaders/<filtertype>/<count>/<hash>.<ext>");
+
+    long nCount = strtol(path[1].c_str(), NULL, 10);
+    if (nCount < 1 || nCount > (long)MAX_GETCFHEADERS_SIZE)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Header count out of range: %s", path[1]));
+
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, path[2]);
+
+    string hashStr = params[0];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    vector<uint256> vHashes;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        const CBlockIndex* pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
+        if (!pindex || !chainActive.Contains(pindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        while (pindex && vHashes.size() < (size_t)nCount) {
+            vHashes.push_back(pindex->GetBlockHash());
+            pindex = chainActive.Next(pindex);
+        }
+    }
+
+    vector<uint256> vHeaders;
+    vHeaders.reserve(vHashes.size());
+    BOOST_FOREACH(const uint256& hashBlock, vHashes) {
+        uint256 header;
+        if (!pblockfilterindex->ReadFilterHeader(hashBlock, header))
+            break;
+        vHeaders.push_back(header);
+    }
+
+    CDataStream ssHeaders(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const uint256& header, vHeaders)
+        ssHeaders << header;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHeaders = ssHeaders.str();
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryHeaders.size(), "application/octet-stream") << binaryHeaders << std::flush;
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssHeaders.begin(), ssHeaders.end()) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        return true;
+    }
+
+    case RF_JSON: {
+        Array arrHeaders;
+        BOOST_FOREACH(const uint256& header, vHeaders)
+            arrHeaders.push_back(header.GetHex());
+        string strJSON = write_string(Value(arrHeaders), false) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(AcceptedConnection* conn,
@@ -224,6 +373,8 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blockfilter/", rest_blockfilter},
+      {"/rest/blockfilterheaders/", rest_blockfilterheaders},
 };
 
 bool HTTPReq_REST(AcceptedConnection* conn,
@@ -533,7 +533,14 @@ Value getblockchaininfo(const Array& params, bool fHelp)
             "  \"bestblockhash\": \"...\", (string) the hash of the currently best block\n"
             "  \"difficulty\": xxxxxx,     (numeric) the current difficulty\n"
             "  \"verificationprogress\": xxxx, (numeric) estimate of verification progress [0..1]\n"
-            "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
+            "  \"chainwork\": \"xxxx\",    (string) total amount of work in active chain, in hexadecimal\n"
+            "  \"backgroundverify\": {     (object) verification of -checkblocks after startup\n"
+            "    \"running\": true|false, (boolean) if the verification is still running\n"
+            "    \"level\": n,            (numeric) the check level\n"
+            "    \"checked\": n,          (numeric) blocks checked so far\n"
+            "    \"total\": n,            (numeric) blocks to check\n"
+            "    \"failedheight\": n      (numeric) height of a corrupted block found, -1 if none\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getblockchaininfo", "")
@@ -548,6 +555,15 @@ Value getblockchaininfo(const Array& params, bool fHelp)
     obj.push_back(Pair("difficulty",            (double)GetDifficulty()));
     obj.push_back(Pair("verificationprogress",  Checkpoints::GuessVerificationProgress(chainActive.Tip())));
     obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex()));
+
+    CBackgroundVerifyStatus verify = GetBackgroundVerifyStatus();
+    Object verifyObj;
+    verifyObj.push_back(Pair("running",         verify.fRunning));
+    verifyObj.push_back(Pair("level",           verify.nCheckLevel));
+    verifyObj.push_back(Pair("checked",         verify.nChecked));
+    verifyObj.push_back(Pair("total",           verify.nTotal));
+    verifyObj.push_back(Pair("failedheight",    verify.nFailedHeight));
+    obj.push_back(Pair("backgroundverify",      verifyObj));
     return obj;
 }
 
@@ -18,6 +18,7 @@
 #include "rpcserver.h"
 #include "util.h"
 #include "auxpow.h"
+#include "auxpowminer.h"
 #include "spork.h"
 #include "masternode-budget.h"
 #ifdef ENABLE_WALLET
@@ -209,11 +210,10 @@ Value setgenerate(const Array& params, bool fHelp)
                 LOCK(cs_main);
                 IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
             }
-            while (!CheckProofOfWork(pblock->GetHash(), pblock->nBits)) {
-                // Yes, there is a chance every nonce could fail to satisfy the -regtest
-                // target -- 1 in 2^(2^32). That ain't gonna happen.
-                ++pblock->nNonce;
-            }
+            // Yes, there is a chance every nonce could fail to satisfy the -regtest
+            // target -- 1 in 2^(2^32). That ain't gonna happen.
+            if (!SolveBlock(pblock))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "No nonce meets the block target");
             CValidationState state;
             if (!ProcessNewBlock(state, NULL, pblock))
                 throw JSONRPCError(RPC_INTERNAL_ERROR, "ProcessNewBlock, block not accepted");
@@ -268,7 +268,7 @@ Value getmininginfo(const Array& params, bool fHelp)
             "  \"errors\": \"...\"          (string) Current errors\n"
             "  \"generate\": true|false     (boolean) If the generation is on or off (see getgenerate or setgenerate calls)\n"
             "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
-            "  \"hashespersec\": n          (numeric) The hashes per second of the generation, or 0 if no generation.\n"
+            "  \"hashespersec\": n          (numeric) The hashes per second of all generation threads, or 0 if no generation.\n"
             "  \"pooledtx\": n              (numeric) The size of the mem pool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
@@ -792,6 +792,179 @@ Value submitblock(const Array& params, bool fHelp)
 /* ************************************************************************** */
 /* Merge mining.  */
 
+static void CheckAuxMiningAvailable(const std::string& strMethod)
+{
+    if (vNodes.empty())
+        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED,
+                           "Crown is not connected!");
+
+    if (IsInitialBlockDownload())
+        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD,
+                           "Crown is downloading blocks...");
+
+    /* This should never fail, since the chain is already
+        past the point of merge-mining start.  Check nevertheless.  */
+    {
+        LOCK(cs_main);
+        if (chainActive.Height() + 1 < Params().AuxpowStartHeight())
+            throw std::runtime_error(strMethod + " method is not yet available");
+    }
+}
+
+/* The block to merge-mine for scriptPubKey, as returned by getauxblock
+   and createauxblock.  */
+static Object GetAuxBlock(const CScript& scriptPubKey)
+{
+    int nHeight;
+    CAmount nFees;
+    std::shared_ptr<const CBlock> pblock = auxpowMiner.GetCurrentBlock(scriptPubKey, nHeight, nFees);
+    if (!pblock)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
+    const CBlock& block = *pblock;
+
+    arith_uint256 target;
+    bool fNegative, fOverflow;
+    target.SetCompact(block.nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || target == 0)
+        throw std::runtime_error("invalid difficulty bits in block");
+
+    json_spirit::Object result;
+    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    result.push_back(Pair("chainid", block.nVersion.GetChainId()));
+    result.push_back(Pair("previousblockhash", block.hashPrevBlock.GetHex()));
+    result.push_back(Pair("coinbasevalue", (int64_t)block.vtx[0].vout[0].nValue));
+    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    result.push_back(Pair("height", static_cast<int64_t> (nHeight)));
+    result.push_back(Pair("target", HexStr(BEGIN(target), END(target))));
+    result.push_back(Pair("longpollid", block.hashPrevBlock.GetHex() + i64tostr(nFees)));
+
+    return result;
+}
+
+/* Wait until the tip is no longer the one in strLongPollId, or the
+   mempool raised the fees of the block for scriptPubKey.  */
+static void WaitForAuxBlockChange(const CScript& scriptPubKey, const std::string& strLongPollId)
+{
+    // Format: <hashBestChain><nFees>
+    if (strLongPollId.size() < 64)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid longpollid");
+    uint256 hashWatchedChain;
+    hashWatchedChain.SetHex(strLongPollId.substr(0, 64));
+    CAmount nFeesLP = atoi64(strLongPollId.substr(64));
+
+    boost::system_time checktxtime = boost::get_system_time() + boost::posix_time::seconds(AUXPOW_TEMPLATE_UPDATE_INTERVAL);
+    boost::unique_lock<boost::mutex> lock(csBestBlock);
+    while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
+    {
+        if (!cvBlockChange.timed_wait(lock, checktxtime))
+        {
+            // Timeout: Check the mempool for more fees, cs_main is taken before csBestBlock
+            lock.unlock();
+            int nHeight;
+            CAmount nFees;
+            bool fChanged = !auxpowMiner.GetCurrentBlock(scriptPubKey, nHeight, nFees) || nFees > nFeesLP;
+            lock.lock();
+            if (fChanged)
+                break;
+            checktxtime += boost::posix_time::seconds(AUXPOW_TEMPLATE_UPDATE_INTERVAL);
+        }
+    }
+
+    if (!IsRPCRunning())
+        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
+}
+
+/* A copy of the block handed out with hash, with the auxpow attached.  */
+static CBlock GetSolvedAuxBlock(const std::string& strHash, const std::string& strAuxpowHex)
+{
+    uint256 hash;
+    hash.SetHex(strHash);
+
+    std::shared_ptr<const CBlock> pblock = auxpowMiner.LookupBlock(hash);
+    if (!pblock)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "block hash unknown");
+    CBlock block(*pblock);
+
+    const std::vector<unsigned char> vchAuxPow = ParseHex(strAuxpowHex);
+    CDataStream ss(vchAuxPow, SER_GETHASH, PROTOCOL_VERSION);
+    CAuxPow pow;
+    ss >> pow;
+    block.SetAuxpow(new CAuxPow(pow));
+    assert(block.GetHash() == hash);
+
+    return block;
+}
+
+Value createauxblock(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw std::runtime_error(
+            "createauxblock \"address\" ( \"longpollid\" )\n"
+            "\nCreate a new block and return information required to merge-mine it.\n"
+            "The block is kept up to date with the mempool, calls for the same\n"
+            "address get the same block until it changes.\n"
+            "\nArguments:\n"
+            "1. \"address\"     (string, required) the block reward is paid to this address\n"
+            "2. \"longpollid\"  (string, optional) wait until the tip changes or the fees\n"
+            "                   of the block returned with this longpollid went up\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hash\"               (string) hash of the created block\n"
+            "  \"chainid\"            (numeric) chain ID for this block\n"
+            "  \"previousblockhash\"  (string) hash of the previous block\n"
+            "  \"coinbasevalue\"      (numeric) value of the block's coinbase\n"
+            "  \"bits\"               (string) compressed target of the block\n"
+            "  \"height\"             (numeric) height of the block\n"
+            "  \"target\"             (string) target in reversed byte order\n"
+            "  \"longpollid\"         (string) pass back to wait for a better block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("createauxblock", "\"address\"")
+            + HelpExampleRpc("createauxblock", "\"address\"")
+            );
+
+    CBitcoinAddress address(params[0].get_str());
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid coinbase payout address");
+    const CScript scriptPubKey = GetScriptForDestination(address.Get());
+
+    CheckAuxMiningAvailable("createauxblock");
+
+    if (params.size() > 1)
+        WaitForAuxBlockChange(scriptPubKey, params[1].get_str());
+
+    return GetAuxBlock(scriptPubKey);
+}
+
+Value submitauxblock(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw std::runtime_error(
+            "submitauxblock \"hash\" \"auxpow\"\n"
+            "\nSubmit a solved auxpow for a block returned by createauxblock.\n"
+            "\nArguments:\n"
+            "1. \"hash\"    (string, required) hash of the block to submit\n"
+            "2. \"auxpow\"  (string, required) serialised auxpow found\n"
+            "\nResult:\n"
+            "xxxxx        (boolean) whether the submitted block was correct\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitauxblock", "\"hash\" \"serialised auxpow\"")
+            + HelpExampleRpc("submitauxblock", "\"hash\" \"serialised auxpow\"")
+            );
+
+    CBlock block = GetSolvedAuxBlock(params[0].get_str(), params[1].get_str());
+
+    LOCK(cs_main);
+    if (block.hashPrevBlock != chainActive.Tip()->GetBlockHash())
+        return error("submitauxblock : block is stale");
+
+    CValidationState state;
+    if (!ProcessNewBlock(state, NULL, &block))
+        return error("submitauxblock : ProcessNewBlock, block not accepted");
+
+    return true;
+}
+
 #ifdef ENABLE_WALLET
 Value getauxblock(const Array& params, bool fHelp)
 {
@@ -814,6 +987,7 @@ Value getauxblock(const Array& params, bool fHelp)
             "  \"bits\"               (string) compressed target of the block\n"
             "  \"height\"             (numeric) height of the block\n"
             "  \"target\"            (string) target in reversed byte order, deprecated\n"
+            "  \"longpollid\"         (string) see createauxblock\n"
             "}\n"
             "\nResult (with arguments):\n"
             "xxxxx        (boolean) whether the submitted block was correct\n"
@@ -823,135 +997,26 @@ Value getauxblock(const Array& params, bool fHelp)
             + HelpExampleRpc("getauxblock", "")
             );
 
-    /*
-    boost::shared_ptr<CReserveScript> coinbaseScript;
-    GetMainSignals().ScriptForMining(coinbaseScript);
-
-    // If the keypool is exhausted, no script is returned at all.  Catch this.
-    if (!coinbaseScript)
-        throw JSONRPCError(RPC_WALLET_KEYPOOL_RAN_OUT, "Error: Keypool ran out, please call keypoolrefill first");
-
-    //throw an error if no script was provided
-    if (!coinbaseScript->reserveScript.size())
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "No coinbase script available (mining requires a wallet)");
-    */
-
-    if (vNodes.empty())
-        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED,
-                           "Crown is not connected!");
-
-    if (IsInitialBlockDownload())
-        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD,
-                           "Crown is downloading blocks...");
-
-    /* This should never fail, since the chain is already
-        past the point of merge-mining start.  Check nevertheless.  */
-    {
-        LOCK(cs_main);
-        if (chainActive.Height() + 1 < Params().AuxpowStartHeight())
-            throw std::runtime_error("getauxblock method is not yet available");
-    }
-
-    /* The variables below are used to keep track of created and not yet
-       submitted auxpow blocks.  Lock them to be sure even for multiple
-       RPC threads running in parallel.  */
-    static CCriticalSection cs_auxblockCache;
-    LOCK(cs_auxblockCache);
-    static std::map<uint256, CBlock*> mapNewBlock;
-    static std::vector<CBlockTemplate*> vNewBlockTemplate;
+    CheckAuxMiningAvailable("getauxblock");
 
     /* Create a new block?  */
     if (params.size() == 0)
     {
-        static unsigned nTransactionsUpdatedLast;
-        static const CBlockIndex* pindexPrev = NULL;
-        static uint64_t nStart;
-        static CBlockTemplate* pblocktemplate;
-        static unsigned nExtraNonce = 0;
-
-        // Update block
-        {
-        LOCK(cs_main);
-        if (pindexPrev != chainActive.Tip()
-            || (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast
-                && GetTime() - nStart > 60))
-        {
-            if (pindexPrev != chainActive.Tip())
-            {
-                // Deallocate old blocks since they're obsolete now
-                mapNewBlock.clear();
-                BOOST_FOREACH(CBlockTemplate* pbt, vNewBlockTemplate)
-                    delete pbt;
-                vNewBlockTemplate.clear();
-            }
-
-            // Create new block with nonce = 0 and extraNonce = 1
-            CKeyID result;
-            CBitcoinAddress auxminingaddr(GetArg("-auxminingaddr", ""));
-            if (!auxminingaddr.GetKeyID(result)) {
-                CReserveKey reservekey(pwalletMain);
-                CPubKey pubkey;
-                reservekey.GetReservedKey(pubkey);
-                result = pubkey.GetID();
-            }
-            CScript scriptCoinbase = GetScriptForDestination(result);
-            pblocktemplate = CreateNewBlock(scriptCoinbase);
-            if (!pblocktemplate)
-                throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
-
-            // Update state only when CreateNewBlock succeeded
-            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            pindexPrev = chainActive.Tip();
-            nStart = GetTime();
-
-            // Finalise it by setting the version and building the merkle root
-            CBlock* pblock = &pblocktemplate->block;
-            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
-            pblock->nVersion.SetAuxpow(true);
-
-            // Save
-            mapNewBlock[pblock->GetHash()] = pblock;
-            vNewBlockTemplate.push_back(pblocktemplate);
-        }
+        CKeyID result;
+        CBitcoinAddress auxminingaddr(GetArg("-auxminingaddr", ""));
+        if (!auxminingaddr.GetKeyID(result)) {
+            CReserveKey reservekey(pwalletMain);
+            CPubKey pubkey;
+            reservekey.GetReservedKey(pubkey);
+            result = pubkey.GetID();
         }
-
-        const CBlock& block = pblocktemplate->block;
-
-        arith_uint256 target;
-        bool fNegative, fOverflow;
-        target.SetCompact(block.nBits, &fNegative, &fOverflow);
-        if (fNegative || fOverflow || target == 0)
-            throw std::runtime_error("invalid difficulty bits in block");
-
-        json_spirit::Object result;
-        result.push_back(Pair("hash", block.GetHash().GetHex()));
-        result.push_back(Pair("chainid", block.nVersion.GetChainId()));
-        result.push_back(Pair("previousblockhash", block.hashPrevBlock.GetHex()));
-        result.push_back(Pair("coinbasevalue", (int64_t)block.vtx[0].vout[0].nValue));
-        result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-        result.push_back(Pair("height", static_cast<int64_t> (pindexPrev->nHeight + 1)));
-        result.push_back(Pair("target", HexStr(BEGIN(target), END(target))));
-
-        return result;
+        return GetAuxBlock(GetScriptForDestination(result));
     }
 
     /* Submit a block instead.  */
 
     assert(params.size() == 2);
-    uint256 hash;
-    hash.SetHex(params[0].get_str());
-
-    const std::map<uint256, CBlock*>::iterator mit = mapNewBlock.find(hash);
-    if (mit == mapNewBlock.end())
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "block hash unknown");
-    CBlock& block = *mit->second;
-
-    const std::vector<unsigned char> vchAuxPow = ParseHex(params[1].get_str());
-    CDataStream ss(vchAuxPow, SER_GETHASH, PROTOCOL_VERSION);
-    CAuxPow pow;
-    ss >> pow;
-    block.SetAuxpow(new CAuxPow(pow));
-    assert(block.GetHash() == hash);
+    CBlock block = GetSolvedAuxBlock(params[0].get_str(), params[1].get_str());
 
     return ProcessBlockFound(&block, *pwalletMain, *pminingKey);
 }
@@ -15,6 +15,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "spork.h"
+#include "startuptasks.h"
 #include "masternode-sync.h"
 #include "systemnode-sync.h"
 #ifdef ENABLE_WALLET
@@ -109,6 +110,55 @@ Value getinfo(const Array& params, bool fHelp)
     return obj;
 }
 
+Value getstartupinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getstartupinfo\n"
+            "Returns the stages of the node startup and their times.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"finished\": xxxxx,         (numeric) milliseconds from the start of the process until the node was ready\n"
+            "  \"stages\": [                (array) stages in the order they ended, independent stages overlap\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",        (string) name of the stage\n"
+            "      \"depends\": [\"xxxx\",...], (array) stages that had to end before this one started\n"
+            "      \"start\": xxxxx,        (numeric) milliseconds from the start of the process until the stage started\n"
+            "      \"time\": xxxxx,         (numeric) milliseconds the stage took\n"
+            "      \"success\": true|false  (boolean) if the stage succeeded\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getstartupinfo", "")
+            + HelpExampleRpc("getstartupinfo", "")
+        );
+
+    int64_t nBegin, nFinished;
+    std::vector<CStartupStage> vStages = GetStartupStages(nBegin, nFinished);
+
+    Array stages;
+    BOOST_FOREACH(const CStartupStage& stage, vStages) {
+        Array depends;
+        BOOST_FOREACH(const std::string& strDepend, stage.vDepends)
+            depends.push_back(strDepend);
+
+        Object obj;
+        obj.push_back(Pair("name", stage.strName));
+        obj.push_back(Pair("depends", depends));
+        obj.push_back(Pair("start", stage.nStart - nBegin));
+        obj.push_back(Pair("time", stage.nEnd - stage.nStart));
+        obj.push_back(Pair("success", stage.fSuccess));
+        stages.push_back(obj);
+    }
+
+    Object ret;
+    ret.push_back(Pair("finished", nFinished ? nFinished - nBegin : 0));
+    ret.push_back(Pair("stages", stages));
+    return ret;
+}
+
 Value mnsync(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -136,6 +186,7 @@ Value mnsync(const Array& params, bool fHelp)
         obj.push_back(Pair("countMasternodeWinner", masternodeSync.countMasternodeWinner));
         obj.push_back(Pair("countBudgetItemProp", masternodeSync.countBudgetItemProp));
         obj.push_back(Pair("countBudgetItemFin", masternodeSync.countBudgetItemFin));
+        obj.push_back(Pair("countBudgetShardsSynced", masternodeSync.CountBudgetShardsSynced()));
         obj.push_back(Pair("RequestedMasternodeAssets", masternodeSync.RequestedMasternodeAssets));
         obj.push_back(Pair("RequestedMasternodeAttempt", masternodeSync.RequestedMasternodeAttempt));
 
@@ -64,6 +64,20 @@ Value ping(const Array& params, bool fHelp)
     return Value::null;
 }
 
+static Object MsgStatsToJSON(const mapMsgCmdStats& mapStats, bool fTime)
+{
+    Object obj;
+    BOOST_FOREACH(const PAIRTYPE(std::string, CNetMsgStats)& item, mapStats) {
+        Object entry;
+        entry.push_back(Pair("count", item.second.nMsgs));
+        entry.push_back(Pair("bytes", item.second.nBytes));
+        if (fTime)
+            entry.push_back(Pair("timemicros", item.second.nTimeMicros));
+        obj.push_back(Pair(item.first, entry));
+    }
+    return obj;
+}
+
 static void CopyNodeStats(std::vector<CNodeStats>& vstats)
 {
     vstats.clear();
@@ -107,7 +121,23 @@ Value getpeerinfo(const Array& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
+            "    \"msgsent\": {              (json object) Messages sent to the peer by command\n"
+            "      \"command\": {\n"
+            "        \"count\": n,           (numeric) Number of messages\n"
+            "        \"bytes\": n            (numeric) Total size including headers\n"
+            "      },\n"
+            "      ...\n"
+            "    },\n"
+            "    \"msgrecv\": {              (json object) Messages received from the peer by command\n"
+            "      \"command\": {\n"
+            "        \"count\": n,           (numeric) Number of messages\n"
+            "        \"bytes\": n,           (numeric) Total size including headers\n"
+            "        \"timemicros\": n       (numeric) Time spent processing them in microseconds\n"
+            "      },\n"
+            "      ...\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -156,6 +186,8 @@ Value getpeerinfo(const Array& params, bool fHelp)
             obj.push_back(Pair("inflight", heights));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
+        obj.push_back(Pair("msgsent", MsgStatsToJSON(stats.mapSendMsgStats, false)));
+        obj.push_back(Pair("msgrecv", MsgStatsToJSON(stats.mapRecvMsgStats, true)));
 
         ret.push_back(obj);
     }
@@ -418,6 +450,45 @@ Value getnettotals(const Array& params, bool fHelp)
     return obj;
 }
 
+Value getnetmsgstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getnetmsgstats\n"
+            "\nReturns the number, size and processing time of the messages exchanged with all peers\n"
+            "since startup, by command. See getpeerinfo for the numbers of each connected peer.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"sent\": {                  (json object) Messages sent by command\n"
+            "    \"command\": {\n"
+            "      \"count\": n,           (numeric) Number of messages\n"
+            "      \"bytes\": n            (numeric) Total size including headers\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"received\": {              (json object) Messages received by command\n"
+            "    \"command\": {\n"
+            "      \"count\": n,           (numeric) Number of messages\n"
+            "      \"bytes\": n,           (numeric) Total size including headers\n"
+            "      \"timemicros\": n       (numeric) Time spent processing them in microseconds\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnetmsgstats", "")
+            + HelpExampleRpc("getnetmsgstats", "")
+       );
+
+    mapMsgCmdStats mapSent, mapRecv;
+    CNode::GetTotalMsgStats(mapSent, mapRecv);
+
+    Object obj;
+    obj.push_back(Pair("sent", MsgStatsToJSON(mapSent, false)));
+    obj.push_back(Pair("received", MsgStatsToJSON(mapRecv, true)));
+    return obj;
+}
+
 static Array GetNetworksInfo()
 {
     Array networks;
@@ -486,7 +557,7 @@ Value getnetworkinfo(const Array& params, bool fHelp)
     obj.push_back(Pair("version",       CLIENT_VERSION));
     obj.push_back(Pair("subversion",    strSubVersion));
     obj.push_back(Pair("protocolversion",PROTOCOL_VERSION));
-    obj.push_back(Pair("localservices",       strprintf("%016x", nLocalServices)));
+    obj.push_back(Pair("localservices",       strprintf("%016x", nLocalServices.load())));
     obj.push_back(Pair("timeoffset",    GetTimeOffset()));
     obj.push_back(Pair("connections",   (int)vNodes.size()));
     obj.push_back(Pair("networks",      GetNetworksInfo()));
@@ -312,6 +312,7 @@ static const CRPCCommand vRPCCommands[] =
   //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
     /* Overall control/query calls */
     { "control",            "getinfo",                &getinfo,                true,      false,      false }, /* uses wallet if enabled */
+    { "control",            "getstartupinfo",         &getstartupinfo,         true,      true,       false },
     { "control",            "help",                   &help,                   true,      true,       false },
     { "control",            "stop",                   &stop,                   true,      true,       false },
     { "control",            "restart",                &restart,                true,      true,       false },
@@ -322,6 +323,7 @@ static const CRPCCommand vRPCCommands[] =
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,      true,       false },
     { "network",            "getconnectioncount",     &getconnectioncount,     true,      false,      false },
     { "network",            "getnettotals",           &getnettotals,           true,      true,       false },
+    { "network",            "getnetmsgstats",         &getnetmsgstats,         true,      true,       false },
     { "network",            "getpeerinfo",            &getpeerinfo,            true,      false,      false },
     { "network",            "ping",                   &ping,                   true,      false,      false },
 
@@ -348,6 +350,8 @@ static const CRPCCommand vRPCCommands[] =
     { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,      false,      false },
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,      false,      false },
     { "mining",             "submitblock",            &submitblock,            true,      true,       false },
+    { "mining",             "createauxblock",         &createauxblock,         true,      true,       false },
+    { "mining",             "submitauxblock",         &submitauxblock,         true,      true,       false },
 
 #ifdef ENABLE_WALLET
     /* Coin generation */
@@ -2087,6 +2087,8 @@ Value getwalletinfo(const Array& params, bool fHelp)
             "  \"keypoololdest\": xxxxxx,    (numeric) the timestamp (seconds since GMT epoch) of the oldest pre-generated key in the key pool\n"
             "  \"keypoolsize\": xxxx,        (numeric) how many new keys are pre-generated\n"
             "  \"unlocked_until\": ttt,      (numeric) the timestamp in seconds since epoch (midnight Jan 1 1970 GMT) that the wallet is unlocked for transfers, or 0 if the wallet is locked\n"
+            "  \"dbcommits\": xxxx,          (numeric) wallet database commits since startup\n"
+            "  \"dbflushes\": xxxx,          (numeric) wallet database log flushes (checkpoints) since startup\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getwalletinfo", "")
@@ -2101,5 +2103,10 @@ Value getwalletinfo(const Array& params, bool fHelp)
     obj.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
     if (pwalletMain->IsCrypted())
         obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
+    {
+        LOCK(bitdb.cs_db);
+        obj.push_back(Pair("dbcommits", bitdb.nCommits));
+        obj.push_back(Pair("dbflushes", bitdb.nFlushes));
+    }
     return obj;
 }
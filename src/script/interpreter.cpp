@@ -1078,6 +1078,99 @@ bool TransactionSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
     return true;
 }
 
+namespace {
+
+/**
+ * The stack a scriptSig of plain data pushes leaves, without the
+ * interpreter. False for any other scriptSig and for anything the
+ * interpreter would refuse, stackRet is untouched then and the caller
+ * runs the script.
+ */
+bool EvalPushOnly(const CScript& script, unsigned int flags, vector<valtype>& stackRet)
+{
+    if (script.size() > 10000)
+        return false;
+    vector<valtype> stack;
+    CScript::const_iterator pc = script.begin();
+    opcodetype opcode;
+    valtype vch;
+    while (pc < script.end())
+    {
+        if (!script.GetOp(pc, opcode, vch) || opcode > OP_PUSHDATA4 || vch.size() > MAX_SCRIPT_ELEMENT_SIZE)
+            return false;
+        if ((flags & SCRIPT_VERIFY_MINIMALDATA) != 0 && !CheckMinimalPush(vch, opcode))
+            return false;
+        stack.push_back(vch);
+        // Leave room for the element the templates push
+        if (stack.size() >= 1000)
+            return false;
+    }
+    stackRet.swap(stack);
+    return true;
+}
+
+bool HashEquals(const valtype& vch, CScript::const_iterator pHash)
+{
+    valtype vchHash(20);
+    CHash160().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+    return std::equal(vchHash.begin(), vchHash.end(), pHash);
+}
+
+/**
+ * Pay-to-pubkey-hash and pay-to-pubkey straight to the signature check.
+ * False if scriptPubKey or the stack are not of that form and the
+ * interpreter has to run. Otherwise fValid and serror are set to what the
+ * interpreter gives.
+ */
+bool VerifyStandardTemplate(const vector<valtype>& stack, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, bool& fValid, ScriptError* serror)
+{
+    valtype vchPubKey;
+    if (stack.size() == 2 && scriptPubKey.IsPayToPublicKeyHash()) {
+        vchPubKey = stack[1];
+        if (!HashEquals(vchPubKey, scriptPubKey.begin() + 3)) {
+            fValid = set_error(serror, SCRIPT_ERR_EQUALVERIFY);
+            return true;
+        }
+    } else if (stack.size() == 1 && scriptPubKey.IsPayToPublicKey()) {
+        vchPubKey.assign(scriptPubKey.begin() + 1, scriptPubKey.end() - 1);
+    } else {
+        return false;
+    }
+    const valtype& vchSig = stack[0];
+
+    // Same as OP_CHECKSIG
+    CScript scriptCode(scriptPubKey);
+    scriptCode.FindAndDelete(CScript(vchSig));
+    if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, serror)) {
+        fValid = false;
+        return true;
+    }
+    if (checker.CheckSig(vchSig, vchPubKey, scriptCode))
+        fValid = set_success(serror);
+    else
+        fValid = set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    return true;
+}
+
+bool VerifyRedeemScript(vector<valtype>& stack, const CScript& redeemScript, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    bool fValid;
+    if (VerifyStandardTemplate(stack, redeemScript, flags, checker, fValid, serror))
+        return fValid;
+
+    if (!EvalScript(stack, redeemScript, flags, checker, serror))
+        // serror is set
+        return false;
+    if (stack.empty())
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    if (!CastToBool(stack.back()))
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    else
+        return set_success(serror);
+}
+
+} // anon namespace
+
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
@@ -1087,6 +1180,27 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
     }
 
     vector<vector<unsigned char> > stack, stackCopy;
+
+    // Nearly all scripts are pushes spending one of the standard templates,
+    // those skip the interpreter
+    if (EvalPushOnly(scriptSig, flags, stack))
+    {
+        bool fValid;
+        if (VerifyStandardTemplate(stack, scriptPubKey, flags, checker, fValid, serror))
+            return fValid;
+        if (scriptPubKey.IsPayToScriptHash() && !stack.empty())
+        {
+            if (!HashEquals(stack.back(), scriptPubKey.begin() + 2))
+                return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+            if ((flags & SCRIPT_VERIFY_P2SH) == 0)
+                return set_success(serror);
+            CScript redeemScript(stack.back().begin(), stack.back().end());
+            popstack(stack);
+            return VerifyRedeemScript(stack, redeemScript, flags, checker, serror);
+        }
+        stack.clear();
+    }
+
     if (!EvalScript(stack, scriptSig, flags, checker, serror))
         // serror is set
         return false;
@@ -1117,15 +1231,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
         popstack(stackCopy);
 
-        if (!EvalScript(stackCopy, pubKey2, flags, checker, serror))
-            // serror is set
-            return false;
-        if (stackCopy.empty())
-            return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
-        if (!CastToBool(stackCopy.back()))
-            return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
-        else
-            return set_success(serror);
+        return VerifyRedeemScript(stackCopy, pubKey2, flags, checker, serror);
     }
 
     return set_success(serror);
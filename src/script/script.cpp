@@ -243,6 +243,22 @@ bool CScript::IsPayToScriptHash() const
             (*this)[22] == OP_EQUAL);
 }
 
+bool CScript::IsPayToPublicKeyHash() const
+{
+    return (this->size() == 25 &&
+            (*this)[0] == OP_DUP &&
+            (*this)[1] == OP_HASH160 &&
+            (*this)[2] == 0x14 &&
+            (*this)[23] == OP_EQUALVERIFY &&
+            (*this)[24] == OP_CHECKSIG);
+}
+
+bool CScript::IsPayToPublicKey() const
+{
+    return ((this->size() == 35 && (*this)[0] == 33 && (*this)[34] == OP_CHECKSIG) ||
+            (this->size() == 67 && (*this)[0] == 65 && (*this)[66] == OP_CHECKSIG));
+}
+
 bool CScript::IsProofOfStakeMarker() const
 {
     return (this->size() > 1 && (*this)[0] == OP_PROOFOFSTAKE);
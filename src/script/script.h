@@ -591,6 +591,10 @@ public:
 
     bool IsNormalPaymentScript() const;
     bool IsPayToScriptHash() const;
+    /** OP_DUP OP_HASH160 20 [20 byte hash] OP_EQUALVERIFY OP_CHECKSIG */
+    bool IsPayToPublicKeyHash() const;
+    /** A compressed or uncompressed size key push followed by OP_CHECKSIG */
+    bool IsPayToPublicKey() const;
 
     /** Proof of Stake is marked via OP code */
     bool IsProofOfStakeMarker() const;
@@ -5,12 +5,18 @@
 
 #include "script/standard.h"
 
+#include "hash.h"
 #include "pubkey.h"
+#include "random.h"
 #include "script/script.h"
+#include "sync.h"
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <limits>
+
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 using namespace std;
 
@@ -34,10 +40,78 @@ const char* GetTxnOutputType(txnouttype t)
     return NULL;
 }
 
+namespace {
+
+/** Salted so scripts cannot be picked to land in one bucket */
+class CScriptCacheHasher
+{
+private:
+    uint64_t k0;
+    uint64_t k1;
+
+public:
+    CScriptCacheHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript& script) const {
+        CSipHasher hasher(k0, k1);
+        if (!script.empty())
+            hasher.Write(&script[0], script.size());
+        return hasher.Finalize();
+    }
+};
+
 /**
- * Return public keys or hashes from scriptPubKey, for 'standard' transaction types.
+ * Solver results by script bytes, for the scripts the template scan has
+ * to parse: multisig and nonstandard ones. The outputs of a wallet or a
+ * multisig address are solved over and over by IsMine, IsStandard and
+ * ExtractDestination.
  */
-bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet)
+class CSolverCache
+{
+private:
+    struct Entry
+    {
+        bool fSolved;
+        txnouttype type;
+        vector<valtype> vSolutions;
+    };
+
+    typedef boost::unordered_map<CScript, Entry, CScriptCacheHasher> map_type;
+    map_type mapEntries;
+    CCriticalSection cs;
+
+public:
+    bool Get(const CScript& script, bool& fSolved, txnouttype& typeRet, vector<valtype>& vSolutionsRet)
+    {
+        LOCK(cs);
+        map_type::const_iterator it = mapEntries.find(script);
+        if (it == mapEntries.end())
+            return false;
+        fSolved = it->second.fSolved;
+        typeRet = it->second.type;
+        vSolutionsRet = it->second.vSolutions;
+        return true;
+    }
+
+    void Set(const CScript& script, bool fSolved, txnouttype type, const vector<valtype>& vSolutions)
+    {
+        LOCK(cs);
+        while (mapEntries.size() >= SOLVER_CACHE_SIZE)
+        {
+            map_type::size_type s = GetRand(mapEntries.bucket_count());
+            map_type::local_iterator it = mapEntries.begin(s);
+            if (it != mapEntries.end(s))
+                mapEntries.erase(it->first);
+        }
+
+        Entry& entry = mapEntries[script];
+        entry.fSolved = fSolved;
+        entry.type = type;
+        entry.vSolutions = vSolutions;
+    }
+};
+
+bool SolveTemplates(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet)
 {
     // Templates
     static multimap<txnouttype, CScript> mTemplates;
@@ -58,16 +132,6 @@ bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsi
         mTemplates.insert(make_pair(TX_NULL_DATA, CScript() << OP_RETURN));
     }
 
-    // Shortcut for pay-to-script-hash, which are more constrained than the other types:
-    // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
-    if (scriptPubKey.IsPayToScriptHash())
-    {
-        typeRet = TX_SCRIPTHASH;
-        vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
-        vSolutionsRet.push_back(hashBytes);
-        return true;
-    }
-
     // Scan templates
     const CScript& script1 = scriptPubKey;
     BOOST_FOREACH(const PAIRTYPE(txnouttype, CScript)& tplate, mTemplates)
@@ -159,6 +223,50 @@ bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsi
     return false;
 }
 
+} // anon namespace
+
+/**
+ * Return public keys or hashes from scriptPubKey, for 'standard' transaction types.
+ */
+bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet)
+{
+    // Shortcut for pay-to-script-hash, which are more constrained than the other types:
+    // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
+    if (scriptPubKey.IsPayToScriptHash())
+    {
+        typeRet = TX_SCRIPTHASH;
+        vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
+        vSolutionsRet.push_back(hashBytes);
+        return true;
+    }
+
+    // The same shortcut for the two single key templates
+    if (scriptPubKey.IsPayToPublicKeyHash())
+    {
+        typeRet = TX_PUBKEYHASH;
+        vSolutionsRet.assign(1, valtype(scriptPubKey.begin()+3, scriptPubKey.begin()+23));
+        return true;
+    }
+    if (scriptPubKey.IsPayToPublicKey())
+    {
+        typeRet = TX_PUBKEY;
+        vSolutionsRet.assign(1, valtype(scriptPubKey.begin()+1, scriptPubKey.end()-1));
+        return true;
+    }
+
+    // Data carriers depend on -datacarriersize and are not worth keeping
+    if (scriptPubKey.size() > MAX_SCRIPT_ELEMENT_SIZE || (!scriptPubKey.empty() && scriptPubKey[0] == OP_RETURN))
+        return SolveTemplates(scriptPubKey, typeRet, vSolutionsRet);
+
+    static CSolverCache solverCache;
+    bool fSolved;
+    if (solverCache.Get(scriptPubKey, fSolved, typeRet, vSolutionsRet))
+        return fSolved;
+    fSolved = SolveTemplates(scriptPubKey, typeRet, vSolutionsRet);
+    solverCache.Set(scriptPubKey, fSolved, typeRet, vSolutionsRet);
+    return fSolved;
+}
+
 int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char> >& vSolutions)
 {
     switch (t)
@@ -28,6 +28,9 @@ public:
 static const unsigned int MAX_OP_RETURN_RELAY = 40;      //! bytes
 extern unsigned nMaxDatacarrierBytes;
 
+//! Scripts whose Solver result is kept, see Solver
+static const size_t SOLVER_CACHE_SIZE = 4096;
+
 /**
  * Mandatory script verification flags that all new blocks must comply with for
  * them to be valid. (but old blocks may not comply with) Currently just P2SH,
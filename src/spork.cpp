@@ -12,6 +12,8 @@
 #include "masternode-budget.h"
 #include <boost/lexical_cast.hpp>
 
+#include <atomic>
+
 using namespace std;
 using namespace boost;
 
@@ -23,6 +25,46 @@ CSporkManager sporkManager;
 std::map<uint256, CSporkMessage> mapSporks;
 std::map<int, CSporkMessage> mapSporksActive;
 
+//! Marks a spork that has not been received, its default applies
+static const int64_t SPORK_VALUE_UNSET = std::numeric_limits<int64_t>::min();
+
+/**
+ * Values of the received sporks by ID, read without locking by IsSporkActive
+ * and GetSporkValue on the validation paths. Written only where a spork
+ * message is accepted, together with mapSporksActive.
+ */
+static std::atomic<int64_t> nSporkValues[SPORK_END - SPORK_START + 1];
+static std::atomic<uint64_t> nSporkVersion(0);
+
+static struct CSporkValuesInit
+{
+    CSporkValuesInit() {
+        for (size_t i = 0; i < sizeof(nSporkValues) / sizeof(nSporkValues[0]); i++)
+            nSporkValues[i].store(SPORK_VALUE_UNSET, std::memory_order_relaxed);
+    }
+} sporkValuesInit;
+
+static void SetSporkActive(const CSporkMessage& spork)
+{
+    mapSporksActive[spork.nSporkID] = spork;
+    if (spork.nSporkID >= SPORK_START && spork.nSporkID <= SPORK_END) {
+        nSporkValues[spork.nSporkID - SPORK_START].store(spork.nValue, std::memory_order_relaxed);
+        nSporkVersion.fetch_add(1, std::memory_order_release);
+    }
+}
+
+static int64_t GetReceivedSporkValue(int nSporkID)
+{
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END)
+        return SPORK_VALUE_UNSET;
+    return nSporkValues[nSporkID - SPORK_START].load(std::memory_order_relaxed);
+}
+
+uint64_t GetSporkVersion()
+{
+    return nSporkVersion.load(std::memory_order_acquire);
+}
+
 
 void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
@@ -56,7 +98,7 @@ void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
         }
 
         mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        SetSporkActive(spork);
         sporkManager.Relay(spork);
 
         //does a task if needed
@@ -77,11 +119,10 @@ void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 // grab the spork, otherwise say it's off
 bool IsSporkActive(int nSporkID)
 {
-    int64_t r = -1;
+    int64_t r = GetReceivedSporkValue(nSporkID);
 
-    if(mapSporksActive.count(nSporkID)){
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
+    if(r == SPORK_VALUE_UNSET){
+        r = -1;
         if(nSporkID == SPORK_2_INSTANTX) r = SPORK_2_INSTANTX_DEFAULT;
         if(nSporkID == SPORK_3_INSTANTX_BLOCK_FILTERING) r = SPORK_3_INSTANTX_BLOCK_FILTERING_DEFAULT;
         if(nSporkID == SPORK_4_ENABLE_MASTERNODE_PAYMENTS)
@@ -109,11 +150,10 @@ bool IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t GetSporkValue(int nSporkID)
 {
-    int64_t r = -1;
+    int64_t r = GetReceivedSporkValue(nSporkID);
 
-    if(mapSporksActive.count(nSporkID)){
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
+    if(r == SPORK_VALUE_UNSET){
+        r = -1;
         if(nSporkID == SPORK_2_INSTANTX) r = SPORK_2_INSTANTX_DEFAULT;
         if(nSporkID == SPORK_3_INSTANTX_BLOCK_FILTERING) r = SPORK_3_INSTANTX_BLOCK_FILTERING_DEFAULT;
         if(nSporkID == SPORK_4_ENABLE_MASTERNODE_PAYMENTS) r = SPORK_4_ENABLE_MASTERNODE_PAYMENTS_DEFAULT;
@@ -244,7 +284,7 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
     if(Sign(msg)){
         Relay(msg);
         mapSporks[msg.GetHash()] = msg;
-        mapSporksActive[nSporkID] = msg;
+        SetSporkActive(msg);
         return true;
     }
 
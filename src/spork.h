@@ -68,6 +68,8 @@ extern CSporkManager sporkManager;
 void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 int64_t GetSporkValue(int nSporkID);
 bool IsSporkActive(int nSporkID);
+/** Number of spork updates accepted so far, for observers that cache spork dependent state */
+uint64_t GetSporkVersion();
 void ExecuteSpork(int nSporkID, int nValue);
 void ReprocessBlocks(int nBlocks);
 
@@ -0,0 +1,129 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "startuptasks.h"
+
+#include "sync.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <assert.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+static CCriticalSection cs_startup;
+static const int64_t nStartupBegin = GetTimeMillis();
+static int64_t nStartupFinished = 0;
+static std::vector<CStartupStage> vStartupStages;
+
+void CStartupTaskGraph::Add(const std::string& strName, const Task& task, const std::vector<std::string>& vDepends)
+{
+    Node node;
+    node.strName = strName;
+    node.task = task;
+    node.vDepends = vDepends;
+    node.nPending = vDepends.size();
+
+    BOOST_FOREACH(const std::string& strDepend, vDepends) {
+        size_t i = 0;
+        while (i < vNodes.size() && vNodes[i].strName != strDepend)
+            i++;
+        assert(i < vNodes.size());
+        vNodes[i].vDependents.push_back(vNodes.size());
+    }
+    vNodes.push_back(node);
+}
+
+bool CStartupTaskGraph::Run(unsigned int nThreads)
+{
+    int64_t nStart = GetTimeMillis();
+
+    nRunning = 0;
+    nDone = 0;
+    fFailed = false;
+    for (size_t i = 0; i < vNodes.size(); i++)
+        if (vNodes[i].nPending == 0)
+            queueReady.push_back(i);
+
+    nThreads = std::max(std::min(nThreads, (unsigned int)vNodes.size()), 1u);
+    boost::thread_group workers;
+    for (unsigned int i = 0; i < nThreads; i++)
+        workers.create_thread(boost::bind(&CStartupTaskGraph::Worker, this));
+    workers.join_all();
+
+    LogPrintf("Startup tasks: %u of %u done on %u threads  %dms\n", nDone, vNodes.size(), nThreads, GetTimeMillis() - nStart);
+    return !fFailed && nDone == vNodes.size();
+}
+
+void CStartupTaskGraph::Worker()
+{
+    RenameThread("crown-startup");
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (true) {
+        while (queueReady.empty() && nRunning > 0 && !fFailed)
+            cond.wait(lock);
+        // Nothing ready and nothing running left means all tasks are done
+        if (fFailed || queueReady.empty())
+            break;
+
+        Node& node = vNodes[queueReady.front()];
+        queueReady.pop_front();
+        nRunning++;
+        lock.unlock();
+
+        int64_t nStart = GetTimeMillis();
+        bool fSuccess = false;
+        try {
+            fSuccess = node.task();
+        } catch (const std::exception& e) {
+            LogPrintf("Startup task %s failed: %s\n", node.strName, e.what());
+        }
+        RecordStartupStage(node.strName, nStart, GetTimeMillis(), fSuccess, node.vDepends);
+
+        lock.lock();
+        nRunning--;
+        if (fSuccess) {
+            nDone++;
+            BOOST_FOREACH(size_t nDependent, node.vDependents)
+                if (--vNodes[nDependent].nPending == 0)
+                    queueReady.push_back(nDependent);
+        } else {
+            fFailed = true;
+        }
+        cond.notify_all();
+    }
+}
+
+void RecordStartupStage(const std::string& strName, int64_t nStart, int64_t nEnd, bool fSuccess, const std::vector<std::string>& vDepends)
+{
+    CStartupStage stage;
+    stage.strName = strName;
+    stage.vDepends = vDepends;
+    stage.nStart = nStart;
+    stage.nEnd = nEnd;
+    stage.fSuccess = fSuccess;
+
+    LogPrintf("Startup stage %-14s %6dms after %6dms%s\n", strName, nEnd - nStart, nStart - nStartupBegin, fSuccess ? "" : " FAILED");
+
+    LOCK(cs_startup);
+    vStartupStages.push_back(stage);
+}
+
+void SetStartupFinished()
+{
+    LOCK(cs_startup);
+    nStartupFinished = GetTimeMillis();
+    LogPrintf("Startup finished after %dms\n", nStartupFinished - nStartupBegin);
+}
+
+std::vector<CStartupStage> GetStartupStages(int64_t& nBegin, int64_t& nFinished)
+{
+    LOCK(cs_startup);
+    nBegin = nStartupBegin;
+    nFinished = nStartupFinished;
+    return vStartupStages;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_STARTUPTASKS_H
+#define BITCOIN_STARTUPTASKS_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** One step of the node startup, times in milliseconds */
+struct CStartupStage
+{
+    std::string strName;
+    std::vector<std::string> vDepends;
+    int64_t nStart;
+    int64_t nEnd;
+    bool fSuccess;
+};
+
+/**
+ * Startup steps with explicit dependencies, run on a pool of threads. A task
+ * starts as soon as all tasks it depends on have succeeded. Once a task
+ * fails no further tasks are started, the running ones are waited for.
+ * Dependencies must be added before the tasks that need them, so there
+ * are no cycles.
+ */
+class CStartupTaskGraph
+{
+public:
+    typedef boost::function<bool()> Task;
+
+    void Add(const std::string& strName, const Task& task, const std::vector<std::string>& vDepends = std::vector<std::string>());
+
+    /** Run all tasks on up to nThreads threads, false if any task failed */
+    bool Run(unsigned int nThreads);
+
+private:
+    struct Node
+    {
+        std::string strName;
+        Task task;
+        std::vector<std::string> vDepends;
+        std::vector<size_t> vDependents;
+        size_t nPending;
+    };
+
+    std::vector<Node> vNodes;
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<size_t> queueReady;
+    size_t nRunning;
+    size_t nDone;
+    bool fFailed;
+
+    void Worker();
+};
+
+/** Record a stage that ran outside a task graph and log its time */
+void RecordStartupStage(const std::string& strName, int64_t nStart, int64_t nEnd, bool fSuccess = true,
+                        const std::vector<std::string>& vDepends = std::vector<std::string>());
+
+/** Mark the node as started, ready to serve */
+void SetStartupFinished();
+
+/** Stages recorded so far in the order they ended, with the start of the process and of serving (0 while starting) */
+std::vector<CStartupStage> GetStartupStages(int64_t& nBegin, int64_t& nFinished);
+
+#endif // BITCOIN_STARTUPTASKS_H
@@ -116,6 +116,7 @@ public:
     bool empty() const                               { return vch.size() == nReadPos; }
     void resize(size_type n, value_type c=0)         { vch.resize(n + nReadPos, c); }
     void reserve(size_type n)                        { vch.reserve(n + nReadPos); }
+    size_type capacity() const                       { return vch.capacity() - nReadPos; }
     const_reference operator[](size_type pos) const  { return vch[pos + nReadPos]; }
     reference operator[](size_type pos)              { return vch[pos + nReadPos]; }
     void clear()                                     { vch.clear(); nReadPos = 0; }
@@ -296,6 +297,12 @@ public:
         data.insert(data.end(), begin(), end());
         clear();
     }
+
+    //! Exchange the underlying storage with data, to hand over or recycle a buffer without copying
+    void SwapData(vector_type& data) {
+        vch.swap(data);
+        nReadPos = 0;
+    }
 };
 
 
@@ -70,8 +70,9 @@ bool CSystemnodePayments::IsTransactionValid(const CAmount& nValueCreated, const
 {
     LOCK(cs_mapSystemnodeBlocks);
 
-    if(mapSystemnodeBlocks.count(nBlockHeight)){
-        return mapSystemnodeBlocks[nBlockHeight].IsTransactionValid(txNew, nValueCreated);
+    CSystemnodeBlockPayees* pblockPayees = systemnodeBlocks.Get(nBlockHeight);
+    if(pblockPayees){
+        return pblockPayees->IsTransactionValid(txNew, nValueCreated);
     }
 
     return true;
@@ -96,17 +97,22 @@ void CSystemnodePayments::ProcessMessageSystemnodePayments(CNode* pfrom, std::st
 
         int nCountNeeded;
         vRecv >> nCountNeeded;
+        // newer peers ask for the votes in snwa aggregates, older ones send only the count
+        bool fAggregate = false;
+        if(!vRecv.empty()) vRecv >> fAggregate;
 
+        // an aggregated sync may be followed by one request for the votes as inventory, see "snwa"
+        std::string strRequest = fAggregate ? "snwaget" : "snget";
         if(Params().NetworkID() == CBaseChainParams::MAIN){
-            if(pfrom->HasFulfilledRequest("snget")) {
+            if(pfrom->HasFulfilledRequest(strRequest)) {
                 LogPrintf("snget - peer already asked me for the list\n");
                 Misbehaving(pfrom->GetId(), 20);
                 return;
             }
         }
 
-        pfrom->FulfilledRequest("snget");
-        systemnodePayments.Sync(pfrom, nCountNeeded);
+        pfrom->FulfilledRequest(strRequest);
+        systemnodePayments.Sync(pfrom, nCountNeeded, fAggregate);
         LogPrintf("snget - Sent Systemnode winners to %s\n", pfrom->addr.ToString().c_str());
     }
     else if (strCommand == "snw") { //Systemnode Payments Declare Winner
@@ -135,36 +141,127 @@ void CSystemnodePayments::ProcessMessageSystemnodePayments(CNode* pfrom, std::st
             return;
         }
 
-        std::string strError = "";
-        if(!winner.IsValid(pfrom, strError)){
-            if(strError != "") LogPrintf("snw - invalid message - %s\n", strError);
+        systemnodePayments.AcceptWinner(pfrom, winner, nHeight, false);
+    }
+    else if (strCommand == "snwa") { //Systemnode Payments Winner Aggregate, sent during sync
+        CSystemnodePaymentWinnerAggregate aggregate;
+        vRecv >> aggregate;
+
+        if(pfrom->nVersion < MIN_MNW_PEER_PROTO_VERSION) return;
+
+        // only sent in answer to our snget, each one costs a rank list and signature checks
+        if(!pfrom->HasFulfilledRequest("snwsync")){
+            LogPrint("snpayments", "snwa - unrequested aggregate from %s\n", pfrom->addr.ToString());
             return;
         }
 
-        if(!systemnodePayments.CanVote(winner.vinSystemnode.prevout, winner.nBlockHeight)){
-            LogPrintf("snw - systemnode already voted - %s\n", winner.vinSystemnode.prevout.ToStringShort());
+        if(!aggregate.IsWellFormed()){
+            LogPrintf("snwa - malformed aggregate from %s\n", pfrom->addr.ToString());
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        int nHeight;
+        {
+            TRY_LOCK(cs_main, locked);
+            if(!locked || chainActive.Tip() == NULL) return;
+            nHeight = chainActive.Tip()->nHeight;
+        }
+
+        int nFirstBlock = nHeight - (snodeman.CountEnabled()*1.25);
+        if(aggregate.nBlockHeight < nFirstBlock || aggregate.nBlockHeight > nHeight+20){
+            LogPrint("snpayments", "snwa - winners out of range - FirstBlock %d Height %d bestHeight %d\n", nFirstBlock, aggregate.nBlockHeight, nHeight);
             return;
         }
 
+        // the ranks are computed once for all voters of the aggregate
+        std::vector<pair<int, CSystemnode> > vecRanks = snodeman.GetSystemnodeRanks(aggregate.nBlockHeight-100, MIN_MNW_PEER_PROTO_VERSION);
+
+        size_t nSig = 0;
+        int nValid = 0;
+        for(int nRank = 1; nRank <= SNPAYMENTS_SIGNATURES_TOTAL; nRank++){
+            if(!aggregate.HasVoter(nRank)) continue;
+            const std::vector<unsigned char>& vchSig = aggregate.vSigs[nSig++];
+            if(nRank > (int)vecRanks.size()) break;
+
+            CSystemnodePaymentWinner winner(vecRanks[nRank-1].second.vin);
+            winner.nBlockHeight = aggregate.nBlockHeight;
+            winner.payee = aggregate.payee;
+            winner.vchSig = vchSig;
+            winner.nRank = nRank;
+
+            if(systemnodePayments.mapSystemnodePayeeVotes.count(winner.GetHash())){
+                systemnodeSync.AddedSystemnodeWinner(winner.GetHash());
+                nValid++;
+                continue;
+            }
+
+            // a different systemnode list at the sender only shows as a signature that does not match
+            if(!winner.SignatureValid()){
+                LogPrint("snpayments", "snwa - signature does not match rank %d\n", winner.nRank);
+                continue;
+            }
+            nValid++;
+
+            systemnodePayments.AcceptWinner(pfrom, winner, nHeight, true);
+        }
+
+        // a systemnode list that differs from the sender's shifts the ranks and fails every
+        // signature, that is no fault of the peer, so ask it once for its votes as inventory
+        if(nValid == 0 && pfrom->nVersion >= MIN_PAYMENT_VOTES_INV_PROTO_VERSION && !pfrom->HasFulfilledRequest("snwsyncinv")){
+            LogPrint("snpayments", "snwa - no valid signature in aggregate from %s, asking for the votes as inventory\n", pfrom->addr.ToString());
+            pfrom->FulfilledRequest("snwsyncinv");
+            pfrom->PushMessage("snget", snodeman.CountEnabled(), false);
+        }
+    }
+}
+
+/**
+ * Check and store a vote that is in range and not known yet. Votes of an
+ * aggregate already have their rank from our systemnode list and their
+ * signature checked by the caller.
+ */
+bool CSystemnodePayments::AcceptWinner(CNode* pfrom, CSystemnodePaymentWinner& winner, int nHeight, bool fAggregated)
+{
+    const char* strCommand = fAggregated ? "snwa" : "snw";
+
+    if(fAggregated){
+        if(!CanVote(winner.vinSystemnode.prevout, winner.nBlockHeight)){
+            LogPrintf("%s - systemnode already voted - %s\n", strCommand, winner.vinSystemnode.prevout.ToStringShort());
+            return false;
+        }
+    } else {
+        std::string strError = "";
+        if(!winner.IsValid(pfrom, strError)){
+            if(strError != "") LogPrintf("%s - invalid message - %s\n", strCommand, strError);
+            return false;
+        }
+
+        if(!CanVote(winner.vinSystemnode.prevout, winner.nBlockHeight)){
+            LogPrintf("%s - systemnode already voted - %s\n", strCommand, winner.vinSystemnode.prevout.ToStringShort());
+            return false;
+        }
+
         if(!winner.SignatureValid()){
-            LogPrintf("snw - invalid signature\n");
+            LogPrintf("%s - invalid signature\n", strCommand);
             if(systemnodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
             // it could just be a non-synced systemnode
             snodeman.AskForSN(pfrom, winner.vinSystemnode);
-            return;
+            return false;
         }
+    }
 
-        CTxDestination address1;
-        ExtractDestination(winner.payee, address1);
-        CBitcoinAddress address2(address1);
+    CTxDestination address1;
+    ExtractDestination(winner.payee, address1);
+    CBitcoinAddress address2(address1);
 
-        LogPrint("snpayments", "snw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinSystemnode.prevout.ToStringShort());
+    LogPrint("snpayments", "%s - winning vote - Addr %s Height %d bestHeight %d - %s\n", strCommand, address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinSystemnode.prevout.ToStringShort());
 
-        if(systemnodePayments.AddWinningSystemnode(winner)){
-            winner.Relay();
-            systemnodeSync.AddedSystemnodeWinner(winner.GetHash());
-        }
-    }
+    if(!AddWinningSystemnode(winner)) return false;
+
+    winner.Relay();
+    systemnodeSync.AddedSystemnodeWinner(winner.GetHash());
+    return true;
 }
 
 bool CSystemnodePayments::CanVote(COutPoint outSystemnode, int nBlockHeight)
@@ -270,8 +367,9 @@ std::string CSystemnodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
     LOCK(cs_mapSystemnodeBlocks);
 
-    if(mapSystemnodeBlocks.count(nBlockHeight)){
-        return mapSystemnodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    CSystemnodeBlockPayees* pblockPayees = systemnodeBlocks.Get(nBlockHeight);
+    if(pblockPayees){
+        return pblockPayees->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -334,11 +432,18 @@ bool CSystemnodeBlockPayees::IsTransactionValid(const CTransaction& txNew, const
 
 bool CSystemnodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 {
-    if(mapSystemnodeBlocks.count(nBlockHeight)){
-        return mapSystemnodeBlocks[nBlockHeight].GetPayee(payee);
-    }
+    LOCK(cs_mapSystemnodeBlocks);
 
-    return false;
+    CSystemnodeBlockPayees* pblockPayees = systemnodeBlocks.Get(nBlockHeight);
+    return pblockPayees && pblockPayees->GetPayee(payee);
+}
+
+bool CSystemnodePayments::HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq)
+{
+    LOCK(cs_mapSystemnodeBlocks);
+
+    CSystemnodeBlockPayees* pblockPayees = systemnodeBlocks.Get(nBlockHeight);
+    return pblockPayees && pblockPayees->HasPayeeWithVotes(payee, nVotesReq);
 }
 
 void CSystemnodePayments::CheckAndRemove()
@@ -352,22 +457,15 @@ void CSystemnodePayments::CheckAndRemove()
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    //keep up to five cycles for historical sake
-    int nLimit = std::max(int(snodeman.size()*1.25), 1000);
-
-    std::map<uint256, CSystemnodePaymentWinner>::iterator it = mapSystemnodePayeeVotes.begin();
-    while(it != mapSystemnodePayeeVotes.end()) {
-        CSystemnodePaymentWinner winner = (*it).second;
+    //keep up to five cycles for historical sake, leave room in the window for votes ahead of the tip
+    int nLimit = std::min(std::max(int(snodeman.size()*1.25), 1000), PAYMENT_VOTE_WINDOW - 100);
 
-        if(nHeight - winner.nBlockHeight > nLimit){
-            LogPrint("snpayments", "CSystemnodePayments::CleanPaymentList - Removing old Systemnode payment - block %d\n", winner.nBlockHeight);
-            systemnodeSync.mapSeenSyncSNW.erase((*it).first);
-            mapSystemnodePayeeVotes.erase(it++);
-            mapSystemnodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+    std::vector<uint256> vExpired;
+    systemnodeBlocks.ExpireBelow(nHeight - nLimit, vExpired);
+    if(!vExpired.empty()){
+        LogPrint("snpayments", "CSystemnodePayments::CleanPaymentList - Removing %d old Systemnode payments below block %d\n", vExpired.size(), nHeight - nLimit);
     }
+    RemoveVotes(vExpired);
 }
 
 bool CSystemnodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
@@ -406,6 +504,7 @@ bool CSystemnodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
         return false;
     }
 
+    nRank = n;
     return true;
 }
 
@@ -415,8 +514,9 @@ bool CSystemnodePayments::ProcessBlock(int nBlockHeight)
 
     //reference node - hybrid mode
 
+    int n = 0;
     if(!IsReferenceNode(activeSystemnode.vin)) {
-        int n = snodeman.GetSystemnodeRank(activeSystemnode.vin, nBlockHeight - 100, MIN_MNW_PEER_PROTO_VERSION);
+        n = snodeman.GetSystemnodeRank(activeSystemnode.vin, nBlockHeight - 100, MIN_MNW_PEER_PROTO_VERSION);
 
         if(n == -1)
         {
@@ -434,6 +534,7 @@ bool CSystemnodePayments::ProcessBlock(int nBlockHeight)
     if(nBlockHeight <= nLastBlockHeight) return false;
 
     CSystemnodePaymentWinner newWinner(activeSystemnode.vin);
+    newWinner.nRank = n;
 
     LogPrintf("CSystemnodePayments::ProcessBlock() Start nHeight %d - vin %s. \n", nBlockHeight, activeSystemnode.vin.ToString().c_str());
     // pay to the oldest MN that still had no payment but its input is old enough and it was active long enough
@@ -491,26 +592,50 @@ bool CSystemnodePayments::AddWinningSystemnode(CSystemnodePaymentWinner& winnerI
         return false;
     }
 
-    {
-        LOCK2(cs_mapSystemnodePayeeVotes, cs_mapSystemnodeBlocks);
-    
-        if(mapSystemnodePayeeVotes.count(winnerIn.GetHash())){
-           return false;
-        }
+    LOCK2(cs_mapSystemnodePayeeVotes, cs_mapSystemnodeBlocks);
 
-        mapSystemnodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+    uint256 hash = winnerIn.GetHash();
+    if(mapSystemnodePayeeVotes.count(hash)){
+       return false;
+    }
 
-        if(!mapSystemnodeBlocks.count(winnerIn.nBlockHeight)){
-           CSystemnodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-           mapSystemnodeBlocks[winnerIn.nBlockHeight] = blockPayees;
-        }
+    // votes of a height that drops out of the window go with it
+    std::vector<uint256> vExpired;
+    if(!AddVoteToBlocks(hash, winnerIn, vExpired)){
+        return false;
     }
+    RemoveVotes(vExpired);
+    mapSystemnodePayeeVotes[hash] = winnerIn;
+
+    return true;
+}
 
+bool CSystemnodePayments::AddVoteToBlocks(const uint256& hash, CSystemnodePaymentWinner& winner, std::vector<uint256>& vExpired)
+{
     int n = 1;
-    if(IsReferenceNode(winnerIn.vinSystemnode)) n = 100;
-    mapSystemnodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, n);
+    if(IsReferenceNode(winner.vinSystemnode)) n = 100;
+    return systemnodeBlocks.AddVote(winner.nBlockHeight, hash, winner.payee, n, vExpired);
+}
 
-    return true;
+void CSystemnodePayments::RemoveVotes(const std::vector<uint256>& vHashes)
+{
+    BOOST_FOREACH(const uint256& hash, vHashes) {
+        systemnodeSync.mapSeenSyncSNW.erase(hash);
+        mapSystemnodePayeeVotes.erase(hash);
+    }
+}
+
+void CSystemnodePayments::RebuildBlocks()
+{
+    LOCK2(cs_mapSystemnodePayeeVotes, cs_mapSystemnodeBlocks);
+
+    systemnodeBlocks.Clear();
+    std::vector<uint256> vRemove;
+    for (std::map<uint256, CSystemnodePaymentWinner>::iterator it = mapSystemnodePayeeVotes.begin(); it != mapSystemnodePayeeVotes.end(); ++it) {
+        if(!AddVoteToBlocks(it->first, it->second, vRemove))
+            vRemove.push_back(it->first);
+    }
+    RemoveVotes(vRemove);
 }
 
 void CSystemnodePaymentWinner::Relay()
@@ -541,9 +666,9 @@ bool CSystemnodePaymentWinner::SignatureValid()
     return false;
 }
 
-void CSystemnodePayments::Sync(CNode* node, int nCountNeeded)
+void CSystemnodePayments::Sync(CNode* node, int nCountNeeded, bool fAggregate)
 {
-    LOCK(cs_mapSystemnodePayeeVotes);
+    LOCK2(cs_mapSystemnodePayeeVotes, cs_mapSystemnodeBlocks);
 
     int nHeight;
     {
@@ -556,15 +681,33 @@ void CSystemnodePayments::Sync(CNode* node, int nCountNeeded)
     if(nCountNeeded > nCount) nCountNeeded = nCount;
 
     int nInvCount = 0;
-    std::map<uint256, CSystemnodePaymentWinner>::iterator it = mapSystemnodePayeeVotes.begin();
-    while(it != mapSystemnodePayeeVotes.end()) {
-        CSystemnodePaymentWinner winner = (*it).second;
-        if(winner.nBlockHeight >= nHeight-nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
-            node->PushInventory(CInv(MSG_SYSTEMNODE_WINNER, winner.GetHash()));
+    int nAggregates = 0;
+    for(int h = nHeight-nCountNeeded; h <= nHeight + 20; h++) {
+        const std::vector<uint256>* pvVotes = systemnodeBlocks.GetVotes(h);
+        if(!pvVotes) continue;
+
+        // votes with a known rank go in one aggregate per payee, the others as inventory
+        std::map<CScript, std::map<int, const CSystemnodePaymentWinner*> > mapByPayee;
+        BOOST_FOREACH(const uint256& hash, *pvVotes) {
+            const CSystemnodePaymentWinner& winner = mapSystemnodePayeeVotes[hash];
+            if(fAggregate && winner.nRank >= 1 && winner.nRank <= SNPAYMENTS_SIGNATURES_TOTAL && !mapByPayee[winner.payee].count(winner.nRank)) {
+                mapByPayee[winner.payee][winner.nRank] = &winner;
+            } else {
+                // an aggregate has one vote per rank, others of the same rank go as inventory
+                node->PushInventory(CInv(MSG_SYSTEMNODE_WINNER, hash));
+            }
             nInvCount++;
         }
-        ++it;
+
+        for(std::map<CScript, std::map<int, const CSystemnodePaymentWinner*> >::iterator it = mapByPayee.begin(); it != mapByPayee.end(); ++it) {
+            CSystemnodePaymentWinnerAggregate aggregate(h, it->first);
+            for(std::map<int, const CSystemnodePaymentWinner*>::iterator itRank = it->second.begin(); itRank != it->second.end(); ++itRank)
+                aggregate.AddVoter(itRank->first, itRank->second->vchSig);
+            node->PushMessage("snwa", aggregate);
+            nAggregates++;
+        }
     }
+    LogPrint("snpayments", "CSystemnodePayments::Sync - %d votes, %d aggregates to %s\n", nInvCount, nAggregates, node->addr.ToString());
     node->PushMessage("snssc", SYSTEMNODE_SYNC_SNW, nInvCount);
 }
 
@@ -581,22 +724,8 @@ bool CSystemnodePayments::IsScheduled(CSystemnode& sn, int nNotBlockHeight)
         nHeight = chainActive.Tip()->nHeight;
     }
 
-    CScript snpayee;
-    snpayee = GetScriptForDestination(sn.pubkey.GetID());
-
-    CScript payee;
-    for(int64_t h = nHeight; h <= nHeight+8; h++){
-        if(h == nNotBlockHeight) continue;
-        if(mapSystemnodeBlocks.count(h)){
-            if(mapSystemnodeBlocks[h].GetPayee(payee)){
-                if(snpayee == payee) {
-                    return true;
-                }
-            }
-        }
-    }
-
-    return false;
+    CScript snpayee = GetScriptForDestination(sn.pubkey.GetID());
+    return systemnodeBlocks.IsLeading(snpayee, nHeight, nHeight+8, nNotBlockHeight);
 }
 
 std::string CSystemnodePayments::ToString() const
@@ -604,7 +733,7 @@ std::string CSystemnodePayments::ToString() const
     std::ostringstream info;
 
     info << "Votes: " << (int)mapSystemnodePayeeVotes.size() <<
-            ", Blocks: " << (int)mapSystemnodeBlocks.size();
+            ", Blocks: " << (int)systemnodeBlocks.size();
 
     return info.str();
 }
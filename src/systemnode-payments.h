@@ -7,6 +7,7 @@
 
 #include "key.h"
 #include "main.h"
+#include "paymentvotes.h"
 #include "systemnode.h"
 #include <boost/lexical_cast.hpp>
 
@@ -133,17 +134,21 @@ public:
     int nBlockHeight;
     CScript payee;
     std::vector<unsigned char> vchSig;
+    //! Rank of the voter at nBlockHeight-100 when the vote was checked, 0 if unknown, not serialized
+    int nRank;
 
     CSystemnodePaymentWinner() {
         nBlockHeight = 0;
         vinSystemnode = CTxIn();
         payee = CScript();
+        nRank = 0;
     }
 
     CSystemnodePaymentWinner(CTxIn vinIn) {
         nBlockHeight = 0;
         vinSystemnode = vinIn;
         payee = CScript();
+        nRank = 0;
     }
 
     uint256 GetHash(){
@@ -185,6 +190,56 @@ public:
     }
 };
 
+// All votes of one height for one payee, sent as a single snwa message
+// during sync: a bitmap of the voters over the systemnode ranks of the
+// height, followed by their signatures in rank order
+class CSystemnodePaymentWinnerAggregate
+{
+public:
+    int nBlockHeight;
+    CScript payee;
+    std::vector<unsigned char> vchVoters;
+    std::vector<std::vector<unsigned char> > vSigs;
+
+    CSystemnodePaymentWinnerAggregate() {
+        nBlockHeight = 0;
+    }
+
+    CSystemnodePaymentWinnerAggregate(int nBlockHeightIn, const CScript& payeeIn) {
+        nBlockHeight = nBlockHeightIn;
+        payee = payeeIn;
+        vchVoters.resize((SNPAYMENTS_SIGNATURES_TOTAL + 7) / 8);
+    }
+
+    bool HasVoter(int nRank) const {
+        return nRank >= 1 && nRank <= SNPAYMENTS_SIGNATURES_TOTAL && (vchVoters[(nRank-1) / 8] >> ((nRank-1) % 8)) & 1;
+    }
+
+    // voters must be added in rank order
+    void AddVoter(int nRank, const std::vector<unsigned char>& vchSig) {
+        vchVoters[(nRank-1) / 8] |= 1 << ((nRank-1) % 8);
+        vSigs.push_back(vchSig);
+    }
+
+    bool IsWellFormed() const {
+        if(vchVoters.size() != (SNPAYMENTS_SIGNATURES_TOTAL + 7) / 8) return false;
+        size_t nVoters = 0;
+        for(int nRank = 1; nRank <= SNPAYMENTS_SIGNATURES_TOTAL; nRank++)
+            if(HasVoter(nRank)) nVoters++;
+        return nVoters > 0 && nVoters == vSigs.size();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nBlockHeight);
+        READWRITE(*(CScriptBase*)(&payee));
+        READWRITE(vchVoters);
+        READWRITE(vSigs);
+    }
+};
+
 //
 // Systemnode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -195,10 +250,16 @@ class CSystemnodePayments
 private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
+    //! Tallies of the votes by height, guarded by cs_mapSystemnodeBlocks
+    CPaymentVoteWindow<CSystemnodeBlockPayees> systemnodeBlocks;
+
+    bool AcceptWinner(CNode* pfrom, CSystemnodePaymentWinner& winner, int nHeight, bool fAggregated);
+    bool AddVoteToBlocks(const uint256& hash, CSystemnodePaymentWinner& winner, std::vector<uint256>& vExpired);
+    void RemoveVotes(const std::vector<uint256>& vHashes);
+    void RebuildBlocks();
 
 public:
     std::map<uint256, CSystemnodePaymentWinner> mapSystemnodePayeeVotes;
-    std::map<int, CSystemnodeBlockPayees> mapSystemnodeBlocks;
     std::map<COutPoint, int> mapSystemnodesLastVote;
 
     CSystemnodePayments() {
@@ -209,17 +270,18 @@ public:
 
     void Clear() {
         LOCK2(cs_mapSystemnodeBlocks, cs_mapSystemnodePayeeVotes);
-        mapSystemnodeBlocks.clear();
+        systemnodeBlocks.Clear();
         mapSystemnodePayeeVotes.clear();
     }
 
     bool ProcessBlock(int nBlockHeight);
     int GetMinSystemnodePaymentsProto() const;
     void ProcessMessageSystemnodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
-    void Sync(CNode* node, int nCountNeeded);
+    void Sync(CNode* node, int nCountNeeded, bool fAggregate = false);
     void CheckAndRemove();
     bool IsTransactionValid(const CAmount& nValueCreated, const CTransaction& txNew, int nBlockHeight);
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
+    bool HasPayeeWithVotes(int nBlockHeight, const CScript& payee, int nVotesReq);
     bool IsScheduled(CSystemnode& sn, int nNotBlockHeight);
     bool CanVote(COutPoint outSystemnode, int nBlockHeight);
     std::string GetRequiredPaymentsString(int nBlockHeight);
@@ -231,7 +293,20 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
         READWRITE(mapSystemnodePayeeVotes);
+        // The tallies are rebuilt from the votes
+        std::map<int, CSystemnodeBlockPayees> mapSystemnodeBlocks;
         READWRITE(mapSystemnodeBlocks);
+        if (ser_action.ForRead())
+            RebuildBlocks();
+    }
+
+    /// Systemnode payee votes by hash, the tallies per height are rebuilt from them after a read
+    template <typename Records>
+    void RecordsOp(Records& r) {
+        LOCK2(cs_mapSystemnodeBlocks, cs_mapSystemnodePayeeVotes);
+        r.Map('v', mapSystemnodePayeeVotes);
+        if (r.ForRead())
+            RebuildBlocks();
     }
 };
 
@@ -178,6 +178,7 @@ void CSystemnodeSync::ClearFulfilledRequest()
         pnode->ClearFulfilledRequest("sngetspork");
         pnode->ClearFulfilledRequest("snsync");
         pnode->ClearFulfilledRequest("snwsync");
+        pnode->ClearFulfilledRequest("snwsyncinv");
     }
 }
 
@@ -224,7 +225,8 @@ void CSystemnodeSync::Process()
                 snodeman.DsegUpdate(pnode); 
             } else if(RequestedSystemnodeAttempt < 6) {
                 int nMnCount = snodeman.CountEnabled();
-                pnode->PushMessage("snget", nMnCount); //sync payees
+                pnode->FulfilledRequest("snwsync");
+                pnode->PushMessage("snget", nMnCount, true); //sync payees, aggregated
                 uint256 n = uint256();
                 pnode->PushMessage("snvs", n); //sync systemnode votes
             } else {
@@ -310,7 +312,7 @@ void CSystemnodeSync::Process()
                 if(pindexPrev == NULL) return;
 
                 int nSnCount = snodeman.CountEnabled();
-                pnode->PushMessage("snget", nSnCount); //sync payees
+                pnode->PushMessage("snget", nSnCount, true); //sync payees, aggregated
                 RequestedSystemnodeAttempt++;
 
                 return;
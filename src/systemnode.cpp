@@ -7,6 +7,7 @@
 #include "systemnode-sync.h"
 #include "activesystemnode.h"
 #include "legacysigner.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "sync.h"
 #include "addrman.h"
@@ -115,6 +116,7 @@ bool CSystemnodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             }
 
             psn->lastPing = *this;
+            uiInterface.NotifySystemnodeChanged(vin, CT_UPDATED);
 
             //snodeman.mapSeenSystemnodeBroadcast.lastPing is probably outdated, so we'll update it
             CSystemnodeBroadcast snb(*psn);
@@ -263,12 +265,21 @@ bool CSystemnode::UpdateFromNewBroadcast(const CSystemnodeBroadcast& snb)
             lastPing = snb.lastPing;
             snodeman.mapSeenSystemnodePing.insert(make_pair(lastPing.GetHash(), lastPing));
         }
+        uiInterface.NotifySystemnodeChanged(vin, CT_UPDATED);
         return true;
     }
     return false;
 }
 
 void CSystemnode::Check(bool forceCheck)
+{
+    int nActiveStatePrev = activeState;
+    CheckActiveState(forceCheck);
+    if(activeState != nActiveStatePrev)
+        uiInterface.NotifySystemnodeChanged(vin, CT_UPDATED);
+}
+
+void CSystemnode::CheckActiveState(bool forceCheck)
 {
     if(ShutdownRequested()) return;
 
@@ -356,14 +367,12 @@ int64_t CSystemnode::GetLastPaid() const
         }
         n++;
 
-        if(systemnodePayments.mapSystemnodeBlocks.count(BlockReading->nHeight)){
-            /*
-                Search for this payee, with at least 2 votes. This will aid in consensus allowing the network 
-                to converge on the same payees quickly, then keep the same schedule.
-            */
-            if(systemnodePayments.mapSystemnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(snpayee, 2)){
-                return BlockReading->nTime + nOffset;
-            }
+        /*
+            Search for this payee, with at least 2 votes. This will aid in consensus allowing the network 
+            to converge on the same payees quickly, then keep the same schedule.
+        */
+        if(systemnodePayments.HasPayeeWithVotes(BlockReading->nHeight, snpayee, 2)){
+            return BlockReading->nTime + nOffset;
         }
 
         if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
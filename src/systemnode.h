@@ -195,7 +195,9 @@ public:
 
     int64_t SecondsSincePayment() const;
     bool UpdateFromNewBroadcast(const CSystemnodeBroadcast& snb);
+    /// Re-evaluate activeState, notifying the UI when it changes
     void Check(bool forceCheck = false);
+    void CheckActiveState(bool forceCheck);
     bool IsBroadcastedWithin(int seconds) const
     {
         return (GetAdjustedTime() - sigTime) < seconds;
@@ -6,6 +6,7 @@
 #include "systemnode-sync.h"
 #include "masternodeman.h"
 #include "legacysigner.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "addrman.h"
 #include "spork.h"
@@ -275,6 +276,28 @@ CSystemnode *CSystemnodeMan::Find(const CTxIn &vin)
     return NULL;
 }
 
+bool CSystemnodeMan::Get(const CTxIn& vin, CSystemnode& snRet)
+{
+    LOCK(cs);
+
+    CSystemnode* psn = Find(vin);
+    if(psn == NULL)
+        return false;
+    snRet = *psn;
+    return true;
+}
+
+std::vector<CTxIn> CSystemnodeMan::GetSystemnodeVins()
+{
+    LOCK(cs);
+
+    std::vector<CTxIn> vVins;
+    vVins.reserve(vSystemnodes.size());
+    BOOST_FOREACH(const CSystemnode& sn, vSystemnodes)
+        vVins.push_back(sn.vin);
+    return vVins;
+}
+
 CSystemnode *CSystemnodeMan::Find(const CPubKey &pubKeySystemnode)
 {
     LOCK(cs);
@@ -377,6 +400,7 @@ bool CSystemnodeMan::Add(CSystemnode &sn)
     {
         LogPrint("systemnode", "CSystemnodeMan: Adding new Systemnode %s - %i now\n", sn.addr.ToString(), size() + 1);
         vSystemnodes.push_back(sn);
+        uiInterface.NotifySystemnodeChanged(sn.vin, CT_NEW);
         return true;
     }
 
@@ -408,6 +432,7 @@ void CSystemnodeMan::Remove(CTxIn vin)
     while(it != vSystemnodes.end()){
         if((*it).vin == vin){
             LogPrint("systemnode", "CSystemnodeMan: Removing Systemnode %s - %i now\n", (*it).addr.ToString(), size() - 1);
+            uiInterface.NotifySystemnodeChanged(vin, CT_DELETED);
             vSystemnodes.erase(it);
             break;
         }
@@ -466,6 +491,8 @@ std::string CSystemnodeMan::ToString() const
 void CSystemnodeMan::Clear()
 {
     LOCK(cs);
+    BOOST_FOREACH(const CSystemnode& sn, vSystemnodes)
+        uiInterface.NotifySystemnodeChanged(sn.vin, CT_DELETED);
     vSystemnodes.clear();
     mAskedUsForSystemnodeList.clear();
     mWeAskedForSystemnodeList.clear();
@@ -577,6 +604,7 @@ void CSystemnodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            uiInterface.NotifySystemnodeChanged((*it).vin, CT_DELETED);
             it = vSystemnodes.erase(it);
         } else {
             ++it;
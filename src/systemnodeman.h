@@ -60,6 +60,18 @@ public:
         READWRITE(mapSeenSystemnodePing);
     }
 
+    /// Systemnode list, list requests both ways and the broadcasts and pings already seen
+    template <typename Records>
+    void RecordsOp(Records& r) {
+        LOCK(cs);
+        r.Vector('s', vSystemnodes);
+        r.Map('a', mAskedUsForSystemnodeList);
+        r.Map('w', mWeAskedForSystemnodeList);
+        r.Map('e', mWeAskedForSystemnodeListEntry);
+        r.Map('b', mapSeenSystemnodeBroadcast);
+        r.Map('p', mapSeenSystemnodePing);
+    }
+
     //CSystemnodeMan();
     //CSystemnodeMan(CSystemnodeMan& other);
 
@@ -94,6 +106,10 @@ public:
     CSystemnode* GetCurrentSystemNode(int mod=1, int64_t nBlockHeight=0, int minProtocol=0);
 
     std::vector<CSystemnode> GetFullSystemnodeVector() { Check(); return vSystemnodes; }
+    /// Copy a single entry, for callers that must not keep pointers into the list
+    bool Get(const CTxIn& vin, CSystemnode& snRet);
+    /// Collateral inputs of all entries
+    std::vector<CTxIn> GetSystemnodeVins();
     
     std::vector<pair<int, CSystemnode> > GetSystemnodeRanks(int64_t nBlockHeight, int minProtocol=0);
     int GetSystemnodeRank(const CTxIn &vin, int64_t nBlockHeight, int minProtocol=0, bool fOnlyActive=true);
@@ -0,0 +1,90 @@
+// Copyright (c) 2012-2014 The Bitcoin Core developers
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addrman.h"
+#include "hash.h"
+#include "streams.h"
+#include "clientversion.h"
+
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(addrman_tests)
+
+BOOST_AUTO_TEST_CASE(addrman_add_select)
+{
+    CAddrMan addrman;
+    CNetAddr source("252.2.2.2");
+
+    BOOST_CHECK_EQUAL(addrman.size(), 0);
+    BOOST_CHECK(!addrman.Select().IsValid());
+
+    CAddress addr1(CService("250.1.1.1", 9340));
+    BOOST_CHECK(addrman.Add(addr1, source));
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+    BOOST_CHECK(addrman.Select() == addr1);
+
+    // Same address, same information: not added again
+    BOOST_CHECK(!addrman.Add(addr1, source));
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+
+    // A batch is added in one pass (entries may collide in the new buckets
+    // of a single source, so not all of them need to stay)
+    vector<CAddress> vAddr;
+    for (int i = 1; i <= 100; i++)
+        vAddr.push_back(CAddress(CService(strprintf("250.2.%d.%d", i / 10, i), 9340)));
+    BOOST_CHECK(addrman.Add(vAddr, source));
+    BOOST_CHECK(addrman.size() > 1);
+
+    addrman.Clear();
+    BOOST_CHECK_EQUAL(addrman.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_good_moves_to_tried)
+{
+    CAddrMan addrman;
+    CNetAddr source("252.2.2.2");
+
+    CAddress addr1(CService("250.1.1.1", 9340));
+    addrman.Add(addr1, source);
+    addrman.Good(addr1);
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+
+    // Only a tried entry is left, Select must return it
+    BOOST_CHECK(addrman.Select() == addr1);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_serialize_checksummed)
+{
+    CAddrMan addrman;
+    CNetAddr source("252.2.2.2");
+    for (int i = 1; i <= 50; i++)
+        addrman.Add(CAddress(CService(strprintf("250.3.%d.%d", i / 10, i), 9340)), source);
+    addrman.Good(CService("250.3.0.1", 9340));
+    int nSize = addrman.size();
+
+    // Write the way CAddrDB does: hash while streaming, then append the hash
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    CHashingWriter<CDataStream> hashout(&ss);
+    hashout << addrman;
+    uint256 hashWritten = hashout.GetHash();
+    BOOST_CHECK(hashWritten == Hash(ss.begin(), ss.end()));
+    ss << hashWritten;
+
+    CAddrMan addrman2;
+    CHashVerifier<CDataStream> verifier(&ss);
+    verifier >> addrman2;
+    uint256 hashRead;
+    ss >> hashRead;
+    BOOST_CHECK(hashRead == verifier.GetHash());
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK_EQUAL(addrman2.size(), nSize);
+    BOOST_CHECK(addrman2.Select().IsValid());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
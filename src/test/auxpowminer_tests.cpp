@@ -0,0 +1,60 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "auxpowminer.h"
+
+#include "arith_uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+namespace
+{
+CScript Client(int n)
+{
+    return CScript() << n << OP_DROP;
+}
+
+uint256 BlockHash(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+}
+
+BOOST_AUTO_TEST_SUITE(auxpowminer_tests)
+
+BOOST_AUTO_TEST_CASE(auxblockcache_per_client_limit)
+{
+    CAuxBlockCache cache(3);
+    std::shared_ptr<const CBlock> pblock = std::make_shared<const CBlock>();
+
+    for (int i = 1; i <= 5; i++)
+        cache.Add(Client(1), BlockHash(i), pblock);
+    cache.Add(Client(2), BlockHash(100), pblock);
+
+    // The busy client only loses its own oldest blocks
+    BOOST_CHECK_EQUAL(cache.size(), 4U);
+    BOOST_CHECK(!cache.Get(BlockHash(1)));
+    BOOST_CHECK(!cache.Get(BlockHash(2)));
+    BOOST_CHECK(cache.Get(BlockHash(3)) == pblock);
+    BOOST_CHECK(cache.Get(BlockHash(5)) == pblock);
+    BOOST_CHECK(cache.Get(BlockHash(100)) == pblock);
+
+    // Handing out the same block again does not count twice
+    cache.Add(Client(2), BlockHash(100), pblock);
+    cache.Add(Client(2), BlockHash(101), pblock);
+    cache.Add(Client(2), BlockHash(102), pblock);
+    BOOST_CHECK(cache.Get(BlockHash(100)));
+
+    cache.EraseClient(Client(1));
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+    BOOST_CHECK(!cache.Get(BlockHash(5)));
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    BOOST_CHECK(!cache.Get(BlockHash(100)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
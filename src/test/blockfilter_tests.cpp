@@ -0,0 +1,125 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "hash.h"
+#include "main.h"
+#include "script/script.h"
+
+#include <ios>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    CGCSFilter::ElementSet included, excluded;
+    for (int i = 0; i < 100; ++i) {
+        CGCSFilter::Element element1(32);
+        element1[0] = i;
+        included.insert(element1);
+
+        CGCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded.insert(element2);
+    }
+
+    CGCSFilter filter(0, 0, 10, 1 << 10, included);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    for (CGCSFilter::ElementSet::const_iterator it = included.begin(); it != included.end(); ++it) {
+        BOOST_CHECK(filter.Match(*it));
+
+        // Matching any set that contains an included element succeeds
+        CGCSFilter::ElementSet query = excluded;
+        query.insert(*it);
+        BOOST_CHECK(filter.MatchAny(query));
+    }
+
+    // Decoding the encoded filter gives the same filter
+    CGCSFilter decoded(0, 0, 10, 1 << 10, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), filter.GetN());
+    BOOST_CHECK(decoded.GetEncoded() == filter.GetEncoded());
+    BOOST_CHECK(decoded.MatchAny(included));
+
+    // An empty filter matches nothing
+    CGCSFilter empty(0, 0, 10, 1 << 10, CGCSFilter::ElementSet());
+    BOOST_CHECK_EQUAL(empty.GetN(), 0U);
+    BOOST_CHECK(!empty.MatchAny(included));
+    BOOST_CHECK(CGCSFilter(0, 0, 10, 1 << 10, empty.GetEncoded()).GetN() == 0);
+
+    // Truncated or padded encodings are rejected
+    vector<unsigned char> vTruncated(filter.GetEncoded().begin(), filter.GetEncoded().end() - 1);
+    BOOST_CHECK_THROW(CGCSFilter(0, 0, 10, 1 << 10, vTruncated), std::ios_base::failure);
+    vector<unsigned char> vPadded = filter.GetEncoded();
+    vPadded.push_back(0);
+    BOOST_CHECK_THROW(CGCSFilter(0, 0, 10, 1 << 10, vPadded), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[4], excluded_scripts[3];
+
+    // Output scripts of the block
+    included_scripts[0] << vector<unsigned char>(33, 1) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << vector<unsigned char>(20, 2) << OP_EQUALVERIFY << OP_CHECKSIG;
+    included_scripts[2] << OP_HASH160 << vector<unsigned char>(20, 3) << OP_EQUAL;
+
+    // Script of an output spent by the block
+    included_scripts[3] << OP_DUP << OP_HASH160 << vector<unsigned char>(20, 4) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Data carrier outputs and empty scripts are left out
+    excluded_scripts[0] << OP_RETURN << vector<unsigned char>(10, 5);
+    // Not in the block at all
+    excluded_scripts[1] << OP_DUP << OP_HASH160 << vector<unsigned char>(20, 6) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    CMutableTransaction tx1;
+    tx1.vout.resize(3);
+    tx1.vout[0].scriptPubKey = included_scripts[0];
+    tx1.vout[1].scriptPubKey = included_scripts[1];
+    tx1.vout[2].scriptPubKey = excluded_scripts[0];
+
+    CMutableTransaction tx2;
+    tx2.vout.resize(2);
+    tx2.vout[0].scriptPubKey = included_scripts[2];
+    tx2.vout[1].scriptPubKey = excluded_scripts[2];
+
+    CBlock block;
+    block.vtx.push_back(tx1);
+    block.vtx.push_back(tx2);
+
+    CBlockUndo blockundo;
+    blockundo.vtxundo.push_back(CTxUndo());
+    blockundo.vtxundo[0].vprevout.push_back(CTxInUndo(CTxOut(1000, included_scripts[3])));
+
+    CBlockFilter filter(BLOCK_FILTER_BASIC, block, blockundo);
+    BOOST_CHECK(filter.GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(filter.GetFilter().GetN(), 4U);
+
+    const CGCSFilter& gcs = filter.GetFilter();
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK(gcs.Match(CGCSFilter::Element(included_scripts[i].begin(), included_scripts[i].end())));
+    for (int i = 0; i < 2; ++i)
+        BOOST_CHECK(!gcs.Match(CGCSFilter::Element(excluded_scripts[i].begin(), excluded_scripts[i].end())));
+
+    // A filter rebuilt from its encoding keeps its hash and header
+    CBlockFilter filter2(BLOCK_FILTER_BASIC, block.GetHash(), filter.GetEncodedFilter());
+    BOOST_CHECK(filter2.GetHash() == filter.GetHash());
+
+    // The header commits to the filter hash and the previous header
+    uint256 prevHeader = Hash(BEGIN(block.nTime), END(block.nTime));
+    uint256 hashFilter = filter.GetHash();
+    BOOST_CHECK(filter.ComputeHeader(prevHeader) == Hash(hashFilter.begin(), hashFilter.end(), prevHeader.begin(), prevHeader.end()));
+    BOOST_CHECK(filter.ComputeHeader(prevHeader) != filter.ComputeHeader(uint256()));
+
+    uint8_t nFilterType;
+    BOOST_CHECK(BlockFilterTypeByName(BlockFilterTypeName(BLOCK_FILTER_BASIC), nFilterType));
+    BOOST_CHECK_EQUAL(nFilterType, BLOCK_FILTER_BASIC);
+    BOOST_CHECK(!BlockFilterTypeByName("extended", nFilterType));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
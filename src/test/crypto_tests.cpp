@@ -2,6 +2,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/common.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -130,6 +131,26 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d_nonce_scanner) {
+    // The 80 byte string of sha256_testvectors as a header, the scanner fills in the last 4 bytes
+    std::string header = "As Bitcoin relies on 80 byte header hashes, we want to have an example for that.";
+    CSHA256DNonceScanner scanner((const unsigned char*)header.data());
+    uint32_t nonces[] = {0, 0x2e746168, 0xfffffffc};
+    for (int n = 0; n < 3; n++) {
+        unsigned char hashes[CSHA256DNonceScanner::LANES][CSHA256::OUTPUT_SIZE];
+        scanner.Hash(nonces[n], hashes);
+        for (int l = 0; l < CSHA256DNonceScanner::LANES; l++) {
+            unsigned char vchHeader[80];
+            memcpy(vchHeader, header.data(), 76);
+            WriteLE32(vchHeader + 76, nonces[n] + l);
+            unsigned char hash[CSHA256::OUTPUT_SIZE];
+            CSHA256().Write(vchHeader, 80).Finalize(hash);
+            CSHA256().Write(hash, sizeof(hash)).Finalize(hash);
+            BOOST_CHECK(memcmp(hashes[l], hash, sizeof(hash)) == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
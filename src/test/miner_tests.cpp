@@ -265,4 +265,83 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity, * boost::unit_test::disabled())
     Checkpoints::fEnabled = true;
 }
 */
+
+BOOST_AUTO_TEST_CASE(UpdateBlockTemplate_validity)
+{
+    CScript scriptPubKey = CScript() << OP_TRUE;
+
+    LOCK(cs_main);
+
+    // Undo the changes to the global coins view and mempool on the way
+    // out, also when a required check fails
+    struct TemplateCleanup {
+        uint256 hashFunding;
+        CBlockTemplate* pblocktemplate;
+        TemplateCleanup() : pblocktemplate(NULL) {}
+        ~TemplateCleanup()
+        {
+            delete pblocktemplate;
+            mempool.clear();
+            if (!hashFunding.IsNull())
+                pcoinsTip->ModifyCoins(hashFunding)->Clear();
+        }
+    } cleanup;
+
+    // Outputs to spend that are not from a coinbase, so they don't need to mature
+    CMutableTransaction txFunding;
+    txFunding.vin.resize(1);
+    txFunding.vin[0].prevout.hash = GetRandHash();
+    txFunding.vin[0].prevout.n = 0;
+    txFunding.vout.resize(2);
+    txFunding.vout[0].nValue = 50 * COIN;
+    txFunding.vout[0].scriptPubKey = scriptPubKey;
+    txFunding.vout[1].nValue = 50 * COIN;
+    txFunding.vout[1].scriptPubKey = scriptPubKey;
+    uint256 hashFunding = CTransaction(txFunding).GetHash();
+    cleanup.hashFunding = hashFunding;
+    pcoinsTip->ModifyCoins(hashFunding)->FromTx(txFunding, 0);
+
+    CBlockTemplate *pblocktemplate;
+    BOOST_REQUIRE(pblocktemplate = CreateNewBlock(scriptPubKey));
+    cleanup.pblocktemplate = pblocktemplate;
+    CBlock *pblock = &pblocktemplate->block;
+    BOOST_REQUIRE_EQUAL(pblock->vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], 0);
+
+    // Nothing new in the mempool, nothing to update
+    BOOST_CHECK_EQUAL(UpdateBlockTemplate(pblocktemplate), 0U);
+
+    const CAmount nFees[] = {1000000, 2000000};
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(hashFunding, i);
+        tx.vin[0].scriptSig = CScript() << OP_TRUE;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = txFunding.vout[i].nValue - nFees[i];
+        tx.vout[0].scriptPubKey = scriptPubKey;
+        mempool.addUnchecked(CTransaction(tx).GetHash(), CTxMemPoolEntry(tx, nFees[i], GetTime(), 111.0, chainActive.Height()));
+    }
+
+    BOOST_CHECK_EQUAL(UpdateBlockTemplate(pblocktemplate), 2U);
+    BOOST_REQUIRE_EQUAL(pblock->vtx.size(), 3U);
+    BOOST_REQUIRE_EQUAL(pblocktemplate->vTxFees.size(), 3U);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxSigOps.size(), 3U);
+
+    // The coinbase pays out the fees of the added transactions
+    CAmount nFeesAdded = 0;
+    for (unsigned int i = 1; i < pblocktemplate->vTxFees.size(); i++)
+        nFeesAdded += pblocktemplate->vTxFees[i];
+    BOOST_CHECK_EQUAL(nFeesAdded, nFees[0] + nFees[1]);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -nFeesAdded);
+    BOOST_CHECK_EQUAL(pblock->vtx[0].GetValueOut(), GetBlockValue(chainActive.Height(), nFeesAdded));
+
+    // And the updated block is still one the chain takes
+    CValidationState state;
+    pblock->fChecked = false;
+    BOOST_CHECK(TestBlockValidity(state, *pblock, chainActive.Tip(), false, true));
+    BOOST_CHECK(state.IsValid());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
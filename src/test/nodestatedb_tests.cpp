@@ -0,0 +1,147 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nodestatedb.h"
+
+#include "arith_uint256.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+namespace
+{
+struct CTestState
+{
+    CCriticalSection cs;
+    map<uint256, string> mapItems;
+    vector<int64_t> vValues;
+    int nCount;
+
+    CTestState() : nCount(0) {}
+
+    void Clear()
+    {
+        mapItems.clear();
+        vValues.clear();
+        nCount = 0;
+    }
+
+    template <typename Records>
+    void RecordsOp(Records& r)
+    {
+        LOCK(cs);
+        r.Map('i', mapItems);
+        r.Vector('v', vValues);
+        r.Value('c', nCount);
+    }
+};
+}
+
+BOOST_AUTO_TEST_SUITE(nodestatedb_tests)
+
+BOOST_AUTO_TEST_CASE(nodestatedb_roundtrip)
+{
+    CNodeStateDB db(1 << 20, true);
+
+    CTestState state;
+    for (int i = 0; i < 10; i++) {
+        state.mapItems[ArithToUint256(arith_uint256(i))] = strprintf("item %d", i);
+        state.vValues.push_back(i * 1000);
+    }
+    state.nCount = 42;
+    BOOST_CHECK(db.WriteObject("test", state));
+
+    // Nothing stored under another name
+    CTestState other;
+    bool fFound = true;
+    BOOST_CHECK(db.ReadObject("tes", other, fFound));
+    BOOST_CHECK(!fFound);
+
+    // Shrink the vector and change one entry of each kind
+    state.vValues.resize(7);
+    state.vValues[3] = -1;
+    state.mapItems.erase(ArithToUint256(arith_uint256(5)));
+    state.mapItems[ArithToUint256(arith_uint256(6))] = "changed";
+    state.nCount = 43;
+    BOOST_CHECK(db.WriteObject("test", state));
+
+    CTestState loaded;
+    BOOST_CHECK(db.ReadObject("test", loaded, fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(loaded.mapItems == state.mapItems);
+    BOOST_CHECK(loaded.vValues == state.vValues);
+    BOOST_CHECK_EQUAL(loaded.nCount, 43);
+}
+
+BOOST_AUTO_TEST_CASE(nodestatedb_damaged)
+{
+    CNodeStateDB db(1 << 20, true);
+
+    CTestState state;
+    for (int i = 0; i < 10; i++)
+        state.vValues.push_back(i);
+    BOOST_CHECK(db.WriteObject("test", state));
+
+    // A count too short to decode fails the read and takes all records of the object along
+    BOOST_CHECK(db.Write(make_pair(string("test"), NodeStateRecordKey(1, 'c')), (unsigned char)1));
+    CTestState loaded;
+    bool fFound = false;
+    BOOST_CHECK(!db.ReadObject("test", loaded, fFound));
+    BOOST_CHECK(loaded.vValues.empty());
+
+    BOOST_CHECK(db.ReadObject("test", loaded, fFound));
+    BOOST_CHECK(!fFound);
+
+    // Written again from scratch
+    state.vValues.resize(3);
+    BOOST_CHECK(db.WriteObject("test", state));
+    BOOST_CHECK(db.ReadObject("test", loaded, fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(loaded.vValues == state.vValues);
+}
+
+BOOST_AUTO_TEST_CASE(nodestatedb_writer_diff)
+{
+    CTestState state;
+    for (int i = 0; i < 10; i++)
+        state.mapItems[ArithToUint256(arith_uint256(i))] = strprintf("item %d", i);
+
+    NodeStateRecordHashes mapStored;
+    unsigned int nErased;
+    {
+        CLevelDBBatch batch;
+        CNodeStateWriter writer("test", mapStored, batch, 1, 2);
+        state.RecordsOp(writer);
+        NodeStateRecordHashes mapNew = writer.Finish(nErased);
+        BOOST_CHECK_EQUAL(writer.GetWritten(), 11U);
+        BOOST_CHECK_EQUAL(nErased, 0U);
+        mapStored.swap(mapNew);
+    }
+
+    // Unchanged state writes nothing, a change writes only the changed records
+    {
+        CLevelDBBatch batch;
+        CNodeStateWriter writer("test", mapStored, batch, 1, 2);
+        state.RecordsOp(writer);
+        writer.Finish(nErased);
+        BOOST_CHECK_EQUAL(writer.GetWritten(), 0U);
+        BOOST_CHECK_EQUAL(nErased, 0U);
+    }
+
+    state.mapItems[ArithToUint256(arith_uint256(3))] = "changed";
+    state.mapItems.erase(ArithToUint256(arith_uint256(4)));
+    state.vValues.push_back(1);
+    {
+        CLevelDBBatch batch;
+        CNodeStateWriter writer("test", mapStored, batch, 1, 2);
+        state.RecordsOp(writer);
+        writer.Finish(nErased);
+        BOOST_CHECK_EQUAL(writer.GetWritten(), 2U);
+        BOOST_CHECK_EQUAL(nErased, 1U);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
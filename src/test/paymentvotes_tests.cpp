@@ -0,0 +1,149 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "paymentvotes.h"
+
+#include "arith_uint256.h"
+#include "masternode-payments.h"
+#include "streams.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+namespace
+{
+// Same interface as CMasternodeBlockPayees without the global lock
+struct CTestBlockPayees
+{
+    int nBlockHeight;
+    vector<pair<CScript, int> > vecPayments;
+
+    CTestBlockPayees(int nBlockHeightIn = 0) : nBlockHeight(nBlockHeightIn) {}
+
+    void AddPayee(const CScript& payee, int nIncrement)
+    {
+        for (size_t i = 0; i < vecPayments.size(); i++) {
+            if (vecPayments[i].first == payee) {
+                vecPayments[i].second += nIncrement;
+                return;
+            }
+        }
+        vecPayments.push_back(make_pair(payee, nIncrement));
+    }
+
+    bool GetPayee(CScript& payee)
+    {
+        int nVotes = -1;
+        for (size_t i = 0; i < vecPayments.size(); i++) {
+            if (vecPayments[i].second > nVotes) {
+                payee = vecPayments[i].first;
+                nVotes = vecPayments[i].second;
+            }
+        }
+        return nVotes > -1;
+    }
+};
+
+CScript Payee(int n)
+{
+    return CScript() << n << OP_DROP;
+}
+
+uint256 VoteHash(int nHeight, int n)
+{
+    return ArithToUint256(arith_uint256(nHeight * 1000 + n));
+}
+}
+
+BOOST_AUTO_TEST_SUITE(paymentvotes_tests)
+
+BOOST_AUTO_TEST_CASE(paymentvotes_leaders)
+{
+    CPaymentVoteWindow<CTestBlockPayees> window(16);
+    vector<uint256> vExpired;
+
+    BOOST_CHECK(window.AddVote(100, VoteHash(100, 0), Payee(1), 1, vExpired));
+    BOOST_CHECK(window.AddVote(101, VoteHash(101, 0), Payee(2), 1, vExpired));
+    BOOST_CHECK(window.IsLeading(Payee(1), 100, 108, -1));
+    BOOST_CHECK(!window.IsLeading(Payee(1), 100, 108, 100));
+    BOOST_CHECK(!window.IsLeading(Payee(1), 101, 108, -1));
+
+    // Payee 3 overtakes payee 1 at 100
+    BOOST_CHECK(window.AddVote(100, VoteHash(100, 1), Payee(3), 1, vExpired));
+    BOOST_CHECK(window.IsLeading(Payee(1), 100, 108, -1));
+    BOOST_CHECK(window.AddVote(100, VoteHash(100, 2), Payee(3), 1, vExpired));
+    BOOST_CHECK(!window.IsLeading(Payee(1), 100, 108, -1));
+    BOOST_CHECK(window.IsLeading(Payee(3), 100, 108, -1));
+
+    CScript payee;
+    BOOST_REQUIRE(window.Get(100));
+    BOOST_CHECK(window.Get(100)->GetPayee(payee) && payee == Payee(3));
+    BOOST_CHECK(window.Get(102) == NULL);
+    BOOST_REQUIRE(window.GetVotes(100));
+    BOOST_CHECK_EQUAL(window.GetVotes(100)->size(), 3U);
+    BOOST_CHECK(vExpired.empty());
+    BOOST_CHECK_EQUAL(window.size(), 2U);
+    BOOST_CHECK_EQUAL(window.GetOldest(), 100);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 101);
+}
+
+BOOST_AUTO_TEST_CASE(paymentvotes_expiry)
+{
+    CPaymentVoteWindow<CTestBlockPayees> window(16);
+    vector<uint256> vExpired;
+
+    for (int h = 100; h < 110; h++)
+        BOOST_CHECK(window.AddVote(h, VoteHash(h, 0), Payee(h), 1, vExpired));
+
+    window.ExpireBelow(105, vExpired);
+    BOOST_CHECK_EQUAL(vExpired.size(), 5U);
+    BOOST_CHECK_EQUAL(window.size(), 5U);
+    BOOST_CHECK(window.Get(104) == NULL);
+    BOOST_CHECK(!window.IsLeading(Payee(104), 0, 200, -1));
+    BOOST_CHECK_EQUAL(window.GetOldest(), 105);
+
+    // A height one window ahead takes over the slot, an older one is refused
+    vExpired.clear();
+    BOOST_CHECK(window.AddVote(121, VoteHash(121, 0), Payee(121), 1, vExpired));
+    BOOST_REQUIRE_EQUAL(vExpired.size(), 1U);
+    BOOST_CHECK(vExpired[0] == VoteHash(105, 0));
+    BOOST_CHECK(!window.AddVote(105, VoteHash(105, 1), Payee(105), 1, vExpired));
+    BOOST_CHECK_EQUAL(window.GetOldest(), 106);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 121);
+
+    // Expiry past the whole window empties it
+    vExpired.clear();
+    window.ExpireBelow(1000, vExpired);
+    BOOST_CHECK_EQUAL(vExpired.size(), 5U);
+    BOOST_CHECK_EQUAL(window.size(), 0U);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(paymentvotes_aggregate)
+{
+    CMasternodePaymentWinnerAggregate aggregate(100, Payee(1));
+    BOOST_CHECK(!aggregate.IsWellFormed());
+    aggregate.AddVoter(2, vector<unsigned char>(65, 2));
+    aggregate.AddVoter(9, vector<unsigned char>(65, 9));
+    BOOST_CHECK(aggregate.IsWellFormed());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << aggregate;
+    CMasternodePaymentWinnerAggregate received;
+    ss >> received;
+    BOOST_CHECK(received.IsWellFormed());
+    BOOST_CHECK_EQUAL(received.nBlockHeight, 100);
+    BOOST_CHECK(received.payee == Payee(1));
+    for (int nRank = 0; nRank <= MNPAYMENTS_SIGNATURES_TOTAL + 1; nRank++)
+        BOOST_CHECK_EQUAL(received.HasVoter(nRank), nRank == 2 || nRank == 9);
+    BOOST_REQUIRE_EQUAL(received.vSigs.size(), 2U);
+    BOOST_CHECK(received.vSigs[1] == vector<unsigned char>(65, 9));
+
+    // One signature per voter
+    received.vSigs.pop_back();
+    BOOST_CHECK(!received.IsWellFormed());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
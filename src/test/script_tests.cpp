@@ -12,6 +12,7 @@
 #include "script/script.h"
 #include "script/script_error.h"
 #include "script/sign.h"
+#include "script/standard.h"
 #include "util.h"
 
 #if defined(HAVE_CONSENSUS_LIB)
@@ -46,6 +47,7 @@ static const unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC;
 
 unsigned int ParseScriptFlags(string strFlags);
 string FormatScriptFlags(unsigned int flags);
+bool CastToBool(const vector<unsigned char>& vch);
 
 Array
 read_json(const std::string& jsondata)
@@ -939,6 +941,140 @@ BOOST_AUTO_TEST_CASE(script_combineSigs, * boost::unit_test::disabled())
     BOOST_CHECK(combined == partial3c);
 }
 */
+namespace
+{
+/** Signature checker with a fixed answer that remembers what it was asked */
+class CFixedSignatureChecker : public BaseSignatureChecker
+{
+private:
+    bool fResult;
+
+public:
+    mutable vector<CScript> vScriptCodes;
+
+    CFixedSignatureChecker(bool fResultIn) : fResult(fResultIn) {}
+
+    bool CheckSig(const vector<unsigned char>& vchSig, const vector<unsigned char>& vchPubKey, const CScript& scriptCode) const
+    {
+        vScriptCodes.push_back(scriptCode);
+        return fResult;
+    }
+};
+
+/** VerifyScript as it was before the template shortcuts, every script runs through the interpreter */
+bool InterpretScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int nFlags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    vector<vector<unsigned char> > stack, stackCopy;
+    if (!EvalScript(stack, scriptSig, nFlags, checker, serror))
+        return false;
+    stackCopy = stack;
+    if (!EvalScript(stack, scriptPubKey, nFlags, checker, serror))
+        return false;
+    *serror = SCRIPT_ERR_EVAL_FALSE;
+    if (stack.empty() || !CastToBool(stack.back()))
+        return false;
+    if ((nFlags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash()) {
+        if (!scriptSig.IsPushOnly()) {
+            *serror = SCRIPT_ERR_SIG_PUSHONLY;
+            return false;
+        }
+        CScript redeemScript(stackCopy.back().begin(), stackCopy.back().end());
+        stackCopy.pop_back();
+        if (!EvalScript(stackCopy, redeemScript, nFlags, checker, serror))
+            return false;
+        *serror = SCRIPT_ERR_EVAL_FALSE;
+        if (stackCopy.empty() || !CastToBool(stackCopy.back()))
+            return false;
+    }
+    *serror = SCRIPT_ERR_OK;
+    return true;
+}
+}
+
+BOOST_AUTO_TEST_CASE(script_standard_templates)
+{
+    vector<unsigned char> vchKey(33, 0x11);
+    vchKey[0] = 0x02;
+    vector<unsigned char> vchKeyUncompressed(65, 0x22);
+    vchKeyUncompressed[0] = 0x04;
+    static const unsigned char der[] = { 0x30, 0x06, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01, SIGHASH_ALL };
+    vector<unsigned char> vchSig(der, der + sizeof(der));
+    vector<unsigned char> vchBadSig(3, 0x01);
+
+    vector<CScript> vScriptPubKeys;
+    vScriptPubKeys.push_back(CScript() << OP_DUP << OP_HASH160 << ToByteVector(Hash160(vchKey)) << OP_EQUALVERIFY << OP_CHECKSIG);
+    vScriptPubKeys.push_back(CScript() << OP_DUP << OP_HASH160 << ToByteVector(Hash160(vchKeyUncompressed)) << OP_EQUALVERIFY << OP_CHECKSIG);
+    vScriptPubKeys.push_back(CScript() << vchKey << OP_CHECKSIG);
+    vScriptPubKeys.push_back(CScript() << vchKeyUncompressed << OP_CHECKSIG);
+    vScriptPubKeys.push_back(CScript() << OP_1 << vchKey << OP_1 << OP_CHECKMULTISIG);
+    // Tell how many elements the scriptSig left
+    vScriptPubKeys.push_back(CScript() << OP_DEPTH << OP_1 << OP_EQUAL);
+    vScriptPubKeys.push_back(CScript() << OP_DEPTH << OP_2 << OP_EQUAL);
+    size_t nRedeemScripts = vScriptPubKeys.size();
+    for (size_t i = 0; i < nRedeemScripts; i++)
+        vScriptPubKeys.push_back(GetScriptForDestination(CScriptID(vScriptPubKeys[i])));
+
+    // The key pushed with OP_PUSHDATA1 is not minimal
+    vector<unsigned char> vchNonMinimal(1, OP_PUSHDATA1);
+    vchNonMinimal.push_back(vchKey.size());
+    vchNonMinimal.insert(vchNonMinimal.end(), vchKey.begin(), vchKey.end());
+
+    vector<CScript> vScriptSigs;
+    vScriptSigs.push_back(CScript());
+    vScriptSigs.push_back(CScript() << vchSig);
+    vScriptSigs.push_back(CScript() << vchBadSig);
+    vScriptSigs.push_back(CScript() << vchSig << vchKey);
+    vScriptSigs.push_back(CScript() << vchSig << vchKeyUncompressed);
+    vScriptSigs.push_back(CScript() << vchBadSig << vchKey);
+    vScriptSigs.push_back(CScript() << OP_0 << vchSig);
+    vScriptSigs.push_back(CScript() << OP_1 << vchSig << vchKey);
+    vScriptSigs.push_back(CScript() << vchSig << OP_NOP << vchKey);
+    vScriptSigs.push_back(CScript() << vchSig << OP_NOP);
+    vScriptSigs.push_back((CScript() << vchSig) + CScript(vchNonMinimal.begin(), vchNonMinimal.end()));
+    size_t nScriptSigs = vScriptSigs.size();
+    for (size_t i = 0; i < nScriptSigs; i++)
+        for (size_t j = 0; j < nRedeemScripts; j++)
+            vScriptSigs.push_back(CScript(vScriptSigs[i]) << ToByteVector(vScriptPubKeys[j]));
+
+    vector<unsigned int> vFlags;
+    vFlags.push_back(SCRIPT_VERIFY_NONE);
+    vFlags.push_back(SCRIPT_VERIFY_P2SH);
+    vFlags.push_back(SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_DERSIG | SCRIPT_VERIFY_LOW_S | SCRIPT_VERIFY_MINIMALDATA);
+
+    // Same outcome, error and signature checks as the interpreter
+    for (size_t i = 0; i < vScriptSigs.size(); i++) {
+        for (size_t j = 0; j < vScriptPubKeys.size(); j++) {
+            for (size_t f = 0; f < vFlags.size(); f++) {
+                for (int nResult = 0; nResult < 2; nResult++) {
+                    CFixedSignatureChecker checker(nResult), checkerInterpreter(nResult);
+                    ScriptError err, errInterpreter;
+                    bool fValid = VerifyScript(vScriptSigs[i], vScriptPubKeys[j], vFlags[f], checker, &err);
+                    bool fValidInterpreter = InterpretScript(vScriptSigs[i], vScriptPubKeys[j], vFlags[f], checkerInterpreter, &errInterpreter);
+                    BOOST_CHECK_MESSAGE(fValid == fValidInterpreter && err == errInterpreter && checker.vScriptCodes == checkerInterpreter.vScriptCodes,
+                        "scriptSig " << i << " scriptPubKey " << j << " flags " << vFlags[f] << ": " << ScriptErrorString(err) << " vs " << ScriptErrorString(errInterpreter));
+                }
+            }
+        }
+    }
+
+    // A scriptSig that is pushes only up to some point is run by the
+    // interpreter alone, without what was pushed before it gave up
+    ScriptError err;
+    CScript scriptSigNop = CScript() << vector<unsigned char>(1, 0x42) << OP_NOP;
+    BOOST_CHECK(VerifyScript(scriptSigNop, CScript() << OP_DEPTH << OP_1 << OP_EQUAL, SCRIPT_VERIFY_NONE, BaseSignatureChecker(), &err));
+    BOOST_CHECK(!VerifyScript(scriptSigNop, CScript() << OP_DEPTH << OP_2 << OP_EQUAL, SCRIPT_VERIFY_NONE, BaseSignatureChecker(), &err));
+    BOOST_CHECK(err == SCRIPT_ERR_EVAL_FALSE);
+
+    // Solver gives the same answer when it has seen a script before
+    for (size_t j = 0; j < vScriptPubKeys.size(); j++) {
+        txnouttype type, typeAgain;
+        vector<vector<unsigned char> > vSolutions, vSolutionsAgain;
+        bool fSolved = Solver(vScriptPubKeys[j], type, vSolutions);
+        BOOST_CHECK(Solver(vScriptPubKeys[j], typeAgain, vSolutionsAgain) == fSolved);
+        BOOST_CHECK(type == typeAgain && vSolutions == vSolutionsAgain);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(script_standard_push)
 {
     ScriptError err;
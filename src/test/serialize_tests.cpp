@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "serialize.h"
+#include "primitives/block.h"
 #include "streams.h"
 
 #include <stdint.h>
@@ -159,6 +160,77 @@ BOOST_AUTO_TEST_CASE(insert_delete)
     CSerializeData d;
     ss.GetAndClear(d);
     BOOST_CHECK_EQUAL(ss.size(), 0);
+
+    // SwapData hands the storage over, including bytes already read
+    ss << (char)1 << (char)2 << (char)3;
+    char chRead;
+    ss >> chRead;
+    CSerializeData d2;
+    d2.reserve(100);
+    ss.SwapData(d2);
+    BOOST_CHECK_EQUAL(d2.size(), 3);
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(ss.capacity() >= 100);
+}
+
+BOOST_AUTO_TEST_CASE(shared_ptr)
+{
+    // Same format as the object itself
+    std::shared_ptr<const std::string> p = std::make_shared<const std::string>("shared");
+    CDataStream ss(SER_DISK, 0);
+    ss << p;
+    BOOST_CHECK_EQUAL(::GetSerializeSize(p, SER_DISK, 0), ss.size());
+    CDataStream ssValue(SER_DISK, 0);
+    ssValue << std::string("shared");
+    BOOST_CHECK(ss.str() == ssValue.str());
+
+    // Reading allocates a new object, others holding the old one keep it
+    std::shared_ptr<const std::string> pOld = p;
+    ss << std::string("other");
+    ss >> p;
+    BOOST_CHECK_EQUAL(*p, "shared");
+    BOOST_CHECK(p != pOld);
+    ss >> p;
+    BOOST_CHECK_EQUAL(*p, "other");
+    BOOST_CHECK_EQUAL(*pOld, "shared");
+}
+
+BOOST_AUTO_TEST_CASE(transaction_size_cache)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(3);
+    mtx.vin[1].scriptSig = CScript() << std::vector<unsigned char>(300, 1);
+    mtx.vout.resize(2);
+    mtx.vout[0].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(40, 2);
+
+    CBlock block;
+    block.vtx.push_back(CTransaction());
+    block.vtx.push_back(CTransaction(mtx));
+    mtx.nVersion = 3;
+    mtx.nType = TRANSACTION_GOVERNANCE_VOTE;
+    mtx.extraPayload.resize(70000);
+    block.vtx.push_back(CTransaction(mtx));
+
+    // The cached sizes match what is written, also after a copy and a read
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block.vtx[i];
+        BOOST_CHECK_EQUAL(::GetSerializeSize(block.vtx[i], SER_NETWORK, PROTOCOL_VERSION), ss.size());
+        CTransaction tx;
+        ss >> tx;
+        BOOST_CHECK_EQUAL(::GetSerializeSize(tx, SER_DISK, 0), ::GetSerializeSize(block.vtx[i], SER_NETWORK, PROTOCOL_VERSION));
+        tx = CTransaction();
+        BOOST_CHECK_EQUAL(::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION), ::GetSerializeSize(CMutableTransaction(), SER_NETWORK, PROTOCOL_VERSION));
+    }
+
+    // A stream reserved from the computed size is written without growing
+    unsigned int nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(nSize);
+    CDataStream::size_type nCapacity = ss.capacity();
+    ss << block;
+    BOOST_CHECK_EQUAL(ss.size(), nSize);
+    BOOST_CHECK_EQUAL(ss.capacity(), nCapacity);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
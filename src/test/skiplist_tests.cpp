@@ -99,4 +99,34 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(blockindexarena_test)
+{
+    CBlockIndexArena arena;
+
+    // Reserved entries are contiguous and constructed like CBlockIndex()
+    arena.Reserve(10000);
+    CBlockIndex* pfirst = arena.Allocate();
+    for (int i = 1; i < 10000; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        BOOST_CHECK(pindex == pfirst + i);
+        BOOST_CHECK(pindex->phashBlock == NULL && pindex->pprev == NULL && pindex->nHeight == 0);
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), 10000U);
+
+    // Spliced entries keep their addresses, allocation goes on after our own
+    CBlockIndexArena other;
+    CBlockIndex* pother = other.Allocate();
+    pother->nHeight = 42;
+    arena.Splice(other);
+    BOOST_CHECK_EQUAL(other.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.Size(), 10001U);
+    BOOST_CHECK_EQUAL(pother->nHeight, 42);
+    CBlockIndex* pnext = arena.Allocate();
+    BOOST_CHECK(pnext != pother);
+
+    // An emptied arena can be used again
+    BOOST_CHECK(other.Allocate() != NULL);
+    BOOST_CHECK_EQUAL(other.Size(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,81 @@
+// Copyright (c) 2014-2018 The Crown developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "startuptasks.h"
+
+#include "sync.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+namespace
+{
+struct CTaskLog
+{
+    CCriticalSection cs;
+    vector<string> vOrder;
+
+    bool Run(const string& strName, bool fResult)
+    {
+        LOCK(cs);
+        vOrder.push_back(strName);
+        return fResult;
+    }
+
+    size_t Position(const string& strName)
+    {
+        LOCK(cs);
+        return find(vOrder.begin(), vOrder.end(), strName) - vOrder.begin();
+    }
+};
+}
+
+BOOST_AUTO_TEST_SUITE(startuptasks_tests)
+
+BOOST_AUTO_TEST_CASE(startuptasks_dependencies)
+{
+    CTaskLog log;
+    CStartupTaskGraph graph;
+    vector<string> vAfterA(1, "a");
+    vector<string> vAfterBC;
+    vAfterBC.push_back("b");
+    vAfterBC.push_back("c");
+
+    graph.Add("a", boost::bind(&CTaskLog::Run, &log, "a", true));
+    graph.Add("b", boost::bind(&CTaskLog::Run, &log, "b", true), vAfterA);
+    graph.Add("c", boost::bind(&CTaskLog::Run, &log, "c", true));
+    graph.Add("d", boost::bind(&CTaskLog::Run, &log, "d", true), vAfterBC);
+    BOOST_CHECK(graph.Run(4));
+
+    BOOST_CHECK_EQUAL(log.vOrder.size(), 4U);
+    BOOST_CHECK(log.Position("a") < log.Position("b"));
+    BOOST_CHECK(log.Position("b") < log.Position("d"));
+    BOOST_CHECK(log.Position("c") < log.Position("d"));
+}
+
+BOOST_AUTO_TEST_CASE(startuptasks_failure)
+{
+    CTaskLog log;
+    CStartupTaskGraph graph;
+    vector<string> vAfterA(1, "a");
+
+    // Nothing that depends on a failed task runs
+    graph.Add("a", boost::bind(&CTaskLog::Run, &log, "a", false));
+    graph.Add("b", boost::bind(&CTaskLog::Run, &log, "b", true), vAfterA);
+    BOOST_CHECK(!graph.Run(1));
+    BOOST_CHECK_EQUAL(log.vOrder.size(), 1U);
+    BOOST_CHECK_EQUAL(log.Position("b"), 1U);
+
+    int64_t nBegin, nFinished;
+    vector<CStartupStage> vStages = GetStartupStages(nBegin, nFinished);
+    BOOST_REQUIRE(!vStages.empty());
+    BOOST_CHECK_EQUAL(vStages.back().strName, "a");
+    BOOST_CHECK(!vStages.back().fSuccess);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
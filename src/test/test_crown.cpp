@@ -6,6 +6,7 @@
 
 #include "key.h"
 #include "main.h"
+#include "platform/platform-db.h"
 #include "random.h"
 #include "txdb.h"
 #include "ui_interface.h"
@@ -28,6 +29,7 @@ extern bool fPrintToConsole;
 extern void noui_connect();
 
 struct TestingSetup {
+    ECCVerifyHandle globalVerifyHandle;
     CCoinsViewDB *pcoinsdbview;
     boost::filesystem::path pathTemp;
     boost::thread_group threadGroup;
@@ -48,6 +50,8 @@ struct TestingSetup {
         pblocktree = new CBlockTreeDB(1 << 20, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        // connecting and disconnecting blocks writes to the platform database
+        Platform::PlatformDb::CreateInstance(1 << 20, Platform::PlatformOpt::OptSpeed, true);
         InitBlockIndex();
 #ifdef ENABLE_WALLET
         bool fFirstRun;
@@ -73,6 +77,7 @@ struct TestingSetup {
         delete pcoinsTip;
         delete pcoinsdbview;
         delete pblocktree;
+        Platform::PlatformDb::DestroyInstance();
 #ifdef ENABLE_WALLET
         bitdb.Flush(true);
 #endif
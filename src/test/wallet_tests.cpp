@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "wallet.h"
+#include "walletdb.h"
 
 #include <set>
 #include <stdint.h>
@@ -21,6 +22,8 @@
 
 using namespace std;
 
+extern CWallet* pwalletMain;
+
 typedef set<pair<const CWalletTx*,unsigned int> > CoinSet;
 
 BOOST_AUTO_TEST_SUITE(wallet_tests)
@@ -305,4 +308,66 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(write_batch_tests)
+{
+    LOCK(pwalletMain->cs_wallet);
+
+    // a keypool top-up is written as a single commit
+    uint64_t nCommitsBefore = bitdb.nCommits;
+    unsigned int nPoolSize = pwalletMain->GetKeyPoolSize();
+    BOOST_CHECK(pwalletMain->TopUpKeyPool(nPoolSize + 20));
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), nPoolSize + 21);
+    BOOST_CHECK_EQUAL(bitdb.nCommits, nCommitsBefore + 1);
+
+    // nested batches join the outer one and only the outermost commit counts
+    {
+        CWalletWriteBatch outer(pwalletMain);
+        {
+            CWalletWriteBatch inner(pwalletMain);
+            CWalletDB* pwalletdb = pwalletMain->GetBatchDB();
+            BOOST_CHECK(pwalletdb != NULL);
+            BOOST_CHECK(pwalletdb->WriteOrderPosNext(pwalletMain->nOrderPosNext));
+            nCommitsBefore = bitdb.nCommits;
+            BOOST_CHECK(inner.Commit());
+            BOOST_CHECK_EQUAL(bitdb.nCommits, nCommitsBefore);
+            BOOST_CHECK(pwalletMain->GetBatchDB() == pwalletdb);
+        }
+        BOOST_CHECK(outer.Commit());
+        BOOST_CHECK_EQUAL(bitdb.nCommits, nCommitsBefore + 1);
+    }
+    BOOST_CHECK(pwalletMain->GetBatchDB() == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(keypool_write_batch_limit)
+{
+    LOCK(pwalletMain->cs_wallet);
+
+    // lower the batch size instead of generating more keys than the mock
+    // environment's 10000 locks, and restore it even if a check throws
+    struct BatchSizeRestorer {
+        ~BatchSizeRestorer() { nKeypoolWriteBatchSize = DEFAULT_KEYPOOL_WRITE_BATCH_SIZE; }
+    } restorer;
+    nKeypoolWriteBatchSize = 10;
+
+    // a top-up beyond the batch size is split into several commits, and
+    // every key of it reaches the disk
+    uint64_t nCommitsBefore = bitdb.nCommits;
+    unsigned int nPoolSize = pwalletMain->GetKeyPoolSize();
+    unsigned int nNewKeys = 35;
+    BOOST_CHECK(pwalletMain->TopUpKeyPool(nPoolSize + nNewKeys - 1));
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), nPoolSize + nNewKeys);
+    BOOST_CHECK_EQUAL(bitdb.nCommits, nCommitsBefore + (nNewKeys + nKeypoolWriteBatchSize - 1) / nKeypoolWriteBatchSize);
+    BOOST_CHECK(pwalletMain->GetBatchDB() == NULL);
+
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    unsigned int nOnDisk = 0;
+    BOOST_FOREACH(int64_t nIndex, pwalletMain->setKeyPool)
+    {
+        CKeyPool keypool;
+        if (walletdb.ReadPool(nIndex, keypool) && pwalletMain->HaveKey(keypool.vchPubKey.GetID()))
+            nOnDisk++;
+    }
+    BOOST_CHECK_EQUAL(nOnDisk, pwalletMain->GetKeyPoolSize());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
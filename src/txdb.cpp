@@ -10,6 +10,8 @@
 
 #include <stdint.h>
 
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -175,62 +177,122 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+namespace {
+/** Block index records of one range of block hashes, decoded by one thread */
+struct CBlockIndexRange
 {
-    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    //! First byte of the stored block hashes, nBegin <= byte < nEnd
+    unsigned int nBegin;
+    unsigned int nEnd;
+
+    CBlockIndexArena arena;
+    std::vector<CBlockIndex*> vIndex;
+    //! Hash and previous block hash of each entry of vIndex
+    std::vector<std::pair<uint256, uint256> > vHashes;
+    //! Stake pointers used by proof of stake blocks, with the block
+    std::vector<std::pair<PointerHash, uint256> > vStakePointers;
+    std::string strError;
+};
+}
 
-    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
-    ssKeySet << make_pair('b', uint256());
-    pcursor->Seek(ssKeySet.str());
+static void DecodeBlockIndexRange(CBlockTreeDB* pdb, CBlockIndexRange* prange)
+{
+    try {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(pdb->NewIterator());
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        try {
+        uint256 hashBegin;
+        *hashBegin.begin() = prange->nBegin;
+        CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+        ssKeySet << make_pair('b', hashBegin);
+
+        for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+            // Keys are the type followed by the block hash
             leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash(), diskindex.fProofOfStake);
-                pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev, diskindex.fProofOfStake);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-                pindexNew->fProofOfStake  = diskindex.fProofOfStake;
-                pindexNew->stakeSource    = diskindex.stakeSource;
-                if (pindexNew->fProofOfStake) {
-                    COutPoint stakeSource(diskindex.stakeSource.first, diskindex.stakeSource.second);
-                    mapUsedStakePointers.emplace(stakeSource.GetHash(), diskindex.GetBlockHash());
-                }
+            if (slKey.size() < 2 || slKey[0] != 'b' || (unsigned char)slKey[1] >= prange->nEnd)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CDiskBlockIndex diskindex;
+            ssValue >> diskindex;
+
+            // Construct block index object, linked to the others later
+            CBlockIndex* pindexNew = prange->arena.Allocate();
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->fProofOfStake  = diskindex.fProofOfStake;
+            pindexNew->stakeSource    = diskindex.stakeSource;
+
+            uint256 hash = diskindex.GetBlockHash();
+            prange->vIndex.push_back(pindexNew);
+            prange->vHashes.push_back(make_pair(hash, diskindex.hashPrev));
+            if (pindexNew->fProofOfStake) {
+                COutPoint stakeSource(diskindex.stakeSource.first, diskindex.stakeSource.second);
+                prange->vStakePointers.push_back(make_pair(stakeSource.GetHash(), hash));
+            }
 
-                /* Bitcoin checks the PoW here.  We don't do this because
-                   the CDiskBlockIndex does not contain the auxpow.
-                   This check isn't important, since the data on disk should
-                   already be valid and can be trusted. */
+            /* Bitcoin checks the PoW here.  We don't do this because
+               the CDiskBlockIndex does not contain the auxpow.
+               This check isn't important, since the data on disk should
+               already be valid and can be trusted. */
+        }
+    } catch (const std::exception& e) {
+        prange->strError = e.what();
+    }
+}
 
-                pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
+bool CBlockTreeDB::LoadBlockIndexGuts()
+{
+    // Records are decoded and hashed in parallel, one range of block hashes
+    // per thread, each into its own arena
+    unsigned int nThreads = std::max(std::min(boost::thread::hardware_concurrency(), BLOCK_INDEX_LOAD_MAX_THREADS), 1u);
+    std::vector<CBlockIndexRange> vRanges(nThreads);
+    boost::thread_group decoders;
+    for (unsigned int i = 0; i < nThreads; i++) {
+        vRanges[i].nBegin = i * 256 / nThreads;
+        vRanges[i].nEnd = (i + 1) * 256 / nThreads;
+        decoders.create_thread(boost::bind(&DecodeBlockIndexRange, this, &vRanges[i]));
+    }
+    decoders.join_all();
+
+    size_t nTotal = 0;
+    for (unsigned int i = 0; i < nThreads; i++) {
+        blockIndexArena.Splice(vRanges[i].arena);
+        if (!vRanges[i].strError.empty())
+            return error("%s : Deserialize or I/O error - %s", __func__, vRanges[i].strError);
+        nTotal += vRanges[i].vIndex.size();
+    }
+
+    boost::this_thread::interruption_point();
+
+    // Load mapBlockIndex, all entries first so that the links find every loaded block
+    mapBlockIndex.reserve(mapBlockIndex.size() + nTotal);
+    BOOST_FOREACH(CBlockIndexRange& range, vRanges) {
+        for (size_t i = 0; i < range.vIndex.size(); i++) {
+            std::pair<BlockMap::iterator, bool> ret = mapBlockIndex.insert(make_pair(range.vHashes[i].first, range.vIndex[i]));
+            if (!ret.second) {
+                *ret.first->second = *range.vIndex[i];
+                range.vIndex[i] = ret.first->second;
             }
-        } catch (std::exception &e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+            range.vIndex[i]->phashBlock = &ret.first->first;
         }
     }
+    BOOST_FOREACH(CBlockIndexRange& range, vRanges) {
+        for (size_t i = 0; i < range.vIndex.size(); i++)
+            range.vIndex[i]->pprev = InsertBlockIndex(range.vHashes[i].second, range.vIndex[i]->fProofOfStake);
+        for (size_t i = 0; i < range.vStakePointers.size(); i++)
+            mapUsedStakePointers.emplace(range.vStakePointers[i].first, range.vStakePointers[i].second);
+    }
 
+    LogPrintf("%s: %u entries decoded on %u threads\n", __func__, nTotal, nThreads);
     return true;
 }
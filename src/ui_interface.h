@@ -13,6 +13,7 @@
 #include <boost/signals2/signal.hpp>
 
 class CBasicKeyStore;
+class CTxIn;
 class CWallet;
 class uint256;
 
@@ -98,6 +99,18 @@ public:
 
     /** New block has been accepted */
     boost::signals2::signal<void (const uint256& hash)> NotifyBlockTip;
+
+    /**
+     * Masternode added, updated (status or last ping) or removed.
+     * @note may be called with mnodeman.cs held.
+     */
+    boost::signals2::signal<void (const CTxIn& vin, ChangeType status)> NotifyMasternodeChanged;
+
+    /**
+     * Systemnode added, updated (status or last ping) or removed.
+     * @note may be called with snodeman.cs held.
+     */
+    boost::signals2::signal<void (const CTxIn& vin, ChangeType status)> NotifySystemnodeChanged;
 };
 
 extern CClientUIInterface uiInterface;
@@ -43,6 +43,10 @@
 #include <fcntl.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #else
 
@@ -834,6 +838,14 @@ void SetThreadPriority(int nPriority)
 #endif // WIN32
 }
 
+void SetThreadIOPriorityIdle()
+{
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    // IOPRIO_WHO_PROCESS with id 0 is the calling thread, the class is IOPRIO_CLASS_IDLE
+    syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+}
+
 std::string Sha256Sum(const std::string& filename)
 {
     std::string result;
@@ -204,6 +204,8 @@ bool SoftSetArg(const std::string& strArg, const std::string& strValue);
 bool SoftSetBoolArg(const std::string& strArg, bool fValue);
 
 void SetThreadPriority(int nPriority);
+/** Let the disk I/O of the calling thread only use otherwise idle time, where supported */
+void SetThreadIOPriorityIdle();
 void RenameThread(const char* name);
 
 /**
@@ -9,7 +9,7 @@
 /**
  * network protocol versioning
  */
-static const int PROTOCOL_VERSION = 70059;
+static const int PROTOCOL_VERSION = 70060;
 static const int PROTOCOL_POS_START = 70057;
 
 //! initial proto version, to be increased after version/verack negotiation
@@ -25,9 +25,15 @@ static const int MIN_POOL_PEER_PROTO_VERSION = 70059;
 //! minimum peer version for masternode budgets
 static const int MIN_BUDGET_PEER_PROTO_VERSION = 70059;
 
+//! minimum peer version that answers budget sync requests per shard
+static const int MIN_BUDGET_SHARD_PEER_PROTO_VERSION = 70060;
+
 //! minimum peer version for masternode winner broadcasts
 static const int MIN_MNW_PEER_PROTO_VERSION = 70059;
 
+//! minimum peer version that answers an inventory mnget/snget after an aggregated one
+static const int MIN_PAYMENT_VOTES_INV_PROTO_VERSION = 70060;
+
 //! minimum version to get version 2 masternode ping messages
 static const int MIN_MNW_PING_VERSION = 70059;
 
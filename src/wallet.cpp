@@ -26,6 +26,7 @@
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 
@@ -40,6 +41,8 @@ unsigned int nTxConfirmTarget = 1;
 bool bSpendZeroConfChange = true;
 bool fSendFreeTransactions = false;
 bool fPayAtLeastCustomFee = true;
+//! only lowered by the unit tests, to split a small top-up into several commits
+unsigned int nKeypoolWriteBatchSize = DEFAULT_KEYPOOL_WRITE_BATCH_SIZE;
 
 /** 
  * Fees smaller than this (in crowns) are considered zero fee (for transaction creation)
@@ -118,6 +121,10 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
+        if (CWalletDB* pwalletdb = GetBatchDB())
+            return pwalletdb->WriteKey(pubkey,
+                                       secret.GetPrivKey(),
+                                       mapKeyMetadata[pubkey.GetID()]);
         return CWalletDB(strWalletFile).WriteKey(pubkey,
                                                  secret.GetPrivKey(),
                                                  mapKeyMetadata[pubkey.GetID()]);
@@ -138,6 +145,10 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
             return pwalletdbEncryption->WriteCryptedKey(vchPubKey,
                                                         vchCryptedSecret,
                                                         mapKeyMetadata[vchPubKey.GetID()]);
+        else if (CWalletDB* pwalletdb = GetBatchDB())
+            return pwalletdb->WriteCryptedKey(vchPubKey,
+                                              vchCryptedSecret,
+                                              mapKeyMetadata[vchPubKey.GetID()]);
         else
             return CWalletDB(strWalletFile).WriteCryptedKey(vchPubKey,
                                                             vchCryptedSecret,
@@ -533,6 +544,8 @@ int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb)
 {
     AssertLockHeld(cs_wallet); // nOrderPosNext
     int64_t nRet = nOrderPosNext++;
+    if (!pwalletdb)
+        pwalletdb = GetBatchDB();
     if (pwalletdb) {
         pwalletdb->WriteOrderPosNext(nOrderPosNext);
     } else {
@@ -541,10 +554,61 @@ int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb)
     return nRet;
 }
 
+void CWallet::BeginWriteBatch()
+{
+    AssertLockHeld(cs_wallet);
+    nWriteBatchDepth++;
+}
+
+bool CWallet::CommitWriteBatch()
+{
+    AssertLockHeld(cs_wallet);
+    assert(nWriteBatchDepth > 0);
+    if (--nWriteBatchDepth > 0 || !pwalletdbBatch)
+        return true;
+
+    bool fOk = pwalletdbBatch->TxnCommit();
+    delete pwalletdbBatch;
+    pwalletdbBatch = NULL;
+    if (!fOk)
+        LogPrintf("CWallet::CommitWriteBatch() : commit failed\n");
+    return fOk;
+}
+
+void CWallet::AbortWriteBatch()
+{
+    AssertLockHeld(cs_wallet);
+    assert(nWriteBatchDepth > 0);
+    if (--nWriteBatchDepth > 0 || !pwalletdbBatch)
+        return;
+
+    pwalletdbBatch->TxnAbort();
+    delete pwalletdbBatch;
+    pwalletdbBatch = NULL;
+}
+
+CWalletDB* CWallet::GetBatchDB() const
+{
+    LOCK(cs_wallet);
+    if (nWriteBatchDepth == 0)
+        return NULL;
+    if (!pwalletdbBatch) {
+        pwalletdbBatch = new CWalletDB(strWalletFile);
+        // without a transaction the batch still shares one handle and flush
+        if (!pwalletdbBatch->TxnBegin())
+            LogPrintf("CWallet::GetBatchDB() : could not begin transaction, writing unbatched\n");
+    }
+    return pwalletdbBatch;
+}
+
 CWallet::TxItems CWallet::OrderedTxItems(std::list<CAccountingEntry>& acentries, std::string strAccount)
 {
     AssertLockHeld(cs_wallet); // mapWallet
-    CWalletDB walletdb(strWalletFile);
+    // inside a write batch, read through its handle so we see (and don't
+    // block on) the records it has written so far
+    CWalletDB* pwalletdbBatchRead = GetBatchDB();
+    boost::scoped_ptr<CWalletDB> pwalletdbOwned(pwalletdbBatchRead ? NULL : new CWalletDB(strWalletFile));
+    CWalletDB& walletdb = pwalletdbBatchRead ? *pwalletdbBatchRead : *pwalletdbOwned;
 
     // First: get all CWalletTx and CAccountingEntry into a sorted-by-order multimap.
     TxItems txOrdered;
@@ -581,8 +645,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
     if (fFromLoadWallet)
     {
-        mapWallet[hash] = wtxIn;
-        mapWallet[hash].BindWallet(this);
+        CWalletTx& wtx = mapWallet[hash];
+        wtx = wtxIn;
+        wtx.BindWallet(this);
         AddToSpends(hash);
     }
     else
@@ -938,6 +1003,8 @@ void CWalletTx::GetAccountAmounts(const string& strAccount, CAmount& nReceived,
 
 bool CWalletTx::WriteToDisk()
 {
+    if (CWalletDB* pwalletdb = pwallet->GetBatchDB())
+        return pwalletdb->WriteTx(GetHash(), *this);
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
@@ -970,11 +1037,13 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 
             CBlock block;
             ReadBlockFromDisk(block, pindex);
+            CWalletWriteBatch batch(this);
             BOOST_FOREACH(CTransaction& tx, block.vtx)
             {
                 if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
                     ret++;
             }
+            batch.Commit();
             pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
@@ -989,6 +1058,8 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 void CWallet::ReacceptWalletTransactions()
 {
     LOCK2(cs_main, cs_wallet);
+    // wallet updates triggered through SyncTransaction share one commit
+    CWalletWriteBatch batch(this);
     BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
     {
         const uint256& wtxid = item.first;
@@ -1004,6 +1075,7 @@ void CWallet::ReacceptWalletTransactions()
             wtx.AcceptToMemoryPool(false);
         }
     }
+    batch.Commit();
 }
 
 void CWalletTx::RelayWalletTransaction(std::string strCommand)
@@ -1910,10 +1982,9 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey)
         LOCK2(cs_main, cs_wallet);
         LogPrintf("CommitTransaction:\n%s", wtxNew.ToString());
         {
-            // This is only to keep the database open to defeat the auto-flush for the
-            // duration of this scope.  This is the only place where this optimization
-            // maybe makes sense; please don't do it anywhere else.
-            CWalletDB* pwalletdb = fFileBacked ? new CWalletDB(strWalletFile,"r") : NULL;
+            // The key pool, order position and transaction records of a send are
+            // written as one batch, so a send costs a single commit and flush.
+            CWalletWriteBatch batch(this);
 
             // Take key pair from key pool so it won't be used again
             reservekey.KeepKey();
@@ -1934,8 +2005,8 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey)
                 NotifyTransactionChanged(this, txin.prevout.hash, CT_UPDATED);
                 updated_hahes.insert(txin.prevout.hash);
             }
-            if (fFileBacked)
-                delete pwalletdb;
+            if (!batch.Commit())
+                LogPrintf("CommitTransaction() : Error: writing transaction to the wallet failed\n");
         }
 
         // Track how many getdata requests our transaction gets
@@ -2305,20 +2376,49 @@ bool CWallet::NewKeyPool()
 {
     {
         LOCK(cs_wallet);
-        CWalletDB walletdb(strWalletFile);
-        BOOST_FOREACH(int64_t nIndex, setKeyPool)
-            walletdb.ErasePool(nIndex);
-        setKeyPool.clear();
+
+        // Erase and write in chunks of nKeypoolWriteBatchSize keys, a
+        // single transaction for a large pool would run out of locks.
+        while (!setKeyPool.empty())
+        {
+            CWalletWriteBatch batch(this);
+            CWalletDB* pwalletdb = GetBatchDB();
+            std::set<int64_t>::iterator it = setKeyPool.begin();
+            for (unsigned int n = 0; n < nKeypoolWriteBatchSize && it != setKeyPool.end(); n++, ++it)
+                pwalletdb->ErasePool(*it);
+            if (!batch.Commit())
+                return false;
+            setKeyPool.erase(setKeyPool.begin(), it);
+        }
 
         if (IsLocked())
             return false;
 
         int64_t nKeys = max(GetArg("-keypool", 1000), (int64_t) 0);
-        for (int i = 0; i < nKeys; i++)
+        int64_t nIndex = 1;
+        while (nIndex <= nKeys)
         {
-            int64_t nIndex = i+1;
-            walletdb.WritePool(nIndex, CKeyPool(GenerateNewKey()));
-            setKeyPool.insert(nIndex);
+            CWalletWriteBatch batch(this);
+            CWalletDB* pwalletdb = GetBatchDB();
+            if (CanSupportFeature(FEATURE_COMPRPUBKEY))
+                SetMinVersion(FEATURE_COMPRPUBKEY, pwalletdb);
+
+            // Indexes whose keys did not make it to disk leave the pool again
+            int64_t nFirst = nIndex;
+            try {
+                for (; nIndex <= nKeys && nIndex < nFirst + nKeypoolWriteBatchSize; nIndex++)
+                {
+                    pwalletdb->WritePool(nIndex, CKeyPool(GenerateNewKey()));
+                    setKeyPool.insert(nIndex);
+                }
+            } catch (...) {
+                setKeyPool.erase(setKeyPool.lower_bound(nFirst), setKeyPool.end());
+                throw;
+            }
+            if (!batch.Commit()) {
+                setKeyPool.erase(setKeyPool.lower_bound(nFirst), setKeyPool.end());
+                return false;
+            }
         }
         LogPrintf("CWallet::NewKeyPool wrote %d new keys\n", nKeys);
     }
@@ -2333,8 +2433,6 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         if (IsLocked())
             return false;
 
-        CWalletDB walletdb(strWalletFile);
-
         // Top up key pool
         unsigned int nTargetSize;
         if (kpSize > 0)
@@ -2342,19 +2440,52 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         else
             nTargetSize = max(GetArg("-keypool", 1000), (int64_t) 0);
 
+        if (setKeyPool.size() >= (nTargetSize + 1))
+            return true;
+
+        // Generate, encrypt and write the missing keys as write batches of
+        // nKeypoolWriteBatchSize keys, so the handle is committed and
+        // flushed once per batch instead of once per key, while a single
+        // transaction for a large pool would run out of locks.
+        unsigned int nAdded = 0;
+        int nLastProgress = -1;
         while (setKeyPool.size() < (nTargetSize + 1))
         {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error("TopUpKeyPool() : writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
+            CWalletWriteBatch batch(this);
+            CWalletDB* pwalletdb = GetBatchDB();
+
+            // Make sure GenerateNewKey has no reason to write the wallet version
+            // through a second handle while the batch transaction is open.
+            if (CanSupportFeature(FEATURE_COMPRPUBKEY))
+                SetMinVersion(FEATURE_COMPRPUBKEY, pwalletdb);
+
+            // Indexes whose keys did not make it to disk leave the pool again
+            int64_t nFirst = setKeyPool.empty() ? 1 : *(--setKeyPool.end()) + 1;
+            try {
+                for (unsigned int n = 0; n < nKeypoolWriteBatchSize && setKeyPool.size() < (nTargetSize + 1); n++)
+                {
+                    int64_t nEnd = 1;
+                    if (!setKeyPool.empty())
+                        nEnd = *(--setKeyPool.end()) + 1;
+                    if (!pwalletdb->WritePool(nEnd, CKeyPool(GenerateNewKey())))
+                        throw runtime_error("TopUpKeyPool() : writing generated key failed");
+                    setKeyPool.insert(nEnd);
+                    nAdded++;
+                    int nProgress = (int)(100 * nEnd / (nTargetSize + 1));
+                    if (nProgress != nLastProgress) {
+                        nLastProgress = nProgress;
+                        std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), (double)nProgress);
+                        uiInterface.InitMessage(strMsg);
+                    }
+                }
+                if (!batch.Commit())
+                    throw runtime_error("TopUpKeyPool() : committing generated keys failed");
+            } catch (...) {
+                setKeyPool.erase(setKeyPool.lower_bound(nFirst), setKeyPool.end());
+                throw;
+            }
         }
+        LogPrintf("keypool added %u keys, size=%u\n", nAdded, setKeyPool.size());
     }
     return true;
 }
@@ -2391,8 +2522,10 @@ void CWallet::KeepKey(int64_t nIndex)
     // Remove from key pool
     if (fFileBacked)
     {
-        CWalletDB walletdb(strWalletFile);
-        walletdb.ErasePool(nIndex);
+        if (CWalletDB* pwalletdb = GetBatchDB())
+            pwalletdb->ErasePool(nIndex);
+        else
+            CWalletDB(strWalletFile).ErasePool(nIndex);
     }
     LogPrintf("keypool keep %d\n", nIndex);
 }
@@ -39,6 +39,7 @@ extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fSendFreeTransactions;
 extern bool fPayAtLeastCustomFee;
+extern unsigned int nKeypoolWriteBatchSize;
 
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
@@ -50,6 +51,8 @@ static const CAmount DEFAULT_TRANSACTION_MAXFEE = 0.2 * COIN; // "smallest denom
 static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWarning;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
+//! Keys written per transaction when filling the key pool, far below the lock limit of the wallet environment
+static const unsigned int DEFAULT_KEYPOOL_WRITE_BATCH_SIZE = 1000;
 
 static const int MASTERNODE_COLLATERAL = 10000;
 static const int SYSTEMNODE_COLLATERAL = 500;
@@ -144,6 +147,10 @@ private:
 
     CWalletDB *pwalletdbEncryption;
 
+    //! open write batch (see CWalletWriteBatch): nesting depth and its lazily opened handle
+    int nWriteBatchDepth;
+    mutable CWalletDB *pwalletdbBatch;
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion;
 
@@ -214,6 +221,7 @@ public:
     ~CWallet()
     {
         delete pwalletdbEncryption;
+        delete pwalletdbBatch;
     }
 
     void SetNull()
@@ -223,6 +231,8 @@ public:
         fFileBacked = false;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
+        nWriteBatchDepth = 0;
+        pwalletdbBatch = NULL;
         nOrderPosNext = 0;
         nNextResend = 0;
         nLastResend = 0;
@@ -309,6 +319,13 @@ public:
      */
     int64_t IncOrderPosNext(CWalletDB *pwalletdb = NULL);
 
+    /** Write batching, normally used through CWalletWriteBatch. */
+    void BeginWriteBatch();
+    bool CommitWriteBatch();
+    void AbortWriteBatch();
+    //! Handle of the open write batch, or NULL if none is open
+    CWalletDB* GetBatchDB() const;
+
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
     typedef std::multimap<int64_t, TxPair > TxItems;
 
@@ -505,6 +522,38 @@ public:
     boost::signals2::signal<void (bool fHaveWatchOnly)> NotifyWatchonlyChanged;
 };
 
+/**
+ * Groups the wallet database writes of one logical operation (a keypool
+ * top-up, a send, a rescanned block) into a single transaction, so they
+ * cost one commit instead of one per record. The transaction is opened on
+ * the first write; nested batches join the outermost one. cs_wallet must
+ * be held for the whole lifetime of the batch.
+ */
+class CWalletWriteBatch
+{
+private:
+    CWallet* pwallet;
+    bool fDone;
+
+public:
+    CWalletWriteBatch(CWallet* pwalletIn) : pwallet(pwalletIn), fDone(false)
+    {
+        pwallet->BeginWriteBatch();
+    }
+
+    ~CWalletWriteBatch()
+    {
+        if (!fDone)
+            pwallet->AbortWriteBatch();
+    }
+
+    bool Commit()
+    {
+        fDone = true;
+        return pwallet->CommitWriteBatch();
+    }
+};
+
 /** A key allocated from the key pool. */
 class CReserveKey
 {
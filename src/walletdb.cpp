@@ -343,9 +343,49 @@ public:
     }
 };
 
+/**
+ * A record read from the wallet cursor ahead of ReadKeyValue. LoadWallet
+ * reads records in batches and deserializes the "tx" records of a batch
+ * on worker threads before applying the whole batch in cursor order.
+ */
+struct CWalletLoadRecord
+{
+    CDataStream ssKey;
+    CDataStream ssValue;
+    bool fTxDecoded;
+    bool fTxDecodeFailed;
+    CWalletTx wtx;
+
+    CWalletLoadRecord() : ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION)
+    {
+        fTxDecoded = false;
+        fTxDecodeFailed = false;
+    }
+};
+
+static void DecodeWalletTxRecords(std::vector<CWalletLoadRecord>* pvRecords, size_t nCount, size_t nBegin, size_t nStep)
+{
+    for (size_t i = nBegin; i < nCount; i += nStep)
+    {
+        CWalletLoadRecord& record = (*pvRecords)[i];
+        try {
+            CDataStream ssKey(record.ssKey);
+            string strType;
+            ssKey >> strType;
+            if (strType != "tx")
+                continue;
+            record.ssValue >> record.wtx;
+            record.fTxDecoded = true;
+        } catch (...) {
+            record.fTxDecodeFailed = true;
+        }
+    }
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
-             CWalletScanState &wss, string& strType, string& strErr)
+             CWalletScanState &wss, string& strType, string& strErr,
+             CWalletTx* pwtxDecoded = NULL)
 {
     try {
         // Unserialize
@@ -376,8 +416,10 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         {
             uint256 hash;
             ssKey >> hash;
-            CWalletTx wtx;
-            ssValue >> wtx;
+            CWalletTx wtxRead;
+            CWalletTx& wtx = pwtxDecoded ? *pwtxDecoded : wtxRead;
+            if (!pwtxDecoded)
+                ssValue >> wtx;
             CValidationState state;
             if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
                 return false;
@@ -641,39 +683,80 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
-        while (true)
+        unsigned int nThreads = std::max(std::min(boost::thread::hardware_concurrency(), (unsigned int)WALLET_LOAD_MAX_THREADS), 1u);
+        std::vector<CWalletLoadRecord> vRecords(WALLET_LOAD_BATCH_SIZE);
+        bool fEnd = false;
+        while (!fEnd)
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            // Read the next batch of records in cursor order
+            size_t nCount = 0;
+            while (nCount < vRecords.size())
             {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+                CWalletLoadRecord& record = vRecords[nCount];
+                record.ssKey.clear();
+                record.ssValue.clear();
+                record.fTxDecoded = false;
+                record.fTxDecodeFailed = false;
+                int ret = ReadAtCursor(pcursor, record.ssKey, record.ssValue);
+                if (ret == DB_NOTFOUND)
+                {
+                    fEnd = true;
+                    break;
+                }
+                else if (ret != 0)
+                {
+                    LogPrintf("Error reading next record from wallet database\n");
+                    pcursor->close();
+                    return DB_CORRUPT;
+                }
+                nCount++;
             }
 
-            // Try to be tolerant of single corrupt records:
-            string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            // Deserialize the transactions of the batch in parallel; hashing
+            // them dominates the load time of large wallets
+            if (nThreads > 1 && nCount > 1)
+            {
+                boost::thread_group threadGroup;
+                for (unsigned int i = 0; i < nThreads; i++)
+                    threadGroup.create_thread(boost::bind(&DecodeWalletTxRecords, &vRecords, nCount, i, nThreads));
+                threadGroup.join_all();
+            }
+            else
+                DecodeWalletTxRecords(&vRecords, nCount, 0, 1);
+
+            for (size_t i = 0; i < nCount; i++)
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType))
-                    result = DB_CORRUPT;
+                CWalletLoadRecord& record = vRecords[i];
+
+                // Try to be tolerant of single corrupt records:
+                string strType, strErr;
+                bool fReadOK;
+                if (record.fTxDecodeFailed)
+                {
+                    strType = "tx";
+                    fReadOK = false;
+                }
                 else
+                    fReadOK = ReadKeyValue(pwallet, record.ssKey, record.ssValue, wss, strType, strErr,
+                                           record.fTxDecoded ? &record.wtx : NULL);
+                if (!fReadOK)
                 {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        SoftSetBoolArg("-rescan", true);
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(strType))
+                        result = DB_CORRUPT;
+                    else
+                    {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            SoftSetBoolArg("-rescan", true);
+                    }
                 }
+                if (!strErr.empty())
+                    LogPrintf("%s\n", strErr);
             }
-            if (!strErr.empty())
-                LogPrintf("%s\n", strErr);
         }
         pcursor->close();
     }
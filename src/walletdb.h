@@ -28,6 +28,11 @@ class CWalletTx;
 class uint160;
 class uint256;
 
+//! Wallet records read per batch by LoadWallet
+static const unsigned int WALLET_LOAD_BATCH_SIZE = 4096;
+//! Maximum number of threads LoadWallet uses to deserialize transactions
+static const unsigned int WALLET_LOAD_MAX_THREADS = 8;
+
 /** Error statuses for the wallet database */
 enum DBErrors
 {